@@ -0,0 +1,82 @@
+#!/usr/bin/env python3
+
+# Compare automating parameters from python a block at a time, with setParamVal and
+# processMultiBlock, against handing the whole automation to renderEvents.
+#
+# Run with surgepy on your PYTHONPATH, for instance
+#   PYTHONPATH=build python3 scripts/misc/surgepy-automation-benchmark.py 24 4000
+
+import sys
+import time
+
+import numpy as np
+import surgepy
+
+
+def automatableParams(s, count):
+    # Continuous parameters from the scene A oscillators, filters, envelopes and LFOs
+    res = []
+    for cg in [surgepy.constants.cg_OSC, surgepy.constants.cg_FILTER,
+               surgepy.constants.cg_ENV, surgepy.constants.cg_LFO]:
+        for ent in s.getControlGroup(cg).getEntries():
+            if ent.getScene() != 1:
+                continue
+            for p in ent.getParams():
+                if s.getParamValType(p) == "float":
+                    res.append(p)
+    return res[:count]
+
+
+def curves(s, params, nBlocks):
+    t = np.linspace(0, 1, nBlocks, dtype=np.float32)
+    res = {}
+    for i, p in enumerate(params):
+        lo, hi = s.getParamMin(p), s.getParamMax(p)
+        wave = 0.5 + 0.5 * np.sin(2 * np.pi * (i + 1) * t)
+        res[p] = (lo + (hi - lo) * wave).astype(np.float32)
+    return res
+
+
+def startNote(s):
+    s.playNote(0, 60, 100, 0)
+
+
+def perBlock(params, nBlocks):
+    s = surgepy.createSurge(48000)
+    auto = curves(s, params, nBlocks)
+    buf = s.createMultiBlock(nBlocks)
+    startNote(s)
+
+    start = time.perf_counter()
+    for b in range(nBlocks):
+        for p in params:
+            s.setParamVal(p, float(auto[p][b]))
+        s.processMultiBlock(buf, b, 1)
+    return time.perf_counter() - start
+
+
+def vectorized(params, nBlocks):
+    s = surgepy.createSurge(48000)
+    auto = curves(s, params, nBlocks)
+    events = np.zeros(0, dtype=surgepy.eventDtype())
+    startNote(s)
+
+    start = time.perf_counter()
+    s.renderEvents(events, nBlocks * s.getBlockSize(), auto)
+    return time.perf_counter() - start
+
+
+def main():
+    count = int(sys.argv[1]) if len(sys.argv) > 1 else 24
+    nBlocks = int(sys.argv[2]) if len(sys.argv) > 2 else 4000
+
+    params = automatableParams(surgepy.createSurge(48000), count)
+    print("Automating", len(params), "parameters over", nBlocks, "blocks")
+
+    for name, fn in [("per block", perBlock), ("vectorized", vectorized)]:
+        secs = min(fn(params, nBlocks) for _ in range(3))
+        print("%-10s : %10.0f blocks/s" % (name, nBlocks / secs))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,132 @@
+/*
+** Surge Synthesizer is Free and Open Source Software
+**
+** Surge is made available under the Gnu General Public License, v3.0
+** https://www.gnu.org/licenses/gpl-3.0.en.html
+**
+** Copyright 2004-2021 by various individuals as described by the Git transaction log
+**
+** All source at: https://github.com/surge-synthesizer/surge.git
+**
+** Surge was a commercial product from 2004-2018, with Copyright and ownership
+** in that period held by Claes Johanson at Vember Audio. Claes made Surge
+** open source in September 2018.
+*/
+
+#include "BlockProfiler.h"
+
+#include <algorithm>
+
+namespace Surge
+{
+namespace Profiling
+{
+std::string BlockProfiler::stageName(int stage)
+{
+    static const char sceneNames[] = "AB";
+
+    if (stage == st_block)
+        return "block";
+    if (stage == st_control)
+        return "control";
+    if (stage >= st_scene && stage < st_voices)
+        return std::string("scene ") + sceneNames[(stage - st_scene) % 2];
+    if (stage >= st_voices && stage < st_filters)
+        return std::string("scene ") + sceneNames[(stage - st_voices) % 2] + " voices";
+    if (stage >= st_filters && stage < st_fx)
+        return std::string("scene ") + sceneNames[(stage - st_filters) % 2] + " filters";
+    if (stage >= st_fx && stage < n_stages)
+        return fxslot_names[stage - st_fx];
+    return "unknown";
+}
+
+void BlockProfiler::endBlock()
+{
+    if (resetRequested.exchange(false, std::memory_order_relaxed))
+    {
+        for (auto &t : totals)
+            t.store(0, std::memory_order_relaxed);
+        sinceReset.store(0, std::memory_order_relaxed);
+        // Readers only look at the rows written since the last reset
+        written.store(0, std::memory_order_release);
+    }
+
+    auto w = written.load(std::memory_order_relaxed);
+    auto &row = history[w % historySize];
+    for (int s = 0; s < n_stages; ++s)
+    {
+        auto ns = pending[s].exchange(0, std::memory_order_relaxed);
+        row[s].store((uint32_t)std::min(ns, (uint64_t)UINT32_MAX), std::memory_order_relaxed);
+        totals[s].fetch_add(ns, std::memory_order_relaxed);
+    }
+    sinceReset.fetch_add(1, std::memory_order_relaxed);
+    written.store(w + 1, std::memory_order_release);
+}
+
+BlockProfiler::Stats BlockProfiler::stats() const
+{
+    Stats res;
+    res.blocks = sinceReset.load(std::memory_order_relaxed);
+
+    auto end = written.load(std::memory_order_acquire);
+    auto begin = end > (uint64_t)historySize ? end - historySize : 0;
+
+    std::vector<std::vector<uint32_t>> rows;
+    rows.reserve(end - begin);
+    for (auto r = begin; r < end; ++r)
+    {
+        std::vector<uint32_t> row(n_stages);
+        for (int s = 0; s < n_stages; ++s)
+            row[s] = history[r % historySize][s].load(std::memory_order_relaxed);
+        rows.push_back(std::move(row));
+    }
+
+    /*
+     * Anything the audio thread has come round to since we started may be half overwritten,
+     * and that includes the slot it may be filling now, after % historySize
+     */
+    auto after = written.load(std::memory_order_acquire);
+    size_t firstGood = 0;
+    if (after < end)
+        rows.clear(); // reset underneath us
+    else if (after + 1 > begin + historySize)
+        firstGood = std::min<size_t>(rows.size(), after + 1 - begin - historySize);
+    rows.erase(rows.begin(), rows.begin() + firstGood);
+
+    res.historyBlocks = (int)rows.size();
+    if (rows.empty())
+        return res;
+
+    double blockSum = 0;
+    for (auto &r : rows)
+        blockSum += r[st_block];
+
+    std::vector<double> v(rows.size());
+    for (int s = 0; s < n_stages; ++s)
+    {
+        double sum = 0;
+        for (size_t i = 0; i < rows.size(); ++i)
+        {
+            v[i] = rows[i][s];
+            sum += v[i];
+        }
+        auto total = totals[s].load(std::memory_order_relaxed);
+        if (sum == 0 && total == 0)
+            continue;
+
+        std::sort(v.begin(), v.end());
+        StageStats st;
+        st.name = stageName(s);
+        st.stage = s;
+        st.mean = sum / v.size();
+        st.p50 = v[v.size() / 2];
+        st.p99 = v[std::min(v.size() - 1, v.size() * 99 / 100)];
+        st.max = v.back();
+        st.share = blockSum > 0 ? sum / blockSum : 0;
+        st.totalNS = total;
+        res.stages.push_back(st);
+    }
+    return res;
+}
+} // namespace Profiling
+} // namespace Surge
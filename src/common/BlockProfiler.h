@@ -0,0 +1,166 @@
+/*
+** Surge Synthesizer is Free and Open Source Software
+**
+** Surge is made available under the Gnu General Public License, v3.0
+** https://www.gnu.org/licenses/gpl-3.0.en.html
+**
+** Copyright 2004-2021 by various individuals as described by the Git transaction log
+**
+** All source at: https://github.com/surge-synthesizer/surge.git
+**
+** Surge was a commercial product from 2004-2018, with Copyright and ownership
+** in that period held by Claes Johanson at Vember Audio. Claes made Surge
+** open source in September 2018.
+*/
+
+#ifndef SURGE_XT_BLOCKPROFILER_H
+#define SURGE_XT_BLOCKPROFILER_H
+
+#include "SurgeStorage.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+ * Build with -DSURGE_BLOCK_PROFILING=TRUE to compile the timing points in. Without it the
+ * SURGE_PROFILE_ macros are empty and SurgeStorage::profiler is never made, so a release build
+ * pays nothing.
+ */
+#ifndef SURGE_BLOCK_PROFILING
+#define SURGE_BLOCK_PROFILING 0
+#endif
+
+namespace Surge
+{
+namespace Profiling
+{
+/*
+ * BlockProfiler records how long each stage of SurgeSynthesizer::process took, block by block:
+ * the whole block, the control rate work, each scene, the voices and the filter chains of each
+ * scene, and each FX slot. Stages add their time as they finish and the audio thread closes the
+ * block, moving the sums into a ring of the last historySize blocks.
+ *
+ * Everything is atomic, so stages may add from the scene and voice worker threads and any thread
+ * may read stats() at any time without holding up the audio thread. A read which overlaps the
+ * audio thread wrapping the ring drops the rows it may have torn.
+ */
+class BlockProfiler
+{
+  public:
+    enum Stage
+    {
+        st_block = 0,
+        st_control,
+        st_scene,
+        st_voices = st_scene + n_scenes,
+        st_filters = st_voices + n_scenes,
+        st_fx = st_filters + n_scenes,
+
+        n_stages = st_fx + n_fx_slots
+    };
+
+    static constexpr int historySize = 512;
+
+    static std::string stageName(int stage);
+
+    static inline uint64_t now()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+    inline void add(int stage, uint64_t ns)
+    {
+        pending[stage].fetch_add(ns, std::memory_order_relaxed);
+    }
+
+    // Audio thread only
+    void endBlock();
+
+    // Clears the history; takes effect at the end of the next block
+    void reset() { resetRequested.store(true, std::memory_order_relaxed); }
+
+    struct StageStats
+    {
+        std::string name;
+        int stage;
+        // Over the blocks in the history; ns per block
+        double mean, p50, p99, max;
+        // Of the whole block's time over the same blocks
+        double share;
+        // Since the last reset
+        uint64_t totalNS;
+    };
+
+    struct Stats
+    {
+        uint64_t blocks; // since the last reset
+        int historyBlocks;
+        std::vector<StageStats> stages; // only stages which ran
+    };
+
+    // Any thread
+    Stats stats() const;
+
+    /*
+     * Times the enclosing scope into a stage. With no profiler it does nothing, so callers can
+     * pass storage->profiler.get() unconditionally.
+     */
+    struct Scope
+    {
+        Scope(BlockProfiler *p, int stage) : p(p), stage(stage), start(p ? now() : 0) {}
+        ~Scope()
+        {
+            if (p)
+                p->add(stage, now() - start);
+        }
+        BlockProfiler *p;
+        int stage;
+        uint64_t start;
+    };
+
+    // Times the whole block and closes it
+    struct BlockScope
+    {
+        BlockScope(BlockProfiler *p) : p(p), start(p ? now() : 0) {}
+        ~BlockScope()
+        {
+            if (p)
+            {
+                p->add(st_block, now() - start);
+                p->endBlock();
+            }
+        }
+        BlockProfiler *p;
+        uint64_t start;
+    };
+
+  private:
+    std::atomic<uint64_t> pending[n_stages]{};
+    std::atomic<uint64_t> totals[n_stages]{};
+    std::atomic<uint32_t> history[historySize][n_stages]{};
+    std::atomic<uint64_t> written{0}, sinceReset{0};
+    std::atomic<bool> resetRequested{false};
+};
+} // namespace Profiling
+} // namespace Surge
+
+#if SURGE_BLOCK_PROFILING
+#define SURGE_PROFILE_CAT2(a, b) a##b
+#define SURGE_PROFILE_CAT(a, b) SURGE_PROFILE_CAT2(a, b)
+#define SURGE_PROFILE_SCOPE(storagePtr, stage)                                                     \
+    Surge::Profiling::BlockProfiler::Scope SURGE_PROFILE_CAT(surgeProfileScope, __LINE__)(        \
+        (storagePtr) ? (storagePtr)->profiler.get() : nullptr, (stage))
+#define SURGE_PROFILE_BLOCK(storagePtr)                                                            \
+    Surge::Profiling::BlockProfiler::BlockScope surgeProfileBlock(                                 \
+        (storagePtr) ? (storagePtr)->profiler.get() : nullptr)
+#else
+#define SURGE_PROFILE_SCOPE(storagePtr, stage)
+#define SURGE_PROFILE_BLOCK(storagePtr)
+#endif
+
+#endif // SURGE_XT_BLOCKPROFILER_H
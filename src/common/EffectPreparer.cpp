@@ -0,0 +1,200 @@
+/*
+** Surge Synthesizer is Free and Open Source Software
+**
+** Surge is made available under the Gnu General Public License, v3.0
+** https://www.gnu.org/licenses/gpl-3.0.en.html
+**
+** Copyright 2004-2021 by various individuals as described by the Git transaction log
+**
+** All source at: https://github.com/surge-synthesizer/surge.git
+**
+** Surge was a commercial product from 2004-2018, with Copyright and ownership
+** in that period held by Claes Johanson at Vember Audio. Claes made Surge
+** open source in September 2018.
+*/
+
+#include "EffectPreparer.h"
+
+#include <cstring>
+
+namespace Surge
+{
+namespace Storage
+{
+void setupEffectParameters(Effect *e, FxStorage *fxdata, bool initDefaults)
+{
+    e->init_ctrltypes();
+    if (initDefaults)
+    {
+        e->init_default_values();
+        return;
+    }
+
+    for (int j = 0; j < n_fx_params; j++)
+    {
+        auto p = &(fxdata->p[j]);
+        if (p->ctrltype != ct_none)
+        {
+            if (p->valtype == vt_float)
+            {
+                if (p->val.f < p->val_min.f)
+                {
+                    p->val.f = p->val_min.f;
+                }
+                if (p->val.f > p->val_max.f)
+                {
+                    p->val.f = p->val_max.f;
+                }
+            }
+            else if (p->valtype == vt_int)
+            {
+                if (p->val.i < p->val_min.i)
+                {
+                    p->val.i = p->val_min.i;
+                }
+                if (p->val.i > p->val_max.i)
+                {
+                    p->val.i = p->val_max.i;
+                }
+            }
+        }
+    }
+}
+
+EffectPreparer::EffectPreparer(SurgeStorage *storage, ServiceThread *service)
+    : storage(storage), serviceThread(service)
+{
+    serviceThread->setHandler(ServiceThread::fxLoad, [this]() { return this->service(); });
+}
+
+EffectPreparer::~EffectPreparer()
+{
+    // The service thread has been stopped by now, so tidy up whatever was left in flight
+    EffectSlabDeleter del;
+    for (auto &slot : slots)
+        del(slot.effect);
+    while (retireRead != retireWrite)
+    {
+        del(retireQueue[retireRead]);
+        retireRead = (retireRead + 1) % retireQueueSize;
+    }
+}
+
+Effect *EffectPreparer::takePrepared(int slot, const FxStorage &sync, bool initDefaults,
+                                     FxStorage *fxdata, pdata *pd, const FxStorage *&settled)
+{
+    auto &s = slots[slot];
+    auto st = s.state.load(std::memory_order_acquire);
+    settled = nullptr;
+
+    if (st == ready)
+    {
+        auto e = s.effect;
+        s.effect = nullptr;
+        s.state.store(idle, std::memory_order_release);
+
+        bool same = s.type == sync.type.val.i && s.initDefaults == initDefaults &&
+                    s.fxdata == fxdata && s.pd == pd;
+        for (int j = 0; j < n_fx_params && same && !initDefaults; j++)
+            same = s.requested[j].i == sync.p[j].val.i;
+
+        if (same)
+        {
+            settled = &s.settings;
+            return e;
+        }
+
+        // The user moved on while we were building this one
+        retire(e);
+        st = idle;
+    }
+
+    if (st == idle)
+    {
+        s.type = sync.type.val.i;
+        s.initDefaults = initDefaults;
+        s.fxdata = fxdata;
+        s.pd = pd;
+        memcpy((void *)&s.settings, (const void *)&sync, sizeof(FxStorage));
+        for (int j = 0; j < n_fx_params; j++)
+            s.requested[j].i = sync.p[j].val.i;
+        s.state.store(requested, std::memory_order_release);
+        serviceThread->post(ServiceThread::fxLoad);
+    }
+
+    return nullptr;
+}
+
+void EffectPreparer::retire(Effect *e)
+{
+    if (!e)
+        return;
+
+    auto w = retireWrite.load(std::memory_order_relaxed);
+    auto next = (w + 1) % retireQueueSize;
+    if (next == retireRead.load(std::memory_order_acquire))
+    {
+        // Sixty-odd effects waiting to be freed means the service thread is wedged; don't leak
+        EffectSlabDeleter()(e);
+        return;
+    }
+    retireQueue[w] = e;
+    retireWrite.store(next, std::memory_order_release);
+    serviceThread->post(ServiceThread::fxLoad);
+}
+
+bool EffectPreparer::hasPendingWork() const
+{
+    for (auto &slot : slots)
+    {
+        auto st = slot.state.load(std::memory_order_acquire);
+        if (st == requested || st == building)
+            return true;
+    }
+    return retireRead.load(std::memory_order_acquire) !=
+           retireWrite.load(std::memory_order_acquire);
+}
+
+bool EffectPreparer::service()
+{
+    bool didWork = false;
+
+    auto r = retireRead.load(std::memory_order_relaxed);
+    while (r != retireWrite.load(std::memory_order_acquire))
+    {
+        EffectSlabDeleter()(retireQueue[r]);
+        r = (r + 1) % retireQueueSize;
+        retireRead.store(r, std::memory_order_release);
+        didWork = true;
+    }
+
+    for (auto &slot : slots)
+    {
+        if (slot.state.load(std::memory_order_acquire) != requested)
+            continue;
+
+        slot.state.store(building, std::memory_order_relaxed);
+
+        /*
+         * Build and init() the effect against our copy of the slot, so nothing the audio thread
+         * reads changes under it, then point it at the live slot for loadFx to swap in.
+         */
+        auto e = spawn_effect_in_slab(slot.type, storage, &slot.settings, slot.settingsData);
+        if (e)
+        {
+            setupEffectParameters(e, &slot.settings, slot.initDefaults);
+            for (int j = 0; j < n_fx_params; j++)
+                slot.settingsData[slot.settings.p[j].id].i = slot.settings.p[j].val.i;
+            e->init();
+            e->rebind(slot.fxdata, slot.pd);
+        }
+        slot.effect = e;
+        slot.state.store(ready, std::memory_order_release);
+        didWork = true;
+    }
+
+    return didWork;
+}
+
+} // namespace Storage
+} // namespace Surge
@@ -0,0 +1,119 @@
+/*
+** Surge Synthesizer is Free and Open Source Software
+**
+** Surge is made available under the Gnu General Public License, v3.0
+** https://www.gnu.org/licenses/gpl-3.0.en.html
+**
+** Copyright 2004-2021 by various individuals as described by the Git transaction log
+**
+** All source at: https://github.com/surge-synthesizer/surge.git
+**
+** Surge was a commercial product from 2004-2018, with Copyright and ownership
+** in that period held by Claes Johanson at Vember Audio. Claes made Surge
+** open source in September 2018.
+*/
+
+#ifndef SURGE_XT_EFFECTPREPARER_H
+#define SURGE_XT_EFFECTPREPARER_H
+
+#include "Effect.h"
+#include "ServiceThread.h"
+
+#include <atomic>
+#include <memory>
+
+namespace Surge
+{
+namespace Storage
+{
+/*
+ * Effects built ahead of time for a whole patch. loadFx uses the one for a slot in place of
+ * building it in line, provided the slot ends up the type the effect was built for.
+ */
+struct PreparedEffects
+{
+    int type[n_fx_slots];
+    std::unique_ptr<Effect, EffectSlabDeleter> fx[n_fx_slots];
+};
+
+/*
+ * What loadFx does to a new effect's parameters before init(): give them the effect's control
+ * types, then either its defaults or the values they had, clamped to the new ranges.
+ */
+void setupEffectParameters(Effect *e, FxStorage *fxdata, bool initDefaults);
+
+/*
+ * EffectPreparer keeps effect construction, setup and destruction off the audio thread.
+ *
+ * When loadFx sees an FX slot change type while audio is running, it asks for an effect of
+ * the new type and carries on without it. The request takes a copy of the slot's fxsync
+ * parameters. The service thread allocates a slab and constructs the effect there against that
+ * copy, sets its parameters up and runs init(), which is where the reverbs and delays clear
+ * their buffers, and only then points it at the live slot. A later loadFx takes it over, copies
+ * the settled parameters into the patch and swaps it in. Effects which are replaced are handed
+ * back through retire() so their destructor and free run on that thread too.
+ *
+ * Slots move idle -> requested -> building -> ready -> idle, with the audio thread making the
+ * idle->requested and ready->idle transitions and the service thread the others. Retired effects
+ * go through a single producer, single consumer ring.
+ */
+class EffectPreparer
+{
+  public:
+    EffectPreparer(SurgeStorage *storage, ServiceThread *service);
+    ~EffectPreparer();
+
+    /*
+     * Audio thread. If an effect built from sync is ready for slot, hand it over, already
+     * init()ed and reading fxdata and pd; settled then holds the parameters it was set up with,
+     * for the caller to copy into fxdata, until the next call for this slot. Otherwise make sure
+     * one is on the way and return nullptr; ask again next block.
+     */
+    Effect *takePrepared(int slot, const FxStorage &sync, bool initDefaults, FxStorage *fxdata,
+                         pdata *pd, const FxStorage *&settled);
+
+    /*
+     * Audio thread. Hand over an effect which is no longer referenced to be destroyed.
+     */
+    void retire(Effect *e);
+
+    bool hasPendingWork() const;
+
+  private:
+    enum SlotState
+    {
+        idle,
+        requested,
+        building,
+        ready
+    };
+
+    struct Slot
+    {
+        std::atomic<int> state{idle};
+        int type{0};
+        bool initDefaults{false};
+        FxStorage *fxdata{nullptr};
+        pdata *pd{nullptr};
+        Effect *effect{nullptr};
+
+        // The copy of fxsync the effect is set up against, and the values it was asked with
+        FxStorage settings;
+        pdata settingsData[n_global_params];
+        pdata requested[n_fx_params];
+    };
+
+    bool service();
+
+    SurgeStorage *storage;
+    ServiceThread *serviceThread;
+    Slot slots[n_fx_slots];
+
+    static constexpr int retireQueueSize = 64;
+    Effect *retireQueue[retireQueueSize];
+    std::atomic<int> retireWrite{0}, retireRead{0};
+};
+} // namespace Storage
+} // namespace Surge
+
+#endif // SURGE_XT_EFFECTPREPARER_H
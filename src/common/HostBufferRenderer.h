@@ -0,0 +1,101 @@
+/*
+** Surge Synthesizer is Free and Open Source Software
+**
+** Surge is made available under the Gnu General Public License, v3.0
+** https://www.gnu.org/licenses/gpl-3.0.en.html
+**
+** Copyright 2004-2021 by various individuals as described by the Git transaction log
+**
+** All source at: https://github.com/surge-synthesizer/surge.git
+**
+** Surge was a commercial product from 2004-2018, with Copyright and ownership
+** in that period held by Claes Johanson at Vember Audio. Claes made Surge
+** open source in September 2018.
+*/
+
+#ifndef SURGE_XT_HOSTBUFFERRENDERER_H
+#define SURGE_XT_HOSTBUFFERRENDERER_H
+
+#include "SurgeSynthesizer.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace Surge
+{
+/*
+ * SurgeSynthesizer renders BLOCK_SIZE samples at a time and hosts hand us buffers of any size,
+ * so this plays the synth out sample by sample, rendering a block whenever the first sample of
+ * one is due. Blocks carry across buffers, so there is no latency, and a host buffer which isn't
+ * a multiple of BLOCK_SIZE just leaves the next buffer starting part way through a block.
+ *
+ * This is the plugin's render loop, kept free of JUCE so the headless tests run the same code.
+ */
+struct HostBufferRenderer
+{
+    int blockPos{0};
+
+    struct Buffer
+    {
+        int numSamples{0};
+        float *out[2]{nullptr, nullptr};
+        const float *in[2]{nullptr, nullptr}; // no input if in[0] is null
+        float *sceneOut[n_scenes][2]{};       // each written only if it isn't null
+        double ppqPerSample{0};               // quarter notes the song moves on per sample
+    };
+
+    /*
+     * applyEventsUpTo(i) is called just before each block is rendered, with the position in
+     * the buffer of the block's first sample, and should apply every event timestamped at or
+     * before it. That puts each onset at most BLOCK_SIZE - 1 samples after its timestamp,
+     * whatever the host buffer size. Events after the last block start in the buffer are left
+     * to the caller, and land on the first block of the next buffer.
+     */
+    template <typename F>
+    void render(SurgeSynthesizer &surge, const Buffer &b, F &&applyEventsUpTo)
+    {
+        for (int i = 0; i < b.numSamples; i++)
+        {
+            surge.time_data.ppqPos += b.ppqPerSample;
+
+            if (blockPos == 0)
+            {
+                /*
+                 * The input is taken a block at a time too. A block which runs past the end of
+                 * this buffer only has the part of its input which is here; the rest is silent.
+                 */
+                surge.process_input = b.in[0] != nullptr;
+                if (surge.process_input)
+                {
+                    auto n = std::min(BLOCK_SIZE, b.numSamples - i);
+                    for (int c = 0; c < 2; ++c)
+                    {
+                        auto in = b.in[c] ? b.in[c] : b.in[0];
+                        memcpy(surge.input[c], in + i, n * sizeof(float));
+                        memset(surge.input[c] + n, 0, (BLOCK_SIZE - n) * sizeof(float));
+                    }
+                }
+
+                applyEventsUpTo(i);
+                surge.process();
+            }
+            else
+            {
+                surge.process_input = false;
+            }
+
+            b.out[0][i] = surge.output[0][blockPos];
+            b.out[1][i] = surge.output[1][blockPos];
+
+            for (int s = 0; s < n_scenes; ++s)
+                for (int c = 0; c < 2; ++c)
+                    if (b.sceneOut[s][c])
+                        b.sceneOut[s][c][i] = surge.sceneout[s][c][blockPos];
+
+            blockPos = (blockPos + 1) & (BLOCK_SIZE - 1);
+        }
+    }
+};
+} // namespace Surge
+
+#endif // SURGE_XT_HOSTBUFFERRENDERER_H
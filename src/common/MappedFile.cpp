@@ -0,0 +1,158 @@
+/*
+** Surge Synthesizer is Free and Open Source Software
+**
+** Surge is made available under the Gnu General Public License, v3.0
+** https://www.gnu.org/licenses/gpl-3.0.en.html
+**
+** Copyright 2004-2021 by various individuals as described by the Git transaction log
+**
+** All source at: https://github.com/surge-synthesizer/surge.git
+**
+** Surge was a commercial product from 2004-2018, with Copyright and ownership
+** in that period held by Claes Johanson at Vember Audio. Claes made Surge
+** open source in September 2018.
+*/
+
+#include "MappedFile.h"
+
+#include <fstream>
+
+#if WINDOWS
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Surge
+{
+namespace Storage
+{
+std::atomic<bool> MappedFile::mappingEnabled{true};
+
+MappedFile::~MappedFile() { close(); }
+
+bool MappedFile::open(const fs::path &path)
+{
+    close();
+    if (mappingEnabled && map(path))
+        return true;
+    return read(path);
+}
+
+#if WINDOWS
+bool MappedFile::map(const fs::path &path)
+{
+    auto fh = CreateFileW(path.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                          OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (fh == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER fsize;
+    if (!GetFileSizeEx(fh, &fsize) || fsize.QuadPart == 0)
+    {
+        CloseHandle(fh);
+        return false;
+    }
+
+    auto mh = CreateFileMappingW(fh, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mh)
+    {
+        CloseHandle(fh);
+        return false;
+    }
+
+    auto view = MapViewOfFile(mh, FILE_MAP_READ, 0, 0, 0);
+    if (!view)
+    {
+        CloseHandle(mh);
+        CloseHandle(fh);
+        return false;
+    }
+
+    fileHandle = fh;
+    mappingHandle = mh;
+    ptr = (const char *)view;
+    sz = (size_t)fsize.QuadPart;
+    mapped = true;
+    return true;
+}
+#else
+bool MappedFile::map(const fs::path &path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    auto view = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping keeps the file open for as long as it needs to
+    ::close(fd);
+    if (view == MAP_FAILED)
+        return false;
+
+    // Patches are read front to back, once
+    madvise(view, (size_t)st.st_size, MADV_SEQUENTIAL);
+
+    ptr = (const char *)view;
+    sz = (size_t)st.st_size;
+    mapped = true;
+    return true;
+}
+#endif
+
+bool MappedFile::read(const fs::path &path)
+{
+    std::filebuf f;
+    if (!f.open(path, std::ios::binary | std::ios::in))
+        return false;
+
+    auto end = f.pubseekoff(0, std::ios::end, std::ios::in);
+    f.pubseekpos(0, std::ios::in);
+    if (end < 0)
+        return false;
+
+    sz = (size_t)end;
+    buffer.reset(new char[sz ? sz : 1]);
+    if ((size_t)f.sgetn(buffer.get(), sz) != sz)
+    {
+        buffer.reset();
+        sz = 0;
+        return false;
+    }
+
+    ptr = buffer.get();
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (mapped)
+    {
+#if WINDOWS
+        UnmapViewOfFile((void *)ptr);
+        CloseHandle((HANDLE)mappingHandle);
+        CloseHandle((HANDLE)fileHandle);
+        fileHandle = nullptr;
+        mappingHandle = nullptr;
+#else
+        munmap((void *)ptr, sz);
+#endif
+    }
+
+    buffer.reset();
+    ptr = nullptr;
+    sz = 0;
+    mapped = false;
+}
+
+} // namespace Storage
+} // namespace Surge
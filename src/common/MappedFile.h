@@ -0,0 +1,71 @@
+/*
+** Surge Synthesizer is Free and Open Source Software
+**
+** Surge is made available under the Gnu General Public License, v3.0
+** https://www.gnu.org/licenses/gpl-3.0.en.html
+**
+** Copyright 2004-2021 by various individuals as described by the Git transaction log
+**
+** All source at: https://github.com/surge-synthesizer/surge.git
+**
+** Surge was a commercial product from 2004-2018, with Copyright and ownership
+** in that period held by Claes Johanson at Vember Audio. Claes made Surge
+** open source in September 2018.
+*/
+
+#ifndef SURGE_XT_MAPPEDFILE_H
+#define SURGE_XT_MAPPEDFILE_H
+
+#include "filesystem/import.h"
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+namespace Surge
+{
+namespace Storage
+{
+/*
+ * A read-only view of a whole file. Normally the file is memory mapped, so reading it costs no
+ * allocation or copy and the pages come straight from the OS file cache; loading a patch then
+ * hands pointers into the mapping to the parser and to Wavetable::BuildWT. If the file can't be
+ * mapped (it is empty, say, or on a file system which won't) it is read into a buffer instead.
+ *
+ * The data is only valid while the MappedFile is open, and anything reading it must check its
+ * own bounds: a read past the end of a mapping is a crash, not a garbage value.
+ */
+class MappedFile
+{
+  public:
+    MappedFile() = default;
+    ~MappedFile();
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    bool open(const fs::path &path);
+    void close();
+
+    const char *data() const { return ptr; }
+    size_t size() const { return sz; }
+    bool isMapped() const { return mapped; }
+
+    // With this off every file is read into a buffer, which is how patches used to load
+    static std::atomic<bool> mappingEnabled;
+
+  private:
+    bool map(const fs::path &path);
+    bool read(const fs::path &path);
+
+    const char *ptr{nullptr};
+    size_t sz{0};
+    bool mapped{false};
+    std::unique_ptr<char[]> buffer;
+#if WINDOWS
+    void *fileHandle{nullptr}, *mappingHandle{nullptr};
+#endif
+};
+} // namespace Storage
+} // namespace Surge
+
+#endif // SURGE_XT_MAPPEDFILE_H
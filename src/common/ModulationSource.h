@@ -449,6 +449,13 @@ class RandomModulationSource : public ModulationSource
 
     float get_output(int which) override { return output[which]; }
 
+    void seed(uint32_t s)
+    {
+        gen.seed(s);
+        dis.reset();
+        norm.reset();
+    }
+
     virtual void attack() override
     {
         if (bipolar)
@@ -0,0 +1,151 @@
+/*
+** Surge Synthesizer is Free and Open Source Software
+**
+** Surge is made available under the Gnu General Public License, v3.0
+** https://www.gnu.org/licenses/gpl-3.0.en.html
+**
+** Copyright 2004-2021 by various individuals as described by the Git transaction log
+**
+** All source at: https://github.com/surge-synthesizer/surge.git
+**
+** Surge was a commercial product from 2004-2018, with Copyright and ownership
+** in that period held by Claes Johanson at Vember Audio. Claes made Surge
+** open source in September 2018.
+*/
+
+#include "ModulationTable.h"
+
+#include <algorithm>
+
+void ModulationTable::rebuild(const std::vector<ModulationRouting> &routings)
+{
+    auto n = routings.size();
+    src.resize(n);
+    srcIndex.resize(n);
+    dst.resize(n);
+    depth.resize(n);
+    muted.resize(n);
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        const auto &r = routings[i];
+        src[i] = r.source_id;
+        srcIndex[i] = useSourceIndex ? r.source_index : 0;
+        dst[i] = r.destination_id;
+        depth[i] = r.depth;
+        muted[i] = r.muted;
+    }
+    compile();
+}
+
+void ModulationTable::set(int i, const ModulationRouting &r)
+{
+    auto idx = useSourceIndex ? r.source_index : 0;
+
+    if (i == size())
+    {
+        src.push_back(r.source_id);
+        srcIndex.push_back(idx);
+        dst.push_back(r.destination_id);
+        depth.push_back(r.depth);
+        muted.push_back(r.muted);
+        compile();
+        return;
+    }
+
+    depth[i] = r.depth;
+    muted[i] = r.muted;
+
+    if (src[i] == r.source_id && srcIndex[i] == idx && dst[i] == r.destination_id)
+    {
+        // The common case of a depth drag or a mute toggle
+        scaledDepth[i] = r.muted ? 0.f : r.depth;
+        return;
+    }
+
+    src[i] = r.source_id;
+    srcIndex[i] = idx;
+    dst[i] = r.destination_id;
+    compile();
+}
+
+void ModulationTable::erase(int i)
+{
+    src.erase(src.begin() + i);
+    srcIndex.erase(srcIndex.begin() + i);
+    dst.erase(dst.begin() + i);
+    depth.erase(depth.begin() + i);
+    muted.erase(muted.begin() + i);
+    compile();
+}
+
+void ModulationTable::compile()
+{
+    int n = size();
+
+    scaledDepth.assign((n + 3) & ~3, 0.f);
+    for (int i = 0; i < n; ++i)
+        scaledDepth[i] = muted[i] ? 0.f : depth[i];
+
+    slot.resize(n);
+    uniqueSrc.clear();
+    uniqueIndex.clear();
+    chunkUniqueStart.clear();
+
+    for (int base = 0; base < n; base += chunkSize)
+    {
+        int first = uniqueSrc.size();
+        chunkUniqueStart.push_back(first);
+
+        int end = std::min(base + (int)chunkSize, n);
+        for (int i = base; i < end; ++i)
+        {
+            int u = first;
+            while (u < (int)uniqueSrc.size() &&
+                   !(uniqueSrc[u] == src[i] && uniqueIndex[u] == srcIndex[i]))
+                ++u;
+
+            if (u == (int)uniqueSrc.size())
+            {
+                uniqueSrc.push_back(src[i]);
+                uniqueIndex.push_back(srcIndex[i]);
+            }
+            slot[i] = u - first;
+        }
+    }
+    chunkUniqueStart.push_back(uniqueSrc.size());
+}
+
+void ModulationTable::apply(ModulationSource *const *sources, pdata *target) const
+{
+    int n = size();
+
+    float values alignas(16)[chunkSize];
+    float out alignas(16)[chunkSize];
+
+    for (int c = 0, base = 0; base < n; ++c, base += chunkSize)
+    {
+        int m = std::min((int)chunkSize, n - base);
+
+        int u0 = chunkUniqueStart[c], u1 = chunkUniqueStart[c + 1];
+        for (int u = u0; u < u1; ++u)
+        {
+            auto s = sources[uniqueSrc[u]];
+            values[u - u0] = s ? s->get_output(uniqueIndex[u]) : 0.f;
+        }
+
+        int m4 = (m + 3) & ~3;
+        for (int i = 0; i < m; ++i)
+            out[i] = values[slot[base + i]];
+        for (int i = m; i < m4; ++i)
+            out[i] = 0.f;
+
+        const float *d = scaledDepth.data() + base;
+        for (int i = 0; i < m4; i += 4)
+            _mm_store_ps(out + i, _mm_mul_ps(_mm_loadu_ps(d + i), _mm_load_ps(out + i)));
+
+        const int *dd = dst.data() + base;
+        for (int i = 0; i < m; ++i)
+            target[dd[i]].f += out[i];
+    }
+}
@@ -0,0 +1,76 @@
+/*
+** Surge Synthesizer is Free and Open Source Software
+**
+** Surge is made available under the Gnu General Public License, v3.0
+** https://www.gnu.org/licenses/gpl-3.0.en.html
+**
+** Copyright 2004-2021 by various individuals as described by the Git transaction log
+**
+** All source at: https://github.com/surge-synthesizer/surge.git
+**
+** Surge was a commercial product from 2004-2018, with Copyright and ownership
+** in that period held by Claes Johanson at Vember Audio. Claes made Surge
+** open source in September 2018.
+*/
+
+#ifndef SURGE_XT_MODULATIONTABLE_H
+#define SURGE_XT_MODULATIONTABLE_H
+
+#include "Parameter.h"
+#include "ModulationSource.h"
+
+#include <vector>
+
+/*
+ * ModulationTable is a flattened, structure-of-arrays copy of one of the patch's
+ * std::vector<ModulationRouting> lists, which is what the audio thread walks each block.
+ *
+ * Routings are applied in chunks of up to chunkSize. For each chunk we call get_output once per
+ * distinct (source, index) pair the chunk uses, spread those values out to one per routing,
+ * scale them by depth four at a time, and finally add each into its destination in the original
+ * routing order so the result matches the old scalar loop exactly.
+ *
+ * The table has to be kept in step with its vector. SurgeSynthesizer updates it in place as it
+ * adds, changes and removes single routings; anything which rewrites a list wholesale calls
+ * SurgePatch::rebuildModulationTables().
+ */
+class ModulationTable
+{
+  public:
+    // The global list always reads output 0 of its source, whatever the routing's index
+    explicit ModulationTable(bool useSourceIndex = true) : useSourceIndex(useSourceIndex) {}
+
+    void rebuild(const std::vector<ModulationRouting> &routings);
+
+    // Update routing i, or append it if i == size()
+    void set(int i, const ModulationRouting &r);
+    void erase(int i);
+
+    int size() const { return (int)dst.size(); }
+    int destination(int i) const { return dst[i]; }
+
+    /*
+     * Add every routing into target. sources is indexed by modsource id, and a null source
+     * contributes nothing.
+     */
+    void apply(ModulationSource *const *sources, pdata *target) const;
+
+    static constexpr int chunkSize = 64;
+
+  private:
+    void compile();
+
+    bool useSourceIndex;
+
+    // One entry per routing, in the order of the vector
+    std::vector<int> src, srcIndex, dst;
+    std::vector<float> depth;
+    std::vector<char> muted;
+
+    // Derived by compile(). scaledDepth is padded with zeros to a multiple of four.
+    std::vector<float> scaledDepth;
+    std::vector<int> slot;
+    std::vector<int> uniqueSrc, uniqueIndex, chunkUniqueStart;
+};
+
+#endif // SURGE_XT_MODULATIONTABLE_H
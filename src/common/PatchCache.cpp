@@ -0,0 +1,178 @@
+/*
+** Surge Synthesizer is Free and Open Source Software
+**
+** Surge is made available under the Gnu General Public License, v3.0
+** https://www.gnu.org/licenses/gpl-3.0.en.html
+**
+** Copyright 2004-2021 by various individuals as described by the Git transaction log
+**
+** All source at: https://github.com/surge-synthesizer/surge.git
+**
+** Surge was a commercial product from 2004-2018, with Copyright and ownership
+** in that period held by Claes Johanson at Vember Audio. Claes made Surge
+** open source in September 2018.
+*/
+
+#include "PatchCache.h"
+#include "SurgeStorage.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <system_error>
+#include <thread>
+
+namespace Surge
+{
+namespace Storage
+{
+namespace
+{
+struct EntryHeader
+{
+    char magic[4];
+    uint32_t version;
+    int64_t mtime;
+    uint64_t size, blobSize, blobHash;
+    uint32_t pathSize, pad;
+};
+
+const char entryMagic[4] = {'s', 'r', 'p', 'c'};
+const uint32_t entryVersion = 1;
+
+uint64_t fnv1a(const char *d, size_t n, uint64_t h = 0xcbf29ce484222325ULL)
+{
+    for (size_t i = 0; i < n; ++i)
+    {
+        h ^= (uint8_t)d[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+} // namespace
+
+PatchCache::PatchCache(const fs::path &dir) : dir(dir)
+{
+    std::error_code ec;
+    fs::create_directories(dir, ec);
+}
+
+bool PatchCache::keyFor(const fs::path &fxp, Key &key)
+{
+    std::error_code ec;
+    auto t = fs::last_write_time(fxp, ec);
+    if (ec)
+        return false;
+    auto sz = fs::file_size(fxp, ec);
+    if (ec)
+        return false;
+
+    key.path = path_to_string(fxp);
+    key.mtime = (int64_t)t.time_since_epoch().count();
+    key.size = (uint64_t)sz;
+    return true;
+}
+
+fs::path PatchCache::entryFor(const Key &key) const
+{
+    std::ostringstream oss;
+    oss << std::hex << std::setw(16) << std::setfill('0')
+        << fnv1a(key.path.data(), key.path.size()) << ".srpc";
+    return dir / string_to_path(oss.str());
+}
+
+bool PatchCache::lookup(const fs::path &fxp, const SurgePatch &forPatch,
+                        std::vector<char> &compiled)
+{
+    compiled.clear();
+
+    Key key;
+    if (!keyFor(fxp, key))
+    {
+        misses++;
+        return false;
+    }
+
+    std::ifstream f(entryFor(key), std::ios::binary);
+    EntryHeader h;
+    if (!f || !f.read((char *)&h, sizeof(h)) || memcmp(h.magic, entryMagic, 4) != 0 ||
+        h.version != entryVersion || h.mtime != key.mtime || h.size != key.size ||
+        h.pathSize != key.path.size())
+    {
+        misses++;
+        return false;
+    }
+
+    // Two paths can share a name in the cache; only the one which wrote it may use it
+    std::string path(h.pathSize, '\0');
+    if (!f.read(&path[0], h.pathSize) || path != key.path || h.blobSize > (1 << 26))
+    {
+        misses++;
+        return false;
+    }
+
+    compiled.resize(h.blobSize);
+    if (!f.read(compiled.data(), h.blobSize) ||
+        fnv1a(compiled.data(), compiled.size()) != h.blobHash ||
+        !forPatch.can_load_compiled(compiled.data(), compiled.size()))
+    {
+        compiled.clear();
+        misses++;
+        return false;
+    }
+
+    hits++;
+    return true;
+}
+
+bool PatchCache::store(const fs::path &fxp, const std::vector<char> &compiled)
+{
+    Key key;
+    if (compiled.empty() || !keyFor(fxp, key))
+        return false;
+
+    EntryHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, entryMagic, 4);
+    h.version = entryVersion;
+    h.mtime = key.mtime;
+    h.size = key.size;
+    h.blobSize = compiled.size();
+    h.blobHash = fnv1a(compiled.data(), compiled.size());
+    h.pathSize = (uint32_t)key.path.size();
+
+    auto entry = entryFor(key);
+    std::ostringstream tn;
+    tn << path_to_string(entry.filename()) << "." << std::this_thread::get_id() << ".tmp";
+    auto tmp = dir / string_to_path(tn.str());
+
+    {
+        std::ofstream f(tmp, std::ios::binary | std::ios::trunc);
+        f.write((const char *)&h, sizeof(h));
+        f.write(key.path.data(), key.path.size());
+        f.write(compiled.data(), compiled.size());
+        if (!f)
+        {
+            f.close();
+            std::error_code ec;
+            fs::remove(tmp, ec);
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    fs::rename(tmp, entry, ec);
+    if (ec)
+    {
+        fs::remove(tmp, ec);
+        return false;
+    }
+
+    stores++;
+    return true;
+}
+
+} // namespace Storage
+} // namespace Surge
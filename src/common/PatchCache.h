@@ -0,0 +1,75 @@
+/*
+** Surge Synthesizer is Free and Open Source Software
+**
+** Surge is made available under the Gnu General Public License, v3.0
+** https://www.gnu.org/licenses/gpl-3.0.en.html
+**
+** Copyright 2004-2021 by various individuals as described by the Git transaction log
+**
+** All source at: https://github.com/surge-synthesizer/surge.git
+**
+** Surge was a commercial product from 2004-2018, with Copyright and ownership
+** in that period held by Claes Johanson at Vember Audio. Claes made Surge
+** open source in September 2018.
+*/
+
+#ifndef SURGE_XT_PATCHCACHE_H
+#define SURGE_XT_PATCHCACHE_H
+
+#include "filesystem/import.h"
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class SurgePatch;
+
+namespace Surge
+{
+namespace Storage
+{
+/*
+ * PatchCache keeps a compiled copy (see SurgePatch::save_compiled) of each .fxp loaded from a
+ * file, one cache file per patch, so the next load of that patch copies values out of the
+ * compiled copy instead of walking its XML. Wavetables are still read from the .fxp itself.
+ *
+ * An entry is keyed by the patch's path and only used while the file still has the modification
+ * time and size it had when the entry was written, while the entry's own contents hash to what
+ * was recorded with them, and while the patch it is for could load all of it (see
+ * SurgePatch::can_load_compiled). Anything else (an edited patch, an entry from another build, a
+ * half written or damaged file) counts as a miss; the patch loads from its XML and the entry is
+ * written again. Entries are written to a temporary file which is then renamed over the old one,
+ * so two instances sharing a cache never see each other's partial writes.
+ *
+ * The cache is off unless the UseCompiledPatchCache user default is set.
+ */
+class PatchCache
+{
+  public:
+    explicit PatchCache(const fs::path &dir);
+
+    // Both of these are safe to call from any thread; lookup only reads forPatch's layout
+    bool lookup(const fs::path &fxp, const SurgePatch &forPatch, std::vector<char> &compiled);
+    bool store(const fs::path &fxp, const std::vector<char> &compiled);
+
+    const fs::path &directory() const { return dir; }
+
+    std::atomic<int> hits{0}, misses{0}, stores{0};
+
+  private:
+    struct Key
+    {
+        std::string path;
+        int64_t mtime{0};
+        uint64_t size{0};
+    };
+    static bool keyFor(const fs::path &fxp, Key &key);
+    fs::path entryFor(const Key &key) const;
+
+    fs::path dir;
+};
+} // namespace Storage
+} // namespace Surge
+
+#endif // SURGE_XT_PATCHCACHE_H
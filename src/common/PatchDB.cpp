@@ -19,8 +19,14 @@
 #include "SurgeStorage.h"
 #include <sstream>
 #include <iterator>
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
 #include "vt_dsp_endian.h"
 #include "DebugHelpers.h"
+#include "MappedFile.h"
 
 namespace Surge
 {
@@ -92,6 +98,8 @@ struct Statement
         return reinterpret_cast<const char *>(sqlite3_column_text(s, c));
     }
     std::string col_str(int c) const { return col_charstar(c); }
+    const void *col_blob(int c) const { return sqlite3_column_blob(s, c); }
+    int col_bytes(int c) const { return sqlite3_column_bytes(s, c); }
 
     void bind(int c, const std::string &val)
     {
@@ -113,6 +121,16 @@ struct Statement
             throw Exception(h);
     }
 
+    void bindBlob(int c, const void *data, int size)
+    {
+        if (!s)
+            throw Exception(-1, "Statement not initialized in bind");
+
+        auto rc = sqlite3_bind_blob(s, c, data, size, SQLITE_STATIC);
+        if (rc != SQLITE_OK)
+            throw Exception(h);
+    }
+
     void bindi64(int c, int64_t val)
     {
         if (!s)
@@ -143,6 +161,19 @@ struct Statement
             throw Exception(h);
     }
 
+    /*
+     * Ready a long lived statement for its next use, whatever its last use left behind. Unlike
+     * reset this doesn't throw if the last step failed; that failure was reported at the time.
+     */
+    void recycle()
+    {
+        if (!s)
+            throw Exception(-1, "Statement not initialized in recycle");
+
+        sqlite3_reset(s);
+        sqlite3_clear_bindings(s);
+    }
+
     bool step() const
     {
         if (!s)
@@ -196,16 +227,126 @@ struct TxnGuard
 };
 } // namespace SQL
 
+namespace
+{
+bool isXMLSpace(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; }
+
+// Finds <tag, outside comments, and returns where its attributes start
+const char *findOpenTag(const char *p, const char *end, const char *tag)
+{
+    auto n = strlen(tag);
+    while (p < end && (p = (const char *)memchr(p, '<', end - p)))
+    {
+        if (end - p >= 4 && memcmp(p, "<!--", 4) == 0)
+        {
+            static const char close[] = "-->";
+            p = std::search(p + 4, end, close, close + 3);
+            continue;
+        }
+        if ((size_t)(end - p) > n + 1 && memcmp(p + 1, tag, n) == 0 &&
+            (isXMLSpace(p[n + 1]) || p[n + 1] == '>' || p[n + 1] == '/'))
+            return p + n + 1;
+        p++;
+    }
+    return nullptr;
+}
+
+// The entities TinyXML decodes, decoded the way it does with TIXML_ENCODING_LEGACY
+std::string decodeEntities(const char *p, const char *end)
+{
+    std::string res;
+    res.reserve(end - p);
+    while (p < end)
+    {
+        auto amp = (const char *)memchr(p, '&', end - p);
+        if (!amp)
+            amp = end;
+        res.append(p, amp);
+        p = amp;
+        if (p == end)
+            break;
+
+        auto semi = (const char *)memchr(p, ';', end - p);
+        if (!semi)
+        {
+            res.append(p, end);
+            break;
+        }
+
+        std::string ent(p + 1, semi);
+        if (ent == "amp")
+            res += '&';
+        else if (ent == "lt")
+            res += '<';
+        else if (ent == "gt")
+            res += '>';
+        else if (ent == "quot")
+            res += '"';
+        else if (ent == "apos")
+            res += '\'';
+        else if (ent.size() > 1 && ent[0] == '#')
+        {
+            bool hex = ent[1] == 'x' || ent[1] == 'X';
+            auto code = strtoul(ent.c_str() + (hex ? 2 : 1), nullptr, hex ? 16 : 10);
+            res += (char)code;
+        }
+        else
+        {
+            res.append(p, semi + 1);
+        }
+        p = semi + 1;
+    }
+    return res;
+}
+
+// Reads attributes up to the end of the tag; false if the tag is malformed or never ends
+bool readAttributes(const char *p, const char *end, std::map<std::string, std::string> &into)
+{
+    while (true)
+    {
+        while (p < end && isXMLSpace(*p))
+            p++;
+        if (p >= end)
+            return false;
+        if (*p == '>' || *p == '/')
+            return true;
+
+        auto ns = p;
+        while (p < end && *p != '=' && *p != '>' && *p != '/' && !isXMLSpace(*p))
+            p++;
+        auto ne = p;
+        while (p < end && isXMLSpace(*p))
+            p++;
+        if (p >= end || *p != '=')
+            return false;
+        p++;
+        while (p < end && isXMLSpace(*p))
+            p++;
+        if (p >= end || (*p != '"' && *p != '\''))
+            return false;
+
+        auto q = *p++;
+        auto ve = (const char *)memchr(p, q, end - p);
+        if (!ve)
+            return false;
+        into[std::string(ns, ne)] = decodeEntities(p, ve);
+        p = ve + 1;
+    }
+}
+} // namespace
+
 struct PatchDB::workerS
 {
-    static constexpr const char *schema_version = "4"; // I will rebuild if this is not my verion
+    static constexpr const char *schema_version = "7"; // I will rebuild if this is not my verion
 
     /*
      * Obviously a lot of thought needs to go into this
      */
     static constexpr const char *setup_sql = R"SQL(
+DROP TABLE IF EXISTS "PatchSearch";
 DROP TABLE IF EXISTS "Patches";
 DROP TABLE IF EXISTS "PatchFeature";
+DROP TABLE IF EXISTS "PatchVector";
 DROP TABLE IF EXISTS "Version";
 DROP TABLE IF EXISTS "Category";
 CREATE TABLE "Version" (
@@ -218,6 +359,9 @@ CREATE TABLE "Patches" (
       name varchar(256),
       category varchar(2048),
       category_type int,
+      author varchar(256),
+      comment varchar(2048),
+      tags varchar(2048),
       last_write_time big int
 );
 CREATE TABLE PatchFeature (
@@ -228,6 +372,10 @@ CREATE TABLE PatchFeature (
       feature_ivalue int,
       feature_svalue varchar(64)
 );
+CREATE TABLE PatchVector (
+      patch_id integer primary key,
+      vector blob
+);
 CREATE TABLE Category (
       id integer primary key,
       name varchar(2048),
@@ -235,7 +383,26 @@ CREATE TABLE Category (
       isroot int,
       type int,
       parent_id int
-)
+);
+CREATE VIRTUAL TABLE PatchSearch USING fts5(
+      name, category, author, comment, tags,
+      content = 'Patches', content_rowid = 'id',
+      tokenize = 'unicode61 remove_diacritics 1', prefix = '1 2 3'
+);
+INSERT INTO PatchSearch (PatchSearch, rank) VALUES ('rank', 'bm25(10.0, 4.0, 4.0, 1.0, 2.0)');
+CREATE TRIGGER Patches_search_insert AFTER INSERT ON Patches BEGIN
+    INSERT INTO PatchSearch (rowid, name, category, author, comment, tags)
+        VALUES (new.id, new.name, new.category, new.author, new.comment, new.tags);
+END;
+CREATE TRIGGER Patches_search_delete AFTER DELETE ON Patches BEGIN
+    INSERT INTO PatchSearch (PatchSearch, rowid, name, category, author, comment, tags)
+        VALUES ('delete', old.id, old.name, old.category, old.author, old.comment, old.tags);
+END;
+CREATE INDEX Patches_path ON Patches (path);
+CREATE INDEX Patches_order ON Patches (category_type, category, name);
+CREATE INDEX PatchFeature_patch_id ON PatchFeature (patch_id);
+CREATE INDEX Category_name ON Category (name, type, isroot);
+CREATE INDEX Category_parent_id ON Category (parent_id);
     )SQL";
 
     struct EnQAble
@@ -244,7 +411,8 @@ CREATE TABLE Category (
         virtual void go(workerS &) = 0;
     };
 
-    struct EnQPatch : public EnQAble
+    // A patch to look at, which one of the reader threads picks up
+    struct EnQPatch
     {
         EnQPatch(const fs::path &p, const std::string &n, const std::string &cn, const CatType t)
             : path(p), name(n), catname(cn), type(t)
@@ -254,8 +422,335 @@ CREATE TABLE Category (
         std::string name;
         std::string catname;
         CatType type;
+    };
+
+    enum FeatureType
+    {
+        INT,
+        STRING
+    };
+    typedef std::tuple<std::string, FeatureType, int, std::string> feature;
+
+    /*
+     * Each patch also gets a fixed length vector describing how it is built, so we can find the
+     * patches built most like it: which oscillator, filter and effect types it uses, the times
+     * and levels of its two envelopes and how much modulation it has. Every entry runs from 0
+     * to 1 and is kept as a byte. A FeatureSpace reads these either from a SurgePatch or, when
+     * indexing, straight from the <parameters> of the XML, knowing which parameters to look at
+     * and their ranges from the patch it was built with.
+     */
+    struct FeatureSpace
+    {
+        static constexpr int oscStart = 0;
+        static constexpr int filterStart = oscStart + n_osc_types;
+        static constexpr int fxStart = filterStart + n_fu_types;
+        static constexpr int envStart = fxStart + n_fx_types;
+        static constexpr int envsPerScene = 2, envFeatures = 4; // a, d, s and r of each
+        static constexpr int modStart = envStart + envsPerScene * envFeatures;
+        static constexpr int dimensions = modStart + 1;
+        // Padded to 16 bytes so the distance loop vectorizes with no remainder
+        static constexpr int stride = (dimensions + 15) & ~15;
+
+        typedef std::array<uint8_t, stride> Vector;
+
+        enum Role
+        {
+            SCENE_MODE,
+            OSC_TYPE,
+            FILTER_TYPE,
+            FX_TYPE,
+            ENVELOPE
+        };
+        struct Slot
+        {
+            Role role;
+            int scene, index;
+            float min, max;
+        };
+        std::unordered_map<std::string, Slot> slots;
+
+        explicit FeatureSpace(const SurgePatch &p)
+        {
+            auto add = [this](const Parameter &par, Role r, int scene, int index) {
+                slots[par.get_storage_name()] =
+                    Slot{r, scene, index, valueOf(par, par.val_min), valueOf(par, par.val_max)};
+            };
+
+            add(p.scenemode, SCENE_MODE, 0, 0);
+            for (int sc = 0; sc < n_scenes; ++sc)
+            {
+                auto &scene = p.scene[sc];
+                for (auto &o : scene.osc)
+                    add(o.type, OSC_TYPE, sc, 0);
+                for (auto &f : scene.filterunit)
+                    add(f.type, FILTER_TYPE, sc, 0);
+                for (int e = 0; e < envsPerScene; ++e)
+                {
+                    auto &env = scene.adsr[e];
+                    add(env.a, ENVELOPE, sc, e * envFeatures + 0);
+                    add(env.d, ENVELOPE, sc, e * envFeatures + 1);
+                    add(env.s, ENVELOPE, sc, e * envFeatures + 2);
+                    add(env.r, ENVELOPE, sc, e * envFeatures + 3);
+                }
+            }
+            for (auto &fx : p.fx)
+                add(fx.type, FX_TYPE, 0, 0);
+        }
+
+        static float valueOf(const Parameter &par, const pdata &d)
+        {
+            if (par.valtype == vt_float)
+                return d.f;
+            if (par.valtype == vt_bool)
+                return d.b ? 1.f : 0.f;
+            return (float)d.i;
+        }
+
+        struct Values
+        {
+            int sceneMode{sm_single};
+            int oscTypes[n_scenes][n_osc_types]{};
+            int filterTypes[n_scenes][n_fu_types]{};
+            bool fxTypes[n_fx_types]{};
+            float envelopes[n_scenes][envsPerScene * envFeatures]{};
+            int modRoutings{0};
+        };
+
+        void set(Values &v, const Slot &slot, float value) const
+        {
+            auto i = (int)value;
+            switch (slot.role)
+            {
+            case SCENE_MODE:
+                v.sceneMode = i;
+                break;
+            case OSC_TYPE:
+                if (i >= 0 && i < n_osc_types)
+                    v.oscTypes[slot.scene][i]++;
+                break;
+            case FILTER_TYPE:
+                if (i >= 0 && i < n_fu_types)
+                    v.filterTypes[slot.scene][i]++;
+                break;
+            case FX_TYPE:
+                if (i > fxt_off && i < n_fx_types)
+                    v.fxTypes[i] = true;
+                break;
+            case ENVELOPE:
+                if (slot.max > slot.min)
+                    v.envelopes[slot.scene][slot.index] =
+                        (value - slot.min) / (slot.max - slot.min);
+                break;
+            }
+        }
+
+        // Scene B only counts if it plays; the types are each scene's share of its units
+        Vector quantize(const Values &v) const
+        {
+            auto q = [](float f) { return (uint8_t)std::round(limit_range(f, 0.f, 1.f) * 255.f); };
+            int scenes = (v.sceneMode == sm_single) ? 1 : n_scenes;
+
+            Vector res{};
+            for (int t = 0; t < n_osc_types; ++t)
+            {
+                int n = 0;
+                for (int sc = 0; sc < scenes; ++sc)
+                    n += v.oscTypes[sc][t];
+                res[oscStart + t] = q((float)n / (scenes * n_oscs));
+            }
+            for (int t = 0; t < n_fu_types; ++t)
+            {
+                int n = 0;
+                for (int sc = 0; sc < scenes; ++sc)
+                    n += v.filterTypes[sc][t];
+                res[filterStart + t] = q((float)n / (scenes * n_filterunits_per_scene));
+            }
+            for (int t = 0; t < n_fx_types; ++t)
+                res[fxStart + t] = v.fxTypes[t] ? 255 : 0;
+            for (int e = 0; e < envsPerScene * envFeatures; ++e)
+            {
+                float sum = 0;
+                for (int sc = 0; sc < scenes; ++sc)
+                    sum += v.envelopes[sc][e];
+                res[envStart + e] = q(sum / scenes);
+            }
+            // Half way at 16 routings, creeping towards 1 beyond
+            res[modStart] = q(v.modRoutings / (v.modRoutings + 16.f));
+            return res;
+        }
+
+        Vector fromPatch(const SurgePatch &p) const
+        {
+            Values v;
+            for (auto *par : p.param_ptr)
+            {
+                auto slot = slots.find(par->get_storage_name());
+                if (slot != slots.end())
+                    set(v, slot->second, valueOf(*par, par->val));
+            }
+
+            v.modRoutings = (int)p.modulation_global.size();
+            for (auto &sc : p.scene)
+                v.modRoutings += (int)(sc.modulation_scene.size() + sc.modulation_voice.size());
+            return quantize(v);
+        }
+
+        // Values are read as saved, so types in patches from before a renumbering aren't migrated
+        bool fromXML(const char *xml, size_t size, Vector &into) const
+        {
+            auto end = xml + size;
+            auto p = findOpenTag(xml, end, "parameters");
+            if (!p)
+                return false;
+
+            Values v;
+            std::map<std::string, std::string> attrs;
+            while (p < end && (p = (const char *)memchr(p, '<', end - p)))
+            {
+                p++;
+                if (p < end && *p == '/')
+                {
+                    if (end - p >= 11 && memcmp(p, "/parameters", 11) == 0)
+                        break;
+                    continue;
+                }
+
+                auto ns = p;
+                while (p < end && !isXMLSpace(*p) && *p != '>' && *p != '/')
+                    p++;
+                std::string name(ns, p);
+                if (name == "modrouting")
+                {
+                    v.modRoutings++;
+                    continue;
+                }
+
+                auto slot = slots.find(name);
+                if (slot == slots.end())
+                    continue;
+
+                attrs.clear();
+                readAttributes(p, end, attrs);
+                auto value = attrs.find("value");
+                if (value != attrs.end())
+                    set(v, slot->second, (float)std::atof(value->second.c_str()));
+            }
+
+            into = quantize(v);
+            return true;
+        }
+    };
+
+    /*
+     * Every patch's feature vector, one row after another, so finding the nearest is a single
+     * pass over one block of memory. Removing a patch moves the last row into its place. The
+     * writer keeps this in step with the PatchVector table and queries read it, under lock.
+     */
+    struct SimilarityIndex
+    {
+        std::mutex lock;
+        std::vector<int64_t> ids;
+        std::vector<uint8_t> rows;
+        std::unordered_map<int64_t, size_t> rowOf;
 
-        void go(workerS &w) override { w.parseFXPIntoDB(*this); }
+        void clear()
+        {
+            std::lock_guard<std::mutex> g(lock);
+            ids.clear();
+            rows.clear();
+            rowOf.clear();
+        }
+
+        void set(int64_t id, const uint8_t *v)
+        {
+            std::lock_guard<std::mutex> g(lock);
+            auto r = rowOf.find(id);
+            size_t row;
+            if (r != rowOf.end())
+            {
+                row = r->second;
+            }
+            else
+            {
+                row = ids.size();
+                ids.push_back(id);
+                rows.resize(rows.size() + FeatureSpace::stride);
+                rowOf[id] = row;
+            }
+            memcpy(&rows[row * FeatureSpace::stride], v, FeatureSpace::stride);
+        }
+
+        void remove(int64_t id)
+        {
+            std::lock_guard<std::mutex> g(lock);
+            auto r = rowOf.find(id);
+            if (r == rowOf.end())
+                return;
+
+            auto row = r->second, last = ids.size() - 1;
+            if (row != last)
+            {
+                ids[row] = ids[last];
+                rowOf[ids[row]] = row;
+                memcpy(&rows[row * FeatureSpace::stride], &rows[last * FeatureSpace::stride],
+                       FeatureSpace::stride);
+            }
+            ids.pop_back();
+            rows.resize(last * FeatureSpace::stride);
+            rowOf.erase(id);
+        }
+
+        bool get(int64_t id, FeatureSpace::Vector &into)
+        {
+            std::lock_guard<std::mutex> g(lock);
+            auto r = rowOf.find(id);
+            if (r == rowOf.end())
+                return false;
+            memcpy(into.data(), &rows[r->second * FeatureSpace::stride], FeatureSpace::stride);
+            return true;
+        }
+
+        // The count nearest to v, as (squared distance, id), leaving out skip
+        std::vector<std::pair<int, int64_t>> nearest(const FeatureSpace::Vector &v, int count,
+                                                     int64_t skip)
+        {
+            std::lock_guard<std::mutex> g(lock);
+            std::vector<std::pair<int, int64_t>> res;
+            res.reserve(ids.size());
+
+            auto row = rows.data();
+            for (auto id : ids)
+            {
+                int d = 0;
+                for (int k = 0; k < FeatureSpace::stride; ++k)
+                {
+                    int x = (int)row[k] - (int)v[k];
+                    d += x * x;
+                }
+                row += FeatureSpace::stride;
+                if (id != skip)
+                    res.emplace_back(d, id);
+            }
+
+            auto n = std::min((size_t)std::max(count, 0), res.size());
+            std::partial_sort(res.begin(), res.begin() + n, res.end());
+            res.resize(n);
+            return res;
+        }
+    };
+
+    // ... and what the reader found, for the writer thread to put in the database
+    struct EnQParsedPatch : public EnQAble
+    {
+        EnQParsedPatch(const EnQPatch &p, int64_t t) : patch(p), lastWriteTime(t) {}
+        EnQPatch patch;
+        int64_t lastWriteTime;
+        std::vector<feature> features;
+        std::string author, comment, tags; // searched, along with the name and category
+        bool hasVector{false};
+        FeatureSpace::Vector vector;
+
+        void go(workerS &w) override { w.writePatchIntoDB(*this); }
     };
 
     struct EnQCategory : public EnQAble
@@ -286,7 +781,8 @@ CREATE TABLE Category (
         }
     };
 
-    explicit workerS(SurgeStorage *storage) : storage(storage)
+    workerS(SurgeStorage *storage, int readerThreads)
+        : storage(storage), features(std::make_unique<FeatureSpace>(storage->getPatch()))
     {
         auto dbname = storage->userDataPath + "/SurgePatches.db";
         auto flag = SQLITE_OPEN_FULLMUTEX; // basically lock
@@ -355,65 +851,306 @@ CREATE TABLE Category (
                 storage->reportError(e.what(), "PatchDB Setup Error");
             }
         }
+
+        /*
+         * This database is an index of files on disk which we can always rebuild, so we trade
+         * the fsync on every commit for speed.
+         */
+        try
+        {
+            SQL::Exec(dbh, "PRAGMA journal_mode=WAL; PRAGMA synchronous=NORMAL;");
+        }
+        catch (const SQL::Exception &e)
+        {
+            std::cout << "        : Unable to set journal mode: " << e.what() << std::endl;
+        }
+
+        try
+        {
+            readKnownPatches();
+        }
+        catch (const SQL::Exception &e)
+        {
+            storage->reportError(e.what(), "PatchDB - Reading Index");
+        }
+
+        if (readerThreads <= 0)
+            readerThreads = std::max(1, std::min((int)std::thread::hardware_concurrency() - 1, 8));
+
         qThread = std::thread([this]() { this->loadQueueFunction(); });
+        for (int i = 0; i < readerThreads; ++i)
+            readers.emplace_back([this]() { this->readQueueFunction(); });
     }
 
     ~workerS()
     {
-        keepRunning = false;
+        // Flip the flag under the queue locks so no thread can miss it on its way into a wait
+        {
+            std::lock_guard<std::mutex> g(readLock);
+            keepRunning = false;
+        }
+        {
+            std::lock_guard<std::mutex> g(qLock);
+        }
+        readCV.notify_all();
         qCV.notify_all();
-        qThread.join();
+        for (auto &r : readers)
+            r.join();
+        if (qThread.joinable())
+            qThread.join();
+
+        for (auto *p : readQ)
+            delete p;
+        for (auto *p : pathQ)
+            delete p;
+
         // clean up all the prepared statements
+        for (auto *st : {&selectKnownPatches, &selectVectors, &insertPatch, &insertFeature,
+                         &insertVector, &dropPatch, &dropPatchFeatures, &dropPatchVector,
+                         &countCategory, &findParentCategory, &insertCategory})
+        {
+            if (*st)
+            {
+                try
+                {
+                    (*st)->finalize();
+                }
+                catch (const SQL::Exception &e)
+                {
+                    std::cout << "PatchDB : " << e.what() << std::endl;
+                }
+            }
+        }
         if (dbh)
             sqlite3_close(dbh);
     }
 
-    // FIXME features shuld be an enum or something
+    /*
+     * The worker runs the same handful of statements over and over, so each is prepared the
+     * first time it is needed and then kept until the worker goes away.
+     */
+    std::unique_ptr<SQL::Statement> selectKnownPatches, selectVectors, insertPatch, insertFeature,
+        insertVector, dropPatch, dropPatchFeatures, dropPatchVector, countCategory,
+        findParentCategory, insertCategory;
 
-    enum FeatureType
+    SQL::Statement &statement(std::unique_ptr<SQL::Statement> &st, const char *sql)
     {
-        INT,
-        STRING
+        if (!st)
+            st = std::make_unique<SQL::Statement>(dbh, sql);
+        else
+            st->recycle();
+        return *st;
+    }
+
+    /*
+     * Every patch already in the database, by path, with the modification time it had when it
+     * was indexed. This is read when the worker starts, so checking whether a patch is up to
+     * date is a stat and a lookup here rather than a query; an unchanged file isn't opened.
+     * The readers check it and the writer keeps it up to date, under knownLock.
+     */
+    struct KnownPatch
+    {
+        int64_t id;
+        int64_t lastWriteTime;
     };
-    typedef std::tuple<std::string, FeatureType, int, std::string> feature;
-    std::vector<feature> extractFeaturesFromXML(const std::string &xml)
+    std::unordered_map<std::string, KnownPatch> knownPatches;
+    std::mutex knownLock;
+    std::atomic<bool> knownPatchesRead{false};
+
+    bool isUpToDate(const std::string &path, int64_t lastWriteTime)
+    {
+        std::lock_guard<std::mutex> g(knownLock);
+        auto known = knownPatches.find(path);
+        return known != knownPatches.end() && known->second.lastWriteTime >= lastWriteTime;
+    }
+
+    // Writer thread only
+    void readKnownPatches()
     {
-        std::vector<feature> res;
-        TiXmlDocument doc;
-        doc.Parse(xml.c_str(), nullptr, TIXML_ENCODING_LEGACY);
-        if (doc.Error())
+        std::lock_guard<std::mutex> g(knownLock);
+        knownPatches.clear();
+        std::vector<int64_t> dropIds;
+
+        auto &q = statement(selectKnownPatches,
+                            "SELECT id, path, last_write_time FROM Patches ORDER BY id");
+        while (q.step())
         {
-            std::cout << "        - ERROR: Unable to load XML; Skipping file" << std::endl;
-            return res;
+            KnownPatch k{q.col_int64(0), q.col_int64(2)};
+            auto res = knownPatches.emplace(q.col_str(1), k);
+
+            // Older databases could end up with a path twice; keep the newest
+            if (!res.second)
+            {
+                if (res.first->second.lastWriteTime <= k.lastWriteTime)
+                    std::swap(res.first->second, k);
+                dropIds.push_back(k.id);
+            }
+        }
+
+        similarity.clear();
+        auto &v = statement(selectVectors, "SELECT patch_id, vector FROM PatchVector");
+        while (v.step())
+        {
+            if (v.col_bytes(1) == FeatureSpace::stride)
+                similarity.set(v.col_int64(0), (const uint8_t *)v.col_blob(1));
         }
 
-        auto patch = TINYXML_SAFE_TO_ELEMENT(doc.FirstChild("patch"));
+        for (auto id : dropIds)
+            dropPatchRows(id);
 
-        if (!patch)
+        knownPatchesRead = true;
+    }
+
+    void dropPatchRows(int64_t id)
+    {
+        auto &dp = statement(dropPatch, "DELETE FROM Patches WHERE id = ?1");
+        dp.bindi64(1, id);
+        dp.step();
+
+        auto &df = statement(dropPatchFeatures, "DELETE FROM PatchFeature WHERE patch_id = ?1");
+        df.bindi64(1, id);
+        df.step();
+
+        auto &dv = statement(dropPatchVector, "DELETE FROM PatchVector WHERE patch_id = ?1");
+        dv.bindi64(1, id);
+        dv.step();
+        similarity.remove(id);
+    }
+
+    void extractFeaturesFromXML(const char *xml, size_t size, EnQParsedPatch &into)
+    {
+        PatchHeader header;
+        if (!readPatchHeader(xml, size, header))
         {
-            std::cout << "        - ERROR: No 'patch' element in XML" << std::endl;
-            return res;
+            std::cout << "        - ERROR: No 'patch' element with a revision in XML" << std::endl;
+            return;
         }
 
-        int rev = 0;
-        if (patch->QueryIntAttribute("revision", &rev) == TIXML_SUCCESS)
+        into.features.emplace_back("REVISION", INT, header.revision, "");
+
+        auto author = header.meta.find("author");
+        if (author != header.meta.end())
         {
-            res.emplace_back("REVISION", INT, rev, "");
+            into.features.emplace_back("AUTHOR", STRING, 0, author->second);
+            into.author = author->second;
         }
-        else
+
+        auto comment = header.meta.find("comment");
+        if (comment != header.meta.end())
+            into.comment = comment->second;
+
+        // Nothing we ship writes tags yet, but a patch which has them gets them searched
+        auto tags = header.meta.find("tags");
+        if (tags != header.meta.end())
+            into.tags = tags->second;
+    }
+
+    /*
+     * Functions for the reader threads. These only touch the database through isUpToDate, so
+     * as many as we like can run at once.
+     */
+    void readQueueFunction()
+    {
+        while (keepRunning)
+        {
+            std::unique_ptr<EnQPatch> p;
+            {
+                std::unique_lock<std::mutex> lk(readLock);
+
+                while (keepRunning && readQ.empty())
+                {
+                    readCV.wait(lk);
+                }
+
+                if (!keepRunning)
+                    return;
+
+                p.reset(readQ.front());
+                readQ.pop_front();
+            }
+
+            auto parsed = readPatch(*p);
+            if (parsed)
+                enqueueWorkItem(parsed.release());
+            outstanding--;
+        }
+    }
+
+    std::unique_ptr<EnQParsedPatch> readPatch(const EnQPatch &p)
+    {
+        std::error_code ec;
+        auto qtime = fs::last_write_time(p.path, ec);
+        if (ec)
         {
-            std::cout << "        - ERROR: No Revision in XML" << std::endl;
+            std::cout << "    - Warning: Non existent " << path_to_string(p.path) << std::endl;
+            return nullptr;
+        }
+        int64_t qtimeInt =
+            std::chrono::duration_cast<std::chrono::seconds>(qtime.time_since_epoch()).count();
+
+        if (isUpToDate(path_to_string(p.path), qtimeInt))
+            return nullptr;
+
+        auto res = std::make_unique<EnQParsedPatch>(p, qtimeInt);
+
+#pragma pack(push, 1)
+        struct patch_header
+        {
+            char tag[4];
+            unsigned int xmlsize,
+                wtsize[2][3]; // TODO: FIX SCENE AND OSC COUNT ASSUMPTION (but also since
+            // it's used in streaming, do it with care!)
+        };
+
+        struct fxChunkSetCustom
+        {
+            int chunkMagic; // 'CcnK'
+            int byteSize;   // of this chunk, excl. magic + byteSize
+
+            int fxMagic; // 'FPCh'
+            int version;
+            int fxID; // fx unique id
+            int fxVersion;
+
+            int numPrograms;
+            char prgName[28];
+
+            int chunkSize;
+            // char chunk[8]; // variable
+        };
+#pragma pack(pop)
+
+        // We only want the front of the XML, so mapping the file saves reading the rest of it
+        Surge::Storage::MappedFile f;
+        fxChunkSetCustom fxp;
+        if (!f.open(p.path) || f.size() < sizeof(fxp))
+        {
+            std::cout << "Not a surge patch; bailing" << std::endl;
+            return res;
+        }
+        memcpy(&fxp, f.data(), sizeof(fxp));
+        if ((vt_read_int32BE(fxp.chunkMagic) != 'CcnK') ||
+            (vt_read_int32BE(fxp.fxMagic) != 'FPCh') || (vt_read_int32BE(fxp.fxID) != 'cjs3'))
+        {
+            std::cout << "Not a surge patch; bailing" << std::endl;
             return res;
         }
 
-        auto meta = TINYXML_SAFE_TO_ELEMENT(patch->FirstChild("meta"));
-        if (meta)
+        auto xd = f.data() + sizeof(fxp);
+        size_t xmlSz = f.size() - sizeof(fxp);
+        patch_header ph;
+        if (xmlSz >= sizeof(ph))
         {
-            if (meta->Attribute("author"))
+            memcpy(&ph, xd, sizeof(ph));
+            if (memcmp(ph.tag, "sub3", 4) == 0)
             {
-                res.emplace_back("AUTHOR", STRING, 0, meta->Attribute("author"));
+                xd += sizeof(ph);
+                xmlSz = std::min(xmlSz - sizeof(ph), (size_t)vt_read_int32LE(ph.xmlsize));
             }
         }
+
+        extractFeaturesFromXML(xd, xmlSz, *res);
+        res->hasVector = features->fromXML(xd, xmlSz, res->vector);
         return res;
     }
 
@@ -422,10 +1159,15 @@ CREATE TABLE Category (
      */
     void loadQueueFunction()
     {
-        static constexpr auto transChunkSize = 10; // How many FXP to load in a single txn
+        /*
+         * How many FXP to load in a single txn. Each commit costs a journal write, so a scan of
+         * a large library wants big ones; this still commits often enough that a partial scan
+         * shows up in queries.
+         */
+        static constexpr auto transChunkSize = 512;
         while (keepRunning)
         {
-            std::vector<EnQAble *> doThis;
+            std::vector<std::unique_ptr<EnQAble>> doThis;
             {
                 std::unique_lock<std::mutex> lk(qLock);
 
@@ -439,7 +1181,8 @@ CREATE TABLE Category (
                     auto b = pathQ.begin();
                     auto e = (pathQ.size() < transChunkSize) ? pathQ.end()
                                                              : pathQ.begin() + transChunkSize;
-                    std::copy(b, e, std::back_inserter(doThis));
+                    for (auto it = b; it != e; ++it)
+                        doThis.emplace_back(*it);
                     pathQ.erase(b, e);
                 }
             }
@@ -448,203 +1191,119 @@ CREATE TABLE Category (
                 {
                     SQL::TxnGuard tg(dbh);
 
-                    for (auto *p : doThis)
-                    {
+                    for (auto &p : doThis)
                         p->go(*this);
-                        delete p;
-                    }
 
                     tg.end();
                 }
                 catch (SQL::Exception &e)
                 {
+                    // The batch was rolled back, so what we know about the database may be wrong
+                    knownPatchesRead = false;
                     storage->reportError(e.what(), "Patch DB");
                 }
             }
+            outstanding -= (int)doThis.size();
         }
     }
 
-    void parseFXPIntoDB(const EnQPatch &p)
+    void writePatchIntoDB(const EnQParsedPatch &pp)
     {
-        sqlite3_stmt *insertStmt = nullptr, *insfeatureStmt = nullptr, *dropIdStmt = nullptr;
+        auto &p = pp.patch;
+        auto pathStr = path_to_string(p.path);
 
-        if (!fs::exists(p.path))
-        {
-            std::cout << "    - Warning: Non existent " << path_to_string(p.path) << std::endl;
-            return;
-        }
-        // Check with
-        auto qtime = fs::last_write_time(p.path);
-        int64_t qtimeInt =
-            std::chrono::duration_cast<std::chrono::seconds>(qtime.time_since_epoch()).count();
-
-        bool patchLoaded = false;
-        std::vector<int> dropIds;
         try
         {
-            auto exists = SQL::Statement(
-                dbh, "SELECT id, last_write_time from Patches WHERE Patches.Path LIKE ?1");
-            auto s = path_to_string(p.path);
-            exists.bind(1, s);
+            if (!knownPatchesRead)
+                readKnownPatches();
 
-            while (exists.step())
+            // Someone may have asked for this patch twice and the other copy got here first
+            int64_t dropId = -1;
             {
-                auto id = exists.col_int(0);
-                auto t = exists.col_int64(1);
-                if (t < qtimeInt || (t == qtimeInt && patchLoaded))
+                std::lock_guard<std::mutex> g(knownLock);
+                auto known = knownPatches.find(pathStr);
+                if (known != knownPatches.end())
                 {
-                    dropIds.push_back(id);
+                    if (known->second.lastWriteTime >= pp.lastWriteTime)
+                        return;
+                    dropId = known->second.id;
                 }
-                if (t >= qtimeInt)
-                    patchLoaded = true;
             }
-
-            exists.finalize();
-
-            if (!dropIds.empty())
-            {
-                auto drop = SQL::Statement(
-                    dbh, "DELETE FROM Patches WHERE ID=?1; DELETE FROM PatchFeature WHERE ID=?1");
-                for (auto did : dropIds)
-                {
-                    drop.bindi64(1, did);
-                    while (drop.step())
-                    {
-                    }
-                    drop.clearBindings();
-                    drop.reset();
-                }
-
-                drop.finalize();
-            }
-        }
-        catch (const SQL::Exception &e)
-        {
-            storage->reportError(e.what(), "PatchDB - Load Check");
-            return;
-        }
-
-        if (patchLoaded)
-            return;
-
-        std::cout << "        - Loading '" << path_to_string(p.path) << "'" << std::endl;
-
-        int64_t patchid = -1;
-        try
-        {
-            auto ins = SQL::Statement(dbh, "INSERT INTO PATCHES ( \"path\", \"name\", "
-                                           "\"category\", \"category_type\", \"last_write_time\" ) "
-                                           "VALUES ( ?1, ?2, ?3, ?4, ?5 )");
-            ins.bind(1, path_to_string(p.path));
+            if (dropId >= 0)
+                dropPatchRows(dropId);
+
+            // The triggers on Patches keep PatchSearch up to date
+            auto &ins = statement(insertPatch,
+                                  "INSERT INTO PATCHES ( \"path\", \"name\", "
+                                  "\"category\", \"category_type\", \"author\", \"comment\", "
+                                  "\"tags\", \"last_write_time\" ) "
+                                  "VALUES ( ?1, ?2, ?3, ?4, ?5, ?6, ?7, ?8 )");
+            ins.bind(1, pathStr);
             ins.bind(2, p.name);
             ins.bind(3, p.catname);
             ins.bind(4, (int)p.type);
-            ins.bindi64(5, qtimeInt);
+            ins.bind(5, pp.author);
+            ins.bind(6, pp.comment);
+            ins.bind(7, pp.tags);
+            ins.bindi64(8, pp.lastWriteTime);
 
             ins.step();
 
             // No real need to encapsulate this
-            patchid = sqlite3_last_insert_rowid(dbh);
-
-            ins.finalize();
-        }
-        catch (const SQL::Exception &e)
-        {
-            storage->reportError(e.what(), "PatchDB - Insert Patch");
-            return;
-        }
-
-        std::ifstream stream(p.path, std::ios::in | std::ios::binary);
-        std::vector<uint8_t> contents((std::istreambuf_iterator<char>(stream)),
-                                      std::istreambuf_iterator<char>());
-
-#pragma pack(push, 1)
-        struct patch_header
-        {
-            char tag[4];
-            unsigned int xmlsize,
-                wtsize[2][3]; // TODO: FIX SCENE AND OSC COUNT ASSUMPTION (but also since
-            // it's used in streaming, do it with care!)
-        };
-
-        struct fxChunkSetCustom
-        {
-            int chunkMagic; // 'CcnK'
-            int byteSize;   // of this chunk, excl. magic + byteSize
-
-            int fxMagic; // 'FPCh'
-            int version;
-            int fxID; // fx unique id
-            int fxVersion;
-
-            int numPrograms;
-            char prgName[28];
-
-            int chunkSize;
-            // char chunk[8]; // variable
-        };
-#pragma pack(pop)
-
-        uint8_t *d = contents.data();
-        auto *fxp = (fxChunkSetCustom *)d;
-        if ((vt_read_int32BE(fxp->chunkMagic) != 'CcnK') ||
-            (vt_read_int32BE(fxp->fxMagic) != 'FPCh') || (vt_read_int32BE(fxp->fxID) != 'cjs3'))
-        {
-            std::cout << "Not a surge patch; bailing" << std::endl;
-            return;
-        }
-
-        auto phd = d + sizeof(fxChunkSetCustom);
-        auto *ph = (patch_header *)phd;
-        auto xmlSz = vt_read_int32LE(ph->xmlsize);
+            int64_t patchid = sqlite3_last_insert_rowid(dbh);
 
-        auto xd = phd + sizeof(patch_header);
-        std::string xml(xd, xd + xmlSz);
-
-        try
-        {
-            auto ins = SQL::Statement(dbh, "INSERT INTO PATCHFEATURE ( \"patch_id\", \"feature\", "
-                                           "\"feature_ivalue\", \"feature_svalue\" ) "
-                                           "VALUES ( ?1, ?2, ?3, ?4 )");
-            auto feat = extractFeaturesFromXML(xml);
-            for (auto f : feat)
+            for (auto f : pp.features)
             {
-                ins.bindi64(1, patchid);
-                ins.bind(2, std::get<0>(f));
-                ins.bind(3, std::get<2>(f));
-                ins.bind(4, std::get<3>(f));
-
-                ins.step();
+                auto &insf = statement(insertFeature,
+                                       "INSERT INTO PATCHFEATURE ( \"patch_id\", \"feature\", "
+                                       "\"feature_ivalue\", \"feature_svalue\" ) "
+                                       "VALUES ( ?1, ?2, ?3, ?4 )");
+                insf.bindi64(1, patchid);
+                insf.bind(2, std::get<0>(f));
+                insf.bind(3, std::get<2>(f));
+                insf.bind(4, std::get<3>(f));
+
+                insf.step();
+            }
 
-                ins.clearBindings();
-                ins.reset();
+            if (pp.hasVector)
+            {
+                auto &insv = statement(insertVector, "INSERT INTO PatchVector ( \"patch_id\", "
+                                                     "\"vector\" ) VALUES ( ?1, ?2 )");
+                insv.bindi64(1, patchid);
+                insv.bindBlob(2, pp.vector.data(), FeatureSpace::stride);
+                insv.step();
+                similarity.set(patchid, pp.vector.data());
             }
 
-            ins.finalize();
+            std::lock_guard<std::mutex> g(knownLock);
+            knownPatches[pathStr] = KnownPatch{patchid, pp.lastWriteTime};
         }
         catch (const SQL::Exception &e)
         {
-            storage->reportError(e.what(), "PatchDB - FXP Features");
-            return;
+            storage->reportError(e.what(), "PatchDB - Insert Patch");
         }
     }
 
+    bool categoryExists(const std::string &name, CatType type, bool isroot)
+    {
+        auto &there = statement(countCategory, "SELECT COUNT(id) from Category WHERE "
+                                               "Category.name = ?1 AND Category.type = ?2 "
+                                               "AND Category.isroot = ?3");
+        there.bind(1, name);
+        there.bind(2, (int)type);
+        there.bind(3, isroot ? 1 : 0);
+        there.step();
+        return there.col_int(0) > 0;
+    }
+
     void addRootCategory(const std::string &name, CatType type)
     {
         // Check if it is there
         try
         {
-            auto there =
-                SQL::Statement(dbh, "SELECT COUNT(id) from Category WHERE Category.name LIKE ?1 "
-                                    "AND Category.type = ?2 AND Category.isroot = 1");
-            there.bind(1, name);
-            there.bind(2, (int)type);
-            there.step();
-            auto count = there.col_int(0);
-            if (count > 0)
+            if (categoryExists(name, type, true))
                 return;
-
-            there.finalize();
         }
         catch (const SQL::Exception &e)
         {
@@ -653,14 +1312,15 @@ CREATE TABLE Category (
 
         try
         {
-            auto add = SQL::Statement(dbh, "INSERT INTO Category ( \"name\", \"leaf_name\", "
-                                           "\"isroot\", \"type\", \"parent_id\" ) "
-                                           "VALUES ( ?1, ?1, 1, ?2, -1 )");
+            auto &add = statement(insertCategory, "INSERT INTO Category ( \"name\", \"leaf_name\", "
+                                                  "\"isroot\", \"type\", \"parent_id\" ) "
+                                                  "VALUES ( ?1, ?2, ?3, ?4, ?5 )");
             add.bind(1, name);
-            add.bind(2, (int)type);
+            add.bind(2, name);
+            add.bind(3, 1);
+            add.bind(4, (int)type);
+            add.bind(5, -1);
             add.step();
-
-            add.finalize();
         }
         catch (const SQL::Exception &e)
         {
@@ -673,17 +1333,7 @@ CREATE TABLE Category (
     {
         try
         {
-            auto there =
-                SQL::Statement(dbh, "SELECT COUNT(id) from Category WHERE Category.name LIKE ?1 "
-                                    "AND Category.type = ?2 AND Category.isroot = 0");
-            there.bind(1, name);
-            there.bind(2, (int)type);
-            there.step();
-            auto count = there.col_int(0);
-
-            there.finalize();
-
-            if (count > 0)
+            if (categoryExists(name, type, false))
                 return;
         }
         catch (const SQL::Exception &e)
@@ -694,23 +1344,22 @@ CREATE TABLE Category (
         try
         {
             int parentId = -1;
-            auto par = SQL::Statement(
-                dbh, "SELECT id from Category WHERE Category.name LIKE ?1 AND Category.type = ?2");
+            auto &par = statement(findParentCategory, "SELECT id from Category WHERE "
+                                                      "Category.name = ?1 AND Category.type = ?2");
             par.bind(1, parentName);
             par.bind(2, (int)type);
             if (par.step())
                 parentId = par.col_int(0);
 
-            auto add = SQL::Statement(dbh, "INSERT INTO Category ( \"name\", \"leaf_name\", "
-                                           "\"isroot\", \"type\", \"parent_id\" ) "
-                                           "VALUES ( ?1, ?2, 0, ?3, ?4 )");
+            auto &add = statement(insertCategory, "INSERT INTO Category ( \"name\", \"leaf_name\", "
+                                                  "\"isroot\", \"type\", \"parent_id\" ) "
+                                                  "VALUES ( ?1, ?2, ?3, ?4, ?5 )");
             add.bind(1, name);
             add.bind(2, leafname);
-            add.bind(3, (int)type);
-            add.bind(4, parentId);
+            add.bind(3, 0);
+            add.bind(4, (int)type);
+            add.bind(5, parentId);
             add.step();
-
-            add.finalize();
         }
         catch (const SQL::Exception &e)
         {
@@ -725,6 +1374,12 @@ CREATE TABLE Category (
     std::condition_variable qCV;
     std::deque<EnQAble *> pathQ;
     std::atomic<bool> keepRunning{true};
+    std::atomic<int> outstanding{0}; // queued, being read or in the batch being written
+
+    std::vector<std::thread> readers;
+    std::mutex readLock;
+    std::condition_variable readCV;
+    std::deque<EnQPatch *> readQ;
 
     /*
      * Call this from any thread
@@ -733,26 +1388,70 @@ CREATE TABLE Category (
     {
         {
             std::lock_guard<std::mutex> g(qLock);
+            outstanding++;
             pathQ.push_back(p);
         }
         qCV.notify_all();
     }
 
+    void enqueueReadItem(EnQPatch *p)
+    {
+        {
+            std::lock_guard<std::mutex> g(readLock);
+            outstanding++;
+            readQ.push_back(p);
+        }
+        readCV.notify_one();
+    }
+
+    /*
+     * The nearest patches to a feature vector, leaving out skip, with their distances scaled so
+     * that each entry of the vector contributes at most 1
+     */
+    std::vector<SimilarPatch> similarPatches(const FeatureSpace::Vector &v, int count,
+                                             int64_t skip)
+    {
+        std::vector<SimilarPatch> res;
+        auto near = similarity.nearest(v, count, skip);
+
+        auto q = SQL::Statement(dbh, "SELECT p.id, p.path, p.category, p.name, p.author "
+                                     "FROM Patches AS p WHERE p.id = ?1");
+        for (auto &n : near)
+        {
+            q.recycle();
+            q.bindi64(1, n.second);
+            if (q.step())
+                res.push_back(SimilarPatch{
+                    patchRecord(q.col_int(0), q.col_str(1), q.col_str(2), q.col_str(3),
+                                q.col_str(4)),
+                    std::sqrt((float)n.first) / 255.f});
+        }
+        q.finalize();
+        return res;
+    }
+
     sqlite3 *dbh;
     SurgeStorage *storage;
+    std::unique_ptr<FeatureSpace> features;
+    SimilarityIndex similarity;
 };
-PatchDB::PatchDB(SurgeStorage *s) : storage(s) { initialize(); }
+PatchDB::PatchDB(SurgeStorage *s, int readerThreads) : storage(s), readerThreads(readerThreads)
+{
+    initialize();
+}
 
 PatchDB::~PatchDB() = default;
 
-void PatchDB::initialize() { worker = std::make_unique<workerS>(storage); }
+void PatchDB::initialize() { worker = std::make_unique<workerS>(storage, readerThreads); }
 
 void PatchDB::considerFXPForLoad(const fs::path &fxp, const std::string &name,
                                  const std::string &catName, const CatType type) const
 {
-    worker->enqueueWorkItem(new workerS::EnQPatch(fxp, name, catName, type));
+    worker->enqueueReadItem(new workerS::EnQPatch(fxp, name, catName, type));
 }
 
+int PatchDB::numberOfJobsOutstanding() const { return worker->outstanding; }
+
 void PatchDB::addRootCategory(const std::string &name, CatType type)
 {
     worker->enqueueWorkItem(new workerS::EnQCategory(name, type));
@@ -798,6 +1497,218 @@ std::vector<PatchDB::patchRecord> PatchDB::rawQueryForNameLike(const std::string
     return res;
 }
 
+namespace
+{
+/*
+ * Turns what someone typed into an FTS5 query: each run of letters and digits becomes a quoted
+ * prefix term, so punctuation and FTS5 syntax in the text are never interpreted, and the terms
+ * must all match. With a column they must all match in that column. Empty if there are no terms.
+ */
+std::string matchExpression(const std::string &text, const char *column = nullptr)
+{
+    std::string res;
+    auto isWordChar = [](char c) { return std::isalnum((unsigned char)c) || (c & 0x80); };
+
+    for (size_t i = 0; i < text.size();)
+    {
+        if (!isWordChar(text[i]))
+        {
+            i++;
+            continue;
+        }
+
+        auto e = i;
+        while (e < text.size() && isWordChar(text[e]))
+            e++;
+
+        if (!res.empty())
+            res += " ";
+        if (column)
+            res += std::string(column) + " : ";
+        res += "\"" + text.substr(i, e - i) + "\"*";
+        i = e;
+    }
+    return res;
+}
+
+// The FROM and WHERE of a search, with ?1 the match expression, ?2 the category and ?3 the author
+std::string searchClauses(const PatchDB::SearchQuery &q, const std::string &match)
+{
+    std::string res;
+    if (match.empty())
+        res = " FROM Patches AS p WHERE 1";
+    else
+        res = " FROM PatchSearch JOIN Patches AS p ON p.id = PatchSearch.rowid"
+              " WHERE PatchSearch MATCH ?1";
+
+    if (!q.category.empty())
+        res += " AND p.category = ?2";
+    if (!q.author.empty())
+        res += " AND p.author = ?3";
+    return res;
+}
+
+void bindSearch(SQL::Statement &st, const PatchDB::SearchQuery &q, const std::string &match)
+{
+    if (!match.empty())
+        st.bind(1, match);
+    if (!q.category.empty())
+        st.bind(2, q.category);
+    if (!q.author.empty())
+        st.bind(3, q.author);
+}
+} // namespace
+
+std::vector<PatchDB::patchRecord> PatchDB::search(const SearchQuery &q, int offset, int limit)
+{
+    std::vector<PatchDB::patchRecord> res;
+    auto match = matchExpression(q.text);
+
+    auto order = match.empty() ? " ORDER BY p.category_type, p.category, p.name" : " ORDER BY rank";
+    auto query = "SELECT p.id, p.path, p.category, p.name, p.author" + searchClauses(q, match) +
+                 order + " LIMIT ?4 OFFSET ?5";
+
+    try
+    {
+        auto st = SQL::Statement(worker->dbh, query);
+        bindSearch(st, q, match);
+        st.bind(4, limit);
+        st.bind(5, offset);
+
+        while (st.step())
+            res.emplace_back(st.col_int(0), st.col_str(1), st.col_str(2), st.col_str(3),
+                             st.col_str(4));
+
+        st.finalize();
+    }
+    catch (SQL::Exception &e)
+    {
+        storage->reportError(e.what(), "PatchDB - search");
+    }
+
+    return res;
+}
+
+int PatchDB::countSearchResults(const SearchQuery &q)
+{
+    int res = 0;
+    auto match = matchExpression(q.text);
+
+    try
+    {
+        auto st = SQL::Statement(worker->dbh, "SELECT COUNT(*)" + searchClauses(q, match));
+        bindSearch(st, q, match);
+        if (st.step())
+            res = st.col_int(0);
+
+        st.finalize();
+    }
+    catch (SQL::Exception &e)
+    {
+        storage->reportError(e.what(), "PatchDB - countSearchResults");
+    }
+
+    return res;
+}
+
+PatchDB::Facets PatchDB::searchFacets(const SearchQuery &q)
+{
+    Facets res;
+    auto match = matchExpression(q.text);
+
+    auto countBy = [&](const char *column, std::vector<Facet> &into) {
+        auto col = std::string("p.") + column;
+        auto query = "SELECT " + col + ", COUNT(*) AS n" + searchClauses(q, match) + " AND " + col +
+                     " != '' GROUP BY " + col + " ORDER BY n DESC, " + col;
+
+        auto st = SQL::Statement(worker->dbh, query);
+        bindSearch(st, q, match);
+        while (st.step())
+            into.push_back(Facet{st.col_str(0), st.col_int(1)});
+
+        st.finalize();
+    };
+
+    try
+    {
+        countBy("category", res.categories);
+        countBy("author", res.authors);
+    }
+    catch (SQL::Exception &e)
+    {
+        storage->reportError(e.what(), "PatchDB - searchFacets");
+    }
+
+    return res;
+}
+
+std::vector<PatchDB::patchRecord> PatchDB::prefixSearch(const std::string &text, int limit)
+{
+    std::vector<PatchDB::patchRecord> res;
+    auto match = matchExpression(text, "name");
+    if (match.empty())
+        return res;
+
+    /*
+     * No ORDER BY, so FTS5 hands back matches in id order and stops at the limit rather than
+     * scoring everything which matches first. That keeps a one letter prefix as quick as a long
+     * one however big the library is.
+     */
+    try
+    {
+        auto st = SQL::Statement(worker->dbh,
+                                 "SELECT p.id, p.path, p.category, p.name, p.author FROM "
+                                 "PatchSearch JOIN Patches AS p ON p.id = PatchSearch.rowid "
+                                 "WHERE PatchSearch MATCH ?1 LIMIT ?2");
+        st.bind(1, match);
+        st.bind(2, limit);
+
+        while (st.step())
+            res.emplace_back(st.col_int(0), st.col_str(1), st.col_str(2), st.col_str(3),
+                             st.col_str(4));
+
+        st.finalize();
+    }
+    catch (SQL::Exception &e)
+    {
+        storage->reportError(e.what(), "PatchDB - prefixSearch");
+    }
+
+    std::sort(res.begin(), res.end(),
+              [](const patchRecord &a, const patchRecord &b) { return a.name < b.name; });
+    return res;
+}
+
+std::vector<PatchDB::SimilarPatch> PatchDB::similarPatches(int patchId, int count)
+{
+    workerS::FeatureSpace::Vector v;
+    if (!worker->similarity.get(patchId, v))
+        return {};
+
+    try
+    {
+        return worker->similarPatches(v, count, patchId);
+    }
+    catch (SQL::Exception &e)
+    {
+        storage->reportError(e.what(), "PatchDB - similarPatches");
+    }
+    return {};
+}
+
+std::vector<PatchDB::SimilarPatch> PatchDB::similarPatchesTo(const SurgePatch &patch, int count)
+{
+    try
+    {
+        return worker->similarPatches(worker->features->fromPatch(patch), count, -1);
+    }
+    catch (SQL::Exception &e)
+    {
+        storage->reportError(e.what(), "PatchDB - similarPatchesTo");
+    }
+    return {};
+}
+
 std::vector<PatchDB::catRecord> PatchDB::rootCategoriesForType(const CatType t)
 {
     std::string query = "select c.id, c.name, c.leaf_name, c.isroot, c.type from Category "
@@ -860,5 +1771,27 @@ std::vector<PatchDB::catRecord> PatchDB::internalCategories(int t, const std::st
     return res;
 }
 
+bool PatchDB::readPatchHeader(const char *xml, size_t size, PatchHeader &into)
+{
+    auto end = xml + size;
+    auto patch = findOpenTag(xml, end, "patch");
+    if (!patch)
+        return false;
+
+    std::map<std::string, std::string> attrs;
+    readAttributes(patch, end, attrs);
+    auto rev = attrs.find("revision");
+    if (rev == attrs.end())
+        return false;
+    into.revision = std::atoi(rev->second.c_str());
+
+    // <meta> is the first thing in <patch> in anything we wrote, so this is usually one step
+    into.meta.clear();
+    auto meta = findOpenTag(patch, end, "meta");
+    if (meta)
+        readAttributes(meta, end, into.meta);
+    return true;
+}
+
 } // namespace PatchStorage
 } // namespace Surge
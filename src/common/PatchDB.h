@@ -21,8 +21,11 @@
 #include <condition_variable>
 #include "filesystem/import.h"
 #include <iostream>
+#include <map>
+#include <string>
 
 class SurgeStorage;
+class SurgePatch;
 
 namespace Surge
 {
@@ -63,12 +66,17 @@ struct PatchDB
         CatType type;
     };
 
-    explicit PatchDB(SurgeStorage *);
+    /*
+     * Patches are read by a pool of readerThreads threads (by default one fewer than the machine
+     * has cores, up to 8) and written to the database by one more.
+     */
+    explicit PatchDB(SurgeStorage *, int readerThreads = 0);
     ~PatchDB();
 
     void initialize();
 
     SurgeStorage *storage;
+    int readerThreads;
 
     std::unique_ptr<workerS> worker;
 
@@ -78,11 +86,74 @@ struct PatchDB
     void addRootCategory(const std::string &name, CatType type);
     void addSubCategory(const std::string &name, const std::string &parent, CatType type);
 
+    // Patches and categories queued but not yet written; 0 once the worker has caught up
+    int numberOfJobsOutstanding() const;
+
     // This is a temporary API point
     std::vector<patchRecord> rawQueryForNameLike(const std::string &nameLikeThis);
     std::vector<catRecord> rootCategoriesForType(const CatType t);
     std::vector<catRecord> childCategoriesOf(int catId);
 
+    /*
+     * Search runs on an FTS5 index of every patch's name, category, author, comment and tags.
+     * Each word of text matches the start of a word anywhere in those, all the words must match,
+     * and results come best first with the name counting most. With no text everything matches,
+     * in category and then name order. A category or author narrows the results to exactly that
+     * one, which is how a facet gets picked. Results come a page at a time, from offset.
+     */
+    struct SearchQuery
+    {
+        std::string text;
+        std::string category;
+        std::string author;
+    };
+    struct Facet
+    {
+        std::string value;
+        int count;
+    };
+    struct Facets
+    {
+        std::vector<Facet> categories, authors; // most patches first
+    };
+
+    std::vector<patchRecord> search(const SearchQuery &q, int offset, int limit);
+    int countSearchResults(const SearchQuery &q);
+    Facets searchFacets(const SearchQuery &q);
+
+    /*
+     * Search as you type: up to limit patches with a word in their name starting with each word
+     * of text, sorted by name. This doesn't rank, so it stays quick on libraries of any size.
+     */
+    std::vector<patchRecord> prefixSearch(const std::string &text, int limit);
+
+    /*
+     * Patches built like another, nearest first. Indexing keeps a vector of each patch's
+     * oscillator, filter and effect types, envelope settings and amount of modulation, and these
+     * compare them all. A distance of 0 means the vectors match; one entry being as different as
+     * it can be is a distance of 1. similarPatches leaves out the patch it was asked about.
+     */
+    struct SimilarPatch
+    {
+        patchRecord patch;
+        float distance;
+    };
+    std::vector<SimilarPatch> similarPatches(int patchId, int count);
+    std::vector<SimilarPatch> similarPatchesTo(const SurgePatch &patch, int count);
+
+    /*
+     * What the database reads out of each patch: the revision from the <patch> element and the
+     * attributes of <meta>. readPatchHeader scans the XML for just these and stops at the end of
+     * the <meta> tag, rather than building a document, so it is cheap to run over a whole
+     * library. It returns false if there is no <patch> element with a revision.
+     */
+    struct PatchHeader
+    {
+        int revision{0};
+        std::map<std::string, std::string> meta;
+    };
+    static bool readPatchHeader(const char *xml, size_t size, PatchHeader &into);
+
   private:
     std::vector<catRecord> internalCategories(int arg, const std::string &query);
 };
@@ -0,0 +1,210 @@
+/*
+** Surge Synthesizer is Free and Open Source Software
+**
+** Surge is made available under the Gnu General Public License, v3.0
+** https://www.gnu.org/licenses/gpl-3.0.en.html
+**
+** Copyright 2004-2021 by various individuals as described by the Git transaction log
+**
+** All source at: https://github.com/surge-synthesizer/surge.git
+**
+** Surge was a commercial product from 2004-2018, with Copyright and ownership
+** in that period held by Claes Johanson at Vember Audio. Claes made Surge
+** open source in September 2018.
+*/
+
+#include "PatchLoader.h"
+#include "SurgeSynthesizer.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace Surge
+{
+namespace Storage
+{
+PatchLoader::PatchLoader(SurgeSynthesizer *synth, ServiceThread *service)
+    : synth(synth), serviceThread(service)
+{
+    requestPath[0] = 0;
+    serviceThread->setHandler(ServiceThread::patchLoad, [this]() { return this->service(); });
+}
+
+bool PatchLoader::requestLoad(int id, const char *path)
+{
+    if (state.load(std::memory_order_acquire) != idle)
+        return false;
+
+    requestId = id;
+    requestPath[0] = 0;
+    if (path)
+    {
+        strncpy(requestPath, path, sizeof(requestPath) - 1);
+        requestPath[sizeof(requestPath) - 1] = 0;
+    }
+    state.store(requested, std::memory_order_release);
+    serviceThread->post(ServiceThread::patchLoad);
+    return true;
+}
+
+void PatchLoader::discardPrepared()
+{
+    if (state.load(std::memory_order_acquire) != prepared)
+        return;
+    state.store(discarded, std::memory_order_release);
+    serviceThread->post(ServiceThread::patchLoad);
+}
+
+void PatchLoader::commit()
+{
+    if (state.load(std::memory_order_acquire) != prepared)
+        return;
+    state.store(committing, std::memory_order_release);
+    serviceThread->post(ServiceThread::patchLoad);
+}
+
+bool PatchLoader::service()
+{
+    auto st = state.load(std::memory_order_acquire);
+
+    if (st == requested)
+    {
+        state.store(preparing, std::memory_order_relaxed);
+        if (prepare())
+        {
+            state.store(prepared, std::memory_order_release);
+        }
+        else
+        {
+            patch.reset();
+            effects.reset();
+            state.store(idle, std::memory_order_release);
+        }
+        return true;
+    }
+
+    if (st == committing)
+    {
+        if (patchId >= 0)
+            synth->patchid = patchId;
+        synth->loadPreparedPatch(*patch, categoryId, name.c_str(), effects.get());
+        synth->updateDisplay();
+        synth->cachePreparedPatch(*patch);
+
+        // Anything left here is the previous patch's wavetable data or unused effects
+        patch.reset();
+        effects.reset();
+
+        /*
+         * The tuning rewrites the storage tables the voices read, so it goes in before the
+         * engine is released. That can mean asking the user first, with the engine held, as the
+         * patch load always has.
+         */
+        synth->applyPatchTuning();
+
+        synth->halt_engine = false;
+        state.store(idle, std::memory_order_release);
+        return true;
+    }
+
+    if (st == discarded)
+    {
+        patch.reset();
+        effects.reset();
+        state.store(idle, std::memory_order_release);
+        return true;
+    }
+
+    return false;
+}
+
+bool PatchLoader::prepare()
+{
+    auto &storage = synth->storage;
+
+    patchId = -1;
+    categoryId = -1;
+
+    if (requestPath[0])
+    {
+        // A file which is also in the patch list loads as that patch, as the old thread did
+        path = requestPath;
+        int ct = 0;
+        for (const auto &pti : storage.patch_list)
+        {
+            if (path_to_string(pti.path) == path)
+                patchId = ct;
+            ct++;
+        }
+        name = path_to_string(string_to_path(path).stem());
+    }
+    else
+    {
+        patchId = std::max(requestId, 0);
+    }
+
+    if (patchId >= 0)
+    {
+        if (storage.patch_list.empty())
+            return false;
+        patchId = patchId % (int)storage.patch_list.size();
+
+        const auto &e = storage.patch_list[patchId];
+        path = path_to_string(e.path);
+        categoryId = e.category;
+        name = e.name;
+    }
+
+    patch = std::make_unique<PreparedPatch>();
+    if (!synth->preparePatchFromPath(path.c_str(), name.c_str(), *patch))
+        return false;
+
+    prepareEffects();
+    return true;
+}
+
+void PatchLoader::prepareEffects()
+{
+    auto &livePatch = synth->storage.getPatch();
+    effects = std::make_unique<PreparedEffects>();
+
+    auto xpatch = TINYXML_SAFE_TO_ELEMENT(patch->doc.FirstChild("patch"));
+    auto params = xpatch ? TINYXML_SAFE_TO_ELEMENT(xpatch->FirstChild("parameters")) : nullptr;
+
+    for (int s = 0; s < n_fx_slots; ++s)
+    {
+        effects->type[s] = fxt_off;
+
+        // A patch from the cache has no XML, but its compiled form has the types just as handy
+        int t;
+        pdata v;
+        if (!patch->compiled.empty())
+        {
+            if (!SurgePatch::compiled_param_value(patch->compiled, livePatch.fx[s].type.id, v))
+                continue;
+            t = v.i;
+        }
+        else
+        {
+            if (!params)
+                continue;
+            auto p = TINYXML_SAFE_TO_ELEMENT(
+                params->FirstChild(livePatch.fx[s].type.get_storage_name()));
+            if (!p || p->QueryIntAttribute("value", &t) != TIXML_SUCCESS)
+                continue;
+        }
+        if (t <= fxt_off || t >= n_fx_types)
+            continue;
+
+        /*
+         * These point at the live slot just as the preparer's do. loadFx only takes one over
+         * if the slot comes out of load_xml with the same type; otherwise it is freed here.
+         */
+        effects->type[s] = t;
+        effects->fx[s].reset(
+            spawn_effect_in_slab(t, &synth->storage, &livePatch.fx[s], livePatch.globaldata));
+    }
+}
+
+} // namespace Storage
+} // namespace Surge
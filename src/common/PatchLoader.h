@@ -0,0 +1,109 @@
+/*
+** Surge Synthesizer is Free and Open Source Software
+**
+** Surge is made available under the Gnu General Public License, v3.0
+** https://www.gnu.org/licenses/gpl-3.0.en.html
+**
+** Copyright 2004-2021 by various individuals as described by the Git transaction log
+**
+** All source at: https://github.com/surge-synthesizer/surge.git
+**
+** Surge was a commercial product from 2004-2018, with Copyright and ownership
+** in that period held by Claes Johanson at Vember Audio. Claes made Surge
+** open source in September 2018.
+*/
+
+#ifndef SURGE_XT_PATCHLOADER_H
+#define SURGE_XT_PATCHLOADER_H
+
+#include "SurgeStorage.h"
+#include "EffectPreparer.h"
+#include "ServiceThread.h"
+
+#include <atomic>
+#include <memory>
+#include <string>
+
+class SurgeSynthesizer;
+
+namespace Surge
+{
+namespace Storage
+{
+/*
+ * PatchLoader does the work of a patch change on the service thread, so the audio thread never
+ * has to start a thread and the old patch keeps playing while the new one is read.
+ *
+ * When process() sees a queued patch it hands it over with requestLoad(). The service thread
+ * reads the file, parses the XML, builds the embedded wavetables and constructs the patch's
+ * effects, and marks the patch prepared. Only then does process() fade out, halt the engine and
+ * commit(); the service thread applies the prepared patch to the live SurgePatch, which is now
+ * a matter of copying values, applies any tuning stored in the patch, and releases the engine
+ * again so process() can fade back in.
+ *
+ * There is a single job which moves through
+ *
+ *     idle -> requested -> preparing -> prepared -> committing -> idle
+ *
+ * with the audio thread making the idle->requested and prepared->committing transitions and
+ * the service thread the others. A prepared patch which is overtaken by a newer request goes
+ * prepared -> discarded -> idle instead, so the last request always wins.
+ */
+class PatchLoader
+{
+  public:
+    PatchLoader(SurgeSynthesizer *synth, ServiceThread *service);
+
+    /*
+     * Audio thread. Start preparing the file at path or, if path is null, patch id from the
+     * patch list. Returns false if the loader is busy with another patch.
+     */
+    bool requestLoad(int id, const char *path);
+
+    // Audio thread. Is a patch ready to be committed?
+    bool isPrepared() const { return state.load(std::memory_order_acquire) == prepared; }
+
+    // Audio thread. Throw away the prepared patch so a newer request can replace it.
+    void discardPrepared();
+
+    /*
+     * Audio thread, with the engine already halted. Applies the prepared patch on the service
+     * thread, which clears halt_engine once it is done.
+     */
+    void commit();
+
+    bool isIdle() const { return state.load(std::memory_order_acquire) == idle; }
+
+  private:
+    enum JobState
+    {
+        idle,
+        requested,
+        preparing,
+        prepared,
+        committing,
+        discarded
+    };
+
+    bool service();
+    bool prepare();
+    void prepareEffects();
+
+    SurgeSynthesizer *synth;
+    ServiceThread *serviceThread;
+    std::atomic<int> state{idle};
+
+    // The request, written by the audio thread while idle
+    int requestId{-1};
+    char requestPath[FILENAME_MAX];
+
+    // The prepared patch, owned by the service thread outside of prepared
+    int patchId{-1}, categoryId{-1};
+    std::string path, name;
+    std::unique_ptr<PreparedPatch> patch;
+    std::unique_ptr<PreparedEffects> effects;
+};
+} // namespace Storage
+} // namespace Surge
+
+#endif // SURGE_XT_PATCHLOADER_H
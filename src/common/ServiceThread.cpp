@@ -0,0 +1,184 @@
+/*
+** Surge Synthesizer is Free and Open Source Software
+**
+** Surge is made available under the Gnu General Public License, v3.0
+** https://www.gnu.org/licenses/gpl-3.0.en.html
+**
+** Copyright 2004-2021 by various individuals as described by the Git transaction log
+**
+** All source at: https://github.com/surge-synthesizer/surge.git
+**
+** Surge was a commercial product from 2004-2018, with Copyright and ownership
+** in that period held by Claes Johanson at Vember Audio. Claes made Surge
+** open source in September 2018.
+*/
+
+#include "ServiceThread.h"
+
+namespace Surge
+{
+namespace Storage
+{
+ServiceThread::ServiceThread()
+{
+    for (int i = 0; i < queueSize; ++i)
+        cells[i].sequence.store(i, std::memory_order_relaxed);
+}
+
+ServiceThread::~ServiceThread() { stop(); }
+
+void ServiceThread::setHandler(CommandType t, std::function<bool()> handler)
+{
+    handlers[t] = std::move(handler);
+}
+
+void ServiceThread::start()
+{
+    if (serviceThread.joinable())
+        return;
+    keepRunning = true;
+    serviceThread = std::thread([this]() { this->serviceLoop(); });
+}
+
+void ServiceThread::stop()
+{
+    keepRunning = false;
+    {
+        std::lock_guard<std::mutex> g(wakeMutex);
+        wakeCV.notify_all();
+    }
+    if (serviceThread.joinable())
+        serviceThread.join();
+}
+
+bool ServiceThread::post(CommandType t)
+{
+    /*
+     * This is the bounded queue from Dmitry Vyukov: each cell carries a sequence number which
+     * tells a producer whether the cell is free for position pos, and the consumer whether it
+     * has been filled.
+     */
+    Cell *cell;
+    auto pos = enqueuePos.load(std::memory_order_relaxed);
+    for (;;)
+    {
+        cell = &cells[pos & (queueSize - 1)];
+        auto seq = cell->sequence.load(std::memory_order_acquire);
+        auto dif = (intptr_t)seq - (intptr_t)pos;
+        if (dif == 0)
+        {
+            if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if (dif < 0)
+        {
+            // Full. The idle sweep will get to it.
+            dropped++;
+            workPending = true;
+            return false;
+        }
+        else
+        {
+            pos = enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+
+    // Counting ourselves, since the command can't have been taken before it is published
+    int depth = (int)(pos + 1 - dequeuePos.load(std::memory_order_relaxed));
+    int prior = maxQueueDepth.load(std::memory_order_relaxed);
+    while (depth > prior && !maxQueueDepth.compare_exchange_weak(prior, depth))
+        ;
+
+    cell->command.type = t;
+    cell->command.posted = clock_t::now();
+    cell->sequence.store(pos + 1, std::memory_order_release);
+
+    // No notify, which could be a futex call on the audio thread; the next poll sees this
+    workPending = true;
+    return true;
+}
+
+bool ServiceThread::pop(Command &c)
+{
+    auto pos = dequeuePos.load(std::memory_order_relaxed);
+    auto &cell = cells[pos & (queueSize - 1)];
+    auto seq = cell.sequence.load(std::memory_order_acquire);
+    if ((intptr_t)seq - (intptr_t)(pos + 1) < 0)
+        return false;
+
+    c = cell.command;
+    cell.sequence.store(pos + queueSize, std::memory_order_release);
+    dequeuePos.store(pos + 1, std::memory_order_relaxed);
+    return true;
+}
+
+void ServiceThread::runAll()
+{
+    for (auto &h : handlers)
+        if (h)
+            h();
+}
+
+void ServiceThread::serviceLoop()
+{
+    while (keepRunning)
+    {
+        bool didWork = false;
+        Command c;
+        while (keepRunning && pop(c))
+        {
+            auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(clock_t::now() -
+                                                                           c.posted)
+                          .count();
+            lastLatencyNs = ns;
+            totalLatencyNs += ns;
+            auto prior = maxLatencyNs.load();
+            while (ns > prior && !maxLatencyNs.compare_exchange_weak(prior, ns))
+                ;
+            serviced++;
+
+            if (handlers[c.type])
+                didWork |= handlers[c.type]();
+        }
+
+        if (didWork)
+            continue;
+
+        std::unique_lock<std::mutex> lk(wakeMutex);
+        bool woken = wakeCV.wait_for(lk, std::chrono::milliseconds(pollMs), [this]() {
+            return !keepRunning || workPending.exchange(false);
+        });
+        lk.unlock();
+
+        // Poll everyone now and then, as the separate loader threads used to
+        if (!woken && keepRunning)
+            runAll();
+    }
+}
+
+ServiceThread::Stats ServiceThread::getStats() const
+{
+    Stats s;
+    s.serviced = serviced;
+    s.dropped = dropped;
+    auto d = dequeuePos.load();
+    s.queueDepth = (int)(enqueuePos.load() - d);
+    s.maxQueueDepth = maxQueueDepth;
+    s.lastLatencyMs = lastLatencyNs * 1e-6;
+    s.maxLatencyMs = maxLatencyNs * 1e-6;
+    s.meanLatencyMs = s.serviced ? totalLatencyNs * 1e-6 / s.serviced : 0.0;
+    return s;
+}
+
+void ServiceThread::resetStats()
+{
+    serviced = 0;
+    dropped = 0;
+    totalLatencyNs = 0;
+    lastLatencyNs = 0;
+    maxLatencyNs = 0;
+    maxQueueDepth = 0;
+}
+
+} // namespace Storage
+} // namespace Surge
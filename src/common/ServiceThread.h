@@ -0,0 +1,125 @@
+/*
+** Surge Synthesizer is Free and Open Source Software
+**
+** Surge is made available under the Gnu General Public License, v3.0
+** https://www.gnu.org/licenses/gpl-3.0.en.html
+**
+** Copyright 2004-2021 by various individuals as described by the Git transaction log
+**
+** All source at: https://github.com/surge-synthesizer/surge.git
+**
+** Surge was a commercial product from 2004-2018, with Copyright and ownership
+** in that period held by Claes Johanson at Vember Audio. Claes made Surge
+** open source in September 2018.
+*/
+
+#ifndef SURGE_XT_SERVICETHREAD_H
+#define SURGE_XT_SERVICETHREAD_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace Surge
+{
+namespace Storage
+{
+/*
+ * ServiceThread is the one long lived, normal priority thread which does the synth's non
+ * realtime work: preparing and committing patches, and building and freeing effects and
+ * wavetables. A patch's own tuning goes in as part of its commit, with the engine held; tuning
+ * loaded from the UI (.scl and .kbm files, the retuneTo calls) doesn't come through here and is
+ * still applied on the thread which asks for it.
+ *
+ * Each kind of work keeps its own state (the slots of WavetableLoader, EffectPreparer and
+ * PatchLoader) and registers a handler for its command type. Whenever one of them moves a slot
+ * along it posts that command, which is a couple of atomic operations on a bounded lock-free
+ * queue and never blocks. Posting doesn't wake the thread, since that can mean a system call on
+ * the audio thread; the thread checks for work at least every pollMs instead. It runs the
+ * handler for every command it pops. A handler returns whether it found anything to do, and
+ * every handler is also run whenever the thread has been idle for a poll, so a command which
+ * doesn't fit in a full queue is only late.
+ *
+ * Mostly the audio thread posts, but a patch load applied on this thread can post too (when it
+ * retires effects, say), so the queue allows any number of producers and a single consumer.
+ */
+class ServiceThread
+{
+  public:
+    enum CommandType
+    {
+        patchLoad,     // PatchLoader: prepare, commit (with the patch's tuning) or discard
+        fxLoad,        // EffectPreparer: build requested effects, free retired ones
+        wavetableLoad, // WavetableLoader: read requested tables, free retired ones
+
+        n_command_types
+    };
+
+    struct Stats
+    {
+        uint64_t serviced{0}, dropped{0};
+        int queueDepth{0}, maxQueueDepth{0};
+        // From post() to the handler starting
+        double lastLatencyMs{0}, maxLatencyMs{0}, meanLatencyMs{0};
+    };
+
+    ServiceThread();
+    ~ServiceThread();
+
+    // Register all the handlers, then start. Both from the thread which owns us.
+    void setHandler(CommandType t, std::function<bool()> handler);
+    void start();
+    void stop();
+
+    // Any thread, realtime safe: no lock and no wakeup. Returns false if the queue was full.
+    bool post(CommandType t);
+
+    Stats getStats() const;
+    void resetStats();
+
+    static constexpr int queueSize = 256; // a power of two
+    static constexpr int pollMs = 20;     // the longest a posted command waits to be seen
+
+  private:
+    typedef std::chrono::steady_clock clock_t;
+
+    struct Command
+    {
+        int type;
+        clock_t::time_point posted;
+    };
+
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        Command command;
+    };
+
+    bool pop(Command &c);
+    void serviceLoop();
+    void runAll();
+
+    Cell cells[queueSize];
+    std::atomic<size_t> enqueuePos{0}, dequeuePos{0};
+
+    std::function<bool()> handlers[n_command_types];
+
+    std::atomic<uint64_t> serviced{0}, dropped{0}, totalLatencyNs{0};
+    std::atomic<int64_t> lastLatencyNs{0}, maxLatencyNs{0};
+    std::atomic<int> maxQueueDepth{0};
+
+    std::thread serviceThread;
+    std::atomic<bool> keepRunning{true};
+    std::atomic<bool> workPending{false};
+    std::mutex wakeMutex;
+    std::condition_variable wakeCV;
+};
+} // namespace Storage
+} // namespace Surge
+
+#endif // SURGE_XT_SERVICETHREAD_H
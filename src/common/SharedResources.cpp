@@ -0,0 +1,213 @@
+/*
+** Surge Synthesizer is Free and Open Source Software
+**
+** Surge is made available under the Gnu General Public License, v3.0
+** https://www.gnu.org/licenses/gpl-3.0.en.html
+**
+** Copyright 2004-2021 by various individuals as described by the Git transaction log
+**
+** All source at: https://github.com/surge-synthesizer/surge.git
+**
+** Surge was a commercial product from 2004-2018, with Copyright and ownership
+** in that period held by Claes Johanson at Vember Audio. Claes made Surge
+** open source in September 2018.
+*/
+
+#include "SharedResources.h"
+#include "DSPUtils.h"
+#include "SurgeSharedBinary.h"
+
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+namespace Surge
+{
+namespace Storage
+{
+std::atomic<bool> SharedResources::sharingEnabled{true};
+
+static void initializeSincTables()
+{
+    float cutoff = 0.455f;
+    float cutoff1X = 0.85f;
+    float cutoffI16 = 1.0f;
+    int j;
+    for (j = 0; j < FIRipol_M + 1; j++)
+    {
+        for (int i = 0; i < FIRipol_N; i++)
+        {
+            double t = -double(i) + double(FIRipol_N / 2.0) + double(j) / double(FIRipol_M) - 1.0;
+            double val = (float)(symmetric_blackman(t, FIRipol_N) * cutoff * sincf(cutoff * t));
+            double val1X =
+                (float)(symmetric_blackman(t, FIRipol_N) * cutoff1X * sincf(cutoff1X * t));
+            sinctable[j * FIRipol_N * 2 + i] = (float)val;
+            sinctable1X[j * FIRipol_N + i] = (float)val1X;
+        }
+    }
+    for (j = 0; j < FIRipol_M; j++)
+    {
+        for (int i = 0; i < FIRipol_N; i++)
+        {
+            sinctable[j * FIRipol_N * 2 + FIRipol_N + i] =
+                (float)((sinctable[(j + 1) * FIRipol_N * 2 + i] -
+                         sinctable[j * FIRipol_N * 2 + i]) /
+                        65536.0);
+        }
+    }
+
+    for (j = 0; j < FIRipol_M + 1; j++)
+    {
+        for (int i = 0; i < FIRipolI16_N; i++)
+        {
+            double t =
+                -double(i) + double(FIRipolI16_N / 2.0) + double(j) / double(FIRipol_M) - 1.0;
+            double val =
+                (float)(symmetric_blackman(t, FIRipolI16_N) * cutoffI16 * sincf(cutoffI16 * t));
+
+            sinctableI16[j * FIRipolI16_N + i] = (short)((float)val * 16384.f);
+        }
+    }
+}
+
+std::shared_ptr<const SharedResources> SharedResources::get()
+{
+    static std::once_flag sincOnce;
+    std::call_once(sincOnce, initializeSincTables);
+
+    if (!sharingEnabled)
+        return std::make_shared<SharedResources>();
+
+    static std::mutex registryMutex;
+    static std::weak_ptr<const SharedResources> registry;
+
+    std::lock_guard<std::mutex> g(registryMutex);
+    auto res = registry.lock();
+    if (!res)
+    {
+        res = std::make_shared<SharedResources>();
+        registry = res;
+    }
+    return res;
+}
+
+SharedResources::SharedResources()
+{
+    loadWindowWT();
+    loadParamDocumentation();
+}
+
+void SharedResources::loadWindowWT()
+{
+    wt_header wh;
+    auto wtData = SurgeStorage::read_wt_header_mem(SurgeSharedBinary::windows_wt,
+                                                   SurgeSharedBinary::windows_wtSize, wh);
+    if (!wtData || !windowWT.BuildWT((void *)wtData, wh, false))
+    {
+        windowWT.size = 0;
+        windowWTError = "Unable to load 'windows.wt' from memory. "
+                        "This is a fatal internal software error which should never occur!";
+    }
+}
+
+void SharedResources::loadParamDocumentation()
+{
+    auto pdData = std::string(SurgeSharedBinary::paramdocumentation_xml,
+                              SurgeSharedBinary::paramdocumentation_xmlSize) +
+                  "\n";
+
+    TiXmlDocument doc;
+    if (!doc.Parse(pdData.c_str()) || doc.Error())
+    {
+        std::cout << "Unable to load  'paramdocumentation'!" << std::endl;
+        std::cout << "Unable to parse!\nError is:\n"
+                  << doc.ErrorDesc() << " at row " << doc.ErrorRow() << ", column "
+                  << doc.ErrorCol() << std::endl;
+        return;
+    }
+
+    TiXmlElement *pdoc = TINYXML_SAFE_TO_ELEMENT(doc.FirstChild("param-doc"));
+    if (!pdoc)
+    {
+        paramDocumentationError = "Unknown top element in paramdocumentation.xml - not a parameter "
+                                  "documentation XML file!";
+        return;
+    }
+
+    for (auto pchild = pdoc->FirstChildElement(); pchild; pchild = pchild->NextSiblingElement())
+    {
+        if (strcmp(pchild->Value(), "ctrl_group") == 0)
+        {
+            int g = 0;
+            if (pchild->QueryIntAttribute("group", &g) == TIXML_SUCCESS)
+            {
+                std::string help_url = pchild->Attribute("help_url");
+                if (help_url.size() > 0)
+                    helpURL_controlgroup[g] = help_url;
+            }
+        }
+        else if (strcmp(pchild->Value(), "param") == 0)
+        {
+            std::string id = pchild->Attribute("id");
+            std::string help_url = pchild->Attribute("help_url");
+            int t = 0;
+            if (help_url.size() > 0)
+            {
+                if (pchild->QueryIntAttribute("type", &t) == TIXML_SUCCESS)
+                {
+                    helpURL_paramidentifier_typespecialized[std::make_pair(id, t)] = help_url;
+                }
+                else
+                {
+                    helpURL_paramidentifier[id] = help_url;
+                }
+            }
+        }
+        else if (strcmp(pchild->Value(), "special") == 0)
+        {
+            std::string id = pchild->Attribute("id");
+            std::string help_url = pchild->Attribute("help_url");
+            if (help_url.size() > 0)
+            {
+                helpURL_specials[id] = help_url;
+            }
+        }
+        else
+        {
+            std::cout << "UNKNOWN " << pchild->Value() << std::endl;
+        }
+    }
+}
+
+std::shared_ptr<SharedCatalog> SharedCatalog::get(const std::string &datapath,
+                                                  const std::string &userDataPath)
+{
+    if (!SharedResources::sharingEnabled)
+        return std::make_shared<SharedCatalog>();
+
+    static std::mutex registryMutex;
+    static std::map<std::pair<std::string, std::string>, std::weak_ptr<SharedCatalog>> registry;
+
+    std::lock_guard<std::mutex> g(registryMutex);
+
+    // Forget the paths nobody is using any more
+    for (auto it = registry.begin(); it != registry.end();)
+    {
+        if (it->second.expired())
+            it = registry.erase(it);
+        else
+            ++it;
+    }
+
+    auto &slot = registry[std::make_pair(datapath, userDataPath)];
+    auto res = slot.lock();
+    if (!res)
+    {
+        res = std::make_shared<SharedCatalog>();
+        slot = res;
+    }
+    return res;
+}
+
+} // namespace Storage
+} // namespace Surge
@@ -0,0 +1,102 @@
+/*
+** Surge Synthesizer is Free and Open Source Software
+**
+** Surge is made available under the Gnu General Public License, v3.0
+** https://www.gnu.org/licenses/gpl-3.0.en.html
+**
+** Copyright 2004-2021 by various individuals as described by the Git transaction log
+**
+** All source at: https://github.com/surge-synthesizer/surge.git
+**
+** Surge was a commercial product from 2004-2018, with Copyright and ownership
+** in that period held by Claes Johanson at Vember Audio. Claes made Surge
+** open source in September 2018.
+*/
+
+#ifndef SURGE_XT_SHAREDRESOURCES_H
+#define SURGE_XT_SHAREDRESOURCES_H
+
+#include "SurgeStorage.h"
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace Surge
+{
+namespace Storage
+{
+/*
+ * SharedResources holds what every SurgeStorage in a process used to build for itself from the
+ * binary data compiled into Surge: the windows.wt table the window oscillator reads and the help
+ * URLs parsed from paramdocumentation.xml. Each storage holds a reference on the one instance,
+ * which is built by the first storage to need it and freed with the last one. It never changes
+ * once built, so the storages read it with no locking.
+ *
+ * Getting it also makes sure the global sinc tables have been computed, which now happens once
+ * per process rather than on every construction (with other instances reading them meanwhile).
+ */
+struct SharedResources
+{
+    Wavetable windowWT;
+    std::string windowWTError;
+
+    std::string paramDocumentationError;
+
+    std::unordered_map<int, std::string> helpURL_controlgroup;
+    std::unordered_map<std::string, std::string> helpURL_paramidentifier;
+    std::unordered_map<std::string, std::string> helpURL_specials;
+    std::map<std::pair<std::string, int>, std::string> helpURL_paramidentifier_typespecialized;
+
+    // Thread safe
+    static std::shared_ptr<const SharedResources> get();
+
+    /*
+     * For measuring what the sharing saves: with this off every get() builds a fresh copy and
+     * every storage walks the patch and wavetable folders itself, as before.
+     */
+    static std::atomic<bool> sharingEnabled;
+
+    SharedResources();
+    SharedResources(const SharedResources &) = delete;
+    SharedResources &operator=(const SharedResources &) = delete;
+
+  private:
+    void loadWindowWT();
+    void loadParamDocumentation();
+};
+
+/*
+ * SharedCatalog caches the result of walking the patch and wavetable folders, per data and user
+ * data path, for as long as some storage using those paths is alive. A new storage copies the
+ * lists rather than walking the disk again. An explicit refresh (after saving a patch, say) still
+ * walks the disk and then updates the cache, so storages created afterwards see the change;
+ * storages which already exist keep their own lists as they always have.
+ */
+struct SharedCatalog
+{
+    struct Lists
+    {
+        bool valid{false};
+        std::vector<Patch> items;
+        std::vector<PatchCategory> categories;
+        int firstThirdPartyCategory{0}, firstUserCategory{0};
+        std::vector<int> ordering, categoryOrdering;
+    };
+
+    std::mutex mutex;
+    Lists patches, wavetables;
+
+    // Thread safe
+    static std::shared_ptr<SharedCatalog> get(const std::string &datapath,
+                                              const std::string &userDataPath);
+};
+} // namespace Storage
+} // namespace Surge
+
+#endif // SURGE_XT_SHAREDRESOURCES_H
@@ -18,6 +18,7 @@
 #include "SurgeParamConfig.h"
 #include "Effect.h"
 #include <list>
+#include <type_traits>
 #include <vembertech/vt_dsp_endian.h>
 #include "MSEGModulationHelper.h"
 #include "FormulaModulationHelper.h"
@@ -748,6 +749,16 @@ void SurgePatch::copy_globaldata(pdata *d)
 }
 // pdata scenedata[n_scenes][n_scene_params];
 
+void SurgePatch::rebuildModulationTables()
+{
+    for (int sc = 0; sc < n_scenes; sc++)
+    {
+        scene[sc].modulation_scene_table.rebuild(scene[sc].modulation_scene);
+        scene[sc].modulation_voice_table.rebuild(scene[sc].modulation_voice);
+    }
+    modulation_global_table.rebuild(modulation_global);
+}
+
 void SurgePatch::update_controls(
     bool init,
     void *init_osc,     // init_osc is the pointer to the data structure of a particular osc to init
@@ -913,64 +924,135 @@ std::string base64_decode(std::string const &encoded_string)
 }
 
 void SurgePatch::load_patch(const void *data, int datasize, bool preset)
+{
+    PreparedPatch pp;
+    prepare_patch(data, datasize, pp);
+    load_prepared(pp, preset);
+
+    // The synth rebuilds these when it loads a patch, but this can be called on its own
+    rebuildModulationTables();
+}
+
+void SurgePatch::prepare_patch(const void *data, int datasize, PreparedPatch &into,
+                               bool parseXML)
 {
     if (datasize <= 4)
         return;
-    assert(datasize);
     assert(data);
-    void *end = (char *)data + datasize;
-    patch_header *ph = (patch_header *)data;
-    ph->xmlsize = vt_read_int32LE(ph->xmlsize);
+    into.valid = true;
 
-    if (!memcmp(ph->tag, "sub3", 4))
+    if (is_compiled(data, datasize))
     {
-        char *dr = (char *)data + sizeof(patch_header);
-        load_xml(dr, ph->xmlsize, preset);
-        dr += ph->xmlsize;
+        into.compiled.assign((const char *)data, (const char *)data + datasize);
+        return;
+    }
 
-        for (int sc = 0; sc < n_scenes; sc++)
+    /*
+     * This only reads data, which may be a read-only file mapping, so every size in the file is
+     * checked against what is left before it is used.
+     */
+    const char *end = (const char *)data + datasize;
+    const patch_header *ph = (const patch_header *)data;
+
+    if (datasize < (int)sizeof(patch_header) || memcmp(ph->tag, "sub3", 4))
+    {
+        if (parseXML)
+            parse_xml(data, datasize, into.doc);
+        return;
+    }
+
+    const char *dr = (const char *)data + sizeof(patch_header);
+    int xmlsize = vt_read_int32LE(ph->xmlsize);
+    if (xmlsize < 0 || xmlsize > end - dr)
+        xmlsize = (int)(end - dr);
+    if (parseXML)
+        parse_xml(dr, xmlsize, into.doc);
+    dr += xmlsize;
+
+    for (int sc = 0; sc < n_scenes; sc++)
+    {
+        for (int osc = 0; osc < n_oscs; osc++)
         {
-            for (int osc = 0; osc < n_oscs; osc++)
+            int wtsize = vt_read_int32LE(ph->wtsize[sc][osc]);
+            if (wtsize)
             {
-                ph->wtsize[sc][osc] = vt_read_int32LE(ph->wtsize[sc][osc]);
-                if (ph->wtsize[sc][osc])
-                {
-                    wt_header *wth = (wt_header *)dr;
-                    if (wth > end)
-                        return;
+                if (wtsize < (int)sizeof(wt_header) || wtsize > end - dr)
+                    return;
 
-                    scene[sc].osc[osc].wt.queue_id = -1;
-                    scene[sc].osc[osc].wt.queue_filename[0] = 0;
-                    scene[sc].osc[osc].wt.current_id = -1;
+                wt_header wth;
+                memcpy(&wth, dr, sizeof(wt_header));
 
-                    void *d = (void *)((char *)dr + sizeof(wt_header));
+                size_t ss = (vt_read_int16LE(wth.flags) & wtf_int16) ? sizeof(short)
+                                                                      : sizeof(float);
+                size_t need = ss * vt_read_int16LE(wth.n_tables) * vt_read_int32LE(wth.n_samples);
+                if (need > (size_t)wtsize - sizeof(wt_header))
+                    return;
 
-                    storage->waveTableDataMutex.lock();
-                    scene[sc].osc[osc].wt.BuildWT(d, *wth, false);
-                    if (scene[sc].osc[osc].wavetable_display_name[0] == '\0')
-                    {
-                        if (scene[sc].osc[osc].wt.flags & wtf_is_sample)
-                        {
-                            strxcpy(scene[sc].osc[osc].wavetable_display_name, "(Patch Sample)",
-                                    WAVETABLE_DISPLAY_NAME_SIZE);
-                        }
-                        else
-                        {
-                            strxcpy(scene[sc].osc[osc].wavetable_display_name, "(Patch Wavetable)",
-                                    WAVETABLE_DISPLAY_NAME_SIZE);
-                        }
-                    }
-                    storage->waveTableDataMutex.unlock();
+                void *d = (void *)(dr + sizeof(wt_header));
 
-                    dr += ph->wtsize[sc][osc];
-                }
+                into.wavetables[sc][osc] = std::make_unique<Wavetable>();
+                into.wavetables[sc][osc]->BuildWT(d, wth, false);
+
+                dr += wtsize;
             }
         }
     }
+}
+
+bool SurgePatch::load_prepared(PreparedPatch &pp, bool preset)
+{
+    if (!pp.valid)
+        return true;
+
+    if (!pp.compiled.empty())
+    {
+        // This leaves the patch as it was, and the wavetables in pp, for the caller to go again
+        if (!load_compiled(pp.compiled.data(), pp.compiled.size(), preset))
+            return false;
+    }
     else
     {
-        load_xml(data, datasize, preset);
+        load_xml(pp.doc, preset);
+
+        // This only copies values out, so it costs little next to the load
+        if (pp.compileOnLoad && !save_compiled(pp.compiled))
+            pp.compiled.clear();
+    }
+
+    for (int sc = 0; sc < n_scenes; sc++)
+    {
+        for (int osc = 0; osc < n_oscs; osc++)
+        {
+            auto &wt = pp.wavetables[sc][osc];
+            if (!wt)
+                continue;
+
+            scene[sc].osc[osc].wt.queue_id = -1;
+            scene[sc].osc[osc].wt.queue_filename[0] = 0;
+            scene[sc].osc[osc].wt.current_id = -1;
+
+            // The old table data ends up in pp, to be freed along with it
+            storage->waveTableDataMutex.lock();
+            if (wt->everBuilt)
+                scene[sc].osc[osc].wt.SwapDataWith(wt.get());
+            scene[sc].osc[osc].wt.refresh_display = true;
+            if (scene[sc].osc[osc].wavetable_display_name[0] == '\0')
+            {
+                if (scene[sc].osc[osc].wt.flags & wtf_is_sample)
+                {
+                    strxcpy(scene[sc].osc[osc].wavetable_display_name, "(Patch Sample)",
+                            WAVETABLE_DISPLAY_NAME_SIZE);
+                }
+                else
+                {
+                    strxcpy(scene[sc].osc[osc].wavetable_display_name, "(Patch Wavetable)",
+                            WAVETABLE_DISPLAY_NAME_SIZE);
+                }
+            }
+            storage->waveTableDataMutex.unlock();
+        }
     }
+    return true;
 }
 
 unsigned int SurgePatch::save_patch(void **data)
@@ -1047,6 +1129,530 @@ unsigned int SurgePatch::save_patch(void **data)
     return psize;
 }
 
+namespace
+{
+/*
+ * The compiled patch layout. Everything is in native byte order and the header pins down the
+ * sizes which the rest depends on, so a blob from another build or platform is refused rather
+ * than misread. The parameter records come straight after the header so compiled_param_value
+ * can find one without walking the rest.
+ */
+const char compiledMagic[4] = {'s', 'r', 'g', 'c'};
+const int32_t compiledFormatVersion = 1;
+
+struct CompiledHeader
+{
+    char magic[4];
+    int32_t formatVersion, revision, nParams;
+    int32_t segmentSize, stepSeqSize, maxMSEGs, maxConfig;
+    int32_t nScenes, nLFOs, nOscs, nCustomControllers;
+};
+
+struct CompiledParam
+{
+    pdata val;
+    int32_t porta_curve, deform_type;
+    uint8_t flags, pad[3];
+};
+
+enum CompiledParamFlags
+{
+    cpf_temposync = 1 << 0,
+    cpf_porta_constrate = 1 << 1,
+    cpf_porta_gliss = 1 << 2,
+    cpf_porta_retrigger = 1 << 3,
+    cpf_deactivated = 1 << 4,
+    cpf_extend_range = 1 << 5,
+    cpf_absolute = 1 << 6,
+};
+
+CompiledHeader compiledHeaderForThisBuild(int nParams)
+{
+    CompiledHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, compiledMagic, 4);
+    h.formatVersion = compiledFormatVersion;
+    h.revision = ff_revision;
+    h.nParams = nParams;
+    h.segmentSize = sizeof(MSEGStorage::segment);
+    h.stepSeqSize = sizeof(StepSequencerStorage);
+    h.maxMSEGs = max_msegs;
+    h.maxConfig = (int32_t)OscillatorStorage::ExtraConfigurationData::max_config;
+    h.nScenes = n_scenes;
+    h.nLFOs = n_lfos;
+    h.nOscs = n_oscs;
+    h.nCustomControllers = n_customcontrollers;
+    return h;
+}
+
+struct CompiledWriter
+{
+    std::vector<char> &out;
+
+    template <typename T> void pod(const T &v)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "Compiled patches hold only PODs");
+        auto p = (const char *)&v;
+        out.insert(out.end(), p, p + sizeof(T));
+    }
+    void i32(int v) { pod((int32_t)v); }
+    void str(const std::string &s)
+    {
+        i32((int)s.size());
+        out.insert(out.end(), s.begin(), s.end());
+    }
+    void routings(const std::vector<ModulationRouting> &r)
+    {
+        i32((int)r.size());
+        for (const auto &t : r)
+        {
+            i32(t.source_id);
+            i32(t.destination_id);
+            pod(t.depth);
+            pod((uint8_t)t.muted);
+            i32(t.source_index);
+        }
+    }
+};
+
+// Every read is bounds checked; once one fails they all do, so callers check ok at the end
+struct CompiledReader
+{
+    const char *p, *end;
+    bool ok = true;
+
+    template <typename T> void pod(T &v)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "Compiled patches hold only PODs");
+        if (!ok || (size_t)(end - p) < sizeof(T))
+        {
+            ok = false;
+            return;
+        }
+        memcpy(&v, p, sizeof(T));
+        p += sizeof(T);
+    }
+    int i32()
+    {
+        int32_t v = 0;
+        pod(v);
+        return v;
+    }
+    float f32()
+    {
+        float v = 0.f;
+        pod(v);
+        return v;
+    }
+    bool b8()
+    {
+        uint8_t v = 0;
+        pod(v);
+        return v != 0;
+    }
+    std::string str()
+    {
+        auto n = i32();
+        if (!ok || n < 0 || n > end - p)
+        {
+            ok = false;
+            return "";
+        }
+        std::string s(p, n);
+        p += n;
+        return s;
+    }
+    void routings(std::vector<ModulationRouting> &r)
+    {
+        r.clear();
+        auto n = i32();
+        for (int i = 0; ok && i < n; ++i)
+        {
+            ModulationRouting t;
+            t.source_id = i32();
+            t.destination_id = i32();
+            t.depth = f32();
+            t.muted = b8();
+            t.source_index = i32();
+            if (ok)
+                r.push_back(t);
+        }
+    }
+};
+
+/*
+ * Walks a whole compiled patch without applying it, so load_compiled can refuse a damaged or
+ * foreign blob before it changes anything. This has to follow save_compiled field for field.
+ */
+bool compiledPatchIsComplete(const void *data, size_t size, int nParams)
+{
+    CompiledReader r{(const char *)data, (const char *)data + size};
+
+    CompiledHeader h;
+    r.pod(h);
+    auto expect = compiledHeaderForThisBuild(nParams);
+    if (!r.ok || memcmp(&h, &expect, sizeof(h)) != 0)
+        return false;
+
+    if ((size_t)(r.end - r.p) < nParams * sizeof(CompiledParam))
+        return false;
+    r.p += nParams * sizeof(CompiledParam);
+
+    for (int i = 0; i < 4; ++i) // name, category, comment, author
+        r.str();
+    r.i32(); // streaming revision
+
+    std::vector<ModulationRouting> routings;
+    for (int i = 0; i < 2 * n_scenes + 1; ++i)
+        r.routings(routings);
+
+    r.i32(); // tuning application mode
+    r.i32(); // hardclip mode
+    for (int sc = 0; sc < n_scenes; sc++)
+    {
+        r.i32();
+        r.i32();
+    }
+
+    for (int i = 0; i < n_scenes * n_oscs; ++i)
+    {
+        r.str();
+        r.str();
+        r.i32();
+        r.i32();
+        OscillatorStorage::ExtraConfigurationData ec;
+        r.pod(ec);
+    }
+
+    for (int i = 0; i < n_scenes * n_lfos; ++i)
+    {
+        StepSequencerStorage ss;
+        r.pod(ss);
+        for (int j = 0; j < 5; ++j) // endpoint, edit and loop modes, loop start and end
+            r.i32();
+        auto nSegments = r.i32();
+        if (nSegments < 0 || nSegments > max_msegs)
+            return false;
+        MSEGStorage::segment seg;
+        for (int j = 0; j < nSegments; ++j)
+            r.pod(seg);
+        for (int j = 0; j < 6; ++j) // snaps and axis
+            r.f32();
+        r.str();
+        r.i32();
+    }
+
+    for (int i = 0; i < n_customcontrollers; i++)
+    {
+        r.b8();
+        r.f32();
+        r.str();
+    }
+    for (int sc = 0; sc < n_scenes; sc++)
+        r.f32();
+
+    r.b8();
+    for (int i = 0; i < 3; ++i)
+        r.str();
+    r.b8();
+
+    return r.ok && r.p == r.end;
+}
+} // namespace
+
+bool SurgePatch::is_compiled(const void *data, size_t size)
+{
+    return data && size >= sizeof(CompiledHeader) && memcmp(data, compiledMagic, 4) == 0;
+}
+
+bool SurgePatch::can_load_compiled(const void *data, size_t size) const
+{
+    return is_compiled(data, size) && compiledPatchIsComplete(data, size, (int)param_ptr.size());
+}
+
+bool SurgePatch::compiled_param_value(const std::vector<char> &data, int id, pdata &value)
+{
+    if (!is_compiled(data.data(), data.size()) || id < 0)
+        return false;
+
+    CompiledHeader h;
+    memcpy(&h, data.data(), sizeof(h));
+    auto expect = compiledHeaderForThisBuild(h.nParams);
+    if (memcmp(&h, &expect, sizeof(h)) != 0 || id >= h.nParams)
+        return false;
+
+    size_t at = sizeof(CompiledHeader) + id * sizeof(CompiledParam);
+    if (at + sizeof(CompiledParam) > data.size())
+        return false;
+
+    CompiledParam cp;
+    memcpy(&cp, data.data() + at, sizeof(cp));
+    value = cp.val;
+    return true;
+}
+
+bool SurgePatch::save_compiled(std::vector<char> &into) const
+{
+    // The DAW extra state belongs to a session, not to a patch file, so it is never cached
+    if (dawExtraState.isPopulated)
+        return false;
+
+    into.clear();
+    CompiledWriter w{into};
+
+    w.pod(compiledHeaderForThisBuild((int)param_ptr.size()));
+
+    for (auto *p : param_ptr)
+    {
+        CompiledParam cp;
+        memset(&cp, 0, sizeof(cp));
+        cp.val = p->val;
+        cp.porta_curve = p->porta_curve;
+        cp.deform_type = p->deform_type;
+        cp.flags = (p->temposync ? cpf_temposync : 0) |
+                   (p->porta_constrate ? cpf_porta_constrate : 0) |
+                   (p->porta_gliss ? cpf_porta_gliss : 0) |
+                   (p->porta_retrigger ? cpf_porta_retrigger : 0) |
+                   (p->deactivated ? cpf_deactivated : 0) |
+                   (p->extend_range ? cpf_extend_range : 0) | (p->absolute ? cpf_absolute : 0);
+        w.pod(cp);
+    }
+
+    w.str(name);
+    w.str(category);
+    w.str(comment);
+    w.str(author);
+    w.i32(streamingRevision);
+
+    for (int sc = 0; sc < n_scenes; sc++)
+    {
+        w.routings(scene[sc].modulation_scene);
+        w.routings(scene[sc].modulation_voice);
+    }
+    w.routings(modulation_global);
+
+    w.i32(storage->tuningApplicationMode);
+    w.i32(storage->hardclipMode);
+    for (int sc = 0; sc < n_scenes; sc++)
+    {
+        w.i32(storage->sceneHardclipMode[sc]);
+        w.i32(scene[sc].monoVoicePriorityMode);
+    }
+
+    for (int sc = 0; sc < n_scenes; sc++)
+    {
+        for (int osc = 0; osc < n_oscs; osc++)
+        {
+            const auto &o = scene[sc].osc[osc];
+            w.str(o.wavetable_display_name);
+            w.str(o.wavetable_formula);
+            w.i32(o.wavetable_formula_nframes);
+            w.i32(o.wavetable_formula_res_base);
+            w.pod(o.extraConfig);
+        }
+    }
+
+    for (int sc = 0; sc < n_scenes; sc++)
+    {
+        for (int l = 0; l < n_lfos; l++)
+        {
+            w.pod(stepsequences[sc][l]);
+
+            const auto &ms = msegs[sc][l];
+            w.i32(ms.endpointMode);
+            w.i32(ms.editMode);
+            w.i32(ms.loopMode);
+            w.i32(ms.loop_start);
+            w.i32(ms.loop_end);
+            w.i32(ms.n_activeSegments);
+            for (int i = 0; i < ms.n_activeSegments; i++)
+                w.pod(ms.segments[i]);
+            w.pod(ms.vSnapDefault);
+            w.pod(ms.hSnapDefault);
+            w.pod(ms.vSnap);
+            w.pod(ms.hSnap);
+            w.pod(ms.axisWidth);
+            w.pod(ms.axisStart);
+
+            w.str(formulamods[sc][l].formulaString);
+            w.i32(formulamods[sc][l].interpreter);
+        }
+    }
+
+    for (int i = 0; i < n_customcontrollers; i++)
+    {
+        auto *cms = (ControllerModulationSource *)scene[0].modsources[ms_ctrl1 + i];
+        w.pod((uint8_t)cms->is_bipolar());
+        w.pod(cms->target);
+        w.str(CustomControllerLabel[i]);
+    }
+
+    for (int sc = 0; sc < n_scenes; sc++)
+        w.pod(((ControllerModulationSource *)scene[sc].modsources[ms_modwheel])->target);
+
+    w.pod((uint8_t)patchTuning.tuningStoredInPatch);
+    w.str(patchTuning.scaleContents);
+    w.str(patchTuning.mappingContents);
+    w.str(patchTuning.mappingName);
+
+    w.pod((uint8_t)correctlyTuneCombFilter);
+    return true;
+}
+
+bool SurgePatch::load_compiled(const void *data, size_t size, bool preset)
+{
+    // Nothing is touched until we know the whole blob was made by a build laid out like this one
+    if (!can_load_compiled(data, size))
+        return false;
+
+    CompiledReader r{(const char *)data, (const char *)data + size};
+    CompiledHeader h;
+    r.pod(h);
+
+    auto params = r.p;
+    r.p += param_ptr.size() * sizeof(CompiledParam);
+
+    auto pname = r.str();
+    auto pcategory = r.str();
+    comment = r.str();
+    author = r.str();
+    if (!preset)
+    {
+        name = pname;
+        category = pcategory;
+    }
+    streamingRevision = r.i32();
+    currentSynthStreamingRevision = ff_revision;
+
+    for (int i = 0; i < (int)param_ptr.size(); i++)
+    {
+        auto *p = param_ptr[i];
+
+        // As in load_xml, a preset leaves these as they were
+        if (preset && (p == &fx_bypass || (p == &volume && streamingRevision < 17)))
+            continue;
+
+        CompiledParam cp;
+        memcpy(&cp, params + i * sizeof(CompiledParam), sizeof(cp));
+        p->val = cp.val;
+        p->porta_curve = cp.porta_curve;
+        p->deform_type = cp.deform_type;
+        p->temposync = cp.flags & cpf_temposync;
+        p->porta_constrate = cp.flags & cpf_porta_constrate;
+        p->porta_gliss = cp.flags & cpf_porta_gliss;
+        p->porta_retrigger = cp.flags & cpf_porta_retrigger;
+        p->deactivated = cp.flags & cpf_deactivated;
+        p->set_extend_range(cp.flags & cpf_extend_range);
+        p->absolute = cp.flags & cpf_absolute;
+    }
+
+    for (auto &sc : scene)
+    {
+        for (int u = 0; u < n_filterunits_per_scene; u++)
+            sc.filterunit[u].type.set_user_data(&patchFilterSelectorMapper);
+        sc.wsunit.type.set_user_data(&patchWaveshaperSelectorMapper);
+    }
+
+    for (int sc = 0; sc < n_scenes; sc++)
+    {
+        r.routings(scene[sc].modulation_scene);
+        r.routings(scene[sc].modulation_voice);
+    }
+    r.routings(modulation_global);
+
+    storage->setTuningApplicationMode((SurgeStorage::TuningApplicationMode)r.i32());
+    storage->hardclipMode = (SurgeStorage::HardClipMode)r.i32();
+    for (int sc = 0; sc < n_scenes; sc++)
+    {
+        storage->sceneHardclipMode[sc] = (SurgeStorage::HardClipMode)r.i32();
+        scene[sc].monoVoicePriorityMode = (MonoVoicePriorityMode)r.i32();
+    }
+
+    for (int sc = 0; sc < n_scenes; sc++)
+    {
+        for (int osc = 0; osc < n_oscs; osc++)
+        {
+            auto &o = scene[sc].osc[osc];
+            strxcpy(o.wavetable_display_name, r.str().c_str(), WAVETABLE_DISPLAY_NAME_SIZE);
+            o.wavetable_formula = r.str();
+            o.wavetable_formula_nframes = r.i32();
+            o.wavetable_formula_res_base = r.i32();
+            r.pod(o.extraConfig);
+        }
+    }
+
+    bool userPrefRestoreMSEGFromPatch = Surge::Storage::getUserDefaultValue(
+        storage, Surge::Storage::RestoreMSEGSnapFromPatch, true);
+    for (int sc = 0; sc < n_scenes; sc++)
+    {
+        for (int l = 0; l < n_lfos; l++)
+        {
+            r.pod(stepsequences[sc][l]);
+
+            // The segments past the active ones are left as the init MSEG has them, as in load_xml
+            auto *ms = &(msegs[sc][l]);
+            if (ms_lfo1 + l >= ms_slfo1 && ms_lfo1 + l <= ms_slfo6)
+                Surge::MSEG::createInitSceneMSEG(ms);
+            else
+                Surge::MSEG::createInitVoiceMSEG(ms);
+
+            ms->endpointMode = (MSEGStorage::EndpointMode)r.i32();
+            ms->editMode = (MSEGStorage::EditMode)r.i32();
+            ms->loopMode = (MSEGStorage::LoopMode)r.i32();
+            ms->loop_start = r.i32();
+            ms->loop_end = r.i32();
+            ms->n_activeSegments = r.i32();
+            if (ms->n_activeSegments < 0 || ms->n_activeSegments > max_msegs)
+            {
+                r.ok = false;
+                ms->n_activeSegments = 0;
+            }
+            for (int i = 0; i < ms->n_activeSegments; i++)
+                r.pod(ms->segments[i]);
+            r.pod(ms->vSnapDefault);
+            r.pod(ms->hSnapDefault);
+            float vSnap = r.f32(), hSnap = r.f32();
+            if (userPrefRestoreMSEGFromPatch)
+            {
+                ms->vSnap = vSnap;
+                ms->hSnap = hSnap;
+            }
+            r.pod(ms->axisWidth);
+            r.pod(ms->axisStart);
+            Surge::MSEG::rebuildCache(ms);
+
+            formulamods[sc][l].setFormula(r.str());
+            formulamods[sc][l].interpreter = (FormulaModulatorStorage::Interpreter)r.i32();
+        }
+    }
+
+    for (int i = 0; i < n_customcontrollers; i++)
+    {
+        auto *cms = (ControllerModulationSource *)scene[0].modsources[ms_ctrl1 + i];
+        cms->reset();
+        cms->set_bipolar(r.b8());
+        cms->init(r.f32());
+        strxcpy(CustomControllerLabel[i], r.str().c_str(), CUSTOM_CONTROLLER_LABEL_SIZE);
+    }
+
+    for (int sc = 0; sc < n_scenes; sc++)
+    {
+        auto mw = r.f32();
+        if (!preset)
+            ((ControllerModulationSource *)scene[sc].modsources[ms_modwheel])->set_target(mw);
+    }
+
+    patchTuning.tuningStoredInPatch = r.b8();
+    patchTuning.scaleContents = r.str();
+    patchTuning.mappingContents = r.str();
+    patchTuning.mappingName = r.str();
+
+    correctlyTuneCombFilter = r.b8();
+    dawExtraState.isPopulated = false;
+
+    return r.ok;
+}
+
 float convert_v11_reso_to_v12_2P(float reso)
 {
     float Qinv =
@@ -1057,11 +1663,8 @@ float convert_v11_reso_to_v12_2P(float reso)
 
 float convert_v11_reso_to_v12_4P(float reso) { return reso * (0.99f / 1.05f); }
 
-void SurgePatch::load_xml(const void *data, int datasize, bool is_preset)
+void SurgePatch::parse_xml(const void *data, int datasize, TiXmlDocument &doc)
 {
-    TiXmlDocument doc;
-    int j;
-    double d;
     if (datasize)
     {
         assert(datasize < (1 << 22)); // something is weird if the patch is this big
@@ -1072,6 +1675,19 @@ void SurgePatch::load_xml(const void *data, int datasize, bool is_preset)
         doc.Parse(temp, nullptr, TIXML_ENCODING_LEGACY);
         free(temp);
     }
+}
+
+void SurgePatch::load_xml(const void *data, int datasize, bool is_preset)
+{
+    TiXmlDocument doc;
+    parse_xml(data, datasize, doc);
+    load_xml(doc, is_preset);
+}
+
+void SurgePatch::load_xml(TiXmlDocument &doc, bool is_preset)
+{
+    int j;
+    double d;
 
     // clear old routings
     for (int sc = 0; sc < n_scenes; sc++)
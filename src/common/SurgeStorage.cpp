@@ -15,6 +15,8 @@
 
 #include "DSPUtils.h"
 #include "SurgeStorage.h"
+#include "PatchCache.h"
+#include "WavetableLoader.h"
 #include <set>
 #include <numeric>
 #include <cctype>
@@ -23,6 +25,8 @@
 #include <vembertech/vt_dsp_endian.h>
 #include "UserDefaults.h"
 #include "SurgeSharedBinary.h"
+#include "SharedResources.h"
+#include "BlockProfiler.h"
 
 #if MAC
 #include <cstdlib>
@@ -97,8 +101,19 @@ std::string getDLLPath()
 }
 #endif
 
-SurgeStorage::SurgeStorage(std::string suppliedDataPath) : otherscene_clients(0)
+SurgeStorage::SurgeStorage(std::string suppliedDataPath)
+    : sharedResources(Surge::Storage::SharedResources::get()),
+      WindowWT(sharedResources->windowWT), otherscene_clients(0),
+      helpURL_controlgroup(sharedResources->helpURL_controlgroup),
+      helpURL_paramidentifier(sharedResources->helpURL_paramidentifier),
+      helpURL_specials(sharedResources->helpURL_specials),
+      helpURL_paramidentifier_typespecialized(
+          sharedResources->helpURL_paramidentifier_typespecialized)
 {
+#if SURGE_BLOCK_PROFILING
+    profiler = std::make_unique<Surge::Profiling::BlockProfiler>();
+#endif
+
     if (samplerate == 0)
     {
         setSamplerate(48000);
@@ -119,51 +134,7 @@ SurgeStorage::SurgeStorage(std::string suppliedDataPath) : otherscene_clients(0)
 
     _patch.reset(new SurgePatch(this));
 
-    float cutoff = 0.455f;
-    float cutoff1X = 0.85f;
-    float cutoffI16 = 1.0f;
-    int j;
-    for (j = 0; j < FIRipol_M + 1; j++)
-    {
-        for (int i = 0; i < FIRipol_N; i++)
-        {
-            double t = -double(i) + double(FIRipol_N / 2.0) + double(j) / double(FIRipol_M) - 1.0;
-            double val = (float)(symmetric_blackman(t, FIRipol_N) * cutoff * sincf(cutoff * t));
-            double val1X =
-                (float)(symmetric_blackman(t, FIRipol_N) * cutoff1X * sincf(cutoff1X * t));
-            sinctable[j * FIRipol_N * 2 + i] = (float)val;
-            sinctable1X[j * FIRipol_N + i] = (float)val1X;
-        }
-    }
-    for (j = 0; j < FIRipol_M; j++)
-    {
-        for (int i = 0; i < FIRipol_N; i++)
-        {
-            sinctable[j * FIRipol_N * 2 + FIRipol_N + i] =
-                (float)((sinctable[(j + 1) * FIRipol_N * 2 + i] -
-                         sinctable[j * FIRipol_N * 2 + i]) /
-                        65536.0);
-        }
-    }
-
-    for (j = 0; j < FIRipol_M + 1; j++)
-    {
-        for (int i = 0; i < FIRipolI16_N; i++)
-        {
-            double t =
-                -double(i) + double(FIRipolI16_N / 2.0) + double(j) / double(FIRipol_M) - 1.0;
-            double val =
-                (float)(symmetric_blackman(t, FIRipolI16_N) * cutoffI16 * sincf(cutoffI16 * t));
-
-            sinctableI16[j * FIRipolI16_N + i] = (short)((float)val * 16384.f);
-        }
-    }
-    /*for(j=0; j<FIRipolI16_N; j++){
-            for(int i=0; i<FIRipol_N; i++){
-                    sinctable[j*FIRipolI16_N*2 + FIRipolI16_N + i] = sinctable[(j+1)*FIRipolI16_N*2
-    + i] - sinctable[j*FIRipolI16_N*2 + i]));
-            }
-    }*/
+    // The sinc tables were computed by SharedResources::get(), once per process
 
     for (int s = 0; s < n_scenes; s++)
         for (int o = 0; o < n_oscs; o++)
@@ -493,24 +464,23 @@ bailOnPortable:
     loadWtAndPatch = !skipLoadWtAndPatch;
     if (loadWtAndPatch)
     {
-        refresh_wtlist();
-        refresh_patchlist();
+        load_catalogs();
     }
 #endif
 
     getPatch().scene[0].osc[0].wt.dt = 1.0f / 512.f;
     load_wt(0, &getPatch().scene[0].osc[0].wt, &getPatch().scene[0].osc[0]);
 
-    // WindowWT is a Wavetable which now has a constructor so don't do this
-    // memset(&WindowWT, 0, sizeof(WindowWT));
-    if (loadWtAndPatch && !load_wt_wt_mem(SurgeSharedBinary::windows_wt,
-                                          SurgeSharedBinary::windows_wtSize, &WindowWT))
+    // WindowWT is loaded by SharedResources, which can't report errors itself
+    if (loadWtAndPatch && !sharedResources->windowWTError.empty())
     {
-        WindowWT.size = 0;
-        std::ostringstream oss;
-        oss << "Unable to load 'windows.wt' from memory. "
-            << "This is a fatal internal software error which should never occur!";
-        reportError(oss.str(), "Surge Resources Loading Error");
+        reportError(sharedResources->windowWTError, "Surge Resources Loading Error");
+    }
+
+    // As are the parameter docs
+    if (loadWtAndPatch && !sharedResources->paramDocumentationError.empty())
+    {
+        reportError(sharedResources->paramDocumentationError, "Error");
     }
 
     // Tunings Library Support
@@ -526,81 +496,7 @@ bailOnPortable:
     for (int q = 0; q < 3; ++q)
         togglePriorState[q] = false;
 
-    // Load the XML DocStrings if we are loading startup data
-    if (loadWtAndPatch)
-    {
-        auto pdData = std::string(SurgeSharedBinary::paramdocumentation_xml,
-                                  SurgeSharedBinary::paramdocumentation_xmlSize) +
-                      "\n";
-
-        TiXmlDocument doc;
-        if (!doc.Parse(pdData.c_str()) || doc.Error())
-        {
-            std::cout << "Unable to load  'paramdocumentation'!" << std::endl;
-            std::cout << "Unable to parse!\nError is:\n"
-                      << doc.ErrorDesc() << " at row " << doc.ErrorRow() << ", column "
-                      << doc.ErrorCol() << std::endl;
-        }
-        else
-        {
-            TiXmlElement *pdoc = TINYXML_SAFE_TO_ELEMENT(doc.FirstChild("param-doc"));
-            if (!pdoc)
-            {
-                reportError(
-                    "Unknown top element in paramdocumentation.xml - not a parameter documentation "
-                    "XML file!",
-                    "Error");
-            }
-            else
-            {
-                for (auto pchild = pdoc->FirstChildElement(); pchild;
-                     pchild = pchild->NextSiblingElement())
-                {
-                    if (strcmp(pchild->Value(), "ctrl_group") == 0)
-                    {
-                        int g = 0;
-                        if (pchild->QueryIntAttribute("group", &g) == TIXML_SUCCESS)
-                        {
-                            std::string help_url = pchild->Attribute("help_url");
-                            if (help_url.size() > 0)
-                                helpURL_controlgroup[g] = help_url;
-                        }
-                    }
-                    else if (strcmp(pchild->Value(), "param") == 0)
-                    {
-                        std::string id = pchild->Attribute("id");
-                        std::string help_url = pchild->Attribute("help_url");
-                        int t = 0;
-                        if (help_url.size() > 0)
-                        {
-                            if (pchild->QueryIntAttribute("type", &t) == TIXML_SUCCESS)
-                            {
-                                helpURL_paramidentifier_typespecialized[std::make_pair(id, t)] =
-                                    help_url;
-                            }
-                            else
-                            {
-                                helpURL_paramidentifier[id] = help_url;
-                            }
-                        }
-                    }
-                    else if (strcmp(pchild->Value(), "special") == 0)
-                    {
-                        std::string id = pchild->Attribute("id");
-                        std::string help_url = pchild->Attribute("help_url");
-                        if (help_url.size() > 0)
-                        {
-                            helpURL_specials[id] = help_url;
-                        }
-                    }
-                    else
-                    {
-                        std::cout << "UNKNOWN " << pchild->Value() << std::endl;
-                    }
-                }
-            }
-        }
-    }
+    // The XML DocStrings are parsed by SharedResources
 
     for (int s = 0; s < n_scenes; ++s)
     {
@@ -642,6 +538,12 @@ bailOnPortable:
         Surge::Storage::getUserDefaultValue(this, Surge::Storage::InitialPatchName, "Init Saw");
     initPatchCategory = Surge::Storage::getUserDefaultValue(
         this, Surge::Storage::InitialPatchCategory, "Templates");
+
+    if (Surge::Storage::getUserDefaultValue(this, Surge::Storage::UseCompiledPatchCache, 0))
+    {
+        patchCache = std::make_unique<Surge::Storage::PatchCache>(string_to_path(userDataPath) /
+                                                                  "PatchCache");
+    }
 }
 
 void SurgeStorage::createUserDirectory()
@@ -734,7 +636,93 @@ struct PEComparer
     bool operator()(const Patch &a, const Patch &b) { return a.name.compare(b.name) < 0; }
 };
 
+namespace
+{
+// Our half of a SharedCatalog::Lists, to copy either way
+struct CatalogLists
+{
+    std::vector<Patch> &items;
+    std::vector<PatchCategory> &categories;
+    int &firstThirdPartyCategory, &firstUserCategory;
+    std::vector<int> &ordering, &categoryOrdering;
+
+    void copyFrom(const Surge::Storage::SharedCatalog::Lists &l)
+    {
+        items = l.items;
+        categories = l.categories;
+        firstThirdPartyCategory = l.firstThirdPartyCategory;
+        firstUserCategory = l.firstUserCategory;
+        ordering = l.ordering;
+        categoryOrdering = l.categoryOrdering;
+    }
+
+    void copyTo(Surge::Storage::SharedCatalog::Lists &l) const
+    {
+        l.items = items;
+        l.categories = categories;
+        l.firstThirdPartyCategory = firstThirdPartyCategory;
+        l.firstUserCategory = firstUserCategory;
+        l.ordering = ordering;
+        l.categoryOrdering = categoryOrdering;
+        l.valid = true;
+    }
+};
+
+CatalogLists wavetableLists(SurgeStorage &s)
+{
+    return {s.wt_list, s.wt_category, s.firstThirdPartyWTCategory,
+            s.firstUserWTCategory, s.wtOrdering, s.wtCategoryOrdering};
+}
+
+CatalogLists patchLists(SurgeStorage &s)
+{
+    return {s.patch_list, s.patch_category, s.firstThirdPartyCategory,
+            s.firstUserCategory, s.patchOrdering, s.patchCategoryOrdering};
+}
+} // namespace
+
+void SurgeStorage::load_catalogs()
+{
+    auto wts = wavetableLists(*this);
+    auto patches = patchLists(*this);
+
+    sharedCatalog = Surge::Storage::SharedCatalog::get(datapath, userDataPath);
+
+    // Held while we walk, so instances starting together walk the folders once between them
+    std::lock_guard<std::mutex> g(sharedCatalog->mutex);
+    if (sharedCatalog->wavetables.valid)
+    {
+        wts.copyFrom(sharedCatalog->wavetables);
+    }
+    else
+    {
+        scan_wtlist();
+        wts.copyTo(sharedCatalog->wavetables);
+    }
+
+    if (sharedCatalog->patches.valid)
+    {
+        patches.copyFrom(sharedCatalog->patches);
+    }
+    else
+    {
+        scan_patchlist();
+        patches.copyTo(sharedCatalog->patches);
+    }
+}
+
 void SurgeStorage::refresh_patchlist()
+{
+    scan_patchlist();
+
+    if (sharedCatalog)
+    {
+        std::lock_guard<std::mutex> g(sharedCatalog->mutex);
+        patchLists(*this).copyTo(sharedCatalog->patches);
+    }
+}
+
+void SurgeStorage::scan_patchlist()
 {
     patch_category.clear();
     patch_list.clear();
@@ -957,6 +945,17 @@ void SurgeStorage::refreshPatchOrWTListAddDir(bool userDir, string subdir,
 }
 
 void SurgeStorage::refresh_wtlist()
+{
+    scan_wtlist();
+
+    if (sharedCatalog)
+    {
+        std::lock_guard<std::mutex> g(sharedCatalog->mutex);
+        wavetableLists(*this).copyTo(sharedCatalog->wavetables);
+    }
+}
+
+void SurgeStorage::scan_wtlist()
 {
     wt_category.clear();
     wt_list.clear();
@@ -1052,15 +1051,43 @@ void SurgeStorage::refresh_wtlistAddDir(bool userDir, std::string subdir)
         wt_list, wt_category);
 }
 
-void SurgeStorage::perform_queued_wtloads()
+void SurgeStorage::perform_queued_wtloads(bool loadInBackground)
 {
     SurgePatch &patch =
         getPatch(); // Change here is for performance and ease of debugging, simply not calling
                     // getPatch so many times. Code should behave identically.
+
+    if (wavetableLoader)
+        wavetableLoader->swapCompletedLoads();
+    else
+        loadInBackground = false;
+
     for (int sc = 0; sc < n_scenes; sc++)
     {
         for (int o = 0; o < n_oscs; o++)
         {
+            if (loadInBackground)
+            {
+                // If this oscillator already has a load in flight the request stays queued
+                auto &wt = patch.scene[sc].osc[o].wt;
+                if (wt.queue_id != -1)
+                {
+                    if (wavetableLoader->requestLoad(sc, o, wt.queue_id, nullptr))
+                        wt.queue_id = -1;
+                }
+                else if (wt.queue_filename[0])
+                {
+                    if (!(patch.scene[sc].osc[o].type.val.i == ot_wavetable ||
+                          patch.scene[sc].osc[o].type.val.i == ot_window))
+                    {
+                        patch.scene[sc].osc[o].queue_type = ot_wavetable;
+                    }
+                    if (wavetableLoader->requestLoad(sc, o, -1, wt.queue_filename))
+                        wt.queue_filename[0] = 0;
+                }
+                continue;
+            }
+
             if (patch.scene[sc].osc[o].wt.queue_id != -1)
             {
                 load_wt(patch.scene[sc].osc[o].wt.queue_id, &patch.scene[sc].osc[o].wt,
@@ -1204,11 +1231,10 @@ bool SurgeStorage::load_wt_wt(string filename, Wavetable *wt)
     return wasBuilt;
 }
 
-bool SurgeStorage::load_wt_wt_mem(const char *data, size_t dataSize, Wavetable *wt)
+const char *SurgeStorage::read_wt_header_mem(const char *data, size_t dataSize, wt_header &wh)
 {
-    wt_header wh;
     if (dataSize < sizeof(wt_header))
-        return false;
+        return nullptr;
 
     memcpy(&wh, data, sizeof(wt_header));
 
@@ -1217,7 +1243,7 @@ bool SurgeStorage::load_wt_wt_mem(const char *data, size_t dataSize, Wavetable *
     if (!(wh.tag[0] == 'v' && wh.tag[1] == 'a' && wh.tag[2] == 'w' && wh.tag[3] == 't'))
     {
         // SOME sort of error reporting is appropriate
-        return false;
+        return nullptr;
     }
 
     size_t ds;
@@ -1230,10 +1256,19 @@ bool SurgeStorage::load_wt_wt_mem(const char *data, size_t dataSize, Wavetable *
     {
         std::cout << "Data size " << dataSize << " < " << ds << " + " << sizeof(wt_header)
                   << std::endl;
-        return false;
+        return nullptr;
     }
 
-    const char *wtData = data + sizeof(wt_header);
+    return data + sizeof(wt_header);
+}
+
+bool SurgeStorage::load_wt_wt_mem(const char *data, size_t dataSize, Wavetable *wt)
+{
+    wt_header wh;
+    const char *wtData = read_wt_header_mem(data, dataSize, wh);
+    if (!wtData)
+        return false;
+
     waveTableDataMutex.lock();
     bool wasBuilt = wt->BuildWT((void *)wtData, wh, false);
     waveTableDataMutex.unlock();
@@ -1563,6 +1598,7 @@ void SurgeStorage::clipboard_paste(int type, int scene, int entry)
         }
     }
 
+    getPatch().rebuildModulationTables();
     modRoutingMutex.unlock();
 }
 
@@ -1702,7 +1738,12 @@ void SurgeStorage::load_midi_controllers()
     }
 }
 
-SurgeStorage::~SurgeStorage() { deinitialize_oddsound(); }
+SurgeStorage::~SurgeStorage()
+{
+    // SurgeSynthesizer normally gets here first, having stopped the service thread
+    wavetableLoader.reset();
+    deinitialize_oddsound();
+}
 
 double shafted_tanh(double x) { return (exp(x) - exp(-x * 1.2)) / (exp(x) + exp(-x)); }
 
@@ -1975,6 +2016,10 @@ void SurgeStorage::setTuningApplicationMode(const TuningApplicationMode m)
 
 bool SurgeStorage::skipLoadWtAndPatch = false;
 
+#if STORAGE_USES_INDEPENDENT_RNG
+thread_local SurgeStorage::RNGGen *SurgeStorage::threadRNGGen = nullptr;
+#endif
+
 void SurgeStorage::rescanUserMidiMappings()
 {
     userMidiMappingsXMLByName.clear();
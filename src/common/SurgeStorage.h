@@ -17,6 +17,7 @@
 #include "globals.h"
 #include "Parameter.h"
 #include "ModulationSource.h"
+#include "ModulationTable.h"
 #include "Wavetable.h"
 
 #include "tinyxml/tinyxml.h"
@@ -568,6 +569,8 @@ struct SurgeSceneStorage
     Parameter lowcut;
 
     std::vector<ModulationRouting> modulation_scene, modulation_voice;
+    // What the audio thread actually walks; see ModulationTable for how these are kept in step
+    ModulationTable modulation_scene_table, modulation_voice_table;
     std::vector<ModulationSource *> modsources;
 
     bool modsource_doprocess[n_modsources];
@@ -764,6 +767,27 @@ struct PatchTuningStorage
 
 class SurgeStorage;
 
+/*
+ * A patch chunk which has been read and parsed, with its embedded wavetables built, but which
+ * hasn't been applied to a SurgePatch yet. Doing the first half on its own lets the patch loader
+ * get a patch ready while the previous one is still playing.
+ */
+struct PreparedPatch
+{
+    bool valid = false; // false for a chunk too short to hold anything, which loads as a no-op
+    TiXmlDocument doc;
+    std::unique_ptr<Wavetable> wavetables[n_scenes][n_oscs];
+
+    /*
+     * If compiled holds a compiled patch (see SurgePatch::save_compiled) it is loaded instead of
+     * doc. A patch read from a file remembers the file, so that with the patch cache on, a patch
+     * which had to be loaded from its XML can be compiled once loaded and cached for next time.
+     */
+    std::vector<char> compiled;
+    fs::path sourcePath;
+    bool compileOnLoad = false;
+};
+
 class SurgePatch
 {
   public:
@@ -779,6 +803,8 @@ class SurgePatch
     // void load_xml();
     // void save_xml();
     void load_xml(const void *data, int size, bool preset);
+    void load_xml(TiXmlDocument &doc, bool preset);
+    static void parse_xml(const void *data, int size, TiXmlDocument &doc);
     unsigned int save_xml(void **data);
     unsigned int save_RIFF(void **data);
 
@@ -791,8 +817,34 @@ class SurgePatch
     void formulaFromXMLElement(FormulaModulatorStorage *ms, TiXmlElement *parent) const;
 
     void load_patch(const void *data, int size, bool preset);
+    /*
+     * load_patch is prepare_patch followed by load_prepared; the first half touches no patch
+     * state. Without parseXML the wavetables are built but the XML is skipped, for when the
+     * caller already has the compiled patch. load_prepared only fails when pp holds a compiled
+     * patch which load_compiled refuses, in which case the patch is left as it was.
+     */
+    static void prepare_patch(const void *data, int size, PreparedPatch &into,
+                              bool parseXML = true);
+    bool load_prepared(PreparedPatch &pp, bool preset);
     unsigned int save_patch(void **data);
 
+    /*
+     * A compiled patch is the state load_xml leaves behind, written out as flat binary: the
+     * parameter values and flags, modulation routings, step sequences, MSEGs, formulae and the
+     * other patch level settings, but not the wavetables (which stay in the .fxp) or the DAW
+     * extra state. Loading one is a matter of copying values, so the patch cache keeps them to
+     * skip the XML walk. They are in native byte order and tied to this streaming revision and
+     * layout, so they are a cache and not an interchange format. load_patch takes a compiled
+     * patch as well as the usual formats. save_compiled fails if the DAW extra state is populated.
+     */
+    bool save_compiled(std::vector<char> &into) const;
+    bool load_compiled(const void *data, size_t size, bool preset);
+    static bool is_compiled(const void *data, size_t size);
+    // Is this a whole compiled patch from a build laid out like this one? load_compiled checks
+    bool can_load_compiled(const void *data, size_t size) const;
+    // Reads one parameter's value out of a compiled patch without loading it
+    static bool compiled_param_value(const std::vector<char> &data, int id, pdata &value);
+
     // data
     SurgeSceneStorage scene[n_scenes], morphscene;
     FxStorage fx[n_fx_slots];
@@ -816,6 +868,8 @@ class SurgePatch
     std::vector<int> easy_params_id;
 
     std::vector<ModulationRouting> modulation_global;
+    ModulationTable modulation_global_table{false};
+    void rebuildModulationTables();
     pdata scenedata[n_scenes][n_scene_params];
     pdata globaldata[n_global_params];
     void *patchptr;
@@ -878,6 +932,21 @@ enum surge_copysource
 
 class MTSClient;
 
+namespace Surge
+{
+namespace Storage
+{
+class WavetableLoader;
+class PatchCache;
+struct SharedResources;
+struct SharedCatalog;
+} // namespace Storage
+namespace Profiling
+{
+class BlockProfiler;
+}
+} // namespace Surge
+
 /* storage layer */
 
 class alignas(16) SurgeStorage
@@ -981,12 +1050,24 @@ class alignas(16) SurgeStorage
                                     std::vector<Patch> &items,
                                     std::vector<PatchCategory> &categories);
 
-    void perform_queued_wtloads();
+    /*
+     * With loadInBackground the file loads are handed to wavetableLoader (if the synth
+     * created one) and land some blocks later, rather than being done right here.
+     */
+    void perform_queued_wtloads(bool loadInBackground = false);
+    std::unique_ptr<Surge::Storage::WavetableLoader> wavetableLoader;
+
+    // Only made when the build has SURGE_BLOCK_PROFILING; see BlockProfiler.h
+    std::unique_ptr<Surge::Profiling::BlockProfiler> profiler;
+    // Set up at construction if the user has asked for it; see PatchCache.h
+    std::unique_ptr<Surge::Storage::PatchCache> patchCache;
 
     void load_wt(int id, Wavetable *wt, OscillatorStorage *);
     void load_wt(std::string filename, Wavetable *wt, OscillatorStorage *);
     bool load_wt_wt(std::string filename, Wavetable *wt);
     bool load_wt_wt_mem(const char *data, const size_t dataSize, Wavetable *wt);
+    // Checks the header of in-memory .wt data, returning its sample data or nullptr
+    static const char *read_wt_header_mem(const char *data, size_t dataSize, wt_header &wh);
     // void load_wt_wav(std::string filename, Wavetable* wt);
     bool load_wt_wav_portable(std::string filename, Wavetable *wt);
     std::string export_wt_wav_portable(std::string fbase, Wavetable *wt);
@@ -1033,7 +1114,11 @@ class alignas(16) SurgeStorage
     // float table_sin[512],table_sin_offset[512];
     std::mutex waveTableDataMutex;
     std::recursive_mutex modRoutingMutex;
-    Wavetable WindowWT;
+
+    // Built once per process and shared by every storage; see SharedResources.h
+    std::shared_ptr<const Surge::Storage::SharedResources> sharedResources;
+    std::shared_ptr<Surge::Storage::SharedCatalog> sharedCatalog;
+    const Wavetable &WindowWT;
 
     // hardclip
     enum HardClipMode
@@ -1233,16 +1318,26 @@ class alignas(16) SurgeStorage
 
     std::atomic<int> otherscene_clients;
 
-    std::unordered_map<int, std::string> helpURL_controlgroup;
-    std::unordered_map<std::string, std::string> helpURL_paramidentifier;
-    std::unordered_map<std::string, std::string> helpURL_specials;
+    // These are sharedResources' maps
+    const std::unordered_map<int, std::string> &helpURL_controlgroup;
+    const std::unordered_map<std::string, std::string> &helpURL_paramidentifier;
+    const std::unordered_map<std::string, std::string> &helpURL_specials;
     // Alternately make this unordered and provide a hash
-    std::map<std::pair<std::string, int>, std::string> helpURL_paramidentifier_typespecialized;
+    const std::map<std::pair<std::string, int>, std::string>
+        &helpURL_paramidentifier_typespecialized;
 
     int subtypeMemory[n_scenes][n_filterunits_per_scene][n_fu_types];
     MonoPedalMode monoPedalMode = HOLD_ALL_NOTES;
 
   private:
+    /*
+     * The refresh functions walk the folders and then update sharedCatalog. At construction we
+     * take the lists from sharedCatalog instead, and only walk the folders if nobody has yet.
+     */
+    void scan_wtlist();
+    void scan_patchlist();
+    void load_catalogs();
+
     TiXmlDocument snapshotloader;
     std::vector<Parameter> clipboard_p;
     int clipboard_type;
@@ -1285,6 +1380,30 @@ class alignas(16) SurgeStorage
         std::uniform_int_distribution<uint32_t> u32;
     } rngGen;
 
+    // Set by SurgeSynthesizer::seedRandomGenerators, for modulators which want to follow it
+    bool rngSeeded = false;
+
+    /*
+     * If a scene is rendering on this thread it installs its own generator here, so
+     * scene A and scene B draw from independent streams and can render in parallel.
+     * See SurgeSynthesizer::processSceneBlock.
+     */
+    static thread_local RNGGen *threadRNGGen;
+    inline RNGGen &activeRNGGen() { return threadRNGGen ? *threadRNGGen : rngGen; }
+
+    /*
+     * For the DSP helpers which have no storage to hand, like oscillator drift: draws from the
+     * generator installed on this thread if there is one, and from std::rand otherwise. So
+     * they follow the scene's stream while a scene renders, and a renderer wanting repeatable
+     * output can install a seeded generator of its own around the rest of its work.
+     */
+    static int threadRand()
+    {
+        if (threadRNGGen)
+            return threadRNGGen->d(threadRNGGen->g);
+        return std::rand();
+    }
+
 #define DEBUG_RNG_THREADING 0
 #if DEBUG_RNG_THREADING
     pthread_t audioThreadID = 0;
@@ -1307,26 +1426,31 @@ class alignas(16) SurgeStorage
     inline int rand()
     {
         runningOnAudioThread();
-        return rngGen.d(rngGen.g);
+        auto &r = activeRNGGen();
+        return r.d(r.g);
     }
     inline uint32_t rand_u32()
     {
         runningOnAudioThread();
-        return rngGen.u32(rngGen.g);
+        auto &r = activeRNGGen();
+        return r.u32(r.g);
     }
     inline float rand_pm1()
     {
         runningOnAudioThread();
-        return rngGen.pm1(rngGen.g);
+        auto &r = activeRNGGen();
+        return r.pm1(r.g);
     }
     inline float rand_01()
     {
         runningOnAudioThread();
-        return rngGen.z1(rngGen.g);
+        auto &r = activeRNGGen();
+        return r.z1(r.g);
     }
     // void seed_rand(int s) { rngGen.g.seed(s); }
 #else
     inline int rand() { return std::rand(); }
+    static int threadRand() { return std::rand(); }
     inline uint32_t rand_u32() { return (uint32_t)(rand_01() * (float)(0xFFFFFFFF)); }
     inline float rand_pm1() { return rand_01() * 2 - 1; }
     inline float rand_01() { return (float)std::rand() / (float)(RAND_MAX); }
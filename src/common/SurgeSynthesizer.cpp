@@ -27,8 +27,10 @@
 #include "SurgeParamConfig.h"
 
 #include "UserDefaults.h"
+#include "WavetableLoader.h"
 #include "filesystem/import.h"
 #include "Effect.h"
+#include "BlockProfiler.h"
 
 #include <thread>
 #include <set>
@@ -79,9 +81,21 @@ SurgeSynthesizer::SurgeSynthesizer(PluginLayer *parent, const std::string &suppl
         voices_usedby[0][i] = 0;
         voices_usedby[1][i] = 0;
     }
+    for (int sc = 0; sc < n_scenes; sc++)
+    {
+        // Stacked so that, to begin with, slots are handed out from the front of the array
+        for (int i = 0; i < MAX_VOICES; i++)
+            freeVoiceSlots[sc][i] = MAX_VOICES - 1 - i;
+        n_freeVoiceSlots[sc] = MAX_VOICES;
+    }
 
     for (int sc = 0; sc < n_scenes; sc++)
     {
+        // The generators are clock seeded so make sure the scenes don't end up in lockstep
+        sceneRNGGen[sc].g.seed(storage.rand_u32());
+        for (auto &r : voiceQuadRNGGen[sc])
+            r.g.seed(storage.rand_u32());
+
         FBQ[sc] = new QuadFilterChainState[MAX_VOICES >> 2]();
 
         for (int i = 0; i < (MAX_VOICES >> 2); ++i)
@@ -103,6 +117,18 @@ SurgeSynthesizer::SurgeSynthesizer(PluginLayer *parent, const std::string &suppl
 
     patch.polylimit.val.i = DEFAULT_POLYLIMIT;
 
+    serviceThread = std::make_unique<Surge::Storage::ServiceThread>();
+    storage.wavetableLoader =
+        std::make_unique<Surge::Storage::WavetableLoader>(&storage, serviceThread.get());
+    fxPreparer = std::make_unique<Surge::Storage::EffectPreparer>(&storage, serviceThread.get());
+    patchLoader = std::make_unique<Surge::Storage::PatchLoader>(this, serviceThread.get());
+    serviceThread->start();
+
+    setMultithreadedSceneRendering(Surge::Storage::getUserDefaultValue(
+        &storage, Surge::Storage::MultithreadedSceneRendering, 0));
+    setMultithreadedVoiceRendering(Surge::Storage::getUserDefaultValue(
+        &storage, Surge::Storage::MultithreadedVoiceRendering, 0));
+
     for (int sc = 0; sc < n_scenes; sc++)
     {
         SurgeSceneStorage &scene = patch.scene[sc];
@@ -249,6 +275,12 @@ SurgeSynthesizer::~SurgeSynthesizer()
 {
     allNotesOff();
 
+    // Stop the service thread while the storage its work points into is still around
+    serviceThread->stop();
+    patchLoader.reset();
+    fxPreparer.reset();
+    storage.wavetableLoader.reset();
+
     for (int sc = 0; sc < n_scenes; sc++)
     {
         delete[] FBQ[sc];
@@ -409,7 +441,7 @@ void SurgeSynthesizer::playNote(char channel, char key, char velocity, char detu
 
 void SurgeSynthesizer::softkillVoice(int s)
 {
-    list<SurgeVoice *>::iterator iter, max_playing, max_released;
+    VoiceList::iterator iter, max_playing, max_released;
     int max_age = 0, max_age_release = 0;
     iter = voices[s].begin();
 
@@ -444,7 +476,7 @@ void SurgeSynthesizer::softkillVoice(int s)
 // only allow 'margin' number of voices to be softkilled simultaneously
 void SurgeSynthesizer::enforcePolyphonyLimit(int s, int margin)
 {
-    list<SurgeVoice *>::iterator iter;
+    VoiceList::iterator iter;
 
     if (voices[s].size() > (storage.getPatch().polylimit.val.i + margin))
     {
@@ -506,29 +538,23 @@ int SurgeSynthesizer::getNonReleasedVoices(int s) const
 
 SurgeVoice *SurgeSynthesizer::getUnusedVoice(int scene)
 {
-    for (int i = 0; i < MAX_VOICES; i++)
-    {
-        if (!voices_usedby[scene][i])
-        {
-            voices_usedby[scene][i] = scene + 1;
-            return &voices_array[scene][i];
-        }
-    }
-    return 0;
+    if (n_freeVoiceSlots[scene] == 0)
+        return 0;
+
+    int i = freeVoiceSlots[scene][--n_freeVoiceSlots[scene]];
+    voices_usedby[scene][i] = scene + 1;
+    return &voices_array[scene][i];
 }
 
 void SurgeSynthesizer::freeVoice(SurgeVoice *v)
 {
-    for (int i = 0; i < MAX_VOICES; i++)
+    // Only touch the owning scene's slots, since scenes may be freeing voices concurrently
+    int s = v->state.scene_id;
+    int i = (int)(v - &voices_array[s][0]);
+    if (i >= 0 && i < MAX_VOICES && voices_usedby[s][i])
     {
-        if (voices_usedby[0][i] && (v == &voices_array[0][i]))
-        {
-            voices_usedby[0][i] = 0;
-        }
-        if (voices_usedby[1][i] && (v == &voices_array[1][i]))
-        {
-            voices_usedby[1][i] = 0;
-        }
+        voices_usedby[s][i] = 0;
+        freeVoiceSlots[s][n_freeVoiceSlots[s]++] = i;
     }
     v->freeAllocatedElements();
 }
@@ -611,7 +637,7 @@ void SurgeSynthesizer::playVoice(int scene, char channel, char key, char velocit
     case pm_mono_fp:
     case pm_latch:
     {
-        list<SurgeVoice *>::const_iterator iter;
+        VoiceList::const_iterator iter;
         bool glide = false;
 
         int primode = storage.getPatch().scene[scene].monoVoicePriorityMode;
@@ -735,7 +761,7 @@ void SurgeSynthesizer::playVoice(int scene, char channel, char key, char velocit
 
         if (createVoice)
         {
-            list<SurgeVoice *>::const_iterator iter;
+            VoiceList::const_iterator iter;
             for (iter = voices[scene].begin(); iter != voices[scene].end(); iter++)
             {
                 SurgeVoice *v = *iter;
@@ -807,7 +833,7 @@ void SurgeSynthesizer::playVoice(int scene, char channel, char key, char velocit
 
 void SurgeSynthesizer::releaseScene(int s)
 {
-    list<SurgeVoice *>::const_iterator iter;
+    VoiceList::const_iterator iter;
     for (iter = voices[s].begin(); iter != voices[s].end(); iter++)
     {
         freeVoice(*iter);
@@ -915,7 +941,7 @@ void SurgeSynthesizer::releaseNote(char channel, char key, char velocity)
 void SurgeSynthesizer::releaseNotePostHoldCheck(int scene, char channel, char key, char velocity)
 {
     channelState[channel].keyState[key].keystate = 0;
-    list<SurgeVoice *>::const_iterator iter;
+    VoiceList::const_iterator iter;
     for (int s = 0; s < n_scenes; s++)
     {
         bool do_switch = false;
@@ -1782,7 +1808,7 @@ void SurgeSynthesizer::allNotesOff()
 
     for (int s = 0; s < n_scenes; s++)
     {
-        list<SurgeVoice *>::const_iterator iter;
+        VoiceList::const_iterator iter;
         for (iter = voices[s].begin(); iter != voices[s].end(); iter++)
         {
             freeVoice(*iter);
@@ -2134,7 +2160,7 @@ void SurgeSynthesizer::switch_toggled()
 {
     for (int s = 0; s < n_scenes; s++)
     {
-        list<SurgeVoice *>::iterator iter;
+        VoiceList::iterator iter;
         for (iter = voices[s].begin(); iter != voices[s].end(); iter++)
         {
             SurgeVoice *v = *iter;
@@ -2143,7 +2169,8 @@ void SurgeSynthesizer::switch_toggled()
     }
 }
 
-bool SurgeSynthesizer::loadFx(bool initp, bool force_reload_all)
+bool SurgeSynthesizer::loadFx(bool initp, bool force_reload_all,
+                              Surge::Storage::PreparedEffects *prebuilt)
 {
     load_fx_needed = false;
     for (int s = 0; s < n_fx_slots; s++)
@@ -2151,13 +2178,37 @@ bool SurgeSynthesizer::loadFx(bool initp, bool force_reload_all)
         bool something_changed = false;
         if ((fxsync[s].type.val.i != storage.getPatch().fx[s].type.val.i) || force_reload_all)
         {
+            /*
+             * With audio running we don't build the effect here; we ask the preparer for one
+             * and leave this slot alone until it is ready. It comes back set up and init()ed,
+             * with the parameters it settled on. A patch load needs every slot at once, so
+             * that still builds in line.
+             */
+            Effect *prepared = nullptr;
+            const FxStorage *settled = nullptr;
+            if (fxPreparer && audio_processing_active && !force_reload_all &&
+                fxsync[s].type.val.i != fxt_off)
+            {
+                prepared = fxPreparer->takePrepared(s, fxsync[s], initp, &storage.getPatch().fx[s],
+                                                    storage.getPatch().globaldata, settled);
+                if (!prepared)
+                {
+                    load_fx_needed = true;
+                    continue;
+                }
+            }
+            else if (prebuilt && prebuilt->fx[s] && prebuilt->type[s] == fxsync[s].type.val.i)
+            {
+                prepared = prebuilt->fx[s].release();
+            }
+
             fx_reload[s] = false;
 
-            fx[s].reset();
+            retireFx(s);
             /*if (!force_reload_all)*/ storage.getPatch().fx[s].type.val.i = fxsync[s].type.val.i;
             // else fxsync[s].type.val.i = storage.getPatch().fx[s].type.val.i;
 
-            for (int j = 0; j < n_fx_params; j++)
+            for (int j = 0; j < n_fx_params && !settled; j++)
             {
                 storage.getPatch().fx[s].p[j].set_type(ct_none);
                 std::string n = "Param ";
@@ -2167,7 +2218,20 @@ bool SurgeSynthesizer::loadFx(bool initp, bool force_reload_all)
                 storage.getPatch().globaldata[storage.getPatch().fx[s].p[j].id].i = 0;
             }
 
-            if (/*!force_reload_all && */ storage.getPatch().fx[s].type.val.i)
+            if (settled)
+            {
+                // Already set up on the service thread; fxsync follows it, as it would here
+                memcpy((void *)&storage.getPatch().fx[s].p, (const void *)&settled->p,
+                       sizeof(Parameter) * n_fx_params);
+                memcpy((void *)&fxsync[s].p, (const void *)&settled->p,
+                       sizeof(Parameter) * n_fx_params);
+                for (int j = 0; j < n_fx_params; j++)
+                {
+                    auto &p = storage.getPatch().fx[s].p[j];
+                    storage.getPatch().globaldata[p.id].i = p.val.i;
+                }
+            }
+            else if (/*!force_reload_all && */ storage.getPatch().fx[s].type.val.i)
                 memcpy((void *)&storage.getPatch().fx[s].p, (void *)&fxsync[s].p,
                        sizeof(Parameter) * n_fx_params);
 
@@ -2175,52 +2239,26 @@ bool SurgeSynthesizer::loadFx(bool initp, bool force_reload_all)
             // fxsync[s].type.val.i << std::endl;
             std::lock_guard<std::mutex> g(fxSpawnMutex);
 
-            fx[s].reset(spawn_effect(storage.getPatch().fx[s].type.val.i, &storage,
-                                     &storage.getPatch().fx[s], storage.getPatch().globaldata));
+            if (prepared)
+                fx[s].reset(prepared);
+            else
+                fx[s].reset(spawn_effect_in_slab(storage.getPatch().fx[s].type.val.i, &storage,
+                                                 &storage.getPatch().fx[s],
+                                                 storage.getPatch().globaldata));
             if (fx[s])
             {
-                fx[s]->init_ctrltypes();
-                if (initp)
-                    fx[s]->init_default_values();
-                else
+                if (!settled)
                 {
-                    for (int j = 0; j < n_fx_params; j++)
+                    Surge::Storage::setupEffectParameters(fx[s].get(), &storage.getPatch().fx[s],
+                                                          initp);
+                    /*for(int j=0; j<n_fx_params; j++)
                     {
-                        auto p = &(storage.getPatch().fx[s].p[j]);
-                        if (p->ctrltype != ct_none)
-                        {
-                            if (p->valtype == vt_float)
-                            {
-                                if (p->val.f < p->val_min.f)
-                                {
-                                    p->val.f = p->val_min.f;
-                                }
-                                if (p->val.f > p->val_max.f)
-                                {
-                                    p->val.f = p->val_max.f;
-                                }
-                            }
-                            else if (p->valtype == vt_int)
-                            {
-                                if (p->val.i < p->val_min.i)
-                                {
-                                    p->val.i = p->val_min.i;
-                                }
-                                if (p->val.i > p->val_max.i)
-                                {
-                                    p->val.i = p->val_max.i;
-                                }
-                            }
-                        }
-                    }
-                }
-                /*for(int j=0; j<n_fx_params; j++)
-                {
-                    storage.getPatch().globaldata[storage.getPatch().fx[s].p[j].id].f =
-                    storage.getPatch().fx[s].p[j].val.f;
-                }*/
+                        storage.getPatch().globaldata[storage.getPatch().fx[s].p[j].id].f =
+                        storage.getPatch().fx[s].p[j].val.f;
+                    }*/
 
-                fx[s]->init();
+                    fx[s]->init();
+                }
 
                 /*
                 ** Clear modulation onto FX otherwise it hangs around from old ones, often with
@@ -2296,6 +2334,14 @@ bool SurgeSynthesizer::loadFx(bool initp, bool force_reload_all)
     return true;
 }
 
+void SurgeSynthesizer::retireFx(int slot)
+{
+    if (fxPreparer)
+        fxPreparer->retire(fx[slot].release());
+    else
+        fx[slot].reset();
+}
+
 bool SurgeSynthesizer::loadOscalgos()
 {
     for (int s = 0; s < n_scenes; s++)
@@ -2709,7 +2755,43 @@ void SurgeSynthesizer::muteModulation(long ptag, modsources modsource, int index
 
     ModulationRouting *r = getModRouting(ptag, modsource, index);
     if (r)
+    {
+        storage.modRoutingMutex.lock();
         r->muted = mute;
+        updateModTable(r);
+        storage.modRoutingMutex.unlock();
+    }
+}
+
+ModulationTable *SurgeSynthesizer::modTableFor(const vector<ModulationRouting> *modlist)
+{
+    auto &patch = storage.getPatch();
+    for (int sc = 0; sc < n_scenes; sc++)
+    {
+        if (modlist == &patch.scene[sc].modulation_scene)
+            return &patch.scene[sc].modulation_scene_table;
+        if (modlist == &patch.scene[sc].modulation_voice)
+            return &patch.scene[sc].modulation_voice_table;
+    }
+    assert(modlist == &patch.modulation_global);
+    return &patch.modulation_global_table;
+}
+
+void SurgeSynthesizer::updateModTable(const ModulationRouting *r)
+{
+    auto &patch = storage.getPatch();
+    auto update = [r, this](vector<ModulationRouting> &modlist) {
+        if (modlist.empty() || r < modlist.data() || r >= modlist.data() + modlist.size())
+            return false;
+        modTableFor(&modlist)->set(r - modlist.data(), *r);
+        return true;
+    };
+
+    if (update(patch.modulation_global))
+        return;
+    for (int sc = 0; sc < n_scenes; sc++)
+        if (update(patch.scene[sc].modulation_scene) || update(patch.scene[sc].modulation_voice))
+            return;
 }
 
 void SurgeSynthesizer::clear_osc_modulation(int scene, int entry)
@@ -2738,6 +2820,10 @@ void SurgeSynthesizer::clear_osc_modulation(int scene, int entry)
         else
             iter++;
     }
+    storage.getPatch().scene[scene].modulation_scene_table.rebuild(
+        storage.getPatch().scene[scene].modulation_scene);
+    storage.getPatch().scene[scene].modulation_voice_table.rebuild(
+        storage.getPatch().scene[scene].modulation_voice);
     storage.modRoutingMutex.unlock();
 }
 
@@ -2807,6 +2893,7 @@ void SurgeSynthesizer::clearModulation(long ptag, modsources modsource, int inde
         {
             storage.modRoutingMutex.lock();
             modlist->erase(modlist->begin() + i);
+            modTableFor(modlist)->erase(i);
             storage.modRoutingMutex.unlock();
             return;
         }
@@ -2856,6 +2943,7 @@ bool SurgeSynthesizer::setModulation(long ptag, modsources modsource, int index,
         if (found_id >= 0)
         {
             modlist->erase(modlist->begin() + found_id);
+            modTableFor(modlist)->erase(found_id);
         }
     }
     else
@@ -2869,10 +2957,12 @@ bool SurgeSynthesizer::setModulation(long ptag, modsources modsource, int index,
             t.muted = false;
             t.source_index = index;
             modlist->push_back(t);
+            modTableFor(modlist)->set(modlist->size() - 1, t);
         }
         else
         {
             modlist->at(found_id).depth = value;
+            modTableFor(modlist)->set(found_id, modlist->at(found_id));
         }
     }
     storage.modRoutingMutex.unlock();
@@ -3030,56 +3120,6 @@ bool SurgeSynthesizer::stringToNormalizedValue(const ID &index, std::string s, f
     return false;
 }
 
-#if MAC || LINUX
-void *loadPatchInBackgroundThread(void *sy)
-{
-#else
-DWORD WINAPI loadPatchInBackgroundThread(LPVOID lpParam)
-{
-    void *sy = lpParam;
-#endif
-
-    SurgeSynthesizer *synth = (SurgeSynthesizer *)sy;
-    std::lock_guard<std::mutex> mg(synth->patchLoadSpawnMutex);
-    if (synth->patchid_queue >= 0)
-    {
-        int patchid = synth->patchid_queue;
-        synth->patchid_queue = -1;
-        synth->allNotesOff();
-        synth->loadPatch(patchid);
-    }
-    if (synth->has_patchid_file)
-    {
-        auto p(string_to_path(synth->patchid_file));
-        auto s = path_to_string(p.stem());
-        synth->has_patchid_file = false;
-        synth->allNotesOff();
-
-        int ptid = -1, ct = 0;
-        for (const auto &pti : synth->storage.patch_list)
-        {
-            if (path_to_string(pti.path) == synth->patchid_file)
-            {
-                ptid = ct;
-            }
-            ct++;
-        }
-
-        if (ptid >= 0)
-        {
-            synth->loadPatch(ptid);
-        }
-        else
-        {
-            synth->loadPatchByPath(synth->patchid_file, -1, s.c_str());
-        }
-    }
-
-    synth->halt_engine = false;
-
-    return 0;
-}
-
 void SurgeSynthesizer::processThreadunsafeOperations(bool dangerMode)
 {
     if (!audio_processing_active || dangerMode)
@@ -3116,7 +3156,8 @@ void SurgeSynthesizer::processControl()
 {
     processEnqueuedPatchIfNeeded();
 
-    storage.perform_queued_wtloads();
+    // Once we are streaming audio, the file I/O and mipmapping happen on the service thread
+    storage.perform_queued_wtloads(audio_processing_active);
     int sm = storage.getPatch().scenemode.val.i;
     // TODO: FIX SCENE ASSUMPTION
     bool playA = (sm == sm_split) || (sm == sm_dual) || (sm == sm_chsplit) ||
@@ -3178,6 +3219,26 @@ void SurgeSynthesizer::processControl()
 
     //	if(sm == sm_morph) storage.getPatch().do_morph();
 
+#ifndef NDEBUG
+    /*
+     * Every edit to a routing list should update its table too. Rebuilding one here would
+     * allocate on the audio thread, so a list which changed length behind its table's back is
+     * only caught in debug builds. apply() reads nothing but the table, so a release build just
+     * keeps playing the old routings until the next edit.
+     */
+    {
+        auto &patch = storage.getPatch();
+        bool inStep = patch.modulation_global_table.size() == (int)patch.modulation_global.size();
+        for (int sc = 0; sc < n_scenes; sc++)
+            inStep = inStep &&
+                     patch.scene[sc].modulation_scene_table.size() ==
+                         (int)patch.scene[sc].modulation_scene.size() &&
+                     patch.scene[sc].modulation_voice_table.size() ==
+                         (int)patch.scene[sc].modulation_voice.size();
+        assert(inStep);
+    }
+#endif
+
     prepareModsourceDoProcess((playA ? 1 : 0) | (playB ? 2 : 0));
 
     for (int s = 0; s < n_scenes; s++)
@@ -3218,21 +3279,8 @@ void SurgeSynthesizer::processControl()
             // for(int i=0; i<n_lfos_scene; i++)
             // storage.getPatch().scene[s].modsources[ms_slfo1+i]->process_block();
 
-            int n = storage.getPatch().scene[s].modulation_scene.size();
-            for (int i = 0; i < n; i++)
-            {
-                int src_id = storage.getPatch().scene[s].modulation_scene[i].source_id;
-                int src_index = storage.getPatch().scene[s].modulation_scene[i].source_index;
-                if (storage.getPatch().scene[s].modsources[src_id])
-                {
-                    int dst_id = storage.getPatch().scene[s].modulation_scene[i].destination_id;
-                    float depth = storage.getPatch().scene[s].modulation_scene[i].depth;
-                    storage.getPatch().scenedata[s][dst_id].f +=
-                        depth *
-                        storage.getPatch().scene[s].modsources[src_id]->get_output(src_index) *
-                        (1.0 - storage.getPatch().scene[s].modulation_scene[i].muted);
-                }
-            }
+            storage.getPatch().scene[s].modulation_scene_table.apply(
+                storage.getPatch().scene[s].modsources.data(), storage.getPatch().scenedata[s]);
 
             for (int i = 0; i < n_lfos_scene; i++)
                 storage.getPatch().scene[s].modsources[ms_slfo1 + i]->process_block();
@@ -3241,16 +3289,8 @@ void SurgeSynthesizer::processControl()
 
     loadOscalgos();
 
-    int n = storage.getPatch().modulation_global.size();
-    for (int i = 0; i < n; i++)
-    {
-        int src_id = storage.getPatch().modulation_global[i].source_id;
-        int dst_id = storage.getPatch().modulation_global[i].destination_id;
-        float depth = storage.getPatch().modulation_global[i].depth;
-        storage.getPatch().globaldata[dst_id].f +=
-            depth * storage.getPatch().scene[0].modsources[src_id]->get_output(0) *
-            (1 - storage.getPatch().modulation_global[i].muted);
-    }
+    storage.getPatch().modulation_global_table.apply(
+        storage.getPatch().scene[0].modsources.data(), storage.getPatch().globaldata);
 
     if (switch_toggled_queued)
     {
@@ -3290,185 +3330,219 @@ void SurgeSynthesizer::processControl()
     }
 }
 
-void SurgeSynthesizer::process()
+bool SurgeSynthesizer::canProcessScenesInParallel() const
 {
-#if DEBUG_RNG_THREADING
-    storage.audioThreadID = pthread_self();
-#endif
-    processRunning = 0;
-
-    float mfade = 1.f;
+    // Scene B can listen to scene A through the audio input oscillator
+    if (storage.otherscene_clients > 0)
+        return false;
 
-    if (halt_engine)
-    {
-        clear_block(output[0], BLOCK_SIZE_QUAD);
-        clear_block(output[1], BLOCK_SIZE_QUAD);
-        return;
-    }
-    else if (patchid_queue >= 0 || has_patchid_file)
+    for (int s = 0; s < n_scenes; s++)
     {
-        masterfade = max(0.f, masterfade - 0.05f);
-        mfade = masterfade * masterfade;
+        // Nothing to gain from waking a worker for an idle scene
+        if (voices[s].empty())
+            return false;
 
-        if (masterfade < 0.0001f)
+        // Formula modulators all evaluate on the one shared audio Lua state
+        for (int l = 0; l < n_lfos_voice; l++)
         {
-            std::lock_guard<std::mutex> mg(patchLoadSpawnMutex);
-            // spawn patch-loading thread
-            allNotesOff();
-            halt_engine = true;
+            if (storage.getPatch().scene[s].lfo[l].shape.val.i == lt_formula)
+                return false;
+        }
+    }
 
-#if MAC || LINUX
-            pthread_t thread;
-            pthread_attr_t attributes;
-            int ret;
-            sched_param params;
+    return true;
+}
 
-            /* initialized with default attributes */
-            ret = pthread_attr_init(&attributes);
+void SurgeSynthesizer::setMultithreadedSceneRendering(bool b)
+{
+    // The pool is never torn down while the synth lives, so the audio thread can't race
+    // a reset here; turning the option off just stops dispatching to it.
+    if (b && !sceneWorkers)
+    {
+        sceneWorkers = std::make_unique<Surge::Threading::WorkerPool>(n_scenes - 1);
+    }
+    multithreadedScenes = b;
+}
 
-            /* safe to get existing scheduling param */
-            ret = pthread_attr_getschedparam(&attributes, &params);
+bool SurgeSynthesizer::canProcessVoicesInParallel(int s) const
+{
+    if (!multithreadedVoices || !voiceWorkers)
+        return false;
 
-            /* set the priority; others are unchanged */
-            params.sched_priority = sched_get_priority_min(SCHED_OTHER);
+    // Small host buffers leave too little headroom to absorb a late worker wakeup
+    int hbs = hostBlockSize;
+    if (hbs > 0 && hbs < minHostBlockSizeForParallelVoices)
+        return false;
 
-            /* setting the new scheduling param */
-            ret = pthread_attr_setschedparam(&attributes, &params);
+    // A single quad is a single job, so there is nothing to split
+    if (voices[s].size() <= 4)
+        return false;
 
-            ret = pthread_create(&thread, &attributes, loadPatchInBackgroundThread, this);
-#else
+    for (int l = 0; l < n_lfos_voice; l++)
+    {
+        if (storage.getPatch().scene[s].lfo[l].shape.val.i == lt_formula)
+            return false;
+    }
 
-            DWORD dwThreadId;
-            HANDLE hThread = CreateThread(NULL, // default security attributes
-                                          0,    // use default stack size
-                                          loadPatchInBackgroundThread, // thread function
-                                          this,         // argument to thread function
-                                          0,            // use default creation flags
-                                          &dwThreadId); // returns the thread identifier
-            SetThreadPriority(hThread, THREAD_PRIORITY_NORMAL);
-#endif
+    return true;
+}
 
-            clear_block(output[0], BLOCK_SIZE_QUAD);
-            clear_block(output[1], BLOCK_SIZE_QUAD);
-            return;
-        }
+void SurgeSynthesizer::setMultithreadedVoiceRendering(bool b)
+{
+    if (b && !voiceWorkers)
+    {
+        int nw = (int)std::thread::hardware_concurrency() - 1;
+        nw = limit_range(nw, 1, (int)maxVoiceWorkers);
+        voiceWorkers = std::make_unique<Surge::Threading::WorkerPool>(nw);
     }
+    multithreadedVoices = b;
+}
 
-    // process inputs (upsample & halfrate)
-    if (process_input)
+void SurgeSynthesizer::processVoiceQuad(int s, int q, int nVoices, fbq_global &g,
+                                        FBQFPtr ProcessQuadFB)
+{
+#if STORAGE_USES_INDEPENDENT_RNG
+    auto priorRNG = storage.threadRNGGen;
+    storage.threadRNGGen = &voiceQuadRNGGen[s][q];
+#endif
+
+    int e = q << 2;
+    int units = std::min(4, nVoices - e);
+
+    for (int i = 0; i < units; i++)
     {
-        hardclip_block8(input[0], BLOCK_SIZE_QUAD);
-        hardclip_block8(input[1], BLOCK_SIZE_QUAD);
-        copy_block(input[0], storage.audio_in_nonOS[0], BLOCK_SIZE_QUAD);
-        copy_block(input[1], storage.audio_in_nonOS[1], BLOCK_SIZE_QUAD);
-        halfbandIN.process_block_U2(input[0], input[1], storage.audio_in[0], storage.audio_in[1]);
+        quadVoiceResume[e + i] = quadVoices[e + i]->process_block(FBQ[s][q], i);
     }
-    else
+
+    SURGE_PROFILE_SCOPE(&storage, Surge::Profiling::BlockProfiler::st_filters + s);
+
+    for (int i = units; i < 4; i++)
     {
-        clear_block_antidenormalnoise(storage.audio_in[0], BLOCK_SIZE_OS_QUAD);
-        clear_block_antidenormalnoise(storage.audio_in[1], BLOCK_SIZE_OS_QUAD);
-        clear_block_antidenormalnoise(storage.audio_in_nonOS[1], BLOCK_SIZE_QUAD);
-        clear_block_antidenormalnoise(storage.audio_in_nonOS[1], BLOCK_SIZE_QUAD);
+        FBQ[s][q].FU[0].active[i] = 0;
+        FBQ[s][q].FU[1].active[i] = 0;
+        FBQ[s][q].FU[2].active[i] = 0;
+        FBQ[s][q].FU[3].active[i] = 0;
     }
 
-    // TODO: FIX SCENE ASSUMPTION
-    float fxsendout alignas(16)[n_send_slots][2][BLOCK_SIZE];
-    bool play_scene[n_scenes];
+    clear_block(quadOut[q][0], BLOCK_SIZE_OS_QUAD);
+    clear_block(quadOut[q][1], BLOCK_SIZE_OS_QUAD);
+    ProcessQuadFB(FBQ[s][q], g, quadOut[q][0], quadOut[q][1]);
 
+    for (int i = 0; i < units; i++)
     {
-        clear_block_antidenormalnoise(sceneout[0][0], BLOCK_SIZE_OS_QUAD);
-        clear_block_antidenormalnoise(sceneout[0][1], BLOCK_SIZE_OS_QUAD);
-        clear_block_antidenormalnoise(sceneout[1][0], BLOCK_SIZE_OS_QUAD);
-        clear_block_antidenormalnoise(sceneout[1][1], BLOCK_SIZE_OS_QUAD);
-
-        for (int i = 0; i < n_send_slots; ++i)
-        {
-            clear_block_antidenormalnoise(fxsendout[i][0], BLOCK_SIZE_QUAD);
-            clear_block_antidenormalnoise(fxsendout[i][1], BLOCK_SIZE_QUAD);
-        }
+        if (quadVoiceResume[e + i])
+            quadVoices[e + i]->GetQFB();
     }
 
-    storage.modRoutingMutex.lock();
-    processControl();
+#if STORAGE_USES_INDEPENDENT_RNG
+    storage.threadRNGGen = priorRNG;
+#endif
+}
 
-    amp.set_target_smoothed(db_to_linear(storage.getPatch().volume.val.f));
-    amp_mute.set_target(mfade);
+int SurgeSynthesizer::processSceneVoicesInParallel(int s, fbq_global &g, FBQFPtr ProcessQuadFB)
+{
+    int nVoices = 0;
+    for (auto v : voices[s])
+    {
+        quadVoices[nVoices++] = v;
+    }
+    int nQuads = (nVoices + 3) >> 2;
 
-    int fx_bypass = storage.getPatch().fx_bypass.val.i;
+    struct QuadJob
+    {
+        SurgeSynthesizer *synth;
+        int scene, nVoices;
+        fbq_global *g;
+        FBQFPtr fn;
+    } job{this, s, nVoices, &g, ProcessQuadFB};
 
-    int sendToIndex[n_send_slots][2] = {
-        {fxslot_send1, 0}, {fxslot_send2, 1}, {fxslot_send3, 2}, {fxslot_send4, 3}};
+    voiceWorkers->runAndJoin(
+        [](void *ctx, int q) {
+            auto j = static_cast<QuadJob *>(ctx);
+            j->synth->processVoiceQuad(j->scene, q, j->nVoices, *(j->g), j->fn);
+        },
+        &job, nQuads);
 
-    if (fx_bypass == fxb_all_fx)
+    // Sum in quad order, which is exactly the order the serial path accumulates in
+    for (int q = 0; q < nQuads; q++)
     {
-        for (auto si : sendToIndex)
-        {
-            auto slot = si[0];
-            auto idx = si[1];
-            if (fx[slot])
-            {
-                FX[idx].set_target_smoothed(amp_to_linear(
-                    storage.getPatch().globaldata[storage.getPatch().fx[slot].return_level.id].f));
-                send[idx][0].set_target_smoothed(amp_to_linear(
-                    storage.getPatch()
-                        .scenedata[0][storage.getPatch().scene[0].send_level[idx].param_id_in_scene]
-                        .f));
-                send[idx][1].set_target_smoothed(amp_to_linear(
-                    storage.getPatch()
-                        .scenedata[1][storage.getPatch().scene[1].send_level[idx].param_id_in_scene]
-                        .f));
-            }
-        }
+        accumulate_block(quadOut[q][0], sceneout[s][0], BLOCK_SIZE_OS_QUAD);
+        accumulate_block(quadOut[q][1], sceneout[s][1], BLOCK_SIZE_OS_QUAD);
     }
 
-    list<SurgeVoice *>::iterator iter;
-
-    for (int sc = 0; sc < n_scenes; sc++)
+    auto keep = voices[s].begin();
+    for (int i = 0; i < nVoices; i++)
     {
-        play_scene[sc] = (!voices[sc].empty());
+        if (quadVoiceResume[i])
+            *keep++ = quadVoices[i];
+        else
+            freeVoice(quadVoices[i]);
     }
+    voices[s].erase(keep, voices[s].end());
 
-    int FBentry[n_scenes];
-    int vcount = 0;
+    return nVoices;
+}
 
-    for (int s = 0; s < n_scenes; s++)
+int SurgeSynthesizer::processSceneBlock(int s, bool inParallelWithOtherScenes, bool &sceneState)
+{
+    // When the scenes run in parallel the audio thread holds modRoutingMutex for both
+    bool manageModRoutingLock = !inParallelWithOtherScenes;
+
+    SURGE_PROFILE_SCOPE(&storage, Surge::Profiling::BlockProfiler::st_scene + s);
+
+    bool play_scene = !voices[s].empty();
+    int FBentry = 0;
+
+#if STORAGE_USES_INDEPENDENT_RNG
+    // Whoever called us may have a generator of their own on this thread; see threadRand
+    auto priorRNG = storage.threadRNGGen;
+#endif
+
+    fbq_global g;
+    g.FU1ptr = GetQFPtrFilterUnit(storage.getPatch().scene[s].filterunit[0].type.val.i,
+                                  storage.getPatch().scene[s].filterunit[0].subtype.val.i);
+    g.FU2ptr = GetQFPtrFilterUnit(storage.getPatch().scene[s].filterunit[1].type.val.i,
+                                  storage.getPatch().scene[s].filterunit[1].subtype.val.i);
+    g.WSptr = GetQFPtrWaveshaper(storage.getPatch().scene[s].wsunit.type.val.i);
+
+    FBQFPtr ProcessQuadFB =
+        GetFBQPointer(storage.getPatch().scene[s].filterblock_configuration.val.i,
+                      g.FU1ptr != 0, g.WSptr != 0, g.FU2ptr != 0);
+
+    if (!inParallelWithOtherScenes && canProcessVoicesInParallel(s))
     {
-        FBentry[s] = 0;
-        iter = voices[s].begin();
-        while (iter != voices[s].end())
+        FBentry = processSceneVoicesInParallel(s, g, ProcessQuadFB);
+
+        if (manageModRoutingLock)
+            storage.modRoutingMutex.unlock();
+    }
+    else
+    {
+        // Finished voices are dropped by moving the survivors forward as we go
+        auto keep = voices[s].begin();
+        for (auto v : voices[s])
         {
-            SurgeVoice *v = *iter;
             assert(v);
-            bool resume = v->process_block(FBQ[s][FBentry[s] >> 2], FBentry[s] & 3);
-            FBentry[s]++;
-
-            vcount++;
+#if STORAGE_USES_INDEPENDENT_RNG
+            storage.threadRNGGen = &voiceQuadRNGGen[s][FBentry >> 2];
+#endif
+            bool resume = v->process_block(FBQ[s][FBentry >> 2], FBentry & 3);
+            FBentry++;
 
-            if (!resume)
-            {
-                freeVoice(v);
-                iter = voices[s].erase(iter);
-            }
+            if (resume)
+                *keep++ = v;
             else
-                iter++;
+                freeVoice(v);
         }
+        voices[s].erase(keep, voices[s].end());
 
-        storage.modRoutingMutex.unlock();
-
-        fbq_global g;
-        g.FU1ptr = GetQFPtrFilterUnit(storage.getPatch().scene[s].filterunit[0].type.val.i,
-                                      storage.getPatch().scene[s].filterunit[0].subtype.val.i);
-        g.FU2ptr = GetQFPtrFilterUnit(storage.getPatch().scene[s].filterunit[1].type.val.i,
-                                      storage.getPatch().scene[s].filterunit[1].subtype.val.i);
-        g.WSptr = GetQFPtrWaveshaper(storage.getPatch().scene[s].wsunit.type.val.i);
-
-        FBQFPtr ProcessQuadFB =
-            GetFBQPointer(storage.getPatch().scene[s].filterblock_configuration.val.i,
-                          g.FU1ptr != 0, g.WSptr != 0, g.FU2ptr != 0);
+        if (manageModRoutingLock)
+            storage.modRoutingMutex.unlock();
 
-        for (int e = 0; e < FBentry[s]; e += 4)
+        SURGE_PROFILE_SCOPE(&storage, Surge::Profiling::BlockProfiler::st_filters + s);
+        for (int e = 0; e < FBentry; e += 4)
         {
-            int units = FBentry[s] - e;
+            int units = FBentry - e;
             for (int i = units; i < 4; i++)
             {
                 FBQ[s][e >> 2].FU[0].active[i] = 0;
@@ -3479,147 +3553,266 @@ void SurgeSynthesizer::process()
             ProcessQuadFB(FBQ[s][e >> 2], g, sceneout[s][0], sceneout[s][1]);
         }
 
-        if (s == 0 && storage.otherscene_clients > 0)
+        for (auto v : voices[s])
         {
-            // Make available for scene B
-            copy_block(sceneout[0][0], storage.audio_otherscene[0], BLOCK_SIZE_OS_QUAD);
-            copy_block(sceneout[0][1], storage.audio_otherscene[1], BLOCK_SIZE_OS_QUAD);
-        }
-
-        iter = voices[s].begin();
-        while (iter != voices[s].end())
-        {
-            SurgeVoice *v = *iter;
             assert(v);
             v->GetQFB(); // save filter state in voices after quad processing is done
-            iter++;
         }
-        storage.modRoutingMutex.lock();
     }
 
-    storage.modRoutingMutex.unlock();
-    polydisplay = vcount;
+#if STORAGE_USES_INDEPENDENT_RNG
+    storage.threadRNGGen = &sceneRNGGen[s];
+#endif
 
-    // TODO: FIX SCENE ASSUMPTION
-    if (play_scene[0])
+    if (s == 0 && storage.otherscene_clients > 0)
     {
-        switch (storage.sceneHardclipMode[0])
-        {
-        case SurgeStorage::HARDCLIP_TO_18DBFS:
-            hardclip_block8(sceneout[0][0], BLOCK_SIZE_OS_QUAD);
-            hardclip_block8(sceneout[0][1], BLOCK_SIZE_OS_QUAD);
-            break;
-        case SurgeStorage::HARDCLIP_TO_0DBFS:
-            hardclip_block(sceneout[0][0], BLOCK_SIZE_OS_QUAD);
-            hardclip_block(sceneout[0][1], BLOCK_SIZE_OS_QUAD);
-            break;
-        case SurgeStorage::BYPASS_HARDCLIP:
-            break;
-        }
-
-        halfbandA.process_block_D2(sceneout[0][0], sceneout[0][1]);
+        // Make available for scene B
+        copy_block(sceneout[0][0], storage.audio_otherscene[0], BLOCK_SIZE_OS_QUAD);
+        copy_block(sceneout[0][1], storage.audio_otherscene[1], BLOCK_SIZE_OS_QUAD);
     }
 
-    if (play_scene[1])
+    // TODO: FIX SCENE ASSUMPTION (use std::array for halfband and lowcut filters)
+    HalfRateFilter &halfband = (s == 0) ? halfbandA : halfbandB;
+    BiquadFilter &lowcut = (s == 0) ? hpA : hpB;
+
+    if (play_scene)
     {
-        switch (storage.sceneHardclipMode[1])
+        switch (storage.sceneHardclipMode[s])
         {
         case SurgeStorage::HARDCLIP_TO_18DBFS:
-            hardclip_block8(sceneout[1][0], BLOCK_SIZE_OS_QUAD);
-            hardclip_block8(sceneout[1][1], BLOCK_SIZE_OS_QUAD);
+            hardclip_block8(sceneout[s][0], BLOCK_SIZE_OS_QUAD);
+            hardclip_block8(sceneout[s][1], BLOCK_SIZE_OS_QUAD);
             break;
         case SurgeStorage::HARDCLIP_TO_0DBFS:
-            hardclip_block(sceneout[1][0], BLOCK_SIZE_OS_QUAD);
-            hardclip_block(sceneout[1][1], BLOCK_SIZE_OS_QUAD);
+            hardclip_block(sceneout[s][0], BLOCK_SIZE_OS_QUAD);
+            hardclip_block(sceneout[s][1], BLOCK_SIZE_OS_QUAD);
             break;
         case SurgeStorage::BYPASS_HARDCLIP:
             break;
         }
 
-        halfbandB.process_block_D2(sceneout[1][0], sceneout[1][1]);
+        halfband.process_block_D2(sceneout[s][0], sceneout[s][1]);
     }
 
-    // TODO: FIX SCENE ASSUMPTION
-    if (storage.getPatch().scene[0].lowcut.deactivated == false)
+    if (storage.getPatch().scene[s].lowcut.deactivated == false)
     {
         auto freq =
-            storage.getPatch().scenedata[0][storage.getPatch().scene[0].lowcut.param_id_in_scene].f;
+            storage.getPatch().scenedata[s][storage.getPatch().scene[s].lowcut.param_id_in_scene].f;
 
-        hpA.coeff_HP(hpA.calc_omega(freq / 12.0), 0.4);    // var 0.707
-        hpA.process_block(sceneout[0][0], sceneout[0][1]); // TODO: quadify
+        lowcut.coeff_HP(lowcut.calc_omega(freq / 12.0), 0.4);  // var 0.707
+        lowcut.process_block(sceneout[s][0], sceneout[s][1]); // TODO: quadify
     }
 
-    if (storage.getPatch().scene[1].lowcut.deactivated == false)
-    {
-        auto freq =
-            storage.getPatch().scenedata[1][storage.getPatch().scene[1].lowcut.param_id_in_scene].f;
-
-        hpB.coeff_HP(hpB.calc_omega(freq / 12.0), 0.4);
-        hpB.process_block(sceneout[1][0], sceneout[1][1]);
-    }
-
-    for (int cls = 0; cls < n_scenes; ++cls)
-    {
-        switch (storage.sceneHardclipMode[cls])
+    auto clipScene = [this, s]() {
+        switch (storage.sceneHardclipMode[s])
         {
         case SurgeStorage::HARDCLIP_TO_18DBFS:
-            hardclip_block8(sceneout[cls][0], BLOCK_SIZE_QUAD);
-            hardclip_block8(sceneout[cls][1], BLOCK_SIZE_QUAD);
+            hardclip_block8(sceneout[s][0], BLOCK_SIZE_QUAD);
+            hardclip_block8(sceneout[s][1], BLOCK_SIZE_QUAD);
             break;
         case SurgeStorage::HARDCLIP_TO_0DBFS:
-            hardclip_block(sceneout[cls][0], BLOCK_SIZE_QUAD);
-            hardclip_block(sceneout[cls][1], BLOCK_SIZE_QUAD);
+            hardclip_block(sceneout[s][0], BLOCK_SIZE_QUAD);
+            hardclip_block(sceneout[s][1], BLOCK_SIZE_QUAD);
             break;
         default:
             break;
         }
-    }
+    };
+
+    clipScene();
 
+    // apply insert effects
     // TODO: FIX SCENE ASSUMPTION
-    bool sc_state[n_scenes];
+    sceneState = play_scene;
+    static const int insertSlots[n_scenes][4] = {
+        {fxslot_ains1, fxslot_ains2, fxslot_ains3, fxslot_ains4},
+        {fxslot_bins1, fxslot_bins2, fxslot_bins3, fxslot_bins4}};
 
-    for (int i = 0; i < n_scenes; i++)
+    if (storage.getPatch().fx_bypass.val.i != fxb_no_fx)
     {
-        sc_state[i] = play_scene[i];
+        for (auto v : insertSlots[s])
+        {
+            if (fx[v] && !(storage.getPatch().fx_disable.val.i & (1 << v)))
+            {
+                sceneState = fx[v]->process_ringout(sceneout[s][0], sceneout[s][1], sceneState);
+            }
+        }
     }
 
-    // apply insert effects
-    if (fx_bypass != fxb_no_fx)
+    clipScene();
+
+    if (manageModRoutingLock)
+        storage.modRoutingMutex.lock();
+
+#if STORAGE_USES_INDEPENDENT_RNG
+    storage.threadRNGGen = priorRNG;
+#endif
+
+    return FBentry;
+}
+
+void SurgeSynthesizer::process()
+{
+#if DEBUG_RNG_THREADING
+    storage.audioThreadID = pthread_self();
+#endif
+    processRunning = 0;
+
+    SURGE_PROFILE_BLOCK(&storage);
+
+    float mfade = 1.f;
+
+    if (halt_engine)
+    {
+        clear_block(output[0], BLOCK_SIZE_QUAD);
+        clear_block(output[1], BLOCK_SIZE_QUAD);
+        return;
+    }
+    else if (patchLoader)
     {
-        for (auto v : {fxslot_ains1, fxslot_ains2, fxslot_ains3, fxslot_ains4})
+        bool queued = patchid_queue >= 0 || has_patchid_file;
+
+        // A newer request replaces one which is prepared but hasn't gone in yet
+        if (queued && patchLoader->isPrepared())
+            patchLoader->discardPrepared();
+
+        if (queued && patchLoader->requestLoad(patchid_queue,
+                                               has_patchid_file ? patchid_file : nullptr))
         {
-            if (fx[v] && !(storage.getPatch().fx_disable.val.i & (1 << v)))
+            patchid_queue = -1;
+            has_patchid_file = false;
+        }
+
+        if (patchLoader->isPrepared())
+        {
+            // The old patch plays on until the new one is ready, then fades out
+            masterfade = max(0.f, masterfade - 0.05f);
+            mfade = masterfade * masterfade;
+
+            if (masterfade < 0.0001f)
             {
-                sc_state[0] = fx[v]->process_ringout(sceneout[0][0], sceneout[0][1], sc_state[0]);
+                allNotesOff();
+                halt_engine = true;
+                patchLoader->commit();
+
+                clear_block(output[0], BLOCK_SIZE_QUAD);
+                clear_block(output[1], BLOCK_SIZE_QUAD);
+                return;
             }
         }
+        else if (masterfade < 1.f)
+        {
+            masterfade = min(1.f, masterfade + 0.05f);
+            mfade = masterfade * masterfade;
+        }
+    }
+
+    // process inputs (upsample & halfrate)
+    if (process_input)
+    {
+        hardclip_block8(input[0], BLOCK_SIZE_QUAD);
+        hardclip_block8(input[1], BLOCK_SIZE_QUAD);
+        copy_block(input[0], storage.audio_in_nonOS[0], BLOCK_SIZE_QUAD);
+        copy_block(input[1], storage.audio_in_nonOS[1], BLOCK_SIZE_QUAD);
+        halfbandIN.process_block_U2(input[0], input[1], storage.audio_in[0], storage.audio_in[1]);
+    }
+    else
+    {
+        clear_block_antidenormalnoise(storage.audio_in[0], BLOCK_SIZE_OS_QUAD);
+        clear_block_antidenormalnoise(storage.audio_in[1], BLOCK_SIZE_OS_QUAD);
+        clear_block_antidenormalnoise(storage.audio_in_nonOS[1], BLOCK_SIZE_QUAD);
+        clear_block_antidenormalnoise(storage.audio_in_nonOS[1], BLOCK_SIZE_QUAD);
+    }
+
+    // TODO: FIX SCENE ASSUMPTION
+    float fxsendout alignas(16)[n_send_slots][2][BLOCK_SIZE];
+
+    {
+        clear_block_antidenormalnoise(sceneout[0][0], BLOCK_SIZE_OS_QUAD);
+        clear_block_antidenormalnoise(sceneout[0][1], BLOCK_SIZE_OS_QUAD);
+        clear_block_antidenormalnoise(sceneout[1][0], BLOCK_SIZE_OS_QUAD);
+        clear_block_antidenormalnoise(sceneout[1][1], BLOCK_SIZE_OS_QUAD);
 
-        for (auto v : {fxslot_bins1, fxslot_bins2, fxslot_bins3, fxslot_bins4})
+        for (int i = 0; i < n_send_slots; ++i)
         {
-            if (fx[v] && !(storage.getPatch().fx_disable.val.i & (1 << v)))
+            clear_block_antidenormalnoise(fxsendout[i][0], BLOCK_SIZE_QUAD);
+            clear_block_antidenormalnoise(fxsendout[i][1], BLOCK_SIZE_QUAD);
+        }
+    }
+
+    storage.modRoutingMutex.lock();
+    {
+        SURGE_PROFILE_SCOPE(&storage, Surge::Profiling::BlockProfiler::st_control);
+        processControl();
+    }
+
+    amp.set_target_smoothed(db_to_linear(storage.getPatch().volume.val.f));
+    amp_mute.set_target(mfade);
+
+    int fx_bypass = storage.getPatch().fx_bypass.val.i;
+
+    int sendToIndex[n_send_slots][2] = {
+        {fxslot_send1, 0}, {fxslot_send2, 1}, {fxslot_send3, 2}, {fxslot_send4, 3}};
+
+    if (fx_bypass == fxb_all_fx)
+    {
+        for (auto si : sendToIndex)
+        {
+            auto slot = si[0];
+            auto idx = si[1];
+            if (fx[slot])
             {
-                sc_state[1] = fx[v]->process_ringout(sceneout[1][0], sceneout[1][1], sc_state[1]);
+                FX[idx].set_target_smoothed(amp_to_linear(
+                    storage.getPatch().globaldata[storage.getPatch().fx[slot].return_level.id].f));
+                send[idx][0].set_target_smoothed(amp_to_linear(
+                    storage.getPatch()
+                        .scenedata[0][storage.getPatch().scene[0].send_level[idx].param_id_in_scene]
+                        .f));
+                send[idx][1].set_target_smoothed(amp_to_linear(
+                    storage.getPatch()
+                        .scenedata[1][storage.getPatch().scene[1].send_level[idx].param_id_in_scene]
+                        .f));
             }
         }
     }
 
-    for (int cls = 0; cls < n_scenes; ++cls)
+    int sceneVoiceCount[n_scenes];
+    bool sc_state[n_scenes];
+
+    if (multithreadedScenes && sceneWorkers && canProcessScenesInParallel())
     {
-        switch (storage.sceneHardclipMode[cls])
+        struct SceneJob
         {
-        case SurgeStorage::HARDCLIP_TO_18DBFS:
-            hardclip_block8(sceneout[cls][0], BLOCK_SIZE_QUAD);
-            hardclip_block8(sceneout[cls][1], BLOCK_SIZE_QUAD);
-            break;
-        case SurgeStorage::HARDCLIP_TO_0DBFS:
-            hardclip_block(sceneout[cls][0], BLOCK_SIZE_QUAD);
-            hardclip_block(sceneout[cls][1], BLOCK_SIZE_QUAD);
-            break;
-        default:
-            break;
+            SurgeSynthesizer *synth;
+            int *voiceCount;
+            bool *sceneState;
+        } job{this, sceneVoiceCount, sc_state};
+
+        // The audio thread keeps modRoutingMutex for the whole parallel section
+        sceneWorkers->runAndJoin(
+            [](void *ctx, int s) {
+                auto j = static_cast<SceneJob *>(ctx);
+                j->voiceCount[s] = j->synth->processSceneBlock(s, true, j->sceneState[s]);
+            },
+            &job, n_scenes);
+    }
+    else
+    {
+        for (int s = 0; s < n_scenes; s++)
+        {
+            sceneVoiceCount[s] = processSceneBlock(s, false, sc_state[s]);
         }
     }
 
+    storage.modRoutingMutex.unlock();
+
+    int vcount = 0;
+    for (int s = 0; s < n_scenes; s++)
+    {
+        vcount += sceneVoiceCount[s];
+    }
+    polydisplay = vcount;
+
     // sum scenes
     // TODO: FIX SCENE ASSUMPTION
     copy_block(sceneout[0][0], output[0], BLOCK_SIZE_QUAD);
@@ -3700,6 +3893,37 @@ void SurgeSynthesizer::process()
     }
 }
 
+void SurgeSynthesizer::seedRandomGenerators(uint32_t seed)
+{
+    auto reseed = [](SurgeStorage::RNGGen &gen, uint32_t s) {
+        gen.g.seed(s);
+        // Distributions may hold on to a draw, so start those over too
+        gen.d.reset();
+        gen.pm1.reset();
+        gen.z1.reset();
+        gen.u32.reset();
+    };
+
+    auto &r = storage.rngGen;
+    reseed(r, seed);
+    storage.rngSeeded = true;
+
+    for (int sc = 0; sc < n_scenes; sc++)
+    {
+        reseed(sceneRNGGen[sc], r.u32(r.g));
+        for (auto &q : voiceQuadRNGGen[sc])
+            reseed(q, r.u32(r.g));
+
+        for (auto ms : {ms_random_bipolar, ms_random_unipolar})
+        {
+            auto rms = dynamic_cast<RandomModulationSource *>(
+                storage.getPatch().scene[sc].modsources[ms]);
+            if (rms)
+                rms->seed(r.u32(r.g));
+        }
+    }
+}
+
 SurgeSynthesizer::PluginLayer *SurgeSynthesizer::getParent()
 {
     assert(_parent != nullptr);
@@ -3904,6 +4128,7 @@ void SurgeSynthesizer::swapMetaControllers(int c1, int c2)
         }
     }
 
+    storage.getPatch().rebuildModulationTables();
     storage.modRoutingMutex.unlock();
 
     refresh_editor = true;
@@ -18,6 +18,11 @@
 #include "SurgeVoice.h"
 #include "Effect.h"
 #include "BiquadFilter.h"
+#include "WorkerPool.h"
+#include "EffectPreparer.h"
+#include "PatchLoader.h"
+#include "ServiceThread.h"
+#include "VoiceList.h"
 
 struct QuadFilterChainState;
 
@@ -83,6 +88,59 @@ class alignas(16) SurgeSynthesizer
     int getMpeMainChannel(int voiceChannel, int key);
     void process();
 
+    /*
+     * Reseeds every random generator the synth owns (the storage's, the scenes', the voice
+     * quads' and the random modulators') from one seed, so that the same patch and events
+     * render the same way each time. Voices and LFOs created from here on take their seeds
+     * from these. The DSP helpers which use SurgeStorage::threadRand outside a scene draw from
+     * the thread's generator; to pin those too, install a seeded one on the rendering thread.
+     */
+    void seedRandomGenerators(uint32_t seed);
+
+    /*
+     * processSceneBlock runs the entire pipeline for one scene: voices, the filter block,
+     * downsampling, lowcut and the scene's insert FX. It returns the number of voices it
+     * rendered and sets sceneState to whether the scene (or its FX ringout) is producing
+     * sound. process() runs it once per scene and then sums into the send and global FX.
+     *
+     * With multithreaded scene rendering enabled, and when the two scenes don't depend on
+     * each other, the scene pipelines run on sceneWorkers instead and are joined before
+     * the sum. Each scene draws from its own RNG so the result is the same either way.
+     */
+    void setMultithreadedSceneRendering(bool b);
+    bool getMultithreadedSceneRendering() const { return multithreadedScenes; }
+    bool canProcessScenesInParallel() const;
+    int processSceneBlock(int s, bool inParallelWithOtherScenes, bool &sceneState);
+    std::unique_ptr<Surge::Threading::WorkerPool> sceneWorkers;
+    std::atomic<bool> multithreadedScenes{false};
+    SurgeStorage::RNGGen sceneRNGGen[n_scenes];
+
+    /*
+     * Within a scene the voices can be spread over a worker pool too. The unit of work is
+     * one quad of FBQ: the (up to) four voices sharing a QuadFilterChainState, followed by
+     * the filter block for that quad into its own buffer in quadOut. The join sums the quad
+     * buffers in order, which matches the serial accumulation exactly, and every quad has
+     * its own RNG stream regardless of which path renders it.
+     *
+     * This only kicks in when the scenes themselves are rendering serially, when the scene
+     * has more than one quad of voices, and when the host block size (if the wrapper told
+     * us) is big enough that a late worker can't blow the deadline.
+     */
+    void setMultithreadedVoiceRendering(bool b);
+    bool getMultithreadedVoiceRendering() const { return multithreadedVoices; }
+    void setHostBlockSize(int bs) { hostBlockSize = bs; }
+    bool canProcessVoicesInParallel(int s) const;
+    int processSceneVoicesInParallel(int s, fbq_global &g, FBQFPtr ProcessQuadFB);
+    void processVoiceQuad(int s, int q, int nVoices, fbq_global &g, FBQFPtr ProcessQuadFB);
+    std::unique_ptr<Surge::Threading::WorkerPool> voiceWorkers;
+    std::atomic<bool> multithreadedVoices{false};
+    std::atomic<int> hostBlockSize{0};
+    static constexpr int minHostBlockSizeForParallelVoices = 64, maxVoiceWorkers = 3;
+    SurgeStorage::RNGGen voiceQuadRNGGen[n_scenes][MAX_VOICES >> 2];
+    SurgeVoice *quadVoices[MAX_VOICES];
+    bool quadVoiceResume[MAX_VOICES];
+    float quadOut alignas(16)[MAX_VOICES >> 2][N_OUTPUTS][BLOCK_SIZE_OS];
+
     PluginLayer *getParent();
 
     // protected:
@@ -100,7 +158,8 @@ class alignas(16) SurgeSynthesizer
      * we only use it in the startup constructor path.
      */
     void processThreadunsafeOperations(bool doItEvenIfAudioIsRunningDANGER = false);
-    bool loadFx(bool initp, bool force_reload_all);
+    bool loadFx(bool initp, bool force_reload_all,
+                Surge::Storage::PreparedEffects *prebuilt = nullptr);
     bool loadOscalgos();
     bool load_fx_needed;
 
@@ -109,7 +168,25 @@ class alignas(16) SurgeSynthesizer
      * so if you swpan or init the fx[s] object lock this mutex
      */
     std::mutex fxSpawnMutex;
-    std::mutex patchLoadSpawnMutex;
+
+    /*
+     * Queued patch changes are read and prepared on the service thread while the current patch
+     * plays on; process() only fades out once the new patch is ready to go in.
+     */
+    std::unique_ptr<Surge::Storage::PatchLoader> patchLoader;
+
+    /*
+     * The one thread behind the patch loader, the FX preparer and the wavetable loader. Its
+     * getStats() reports how deep the command queue gets and how long commands wait.
+     */
+    std::unique_ptr<Surge::Storage::ServiceThread> serviceThread;
+
+    /*
+     * While audio is running, a changed FX type is built on the service thread and picked up
+     * by loadFx a block or two later, and replaced effects are destroyed over there too.
+     */
+    std::unique_ptr<Surge::Storage::EffectPreparer> fxPreparer;
+    void retireFx(int slot);
     enum FXReorderMode
     {
         NONE,
@@ -134,6 +211,9 @@ class alignas(16) SurgeSynthesizer
     std::array<std::array<SurgeVoice, MAX_VOICES>, 2> voices_array;
     unsigned int voices_usedby[2][MAX_VOICES]; // 0 indicates no user, 1 is scene A & 2 is scene B
                                                // // TODO: FIX SCENE ASSUMPTION!
+    // A stack of the free voices_array indices for each scene, so finding one is O(1)
+    int freeVoiceSlots[n_scenes][MAX_VOICES];
+    int n_freeVoiceSlots[n_scenes];
     int64_t voiceCounter = 1L;
 
     std::atomic<unsigned int> processRunning{0};
@@ -291,6 +371,21 @@ class alignas(16) SurgeSynthesizer
     void loadRaw(const void *data, int size, bool preset = false);
     void loadPatch(int id);
     bool loadPatchByPath(const char *fxpPath, int categoryId, const char *name);
+
+    /*
+     * The two halves of loadRaw and loadPatchByPath. Preparing reads and parses the patch
+     * without touching the synth, so it can run while the previous patch is still playing;
+     * see Surge::Storage::PatchLoader.
+     */
+    bool preparePatchFromPath(const char *fxpPath, const char *name, PreparedPatch &into,
+                              bool useCache = true);
+    void loadPreparedPatch(PreparedPatch &pp, int categoryId, const char *name,
+                           Surge::Storage::PreparedEffects *prebuiltFx = nullptr);
+    void loadPreparedRaw(PreparedPatch &pp, bool preset,
+                         Surge::Storage::PreparedEffects *prebuiltFx = nullptr);
+    void applyPatchTuning(); // the tuning stored in the patch, if there is one
+    // Writes a patch compiled while loading to storage.patchCache, if it is on
+    void cachePreparedPatch(PreparedPatch &pp);
     void incrementPatch(bool nextPrev, bool insideCategory = true);
     void incrementCategory(bool nextPrev);
     void selectRandomPatch();
@@ -301,6 +396,8 @@ class alignas(16) SurgeSynthesizer
     void savePatch();
     void updateUsedState();
     void prepareModsourceDoProcess(int scenemask);
+    ModulationTable *modTableFor(const std::vector<ModulationRouting> *modlist);
+    void updateModTable(const ModulationRouting *r);
     unsigned int saveRaw(void **data);
     // synth -> editor variables
     std::atomic<int>
@@ -327,8 +424,8 @@ class alignas(16) SurgeSynthesizer
     float masterfade = 0;
     HalfRateFilter halfbandA, halfbandB,
         halfbandIN; // TODO: FIX SCENE ASSUMPTION (for halfbandA/B - use std::array)
-    std::list<SurgeVoice *> voices[n_scenes];
-    std::unique_ptr<Effect> fx[n_fx_slots];
+    VoiceList voices[n_scenes];
+    std::unique_ptr<Effect, EffectSlabDeleter> fx[n_fx_slots];
     std::atomic<bool> halt_engine;
     MidiChannelState channelState[16];
     bool mpeEnabled = false;
@@ -14,6 +14,9 @@
 */
 
 #include "SurgeSynthesizer.h"
+#include "WavetableLoader.h"
+#include "MappedFile.h"
+#include "PatchCache.h"
 #include "DSPUtils.h"
 #include <time.h>
 #include <vembertech/vt_dsp_endian.h>
@@ -204,16 +207,37 @@ void SurgeSynthesizer::loadPatch(int id)
 
 bool SurgeSynthesizer::loadPatchByPath(const char *fxpPath, int categoryId, const char *patchName)
 {
-    std::filebuf f;
-    if (!f.open(string_to_path(fxpPath), std::ios::binary | std::ios::in))
+    PreparedPatch pp;
+    if (!preparePatchFromPath(fxpPath, patchName, pp))
+        return false;
+
+    loadPreparedPatch(pp, categoryId, patchName);
+    cachePreparedPatch(pp);
+    applyPatchTuning();
+
+    masterfade = 1.f;
+    /*
+    ** Notify the host display that the patch name has changed
+    */
+    updateDisplay();
+    return true;
+}
+
+bool SurgeSynthesizer::preparePatchFromPath(const char *fxpPath, const char *patchName,
+                                            PreparedPatch &into, bool useCache)
+{
+    // The patch is parsed straight out of the mapping; see MappedFile.h
+    Surge::Storage::MappedFile f;
+    if (!f.open(string_to_path(fxpPath)))
         return false;
     fxChunkSetCustom fxp;
-    auto read = f.sgetn(reinterpret_cast<char *>(&fxp), sizeof(fxp));
-    // FIXME - error if read != chunk size
+    if (f.size() < sizeof(fxp))
+        memset(&fxp, 0, sizeof(fxp));
+    else
+        memcpy(&fxp, f.data(), sizeof(fxp));
     if ((vt_read_int32BE(fxp.chunkMagic) != 'CcnK') || (vt_read_int32BE(fxp.fxMagic) != 'FPCh') ||
         (vt_read_int32BE(fxp.fxID) != 'cjs3'))
     {
-        f.close();
         auto cm = vt_read_int32BE(fxp.chunkMagic);
         auto fm = vt_read_int32BE(fxp.fxMagic);
         auto id = vt_read_int32BE(fxp.fxID);
@@ -245,11 +269,40 @@ bool SurgeSynthesizer::loadPatchByPath(const char *fxpPath, int categoryId, cons
     }
 
     int cs = vt_read_int32BE(fxp.chunkSize);
-    std::unique_ptr<char[]> data{new char[cs]};
-    if (f.sgetn(data.get(), cs) != cs)
-        perror("Error while loading patch!");
-    f.close();
+    auto avail = f.size() - sizeof(fxp);
+    if (cs < 0 || (size_t)cs > avail)
+    {
+        std::cout << "Error while loading patch! Chunk of " << cs << " bytes but only " << avail
+                  << " in file" << std::endl;
+        cs = (int)avail;
+    }
+
+    /*
+     * With the patch cache on, a patch compiled on an earlier load skips its XML; the wavetables
+     * still come from the file. Otherwise it is compiled as it loads, for cachePreparedPatch.
+     */
+    into.sourcePath = string_to_path(fxpPath);
+    if (useCache && storage.patchCache &&
+        storage.patchCache->lookup(into.sourcePath, storage.getPatch(), into.compiled))
+    {
+        SurgePatch::prepare_patch(f.data() + sizeof(fxp), cs, into, false);
+        return true;
+    }
+
+    into.compileOnLoad = storage.patchCache != nullptr;
+    SurgePatch::prepare_patch(f.data() + sizeof(fxp), cs, into);
+    return true;
+}
+
+void SurgeSynthesizer::cachePreparedPatch(PreparedPatch &pp)
+{
+    if (storage.patchCache && pp.compileOnLoad && !pp.compiled.empty())
+        storage.patchCache->store(pp.sourcePath, pp.compiled);
+}
 
+void SurgeSynthesizer::loadPreparedPatch(PreparedPatch &pp, int categoryId, const char *patchName,
+                                         Surge::Storage::PreparedEffects *prebuiltFx)
+{
     storage.getPatch().comment = "";
     storage.getPatch().author = "";
     if (categoryId >= 0)
@@ -263,9 +316,11 @@ bool SurgeSynthesizer::loadPatchByPath(const char *fxpPath, int categoryId, cons
     current_category_id = categoryId;
     storage.getPatch().name = patchName;
 
-    loadRaw(data.get(), cs, true);
-    data.reset();
+    loadPreparedRaw(pp, true, prebuiltFx);
+}
 
+void SurgeSynthesizer::applyPatchTuning()
+{
     /*
     ** OK so at this point we may have loaded a patch with a tuning override
     */
@@ -349,13 +404,6 @@ bool SurgeSynthesizer::loadPatchByPath(const char *fxpPath, int categoryId, cons
             }
         }
     }
-
-    masterfade = 1.f;
-    /*
-    ** Notify the host display that the patch name has changed
-    */
-    updateDisplay();
-    return true;
 }
 
 void SurgeSynthesizer::enqueuePatchForLoad(void *data, int size)
@@ -393,6 +441,14 @@ void SurgeSynthesizer::processEnqueuedPatchIfNeeded()
 }
 
 void SurgeSynthesizer::loadRaw(const void *data, int size, bool preset)
+{
+    PreparedPatch pp;
+    SurgePatch::prepare_patch(data, size, pp);
+    loadPreparedRaw(pp, preset);
+}
+
+void SurgeSynthesizer::loadPreparedRaw(PreparedPatch &pp, bool preset,
+                                       Surge::Storage::PreparedEffects *prebuiltFx)
 {
     halt_engine = true;
     allNotesOff();
@@ -400,8 +456,24 @@ void SurgeSynthesizer::loadRaw(const void *data, int size, bool preset)
         for (int i = 0; i < n_customcontrollers; i++)
             storage.getPatch().scene[s].modsources[ms_ctrl1 + i]->reset();
 
+    if (storage.wavetableLoader)
+        storage.wavetableLoader->discardPendingLoads();
+
     storage.getPatch().init_default_values();
-    storage.getPatch().load_patch(data, size, preset);
+    if (!storage.getPatch().load_prepared(pp, preset))
+    {
+        /*
+         * PatchCache::lookup only hands out entries this build can load, so this is a compiled
+         * chunk from somewhere else. The engine is held, so we don't go back to a file here;
+         * the patch stays at its defaults and nothing is cached from it.
+         */
+        pp.compiled.clear();
+        pp.compileOnLoad = false;
+        storage.reportError("This patch was saved in a compiled form which this version of "
+                            "Surge XT can't read, so it has been reset to the default patch.",
+                            "Patch Load Error");
+    }
+    storage.getPatch().rebuildModulationTables();
     storage.getPatch().update_controls(false, nullptr, true);
     for (int i = 0; i < n_fx_slots; i++)
     {
@@ -409,7 +481,7 @@ void SurgeSynthesizer::loadRaw(const void *data, int size, bool preset)
         fx_reload[i] = true;
     }
 
-    loadFx(false, true);
+    loadFx(false, true, prebuiltFx);
 
     for (int sc = 0; sc < n_scenes; sc++)
     {
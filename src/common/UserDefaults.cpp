@@ -5,6 +5,7 @@
 #include <iostream>
 #include <iomanip>
 #include <map>
+#include <mutex>
 #include <sstream>
 #include <fstream>
 
@@ -141,6 +142,15 @@ void initMaps()
             case LastWavetablePath:
                 r = "lastWavetablePath";
                 break;
+            case MultithreadedSceneRendering:
+                r = "multithreadedSceneRendering";
+                break;
+            case MultithreadedVoiceRendering:
+                r = "multithreadedVoiceRendering";
+                break;
+            case UseCompiledPatchCache:
+                r = "useCompiledPatchCache";
+                break;
             case nKeys:
                 break;
             }
@@ -155,6 +165,13 @@ void initMaps()
 std::map<DefaultKey, UserDefaultValue> defaultsFileContents;
 bool haveReadDefaultsFile = false;
 
+/*
+** Every storage in the process shares the maps above, and storages get built on several
+** threads at once (headless batch renders, surgepy farms), so the functions from the header
+** hold this. It's recursive since reportError can come back round to ask for a default.
+*/
+std::recursive_mutex defaultsMutex;
+
 std::string defaultsFileName(SurgeStorage *storage)
 {
     std::string fn = storage->userDefaultFilePath + PATH_SEPARATOR + "SurgeXTUserDefaults.xml";
@@ -216,6 +233,8 @@ void readDefaultsFile(std::string fn, bool forceRead, SurgeStorage *storage)
 bool storeUserDefaultValue(SurgeStorage *storage, const DefaultKey &key, const std::string &val,
                            UserDefaultValue::ValueType type)
 {
+    std::lock_guard<std::recursive_mutex> g(defaultsMutex);
+
     // Re-read the file in case another surge has updated it
     readDefaultsFile(defaultsFileName(storage), true, storage);
 
@@ -275,6 +294,7 @@ std::string getUserDefaultValue(SurgeStorage *storage, const DefaultKey &key,
         return storage->userPrefOverrides[key].second;
     }
 
+    std::lock_guard<std::recursive_mutex> g(defaultsMutex);
     readDefaultsFile(defaultsFileName(storage), false, storage);
 
     if (defaultsFileContents.find(key) != defaultsFileContents.end())
@@ -297,6 +317,7 @@ int getUserDefaultValue(SurgeStorage *storage, const DefaultKey &key, int valueI
         return storage->userPrefOverrides[key].first;
     }
 
+    std::lock_guard<std::recursive_mutex> g(defaultsMutex);
     readDefaultsFile(defaultsFileName(storage), false, storage);
 
     if (defaultsFileContents.find(key) != defaultsFileContents.end())
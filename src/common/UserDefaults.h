@@ -56,6 +56,11 @@ enum DefaultKey // streamed as strings so feel free to change the order to whate
     LastWavetablePath,
     LastPatchPath,
 
+    MultithreadedSceneRendering,
+    MultithreadedVoiceRendering,
+
+    UseCompiledPatchCache,
+
     nKeys
 };
 /**
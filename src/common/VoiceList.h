@@ -0,0 +1,73 @@
+/*
+** Surge Synthesizer is Free and Open Source Software
+**
+** Surge is made available under the Gnu General Public License, v3.0
+** https://www.gnu.org/licenses/gpl-3.0.en.html
+**
+** Copyright 2004-2021 by various individuals as described by the Git transaction log
+**
+** All source at: https://github.com/surge-synthesizer/surge.git
+**
+** Surge was a commercial product from 2004-2018, with Copyright and ownership
+** in that period held by Claes Johanson at Vember Audio. Claes made Surge
+** open source in September 2018.
+*/
+
+#ifndef SURGE_XT_VOICELIST_H
+#define SURGE_XT_VOICELIST_H
+
+#include "globals.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+
+class SurgeVoice;
+
+/*
+ * A scene's playing voices, oldest first, in a fixed array of MAX_VOICES pointers.
+ *
+ * This has the parts of the std::list interface the synth uses, so voices come and go without
+ * touching the heap and walking them is a walk along one small array. erase() moves the later
+ * pointers down to keep the order, which at these sizes is cheaper than chasing list nodes. To
+ * drop several voices in one pass, copy the keepers forward and erase the tail in one go.
+ */
+class VoiceList
+{
+  public:
+    typedef SurgeVoice **iterator;
+    typedef SurgeVoice *const *const_iterator;
+
+    iterator begin() { return voices; }
+    iterator end() { return voices + n; }
+    const_iterator begin() const { return voices; }
+    const_iterator end() const { return voices + n; }
+
+    size_t size() const { return n; }
+    bool empty() const { return n == 0; }
+    SurgeVoice *front() const { return voices[0]; }
+
+    // Each scene only ever has MAX_VOICES voices to hand out, so this can't overflow
+    void push_back(SurgeVoice *v)
+    {
+        assert(n < MAX_VOICES);
+        if (n < MAX_VOICES)
+            voices[n++] = v;
+    }
+
+    iterator erase(iterator it) { return erase(it, it + 1); }
+    iterator erase(iterator first, iterator last)
+    {
+        auto e = std::move(last, end(), first);
+        n = (int)(e - voices);
+        return first;
+    }
+
+    void clear() { n = 0; }
+
+  private:
+    SurgeVoice *voices[MAX_VOICES];
+    int n = 0;
+};
+
+#endif // SURGE_XT_VOICELIST_H
@@ -0,0 +1,171 @@
+/*
+** Surge Synthesizer is Free and Open Source Software
+**
+** Surge is made available under the Gnu General Public License, v3.0
+** https://www.gnu.org/licenses/gpl-3.0.en.html
+**
+** Copyright 2004-2021 by various individuals as described by the Git transaction log
+**
+** All source at: https://github.com/surge-synthesizer/surge.git
+**
+** Surge was a commercial product from 2004-2018, with Copyright and ownership
+** in that period held by Claes Johanson at Vember Audio. Claes made Surge
+** open source in September 2018.
+*/
+
+#include "WavetableLoader.h"
+
+#include <cstring>
+
+namespace Surge
+{
+namespace Storage
+{
+WavetableLoader::WavetableLoader(SurgeStorage *storage, ServiceThread *service)
+    : storage(storage), serviceThread(service)
+{
+    serviceThread->setHandler(ServiceThread::wavetableLoad, [this]() { return this->service(); });
+}
+
+bool WavetableLoader::requestLoad(int s, int o, int id, const char *filename)
+{
+    auto &slot = slots[s][o];
+    if (slot.state.load(std::memory_order_acquire) != idle)
+        return false;
+
+    slot.epoch = epoch;
+    slot.id = id;
+    slot.filename[0] = 0;
+    if (filename)
+    {
+        strncpy(slot.filename, filename, sizeof(slot.filename) - 1);
+        slot.filename[sizeof(slot.filename) - 1] = 0;
+    }
+    slot.state.store(requested, std::memory_order_release);
+    serviceThread->post(ServiceThread::wavetableLoad);
+    return true;
+}
+
+void WavetableLoader::swapCompletedLoads()
+{
+    bool retiredAny = false;
+    for (int s = 0; s < n_scenes; ++s)
+    {
+        for (int o = 0; o < n_oscs; ++o)
+        {
+            auto &slot = slots[s][o];
+            if (slot.state.load(std::memory_order_acquire) != ready)
+                continue;
+
+            if (slot.epoch == epoch)
+            {
+                if (!storage->waveTableDataMutex.try_lock())
+                    continue;
+
+                auto &osc = storage->getPatch().scene[s].osc[o];
+                if (slot.table->everBuilt)
+                    osc.wt.SwapDataWith(slot.table.get());
+                if (slot.displayName[0])
+                    strncpy(osc.wavetable_display_name, slot.displayName, 256);
+                osc.wt.current_id = slot.current_id;
+                osc.wt.refresh_display = true;
+
+                storage->waveTableDataMutex.unlock();
+            }
+
+            // The slot's table now holds whatever the oscillator was playing before
+            slot.state.store(retired, std::memory_order_release);
+            retiredAny = true;
+        }
+    }
+
+    if (retiredAny)
+        serviceThread->post(ServiceThread::wavetableLoad);
+}
+
+bool WavetableLoader::hasPendingLoads() const
+{
+    for (int s = 0; s < n_scenes; ++s)
+        for (int o = 0; o < n_oscs; ++o)
+        {
+            auto st = slots[s][o].state.load(std::memory_order_acquire);
+            if (st == requested || st == loading || st == ready)
+                return true;
+        }
+    return false;
+}
+
+bool WavetableLoader::service()
+{
+    bool didWork = false;
+    for (int s = 0; s < n_scenes; ++s)
+    {
+        for (int o = 0; o < n_oscs; ++o)
+        {
+            auto &slot = slots[s][o];
+            auto st = slot.state.load(std::memory_order_acquire);
+            if (st == requested)
+            {
+                slot.state.store(loading, std::memory_order_relaxed);
+                buildTable(slot);
+                slot.state.store(ready, std::memory_order_release);
+                didWork = true;
+            }
+            else if (st == retired)
+            {
+                slot.table.reset();
+                slot.state.store(idle, std::memory_order_release);
+                didWork = true;
+            }
+        }
+    }
+    return didWork;
+}
+
+void WavetableLoader::buildTable(Slot &slot)
+{
+    slot.table = std::make_unique<Wavetable>();
+    slot.displayName[0] = 0;
+    auto wt = slot.table.get();
+
+    if (slot.id >= 0)
+    {
+        // As SurgeStorage::load_wt(int, ...), which names the oscillator even if the load fails
+        slot.current_id = slot.id;
+        storage->load_wt(slot.id, wt, nullptr);
+
+        std::string name;
+        if (storage->wt_list.empty() && slot.id == 0)
+            name = "Sin to Saw";
+        else if (slot.id < (int)storage->wt_list.size())
+            name = storage->wt_list[slot.id].name;
+        strncpy(slot.displayName, name.c_str(), sizeof(slot.displayName) - 1);
+        slot.displayName[sizeof(slot.displayName) - 1] = 0;
+    }
+    else
+    {
+        std::string fn = slot.filename;
+
+        int wtidx = -1, ct = 0;
+        for (const auto &wti : storage->wt_list)
+        {
+            if (path_to_string(wti.path) == fn)
+                wtidx = ct;
+            ct++;
+        }
+        slot.current_id = wtidx;
+
+        storage->load_wt(fn, wt, nullptr);
+
+        if (wt->everBuilt)
+        {
+            auto stem = fn.substr(fn.find_last_of(PATH_SEPARATOR) + 1, fn.npos);
+            stem = stem.substr(0, stem.find_last_of('.'));
+            strncpy(slot.displayName, stem.c_str(), sizeof(slot.displayName) - 1);
+            slot.displayName[sizeof(slot.displayName) - 1] = 0;
+        }
+    }
+}
+
+} // namespace Storage
+} // namespace Surge
@@ -0,0 +1,108 @@
+/*
+** Surge Synthesizer is Free and Open Source Software
+**
+** Surge is made available under the Gnu General Public License, v3.0
+** https://www.gnu.org/licenses/gpl-3.0.en.html
+**
+** Copyright 2004-2021 by various individuals as described by the Git transaction log
+**
+** All source at: https://github.com/surge-synthesizer/surge.git
+**
+** Surge was a commercial product from 2004-2018, with Copyright and ownership
+** in that period held by Claes Johanson at Vember Audio. Claes made Surge
+** open source in September 2018.
+*/
+
+#ifndef SURGE_XT_WAVETABLELOADER_H
+#define SURGE_XT_WAVETABLELOADER_H
+
+#include "SurgeStorage.h"
+#include "ServiceThread.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+namespace Surge
+{
+namespace Storage
+{
+/*
+ * WavetableLoader moves wavetable file loading off the audio thread.
+ *
+ * perform_queued_wtloads used to read, parse and mipmap wavetables right inside processControl.
+ * With the loader running, the audio thread instead hands each queued load to the service
+ * thread, which builds a complete Wavetable on the side. Once it is ready the audio thread swaps
+ * the data pointers of the finished table into the oscillator's Wavetable, and hands the old
+ * buffers back to the service thread to be freed.
+ *
+ * There is one slot per oscillator, and each slot moves through
+ *
+ *     idle -> requested -> loading -> ready -> retired -> idle
+ *
+ * where only the audio thread makes the idle->requested and ready->retired transitions and
+ * only the service thread makes the others, so a slot is only ever touched by whichever thread
+ * owns its current state. If an oscillator queues another load while its slot is busy, the
+ * request stays queued on the oscillator and is picked up a few blocks later, so the last
+ * request always wins.
+ */
+class WavetableLoader
+{
+  public:
+    WavetableLoader(SurgeStorage *storage, ServiceThread *service);
+
+    /*
+     * Audio thread. Ask for wavetable id (if >= 0) or the file at filename to be loaded into
+     * scene s oscillator o. Returns false if that oscillator already has a load in flight.
+     */
+    bool requestLoad(int s, int o, int id, const char *filename);
+
+    /*
+     * Audio thread. Swap every finished table into the patch. If the UI holds the wavetable
+     * data lock we simply try again next block rather than wait for it.
+     */
+    void swapCompletedLoads();
+
+    /*
+     * Any thread. Loads which are in flight when a new patch arrives are thrown away rather
+     * than swapped over the top of the wavetables the patch brought with it.
+     */
+    void discardPendingLoads() { epoch++; }
+
+    bool hasPendingLoads() const;
+
+  private:
+    enum SlotState
+    {
+        idle,
+        requested,
+        loading,
+        ready,
+        retired
+    };
+
+    struct Slot
+    {
+        std::atomic<int> state{idle};
+        uint32_t epoch{0};
+
+        int id{-1};
+        char filename[256];
+
+        std::unique_ptr<Wavetable> table;
+        int current_id{-1};
+        char displayName[256];
+    };
+
+    bool service();
+    void buildTable(Slot &slot);
+
+    SurgeStorage *storage;
+    ServiceThread *serviceThread;
+    Slot slots[n_scenes][n_oscs];
+    std::atomic<uint32_t> epoch{0};
+};
+} // namespace Storage
+} // namespace Surge
+
+#endif // SURGE_XT_WAVETABLELOADER_H
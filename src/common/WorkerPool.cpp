@@ -0,0 +1,134 @@
+/*
+** Surge Synthesizer is Free and Open Source Software
+**
+** Surge is made available under the Gnu General Public License, v3.0
+** https://www.gnu.org/licenses/gpl-3.0.en.html
+**
+** Copyright 2004-2021 by various individuals as described by the Git transaction log
+**
+** All source at: https://github.com/surge-synthesizer/surge.git
+**
+** Surge was a commercial product from 2004-2018, with Copyright and ownership
+** in that period held by Claes Johanson at Vember Audio. Claes made Surge
+** open source in September 2018.
+*/
+
+#include "WorkerPool.h"
+#include "globals.h"
+
+namespace Surge
+{
+namespace Threading
+{
+// How many times an idle worker checks for new work before it goes to sleep. At 48k a
+// 32 sample block is ~670us, so this keeps workers hot across consecutive blocks
+// without pinning a core when the synth is idle.
+static constexpr int spinYieldsBeforeSleep = 1024;
+
+WorkerPool::WorkerPool(int nWorkers)
+{
+    for (int i = 0; i < nWorkers; ++i)
+    {
+        workers.emplace_back([this]() { this->workerLoop(); });
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    keepRunning = false;
+    {
+        std::lock_guard<std::mutex> g(sleepMutex);
+        sleepCV.notify_all();
+    }
+    for (auto &t : workers)
+    {
+        if (t.joinable())
+            t.join();
+    }
+}
+
+bool WorkerPool::claimAndRunJob(bool onWorker)
+{
+    auto w = claimWord.load(std::memory_order_acquire);
+    while (hasClaimableJob(w))
+    {
+        if (claimWord.compare_exchange_weak(w, w + 1, std::memory_order_acq_rel,
+                                            std::memory_order_acquire))
+        {
+#ifndef ARM_NEON
+            if (onWorker)
+                _mm_setcsr(callerFPUState);
+#endif
+            currentJob(currentCtx, (int)(w & indexMask));
+            jobsDone.fetch_add(1, std::memory_order_release);
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkerPool::runAndJoin(job_t job, void *ctx, int nJobs)
+{
+    if (nJobs <= 0)
+        return;
+
+    if (workers.empty())
+    {
+        for (int i = 0; i < nJobs; ++i)
+            job(ctx, i);
+        return;
+    }
+
+    currentJob = job;
+    currentCtx = ctx;
+#ifndef ARM_NEON
+    callerFPUState = _mm_getcsr();
+#endif
+    jobsDone.store(0, std::memory_order_relaxed);
+
+    uint64_t gen = ((claimWord.load(std::memory_order_relaxed) >> genShift) + 1) & 0xFFFFFFFF;
+    claimWord.store((gen << genShift) | ((uint64_t)nJobs << countShift));
+
+    if (sleepers.load() > 0)
+    {
+        std::lock_guard<std::mutex> g(sleepMutex);
+        sleepCV.notify_all();
+    }
+
+    while (claimAndRunJob(false))
+        ;
+
+    // Everything left is already running on a worker so this wait is bounded by one job
+    while (jobsDone.load(std::memory_order_acquire) < nJobs)
+        ;
+}
+
+void WorkerPool::workerLoop()
+{
+    while (keepRunning)
+    {
+        if (claimAndRunJob(true))
+            continue;
+
+        bool found = false;
+        for (int i = 0; i < spinYieldsBeforeSleep && keepRunning; ++i)
+        {
+            if (hasClaimableJob(claimWord.load(std::memory_order_acquire)))
+            {
+                found = true;
+                break;
+            }
+            std::this_thread::yield();
+        }
+        if (found)
+            continue;
+
+        std::unique_lock<std::mutex> lk(sleepMutex);
+        sleepers++;
+        sleepCV.wait(lk, [this]() { return !keepRunning || hasClaimableJob(claimWord.load()); });
+        sleepers--;
+    }
+}
+
+} // namespace Threading
+} // namespace Surge
@@ -0,0 +1,92 @@
+/*
+** Surge Synthesizer is Free and Open Source Software
+**
+** Surge is made available under the Gnu General Public License, v3.0
+** https://www.gnu.org/licenses/gpl-3.0.en.html
+**
+** Copyright 2004-2021 by various individuals as described by the Git transaction log
+**
+** All source at: https://github.com/surge-synthesizer/surge.git
+**
+** Surge was a commercial product from 2004-2018, with Copyright and ownership
+** in that period held by Claes Johanson at Vember Audio. Claes made Surge
+** open source in September 2018.
+*/
+
+#ifndef SURGE_XT_WORKERPOOL_H
+#define SURGE_XT_WORKERPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Surge
+{
+namespace Threading
+{
+/*
+ * WorkerPool is a small set of persistent threads which the audio thread can hand a
+ * batch of jobs to and then join on. It is built for the case where we have a handful
+ * of coarse grained, independent pieces of work per block (like rendering scene A and
+ * scene B) and want them on separate cores.
+ *
+ * The rules which make it safe to call from the audio thread are
+ *
+ * - the threads are created in the constructor and never on the render path
+ * - runAndJoin never allocates and never blocks waiting for a worker to *start*; the
+ *   calling thread claims jobs too, so if every worker is asleep or descheduled the
+ *   batch simply runs serially on the caller
+ * - the only lock the caller ever touches is the one used to wake sleeping workers,
+ *   which the workers hold just long enough to go to sleep
+ *
+ * Jobs are claimed through a single 64 bit word holding (generation, count, next index)
+ * so a worker can never run a job from a batch other than the one it claimed from.
+ * Workers copy the caller's floating point control state before running a job so the
+ * results are bit identical to running the batch serially on the audio thread.
+ */
+class WorkerPool
+{
+  public:
+    typedef void (*job_t)(void *ctx, int index);
+
+    explicit WorkerPool(int nWorkers);
+    ~WorkerPool();
+
+    /*
+     * Run job(ctx, i) for i in [0, nJobs) and return once all of them are complete.
+     * nJobs must be less than 65536.
+     */
+    void runAndJoin(job_t job, void *ctx, int nJobs);
+
+    int getNumWorkers() const { return (int)workers.size(); }
+
+  private:
+    static constexpr uint64_t indexMask = 0xFFFF, countShift = 16, genShift = 32;
+
+    void workerLoop();
+    bool hasClaimableJob(uint64_t w) const
+    {
+        return (w & indexMask) < ((w >> countShift) & indexMask);
+    }
+    bool claimAndRunJob(bool onWorker);
+
+    std::vector<std::thread> workers;
+
+    std::atomic<uint64_t> claimWord{0};
+    std::atomic<int> jobsDone{0};
+    job_t currentJob{nullptr};
+    void *currentCtx{nullptr};
+    unsigned int callerFPUState{0};
+
+    std::atomic<bool> keepRunning{true};
+    std::atomic<int> sleepers{0};
+    std::mutex sleepMutex;
+    std::condition_variable sleepCV;
+};
+} // namespace Threading
+} // namespace Surge
+
+#endif // SURGE_XT_WORKERPOOL_H
@@ -23,68 +23,110 @@
 #include "chowdsp/ExciterEffect.h"
 #include "chowdsp/TapeEffect.h"
 #include "DebugHelpers.h"
+#include "BlockProfiler.h"
+#include <new>
+#include <type_traits>
 
 using namespace std;
 
+// Every effect type and the class which implements it
+#define SURGE_EFFECT_TYPES(X)                                                                      \
+    X(fxt_delay, DelayEffect)                                                                      \
+    X(fxt_eq, ParametricEQ3BandEffect)                                                             \
+    X(fxt_phaser, PhaserEffect)                                                                    \
+    X(fxt_rotaryspeaker, RotarySpeakerEffect)                                                      \
+    X(fxt_distortion, DistortionEffect)                                                            \
+    X(fxt_reverb, Reverb1Effect)                                                                   \
+    X(fxt_reverb2, Reverb2Effect)                                                                  \
+    X(fxt_freqshift, FrequencyShifterEffect)                                                       \
+    X(fxt_conditioner, ConditionerEffect)                                                          \
+    X(fxt_chorus4, ChorusEffect<4>)                                                                \
+    X(fxt_vocoder, VocoderEffect)                                                                  \
+    X(fxt_flanger, FlangerEffect)                                                                  \
+    X(fxt_ringmod, RingModulatorEffect)                                                            \
+    X(fxt_airwindows, AirWindowsEffect)                                                            \
+    X(fxt_neuron, chowdsp::NeuronEffect)                                                           \
+    X(fxt_geq11, GraphicEQ11BandEffect)                                                            \
+    X(fxt_resonator, ResonatorEffect)                                                              \
+    X(fxt_combulator, CombulatorEffect)                                                            \
+    X(fxt_chow, chowdsp::CHOWEffect)                                                               \
+    X(fxt_nimbus, NimbusEffect)                                                                    \
+    X(fxt_exciter, chowdsp::ExciterEffect)                                                         \
+    X(fxt_tape, chowdsp::TapeEffect)                                                               \
+    X(fxt_ensemble, BBDEnsembleEffect)                                                             \
+    X(fxt_treemonster, TreemonsterEffect)
+
 Effect *spawn_effect(int id, SurgeStorage *storage, FxStorage *fxdata, pdata *pd)
 {
     // std::cout << "Spawn Effect " << _D(id) << std::endl;
     // Surge::Debug::stackTraceToStdout(7);
     switch (id)
     {
-    case fxt_delay:
-        return new DelayEffect(storage, fxdata, pd);
-    case fxt_eq:
-        return new ParametricEQ3BandEffect(storage, fxdata, pd);
-    case fxt_phaser:
-        return new PhaserEffect(storage, fxdata, pd);
-    case fxt_rotaryspeaker:
-        return new RotarySpeakerEffect(storage, fxdata, pd);
-    case fxt_distortion:
-        return new DistortionEffect(storage, fxdata, pd);
-    case fxt_reverb:
-        return new Reverb1Effect(storage, fxdata, pd);
-    case fxt_reverb2:
-        return new Reverb2Effect(storage, fxdata, pd);
-    case fxt_freqshift:
-        return new FrequencyShifterEffect(storage, fxdata, pd);
-    case fxt_conditioner:
-        return new ConditionerEffect(storage, fxdata, pd);
-    case fxt_chorus4:
-        return new ChorusEffect<4>(storage, fxdata, pd);
-    case fxt_vocoder:
-        return new VocoderEffect(storage, fxdata, pd);
-    case fxt_flanger:
-        return new FlangerEffect(storage, fxdata, pd);
-    case fxt_ringmod:
-        return new RingModulatorEffect(storage, fxdata, pd);
-    case fxt_airwindows:
-        return new AirWindowsEffect(storage, fxdata, pd);
-    case fxt_neuron:
-        return new chowdsp::NeuronEffect(storage, fxdata, pd);
-    case fxt_geq11:
-        return new GraphicEQ11BandEffect(storage, fxdata, pd);
-    case fxt_resonator:
-        return new ResonatorEffect(storage, fxdata, pd);
-    case fxt_combulator:
-        return new CombulatorEffect(storage, fxdata, pd);
-    case fxt_chow:
-        return new chowdsp::CHOWEffect(storage, fxdata, pd);
-    case fxt_nimbus:
-        return new NimbusEffect(storage, fxdata, pd);
-    case fxt_exciter:
-        return new chowdsp::ExciterEffect(storage, fxdata, pd);
-    case fxt_tape:
-        return new chowdsp::TapeEffect(storage, fxdata, pd);
-    case fxt_ensemble:
-        return new BBDEnsembleEffect(storage, fxdata, pd);
-    case fxt_treemonster:
-        return new TreemonsterEffect(storage, fxdata, pd);
+#define X(t, cls)                                                                                  \
+    case t:                                                                                        \
+        return new cls(storage, fxdata, pd);
+        SURGE_EFFECT_TYPES(X)
+#undef X
     default:
         return 0;
     };
 }
 
+size_t effect_size(int id)
+{
+    switch (id)
+    {
+#define X(t, cls)                                                                                  \
+    case t:                                                                                        \
+        return sizeof(cls);
+        SURGE_EFFECT_TYPES(X)
+#undef X
+    default:
+        return 0;
+    };
+}
+
+Effect *spawn_effect(int id, SurgeStorage *storage, FxStorage *fxdata, pdata *pd, void *onto)
+{
+    switch (id)
+    {
+#define X(t, cls)                                                                                  \
+    case t:                                                                                        \
+        return new (onto) cls(storage, fxdata, pd);
+        SURGE_EFFECT_TYPES(X)
+#undef X
+    default:
+        return 0;
+    };
+}
+
+typedef std::aligned_storage<16, 16>::type effect_slab_unit_t;
+
+Effect *spawn_effect_in_slab(int id, SurgeStorage *storage, FxStorage *fxdata, pdata *pd)
+{
+    auto sz = effect_size(id);
+    if (sz == 0)
+        return nullptr;
+
+    auto units = (sz + sizeof(effect_slab_unit_t) - 1) / sizeof(effect_slab_unit_t);
+    auto slab = new effect_slab_unit_t[units];
+
+    // Writing the whole slab pages it in now, rather than when init() clears the delay lines
+    memset((void *)slab, 0, units * sizeof(effect_slab_unit_t));
+    return spawn_effect(id, storage, fxdata, pd, slab);
+}
+
+void EffectSlabDeleter::operator()(Effect *e) const
+{
+    if (!e)
+        return;
+
+    // The most derived object sits at the start of the slab
+    auto slab = static_cast<effect_slab_unit_t *>(dynamic_cast<void *>(e));
+    e->~Effect();
+    delete[] slab;
+}
+
 Effect::Effect(SurgeStorage *storage, FxStorage *fxdata, pdata *pd)
 {
     // assert(storage);
@@ -102,8 +144,29 @@ Effect::Effect(SurgeStorage *storage, FxStorage *fxdata, pdata *pd)
     }
 }
 
+void Effect::rebind(FxStorage *fxdata, pdata *pd)
+{
+    this->fxdata = fxdata;
+    this->pd = pd;
+    if (pd)
+    {
+        for (int i = 0; i < n_fx_params; i++)
+        {
+            f[i] = &pd[fxdata->p[i].id].f;
+            pdata_ival[i] = &pd[fxdata->p[i].id].i;
+        }
+    }
+}
+
 bool Effect::process_ringout(float *dataL, float *dataR, bool indata_present)
 {
+#if SURGE_BLOCK_PROFILING
+    // Live effects run on the patch's own FxStorage, so that tells us the slot
+    auto slot = storage ? fxdata - storage->getPatch().fx : -1;
+    SURGE_PROFILE_SCOPE(slot >= 0 && slot < n_fx_slots ? storage : nullptr,
+                        Surge::Profiling::BlockProfiler::st_fx + (int)slot);
+#endif
+
     if (indata_present)
         ringout = 0;
     else
@@ -31,6 +31,9 @@ class alignas(16) Effect
     Effect(SurgeStorage *storage, FxStorage *fxdata, pdata *pd);
     virtual ~Effect() { return; }
 
+    // Point the effect at different parameter storage, with the same ids
+    void rebind(FxStorage *fxdata, pdata *pd);
+
     virtual const char *get_effectname() { return 0; }
 
     virtual void init(){};
@@ -92,3 +95,20 @@ const int slowrate = 8;
 const int slowrate_m1 = slowrate - 1;
 
 Effect *spawn_effect(int id, SurgeStorage *storage, FxStorage *fxdata, pdata *pd);
+
+/*
+ * Effects can also be constructed into memory the caller provides, the same way spawn_osc builds
+ * oscillators into a voice's oscbuffer. onto has to be 16 byte aligned and hold effect_size(id)
+ * bytes. The sizes run from under a kilobyte to several megabytes, so rather than one worst case
+ * buffer per slot, spawn_effect_in_slab allocates a right-sized slab, pages it in and builds the
+ * effect there. That is the part we keep off the audio thread (see EffectPreparer), and
+ * EffectSlabDeleter is what undoes it.
+ */
+size_t effect_size(int id);
+Effect *spawn_effect(int id, SurgeStorage *storage, FxStorage *fxdata, pdata *pd, void *onto);
+Effect *spawn_effect_in_slab(int id, SurgeStorage *storage, FxStorage *fxdata, pdata *pd);
+
+struct EffectSlabDeleter
+{
+    void operator()(Effect *e) const;
+};
@@ -16,6 +16,9 @@
 #include "SurgeVoice.h"
 #include "DSPUtils.h"
 #include "QuadFilterChain.h"
+#include "BlockProfiler.h"
+#include <algorithm>
+#include <initializer_list>
 #include <math.h>
 #include "libMTSClient.h"
 
@@ -367,6 +370,12 @@ void SurgeVoice::switch_toggled()
     {
         if (osctype[i] != scene->osc[i].type.val.i)
         {
+            // calc_ctrldata may have been skipping this oscillator, but init reads its parameters
+            if (!(snapshotOscMask & (1 << i)))
+                copySnapshotRange(scene->osc[i].type.param_id_in_scene,
+                                  scene->osc[i].retrigger.param_id_in_scene -
+                                      scene->osc[i].type.param_id_in_scene + 1);
+
             bool nzid = scene->drift.extend_range;
             osc[i] = spawn_osc(scene->osc[i].type.val.i, storage, &scene->osc[i], localcopy,
                                oscbuffer[i]);
@@ -436,6 +445,12 @@ void SurgeVoice::switch_toggled()
         set_path(use_osc1, use_osc2, use_osc3, FM, use_ring12, use_ring23, use_noise);
     }
 
+    int oscMask = 0;
+    for (int i = 0; i < n_oscs; i++)
+        if (oscIsProcessed(i))
+            oscMask |= 1 << i;
+    updateSnapshotPlan(oscMask, currentLFOMask());
+
     // check the filtertype
     for (int u = 0; u < n_filterunits_per_scene; u++)
     {
@@ -544,8 +559,125 @@ int SurgeVoice::routefilter(int r)
     return r;
 }
 
+void SurgeVoice::copySnapshotRange(int start, int count)
+{
+    memcpy(&localcopy[start], &paramptr[start], count * sizeof(pdata));
+}
+
+int SurgeVoice::snapshotParamCount() const
+{
+    int res = 0;
+    for (int i = 0; i < n_snapshotRanges; i++)
+        res += snapshotRanges[i].count;
+    return res;
+}
+
+int SurgeVoice::currentLFOMask() const
+{
+    // LFO 1 is always processed, see calc_ctrldata
+    int mask = 1;
+    for (int i = 1; i < n_lfos_voice; i++)
+        if (scene->modsource_doprocess[ms_lfo1 + i])
+            mask |= 1 << i;
+    return mask;
+}
+
+void SurgeVoice::updateSnapshotPlan(int oscMask, int lfoMask)
+{
+    bool reads[n_scene_params] = {};
+    auto mark = [&reads](std::initializer_list<const Parameter *> ps) {
+        for (auto p : ps)
+            reads[p->param_id_in_scene] = true;
+    };
+    // Every id from the lowest to the highest of ps, in case a unit's parameters interleave
+    auto markSpan = [&reads](std::initializer_list<const Parameter *> ps) {
+        int lo = n_scene_params, hi = -1;
+        for (auto p : ps)
+        {
+            lo = std::min(lo, p->param_id_in_scene);
+            hi = std::max(hi, p->param_id_in_scene);
+        }
+        for (int i = lo; i <= hi; i++)
+            reads[i] = true;
+    };
+
+    // What process_block, SetQFB and the portamento read from localcopy
+    mark({&scene->pitch, &scene->octave, &scene->fm_depth, &scene->drift, &scene->noise_colour,
+          &scene->level_o1, &scene->level_o2, &scene->level_o3, &scene->level_noise,
+          &scene->level_ring_12, &scene->level_ring_23, &scene->level_pfg, &scene->vca_level,
+          &scene->vca_velsense, &scene->portamento, &scene->volume, &scene->pan, &scene->width,
+          &scene->feedback, &scene->filter_balance, &scene->wsunit.drive});
+    for (auto &fu : scene->filterunit)
+        mark({&fu.cutoff, &fu.resonance, &fu.envmod, &fu.keytrack});
+
+    // The envelopes, the oscillators we run and the voice LFOs we process read their own units
+    for (auto &a : scene->adsr)
+        markSpan({&a.a, &a.d, &a.s, &a.r, &a.a_s, &a.d_s, &a.r_s, &a.mode});
+    for (int i = 0; i < n_oscs; i++)
+    {
+        if (oscMask & (1 << i))
+        {
+            auto &o = scene->osc[i];
+            for (int j = o.type.param_id_in_scene; j <= o.retrigger.param_id_in_scene; j++)
+                reads[j] = true;
+        }
+    }
+    for (int i = 0; i < n_lfos_voice; i++)
+    {
+        if (lfoMask & (1 << i))
+        {
+            auto &l = scene->lfo[i];
+            markSpan({&l.rate, &l.shape, &l.start_phase, &l.magnitude, &l.deform, &l.trigmode,
+                      &l.unipolar, &l.delay, &l.hold, &l.attack, &l.decay, &l.sustain,
+                      &l.release});
+        }
+    }
+
+    n_snapshotRanges = 0;
+    for (int i = 0; i < n_scene_params; i++)
+    {
+        if (!reads[i])
+            continue;
+        int start = i;
+        while (i < n_scene_params && reads[i])
+            i++;
+        snapshotRanges[n_snapshotRanges++] = {start, i - start};
+    }
+
+    // Anything joining the plan has been stale since it was last skipped, so catch it up now
+    int addedOscs = oscMask & ~snapshotOscMask, addedLFOs = lfoMask & ~snapshotLFOMask;
+    for (int i = 0; i < n_oscs; i++)
+    {
+        if (addedOscs & (1 << i))
+        {
+            auto &o = scene->osc[i];
+            copySnapshotRange(o.type.param_id_in_scene,
+                              o.retrigger.param_id_in_scene - o.type.param_id_in_scene + 1);
+        }
+    }
+    for (int i = 0; i < n_lfos_voice; i++)
+    {
+        if (addedLFOs & (1 << i))
+        {
+            auto &l = scene->lfo[i];
+            copySnapshotRange(l.shape.param_id_in_scene,
+                              l.release.param_id_in_scene - l.shape.param_id_in_scene + 1);
+        }
+    }
+
+    snapshotOscMask = oscMask;
+    snapshotLFOMask = lfoMask;
+}
+
 template <bool first> void SurgeVoice::calc_ctrldata(QuadFilterChainState *Q, int e)
 {
+    if (!first)
+    {
+        auto lfoMask = currentLFOMask();
+        if (lfoMask != snapshotLFOMask)
+            updateSnapshotPlan(snapshotOscMask, lfoMask);
+    }
+
     // Always process LFO1 so the gate retrigger always work
     lfo[0].process_block();
 
@@ -572,35 +704,40 @@ template <bool first> void SurgeVoice::calc_ctrldata(QuadFilterChainState *Q, in
     if (((ADSRModulationSource *)modsources[ms_ampeg])->is_idle())
         state.keep_playing = false;
 
-    // TODO memcpy is bottleneck
-    memcpy(localcopy, paramptr, sizeof(localcopy));
-    // don't actually need to copy everything
-    // LFOs could be ignore when unused
-    // same for FX & OSCs
-    // also ignore int-parameters
-
-    vector<ModulationRouting>::iterator iter;
-    iter = scene->modulation_voice.begin();
-    while (iter != scene->modulation_voice.end())
+    if (first)
     {
-        int src_id = iter->source_id;
-        int dst_id = iter->destination_id;
-        float depth = iter->depth;
+        memcpy(localcopy, paramptr, sizeof(localcopy));
+    }
+    else
+    {
+        for (int i = 0; i < n_snapshotRanges; i++)
+            copySnapshotRange(snapshotRanges[i].start, snapshotRanges[i].count);
+    }
 
-        if (modsources[src_id])
-        {
-            localcopy[dst_id].f +=
-                depth * modsources[src_id]->get_output(iter->source_index) * (1.0 - iter->muted);
-        }
-        iter++;
+    /*
+     * A destination can sit in a range the plan skips, so reset every destination before any
+     * routing adds to it. This keeps the per-block cost at the size of the plan plus the number
+     * of routings, rather than the whole scene.
+     */
+    const auto &voiceTable = scene->modulation_voice_table;
+    for (int i = 0; i < voiceTable.size(); i++)
+        localcopy[voiceTable.destination(i)] = paramptr[voiceTable.destination(i)];
+    if (mpeEnabled)
+    {
+        for (const auto &r : scene->modulation_scene)
+            if (r.source_id == ms_aftertouch && r.destination_id >= 0 &&
+                r.destination_id < n_scene_params)
+                localcopy[r.destination_id] = paramptr[r.destination_id];
     }
 
+    voiceTable.apply(modsources.data(), localcopy);
+
     if (mpeEnabled)
     {
         // See github issue 1214. This basically compensates for
         // channel AT being per-voice in MPE mode (since it is per channel)
         // vs per-scene (since it is per keyboard in non MPE mode).
-        iter = scene->modulation_scene.begin();
+        auto iter = scene->modulation_scene.begin();
         while (iter != scene->modulation_scene.end())
         {
             int src_id = iter->source_id;
@@ -744,6 +881,8 @@ template <bool first> void SurgeVoice::calc_ctrldata(QuadFilterChainState *Q, in
 
 bool SurgeVoice::process_block(QuadFilterChainState &Q, int Qe)
 {
+    SURGE_PROFILE_SCOPE(storage, Surge::Profiling::BlockProfiler::st_voices + state.scene_id);
+
     calc_ctrldata<0>(&Q, Qe);
 
     bool is_wide = scene->filterblock_configuration.val.i == fc_wide;
@@ -766,8 +905,7 @@ bool SurgeVoice::process_block(QuadFilterChainState &Q, int Qe)
         }
     }
 
-    if (osc3 || ring23 || ((osc1 || osc2 || ring12) && (FMmode == fm_3to2to1)) ||
-        ((osc1 || ring12) && (FMmode == fm_2and3to1)))
+    if (oscIsProcessed(2))
     {
         osc[2]->process_block(
             noteShiftFromPitchParam(
@@ -799,7 +937,7 @@ bool SurgeVoice::process_block(QuadFilterChainState &Q, int Qe)
         }
     }
 
-    if (osc2 || ring12 || ring23 || (FMmode && osc1))
+    if (oscIsProcessed(1))
     {
         if (FMmode == fm_3to2to1)
         {
@@ -843,7 +981,7 @@ bool SurgeVoice::process_block(QuadFilterChainState &Q, int Qe)
         }
     }
 
-    if (osc1 || ring12)
+    if (oscIsProcessed(0))
     {
         if (FMmode == fm_2and3to1)
         {
@@ -51,6 +51,7 @@ class alignas(16) SurgeVoice
     void legato(int key, int velocity, char detune);
     void switch_toggled();
     void freeAllocatedElements();
+    int snapshotParamCount() const; // how many params calc_ctrldata copies per block
     int osctype[n_oscs];
     SurgeVoiceState state;
     int age, age_release;
@@ -140,6 +141,43 @@ class alignas(16) SurgeVoice
                   bool noise);
     int routefilter(int);
 
+    // Does process_block run oscillator i given the current path?
+    inline bool oscIsProcessed(int i) const
+    {
+        switch (i)
+        {
+        case 0:
+            return osc1 || ring12;
+        case 1:
+            return osc2 || ring12 || ring23 || (FMmode && osc1);
+        case 2:
+            return osc3 || ring23 || ((osc1 || osc2 || ring12) && (FMmode == fm_3to2to1)) ||
+                   ((osc1 || ring12) && (FMmode == fm_2and3to1));
+        }
+        return false;
+    }
+
+    /*
+     * calc_ctrldata used to copy the whole scene into localcopy every block. Instead we keep a
+     * list of the parameter ranges this voice actually reads: the scene parameters process_block
+     * and SetQFB use, the envelopes, the oscillators it runs and the voice LFOs it processes.
+     * Scene level parameters (sends, polyphony and the like), muted oscillators and the other
+     * LFOs are left out. Modulation destinations are refreshed individually on top of that, so
+     * a routing into a skipped parameter can't accumulate. The plan depends only on the
+     * oscillator and LFO masks, so it is rebuilt from switch_toggled and when the LFO set
+     * changes.
+     */
+    struct SnapshotRange
+    {
+        int start, count;
+    };
+    void updateSnapshotPlan(int oscMask, int lfoMask);
+    void copySnapshotRange(int start, int count);
+    int currentLFOMask() const;
+    SnapshotRange snapshotRanges[n_scene_params / 2 + 1];
+    int n_snapshotRanges = 0;
+    int snapshotOscMask = -1, snapshotLFOMask = -1;
+
     LFOModulationSource lfo[6];
 
     // Filterblock state storage
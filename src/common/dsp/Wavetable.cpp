@@ -152,6 +152,32 @@ void Wavetable::Copy(Wavetable *wt)
     current_id = wt->current_id;
 }
 
+//! Exchange the table data (but not the id or queue state) with another wavetable. This only
+//! swaps pointers, so it is cheap enough to do on the audio thread with a table built elsewhere.
+void Wavetable::SwapDataWith(Wavetable *wt)
+{
+    std::swap(size, wt->size);
+    std::swap(size_po2, wt->size_po2);
+    std::swap(flags, wt->flags);
+    std::swap(dt, wt->dt);
+    std::swap(everBuilt, wt->everBuilt);
+    std::swap(dataSizes, wt->dataSizes);
+    std::swap(TableF32Data, wt->TableF32Data);
+    std::swap(TableI16Data, wt->TableI16Data);
+
+    // Only the leading columns of the weak pointer tables are ever populated
+    int cols = std::max(std::max((int)n_tables, (int)wt->n_tables), min_F32_tables);
+    cols = std::min(cols, max_subtables);
+    for (int i = 0; i < max_mipmap_levels; i++)
+    {
+        std::swap_ranges(TableF32WeakPointers[i], TableF32WeakPointers[i] + cols,
+                         wt->TableF32WeakPointers[i]);
+        std::swap_ranges(TableI16WeakPointers[i], TableI16WeakPointers[i] + cols,
+                         wt->TableI16WeakPointers[i]);
+    }
+    std::swap(n_tables, wt->n_tables);
+}
+
 bool Wavetable::BuildWT(void *wdata, wt_header &wh, bool AppendSilence)
 {
     assert(wdata);
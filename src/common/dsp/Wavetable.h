@@ -25,6 +25,7 @@ class Wavetable
     Wavetable();
     ~Wavetable();
     void Copy(Wavetable *wt);
+    void SwapDataWith(Wavetable *wt);
     bool BuildWT(void *wdata, wt_header &wh, bool AppendSilence);
     void MipMapWT();
 
@@ -166,7 +166,7 @@ class ModControl
         {
             if (lforeset)
             {
-                lfosandhtarget = (rand() / (float)RAND_MAX) - 1.f;
+                lfosandhtarget = (SurgeStorage::threadRand() / (float)RAND_MAX) - 1.f;
             }
 
             if (mwave == mod_noise)
@@ -5,7 +5,7 @@
 
 using namespace std;
 
-int LFOModulationSource::urngSeed = 1234;
+std::atomic<int> LFOModulationSource::urngSeed{1234};
 
 LFOModulationSource::LFOModulationSource() { Surge::Formula::initEvaluatorState(formulastate); }
 LFOModulationSource::~LFOModulationSource() { Surge::Formula::cleanEvaluatorState(formulastate); }
@@ -62,10 +62,24 @@ void LFOModulationSource::assign(SurgeStorage *storage, LFOStorage *lfo, pdata *
     }
     else
     {
+        /*
+         * A synth whose generators were seeded (see SurgeSynthesizer::seedRandomGenerators)
+         * seeds its LFOs from the storage, so it gets the same LFOs every time. Anything else
+         * keeps the process wide counter, and renders as it always has.
+         */
         gen = std::default_random_engine();
-        gen.seed(urngSeed++);
         distro = std::uniform_real_distribution<float>(-1.f, 1.f);
         urng = [this]() -> float { return distro(gen); };
+
+        if (storage->rngSeeded)
+        {
+            gen.seed(storage->rand_u32());
+            msegstate.seed(storage->rand_u32());
+        }
+        else
+        {
+            gen.seed(urngSeed++);
+        }
     }
     noise = 0.f;
     noised1 = 0.f;
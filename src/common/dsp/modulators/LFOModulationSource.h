@@ -21,6 +21,7 @@
 #include "ModulationSource.h"
 #include "MSEGModulationHelper.h" // We need this for the MSEGEvalatorState member
 #include "FormulaModulationHelper.h"
+#include <atomic>
 #include <functional>
 
 enum LFOEG_state
@@ -105,6 +106,6 @@ class LFOModulationSource : public ModulationSource
     std::default_random_engine gen;
     std::uniform_real_distribution<float> distro;
     std::function<float()> urng;
-    static int urngSeed;
+    static std::atomic<int> urngSeed;
     quadr_osc sinus;
 };
@@ -18,6 +18,8 @@
 #include "AliasOscillator.h"
 #include "SineOscillator.h"
 
+#include <mutex>
+
 // This linear representation is required for VST3 automation and the like and needs to
 // match the param ID the UI is driven by the remapper code in init_ctrltypes
 int alias_waves_count() { return AliasOscillator::ao_waves::ao_n_waves; }
@@ -46,13 +48,12 @@ const uint8_t alias_sinetable[256] = {
 };
 
 static uint8_t shaped_sinetable[7][256];
-static bool initializedShapedSinetable = false;
+static std::once_flag initializedShapedSinetable;
 
 void AliasOscillator::init(float pitch, bool is_display, bool nonzero_init_drift)
 {
-    if (!initializedShapedSinetable)
-    {
-        initializedShapedSinetable = true;
+    // Synths on other threads may get here at the same time, and must not see a half built table
+    std::call_once(initializedShapedSinetable, []() {
         float dPhase = 2.0 * M_PI / (256 - 1);
         for (int i = 0; i < 7; ++i)
         {
@@ -65,7 +66,7 @@ void AliasOscillator::init(float pitch, bool is_display, bool nonzero_init_drift
                 shaped_sinetable[i][k] = (uint8_t)(r01 * 0xFF);
             }
         }
-    }
+    });
 
     n_unison = is_display ? 1 : oscdata->p[ao_unison_voices].val.i;
 
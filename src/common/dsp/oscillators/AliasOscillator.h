@@ -108,7 +108,7 @@ class AliasOscillator : public Oscillator
 
         uint8_t x, y, z, a;
         uint8_t stepCount;
-        UInt8RNG() : x(21), y(229), z(181), a(rand() & 0xFF), stepCount(0) {}
+        UInt8RNG() : x(21), y(229), z(181), a(SurgeStorage::threadRand() & 0xFF), stepCount(0) {}
 
         inline uint8_t step()
         {
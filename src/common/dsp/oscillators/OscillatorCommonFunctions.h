@@ -32,7 +32,7 @@ struct DriftLFO
         d = 0;
         d2 = 0;
         if (nzi)
-            d2 = 0.0005 * ((float)rand() / (float)(RAND_MAX));
+            d2 = 0.0005 * ((float)SurgeStorage::threadRand() / (float)(RAND_MAX));
     }
 
     inline float next()
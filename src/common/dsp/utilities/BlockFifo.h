@@ -0,0 +1,93 @@
+/*
+** Surge Synthesizer is Free and Open Source Software
+**
+** Surge is made available under the Gnu General Public License, v3.0
+** https://www.gnu.org/licenses/gpl-3.0.en.html
+**
+** Copyright 2004-2021 by various individuals as described by the Git transaction log
+**
+** All source at: https://github.com/surge-synthesizer/surge.git
+**
+** Surge was a commercial product from 2004-2018, with Copyright and ownership
+** in that period held by Claes Johanson at Vember Audio. Claes made Surge
+** open source in September 2018.
+*/
+
+#ifndef SURGE_BLOCKFIFO_H
+#define SURGE_BLOCKFIFO_H
+
+#include "globals.h"
+#include <algorithm>
+#include <cstring>
+
+/*
+ * Lets code which works in BLOCK_SIZE blocks run on buffers of any size, such as whatever a
+ * plugin host hands us. Each sample goes into the write bank and comes out of the other one,
+ * which holds the previous block processed, so the audio is delayed by exactly one block
+ * however the buffers are split up.
+ *
+ * A sidechain, if there is one, is collected alongside and handed over with its block. Where
+ * there isn't one the sidechain block is silent.
+ */
+struct BlockFifo
+{
+    static constexpr int latency = BLOCK_SIZE;
+
+    float main alignas(16)[2][2][BLOCK_SIZE];
+    float side alignas(16)[2][BLOCK_SIZE];
+    int pos = 0, write = 0;
+
+    BlockFifo() { reset(); }
+
+    void reset()
+    {
+        pos = 0;
+        write = 0;
+        memset(main, 0, sizeof(main));
+        memset(side, 0, sizeof(side));
+    }
+
+    /*
+     * Runs numSamples samples of L and R through the FIFO, in place. processBlock is called
+     * with (float *L, float *R, const float *sideL, const float *sideR) for each block as it
+     * fills, with 16 byte aligned pointers, and works on L and R in place. Return false from
+     * keepGoing to stop early; the rest of the buffer is then left as it is.
+     */
+    template <typename F, typename G>
+    void process(float *L, float *R, const float *sideL, const float *sideR, int numSamples,
+                 F &&processBlock, G &&keepGoing)
+    {
+        float *io[2] = {L, R};
+        const float *sideIn[2] = {sideL, sideR};
+        int done = 0;
+
+        while (done < numSamples && keepGoing())
+        {
+            auto n = std::min(BLOCK_SIZE - pos, numSamples - done);
+
+            for (int c = 0; c < 2; ++c)
+            {
+                // The buffer is both input and output, so take the input out first
+                memcpy(&main[write][c][pos], io[c] + done, n * sizeof(float));
+                memcpy(io[c] + done, &main[1 - write][c][pos], n * sizeof(float));
+
+                if (sideIn[c])
+                    memcpy(&side[c][pos], sideIn[c] + done, n * sizeof(float));
+                else
+                    memset(&side[c][pos], 0, n * sizeof(float));
+            }
+
+            pos += n;
+            done += n;
+
+            if (pos == BLOCK_SIZE)
+            {
+                processBlock(main[write][0], main[write][1], side[0], side[1]);
+                write = 1 - write;
+                pos = 0;
+            }
+        }
+    }
+};
+
+#endif // SURGE_BLOCKFIFO_H
@@ -3485,23 +3485,25 @@ std::string SurgeGUIEditor::helpURLFor(Parameter *p)
     if (type >= 0)
     {
         auto key = std::make_pair(id, type);
-        if (storage->helpURL_paramidentifier_typespecialized.find(key) !=
-            storage->helpURL_paramidentifier_typespecialized.end())
+        auto it = storage->helpURL_paramidentifier_typespecialized.find(key);
+        if (it != storage->helpURL_paramidentifier_typespecialized.end())
         {
-            auto r = storage->helpURL_paramidentifier_typespecialized[key];
+            auto r = it->second;
             if (r != "")
                 return r;
         }
     }
-    if (storage->helpURL_paramidentifier.find(id) != storage->helpURL_paramidentifier.end())
+    auto pit = storage->helpURL_paramidentifier.find(id);
+    if (pit != storage->helpURL_paramidentifier.end())
     {
-        auto r = storage->helpURL_paramidentifier[id];
+        auto r = pit->second;
         if (r != "")
             return r;
     }
-    if (storage->helpURL_controlgroup.find(p->ctrlgroup) != storage->helpURL_controlgroup.end())
+    auto git = storage->helpURL_controlgroup.find(p->ctrlgroup);
+    if (git != storage->helpURL_controlgroup.end())
     {
-        auto r = storage->helpURL_controlgroup[p->ctrlgroup];
+        auto r = git->second;
         if (r != "")
             return r;
     }
@@ -3516,9 +3518,10 @@ std::string SurgeGUIEditor::helpURLForSpecial(const string &special)
 
 std::string SurgeGUIEditor::helpURLForSpecial(SurgeStorage *storage, const std::string &special)
 {
-    if (storage->helpURL_specials.find(special) != storage->helpURL_specials.end())
+    auto it = storage->helpURL_specials.find(special);
+    if (it != storage->helpURL_specials.end())
     {
-        auto r = storage->helpURL_specials[special];
+        auto r = it->second;
         if (r != "")
             return r;
     }
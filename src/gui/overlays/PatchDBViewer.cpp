@@ -171,7 +171,24 @@ struct PatchDBSQLTreeViewItem : public SharedTreeViewItem
 
         void itemOpennessChanged(bool isOpenNow) override
         {
-            std::cout << type << " " << isOpenNow << std::endl;
+            if (!isOpenNow)
+            {
+                while (getNumSubItems() > 0)
+                    removeSubItem(0);
+            }
+            else if (type == AUTHOR)
+            {
+                auto facets = storage->patchDB->searchFacets({});
+                for (auto &f : facets.authors)
+                {
+                    addSubItem(new TextSubItem(editor, storage,
+                                               f.value + " (" + std::to_string(f.count) + ")"));
+                }
+            }
+            else
+            {
+                std::cout << type << " " << isOpenNow << std::endl;
+            }
         }
         JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SpecialQueryItem);
     };
@@ -204,7 +221,7 @@ class PatchDBSQLTableModel : public juce::TableListBoxModel
 {
   public:
     PatchDBSQLTableModel(SurgeGUIEditor *ed, SurgeStorage *s) : editor(ed), storage(s) {}
-    int getNumRows() override { return data.size(); }
+    int getNumRows() override { return numRows; }
 
     void paintRowBackground(juce::Graphics &g, int rowNumber, int width, int height,
                             bool rowIsSelected) override
@@ -219,15 +236,15 @@ class PatchDBSQLTableModel : public juce::TableListBoxModel
     void paintCell(juce::Graphics &g, int rowNumber, int columnId, int width, int height,
                    bool rowIsSelected) override
     {
-        // FIXME - make sure the codition this is handling is handled everywhere consistently
-        if (rowNumber >= data.size())
+        auto r = recordAt(rowNumber);
+        if (!r)
         {
             return;
         }
 
         g.setColour(juce::Colour(100, 100, 100));
         g.setColour(juce::Colour(0, 0, 0));
-        auto d = data[rowNumber];
+        auto &d = *r;
         auto s = std::to_string(d.id);
         switch (columnId)
         {
@@ -247,20 +264,48 @@ class PatchDBSQLTableModel : public juce::TableListBoxModel
 
     void cellDoubleClicked(int rowNumber, int columnId, const juce::MouseEvent &event) override
     {
-        // FIXME - make sure the codition this is handling is handled everywhere consistently
-        if (rowNumber >= data.size())
+        auto r = recordAt(rowNumber);
+        if (!r)
         {
             return;
         }
 
-        auto d = data[rowNumber];
-        editor->queuePatchFileLoad(d.file);
+        editor->queuePatchFileLoad(r->file);
         editor->closePatchBrowserDialog();
     }
 
-    void executeQuery(const std::string &n) { data = storage->patchDB->rawQueryForNameLike(n); }
+    /*
+     * The table only asks for the rows it shows, so we count the results and then fetch them a
+     * page at a time as they scroll into view, rather than reading every match on each keystroke
+     */
+    void executeQuery(const std::string &n)
+    {
+        query.text = n;
+        numRows = storage->patchDB->countSearchResults(query);
+        page.clear();
+        pageStart = 0;
+    }
+
+    const Surge::PatchStorage::PatchDB::patchRecord *recordAt(int row)
+    {
+        if (row < 0 || row >= numRows)
+            return nullptr;
+
+        if (row < pageStart || row >= pageStart + (int)page.size())
+        {
+            pageStart = row - row % pageSize;
+            page = storage->patchDB->search(query, pageStart, pageSize);
+        }
+
+        auto i = row - pageStart;
+        return i < (int)page.size() ? &page[i] : nullptr;
+    }
 
-    std::vector<Surge::PatchStorage::PatchDB::patchRecord> data;
+    static constexpr int pageSize = 100;
+    Surge::PatchStorage::PatchDB::SearchQuery query;
+    int numRows{0};
+    int pageStart{0};
+    std::vector<Surge::PatchStorage::PatchDB::patchRecord> page;
     SurgeStorage *storage;
     SurgeGUIEditor *editor;
 
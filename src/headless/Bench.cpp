@@ -0,0 +1,386 @@
+/*
+** surge-bench times the engine on every oscillator, filter type and subtype and effect type,
+** at a range of voice counts and (for the oscillators) unison settings, and writes the results
+** as JSON so runs on different commits can be compared. Each case gets a fresh synth on the
+** Init patch, a warmup, and a set of timed repetitions; we report the real time factor (seconds
+** of audio rendered per second of wall clock) per repetition and the spread of per-block times.
+**
+** Run with surge-bench --json bench.json, or surge-bench --help for the options
+*/
+
+#include "HeadlessUtils.h"
+#include "version.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+struct Options
+{
+    float sampleRate{48000};
+    float seconds{1.f};
+    float warmupSeconds{0.25f};
+    int reps{5};
+    std::vector<int> voices{1, 8, 32};
+    std::vector<int> unison{1, 4};
+    std::string filter;
+    std::string jsonFile;
+};
+
+struct Case
+{
+    std::string group, name;
+    int type{0}, subtype{-1}, voices{1}, unison{1};
+    std::function<bool(SurgeSynthesizer *)> configure;
+};
+
+struct Result
+{
+    Case c;
+    std::vector<double> rtf;
+    double blockNS[4]{0, 0, 0, 0}; // median, p90, p99, max
+};
+
+std::vector<int> parseList(const char *s)
+{
+    std::vector<int> res;
+    std::stringstream ss(s);
+    std::string item;
+    while (std::getline(ss, item, ','))
+    {
+        auto v = std::atoi(item.c_str());
+        if (v > 0)
+            res.push_back(v);
+    }
+    return res;
+}
+
+void setTypeParam(SurgeSynthesizer *surge, Parameter &p, int value)
+{
+    surge->setParameter01(surge->idForParameter(&p),
+                          Parameter::intScaledToFloat(value, p.val_max.i, p.val_min.i), false);
+}
+
+Parameter *unisonParam(OscillatorStorage &osc)
+{
+    for (auto &p : osc.p)
+        if (p.ctrltype == ct_osccount || p.ctrltype == ct_osccountWT)
+            return &p;
+    return nullptr;
+}
+
+std::vector<Case> makeCases(const Options &opt)
+{
+    std::vector<Case> res;
+
+    for (int ot = 0; ot < n_osc_types; ++ot)
+    {
+        for (auto u : opt.unison)
+        {
+            Case c;
+            c.group = "oscillator";
+            c.name = osc_type_names[ot];
+            c.type = ot;
+            c.unison = u;
+            c.configure = [ot, u](SurgeSynthesizer *surge) {
+                auto &osc = surge->storage.getPatch().scene[0].osc[0];
+                setTypeParam(surge, osc.type, ot);
+                // The new oscillator and its defaults arrive on the next block
+                for (int i = 0; i < 4; ++i)
+                    surge->process();
+                auto up = unisonParam(osc);
+                if (!up)
+                    return u == 1;
+                up->val.i = std::min(u, up->val_max.i);
+                return up->val.i == u;
+            };
+            res.push_back(c);
+        }
+    }
+
+    for (int ft = 1; ft < n_fu_types; ++ft)
+    {
+        for (int st = 0; st < std::max(fut_subcount[ft], 1); ++st)
+        {
+            Case c;
+            c.group = "filter";
+            c.name = fut_names[ft];
+            c.type = ft;
+            c.subtype = st;
+            c.configure = [ft, st](SurgeSynthesizer *surge) {
+                auto &fu = surge->storage.getPatch().scene[0].filterunit[0];
+                setTypeParam(surge, fu.type, ft);
+                fu.subtype.val.i = st;
+                return true;
+            };
+            res.push_back(c);
+        }
+    }
+
+    for (int fx = 1; fx < n_fx_types; ++fx)
+    {
+        Case c;
+        c.group = "effect";
+        c.name = fx_type_names[fx];
+        c.type = fx;
+        c.configure = [fx](SurgeSynthesizer *surge) {
+            setTypeParam(surge, surge->storage.getPatch().fx[0].type, fx);
+            for (int i = 0; i < 4; ++i)
+                surge->process();
+            return surge->fx[0] != nullptr;
+        };
+        res.push_back(c);
+    }
+
+    // Every case at every voice count
+    std::vector<Case> byVoices;
+    for (auto &c : res)
+    {
+        for (auto v : opt.voices)
+        {
+            auto cv = c;
+            cv.voices = std::min(v, MAX_VOICES);
+            byVoices.push_back(cv);
+        }
+    }
+
+    if (opt.filter.empty())
+        return byVoices;
+
+    std::vector<Case> filtered;
+    for (auto &c : byVoices)
+        if ((c.group + "/" + c.name).find(opt.filter) != std::string::npos)
+            filtered.push_back(c);
+    return filtered;
+}
+
+double percentile(const std::vector<double> &sorted, double pct)
+{
+    if (sorted.empty())
+        return 0;
+    auto idx = (size_t)std::min(pct / 100.0 * (sorted.size() - 1) + 0.5, sorted.size() - 1.0);
+    return sorted[idx];
+}
+
+bool runCase(const Options &opt, const Case &c, Result &r)
+{
+    r.c = c;
+
+    auto surge = Surge::Headless::createSurge(opt.sampleRate);
+    surge->storage.getPatch().polylimit.val.i = MAX_VOICES;
+    for (int i = 0; i < 4; ++i)
+        surge->process();
+    if (!c.configure(surge.get()))
+        return false;
+    surge->process();
+
+    // Spread the keys so each voice is its own note; 7 and 72 are coprime, so these are distinct
+    for (int v = 0; v < c.voices; ++v)
+        surge->playNote(0, 24 + (v * 7) % 72, 100, 0);
+
+    int warmupBlocks = (int)(opt.warmupSeconds * opt.sampleRate / BLOCK_SIZE);
+    for (int i = 0; i < warmupBlocks; ++i)
+        surge->process();
+
+    int blocks = std::max(1, (int)(opt.seconds * opt.sampleRate / BLOCK_SIZE));
+    double audioSeconds = 1.0 * blocks * BLOCK_SIZE / opt.sampleRate;
+
+    std::vector<double> blockNS;
+    blockNS.reserve((size_t)blocks * opt.reps);
+    for (int rep = 0; rep < opt.reps; ++rep)
+    {
+        auto repStart = std::chrono::steady_clock::now();
+        auto prior = repStart;
+        for (int i = 0; i < blocks; ++i)
+        {
+            surge->process();
+            auto now = std::chrono::steady_clock::now();
+            blockNS.push_back(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(now - prior).count());
+            prior = now;
+        }
+        auto wall = std::chrono::duration<double>(prior - repStart).count();
+        r.rtf.push_back(audioSeconds / std::max(wall, 1e-9));
+    }
+
+    std::sort(blockNS.begin(), blockNS.end());
+    r.blockNS[0] = percentile(blockNS, 50);
+    r.blockNS[1] = percentile(blockNS, 90);
+    r.blockNS[2] = percentile(blockNS, 99);
+    r.blockNS[3] = blockNS.back();
+    return true;
+}
+
+std::string jsonString(const std::string &s)
+{
+    std::ostringstream oss;
+    oss << '"';
+    for (auto c : s)
+    {
+        if (c == '"' || c == '\\')
+            oss << '\\' << c;
+        else if ((unsigned char)c < 0x20)
+            oss << "\\u" << std::hex << std::setw(4) << std::setfill('0') << (int)c << std::dec;
+        else
+            oss << c;
+    }
+    oss << '"';
+    return oss.str();
+}
+
+void writeJSON(std::ostream &os, const Options &opt, const std::vector<Result> &results)
+{
+    os << "{\n"
+       << "  \"version\": " << jsonString(Surge::Build::FullVersionStr) << ",\n"
+       << "  \"gitHash\": " << jsonString(Surge::Build::GitHash) << ",\n"
+       << "  \"gitBranch\": " << jsonString(Surge::Build::GitBranch) << ",\n"
+       << "  \"sampleRate\": " << opt.sampleRate << ",\n"
+       << "  \"blockSize\": " << BLOCK_SIZE << ",\n"
+       << "  \"seconds\": " << opt.seconds << ",\n"
+       << "  \"warmupSeconds\": " << opt.warmupSeconds << ",\n"
+       << "  \"reps\": " << opt.reps << ",\n"
+       << "  \"results\": [";
+
+    bool first = true;
+    for (auto &r : results)
+    {
+        auto rtf = r.rtf;
+        std::sort(rtf.begin(), rtf.end());
+
+        os << (first ? "\n" : ",\n") << "    {\"group\": " << jsonString(r.c.group)
+           << ", \"name\": " << jsonString(r.c.name) << ", \"type\": " << r.c.type
+           << ", \"subtype\": " << r.c.subtype << ", \"voices\": " << r.c.voices
+           << ", \"unison\": " << r.c.unison << ",\n"
+           << "     \"rtf\": {\"median\": " << percentile(rtf, 50) << ", \"min\": " << rtf.front()
+           << ", \"max\": " << rtf.back() << ", \"reps\": [";
+        for (size_t i = 0; i < r.rtf.size(); ++i)
+            os << (i ? ", " : "") << r.rtf[i];
+        os << "]},\n"
+           << "     \"blockNS\": {\"median\": " << r.blockNS[0] << ", \"p90\": " << r.blockNS[1]
+           << ", \"p99\": " << r.blockNS[2] << ", \"max\": " << r.blockNS[3] << "}}";
+        first = false;
+    }
+    os << "\n  ]\n}\n";
+}
+
+void usage()
+{
+    std::cout
+        << "surge-bench [options]\n\n"
+        << "   --json file           # write results as JSON to file ('-' for stdout)\n"
+        << "   --filter text         # only run cases whose group/name contains text\n"
+        << "   --voices 1,8,32       # voice counts to run every case at\n"
+        << "   --unison 1,4          # unison counts to run the oscillator cases at\n"
+        << "   --seconds 1           # seconds of audio per timed repetition\n"
+        << "   --warmup 0.25         # seconds of audio rendered before timing\n"
+        << "   --reps 5              # timed repetitions per case\n"
+        << "   --sample-rate 48000\n"
+        << "   --list                # list the cases and exit\n";
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+    Options opt;
+    bool listOnly = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        auto arg = std::string(argv[i]);
+        auto hasValue = i + 1 < argc;
+
+        if (arg == "--help")
+        {
+            usage();
+            return 0;
+        }
+        else if (arg == "--list")
+            listOnly = true;
+        else if (arg == "--json" && hasValue)
+            opt.jsonFile = argv[++i];
+        else if (arg == "--filter" && hasValue)
+            opt.filter = argv[++i];
+        else if (arg == "--voices" && hasValue)
+            opt.voices = parseList(argv[++i]);
+        else if (arg == "--unison" && hasValue)
+            opt.unison = parseList(argv[++i]);
+        else if (arg == "--seconds" && hasValue)
+            opt.seconds = std::atof(argv[++i]);
+        else if (arg == "--warmup" && hasValue)
+            opt.warmupSeconds = std::atof(argv[++i]);
+        else if (arg == "--reps" && hasValue)
+            opt.reps = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--sample-rate" && hasValue)
+            opt.sampleRate = std::atof(argv[++i]);
+        else
+        {
+            std::cerr << "Unknown argument " << arg << "\n";
+            usage();
+            return 1;
+        }
+    }
+
+    if (opt.voices.empty() || opt.unison.empty() || opt.sampleRate <= 0)
+    {
+        usage();
+        return 1;
+    }
+
+    auto cases = makeCases(opt);
+    if (listOnly)
+    {
+        for (auto &c : cases)
+            std::cout << c.group << "/" << c.name << " type=" << c.type
+                      << " subtype=" << c.subtype << " voices=" << c.voices
+                      << " unison=" << c.unison << "\n";
+        return 0;
+    }
+
+    // Progress goes to stderr so the JSON can go to stdout
+    auto &log = opt.jsonFile == "-" ? std::cerr : std::cout;
+    log << "surge-bench " << Surge::Build::FullVersionStr << " : " << cases.size()
+        << " cases at " << opt.sampleRate << "Hz" << std::endl;
+
+    std::vector<Result> results;
+    for (auto &c : cases)
+    {
+        Result r;
+        if (!runCase(opt, c, r))
+            continue;
+
+        auto rtf = r.rtf;
+        std::sort(rtf.begin(), rtf.end());
+        log << std::left << std::setw(11) << c.group << std::setw(26) << c.name << std::right
+            << " st=" << std::setw(2) << c.subtype << " v=" << std::setw(2) << c.voices
+            << " u=" << std::setw(2) << c.unison << " : rtf " << std::setw(8)
+            << std::setprecision(4) << percentile(rtf, 50) << "x; block p50/p99 "
+            << r.blockNS[0] / 1000.0 << "/" << r.blockNS[2] / 1000.0 << "us" << std::endl;
+        results.push_back(r);
+    }
+
+    if (opt.jsonFile == "-")
+    {
+        writeJSON(std::cout, opt, results);
+    }
+    else if (!opt.jsonFile.empty())
+    {
+        std::ofstream ofs(opt.jsonFile);
+        if (!ofs)
+        {
+            std::cerr << "Unable to open " << opt.jsonFile << std::endl;
+            return 1;
+        }
+        writeJSON(ofs, opt, results);
+    }
+    return 0;
+}
@@ -1,10 +1,25 @@
 #include "HeadlessUtils.h"
 #include "Player.h"
 #include "filesystem/import.h"
+#include "SharedResources.h"
+#include "MappedFile.h"
+#include "PatchDB.h"
+#include "BlockProfiler.h"
 #include <iostream>
 #include <sstream>
+#include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <deque>
+#include <thread>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <vector>
+
+#if LINUX
+#include <unistd.h>
+#endif
 
 namespace Surge
 {
@@ -563,6 +578,539 @@ void filterAnalyzer(int ft, int sft, std::ostream &os)
     }
 }
 
+void sceneThreadingBenchmark(const std::string &patchName, int voicesPerScene)
+{
+    /*
+     * Render the same dual-scene chord with scene rendering on the audio thread only
+     * and with the scenes split across the worker pool, and report the time for each.
+     * Run with surge-headless --non-test --scene-threading-benchmark patch.fxp 32
+     */
+    const int sr = 48000;
+    const int seconds = 20;
+    const int nBlocks = seconds * sr / BLOCK_SIZE;
+
+    auto runOne = [&](bool threaded) {
+        auto surge = Surge::Headless::createSurge(sr);
+        if (!patchName.empty())
+            surge->loadPatchByPath(patchName.c_str(), -1, "RUNTIME");
+        surge->storage.getPatch().scenemode.val.i = sm_dual;
+        surge->storage.getPatch().polylimit.val.i = MAX_VOICES;
+        surge->setMultithreadedSceneRendering(threaded);
+
+        for (int i = 0; i < 10; ++i)
+            surge->process();
+
+        for (int v = 0; v < voicesPerScene; ++v)
+            surge->playNote(0, 36 + (v * 7) % 60, 100, 0);
+
+        for (int i = 0; i < 100; ++i)
+            surge->process();
+
+        auto parallelOK = surge->canProcessScenesInParallel();
+
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < nBlocks; ++i)
+            surge->process();
+        auto end = std::chrono::high_resolution_clock::now();
+        auto us = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+
+        std::cout << (threaded ? "threaded" : "serial  ") << " : " << seconds << "s of audio in "
+                  << us / 1000.0 << "ms; " << 100.0 * us / (seconds * 1000000.0)
+                  << "% of realtime; voices=" << surge->polydisplay
+                  << (threaded && !parallelOK ? " (patch requires serial scenes)" : "")
+                  << std::endl;
+        return us;
+    };
+
+    std::cout << "Scene Threading Benchmark at " << sr << "Hz with " << voicesPerScene
+              << " voices per scene\n"
+              << "-- patchName = " << (patchName.empty() ? "Init" : patchName) << std::endl;
+
+    auto serialUS = runOne(false);
+    auto threadedUS = runOne(true);
+    std::cout << "speedup = " << 1.0 * serialUS / threadedUS << "x" << std::endl;
+}
+
+void voiceSnapshotBenchmark(int voices)
+{
+    /*
+     * Time the per-voice control rate work with many voices held. The sparse case is the Init
+     * patch, where one oscillator and one voice LFO are running; the dense case turns on every
+     * oscillator and routes every voice LFO, so the snapshot covers everything a voice reads.
+     * Run with surge-headless --non-test --voice-snapshot-benchmark 64
+     */
+    const int sr = 48000;
+    const int seconds = 10;
+    const int nBlocks = seconds * sr / BLOCK_SIZE;
+
+    auto runOne = [&](bool dense) {
+        auto surge = Surge::Headless::createSurge(sr);
+        auto &patch = surge->storage.getPatch();
+        patch.polylimit.val.i = MAX_VOICES;
+
+        if (dense)
+        {
+            auto &sc = patch.scene[0];
+            sc.mute_o2.val.b = false;
+            sc.mute_o3.val.b = false;
+            for (int l = 0; l < n_lfos_voice; ++l)
+                surge->setModulation(sc.osc[0].p[0].id, (modsources)(ms_lfo1 + l), 0, 0.01f);
+        }
+
+        for (int i = 0; i < 10; ++i)
+            surge->process();
+
+        for (int v = 0; v < voices; ++v)
+            surge->playNote(0, 24 + v % 96, 100, 0);
+
+        for (int i = 0; i < 100; ++i)
+            surge->process();
+
+        int nv = 0, copied = 0;
+        for (auto v : surge->voices[0])
+        {
+            copied += v->snapshotParamCount();
+            nv++;
+        }
+
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < nBlocks; ++i)
+            surge->process();
+        auto end = std::chrono::high_resolution_clock::now();
+        auto us = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+
+        std::cout << (dense ? "dense " : "sparse") << " : " << nv << " voices copy "
+                  << (nv ? copied / nv : 0) << " of " << n_scene_params
+                  << " params per block; " << seconds << "s of audio in " << us / 1000.0
+                  << "ms; " << 1000.0 * us / ((double)nBlocks * std::max(nv, 1))
+                  << "ns per voice block" << std::endl;
+    };
+
+    std::cout << "Voice Snapshot Benchmark at " << sr << "Hz with " << voices << " voices"
+              << std::endl;
+    runOne(false);
+    runOne(true);
+}
+
+void storageStartupBenchmark(int instances, const std::string &mode)
+{
+    /*
+     * Start many synths side by side, as a host with dozens of instances or a render node does,
+     * with the process-wide shared resources and catalogs on and off, and report what each
+     * instance costs in startup time and resident memory. The allocator hands the first run's
+     * freed memory to the second, so for exact memory figures run each mode in its own process.
+     * Run with surge-headless --non-test --storage-startup-benchmark 32 [shared|unshared]
+     */
+    auto residentKB = []() -> long {
+#if LINUX
+        std::ifstream statm("/proc/self/statm");
+        long pages = 0, resident = 0;
+        if (statm >> pages >> resident)
+            return resident * (sysconf(_SC_PAGESIZE) / 1024);
+#endif
+        return -1;
+    };
+
+    auto runOne = [&](bool shared) {
+        Surge::Storage::SharedResources::sharingEnabled = shared;
+
+        std::vector<std::shared_ptr<SurgeSynthesizer>> synths;
+        double firstMS = 0, restMS = 0;
+        auto rss0 = residentKB();
+
+        for (int i = 0; i < instances; ++i)
+        {
+            auto start = std::chrono::high_resolution_clock::now();
+            synths.push_back(Surge::Headless::createSurge(48000));
+            auto end = std::chrono::high_resolution_clock::now();
+            auto ms =
+                std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000.0;
+            if (i == 0)
+                firstMS = ms;
+            else
+                restMS += ms;
+        }
+
+        auto rss1 = residentKB();
+
+        std::cout << (shared ? "shared  " : "unshared") << " : first instance " << firstMS
+                  << "ms; later instances " << (instances > 1 ? restMS / (instances - 1) : 0.0)
+                  << "ms each; ";
+        if (rss0 >= 0 && rss1 >= 0)
+            std::cout << (rss1 - rss0) / instances << "kB resident each";
+        else
+            std::cout << "resident size not available on this platform";
+        std::cout << "; " << synths[0]->storage.patch_list.size() << " patches, "
+                  << synths[0]->storage.wt_list.size() << " wavetables" << std::endl;
+
+        synths.clear();
+        Surge::Storage::SharedResources::sharingEnabled = true;
+    };
+
+    instances = std::max(instances, 1);
+    std::cout << "Storage Startup Benchmark with " << instances << " instances" << std::endl;
+    if (mode != "unshared")
+        runOne(true);
+    if (mode != "shared")
+        runOne(false);
+}
+
+void patchLoadBenchmark(int passes)
+{
+    /*
+     * Prepare every patch in the library, as the patch loader does before a patch goes live,
+     * reading the files into a buffer as patches used to be read and then from a memory mapping.
+     * The first pass of each warms the OS file cache, so the passes after it compare the readers
+     * rather than the disk.
+     * Run with surge-headless --non-test --patch-load-benchmark 3
+     */
+    auto surge = Surge::Headless::createSurge(48000);
+    auto &patches = surge->storage.patch_list;
+    passes = std::max(passes, 1);
+
+    std::cout << "Patch Load Benchmark with " << patches.size() << " patches and " << passes
+              << " timed passes" << std::endl;
+    if (patches.empty())
+        return;
+
+    auto runOne = [&](bool mapped) {
+        Surge::Storage::MappedFile::mappingEnabled = mapped;
+
+        int failed = 0;
+        double us = 0;
+        for (int pass = 0; pass <= passes; ++pass)
+        {
+            auto start = std::chrono::high_resolution_clock::now();
+            for (auto &p : patches)
+            {
+                PreparedPatch pp;
+                auto path = path_to_string(p.path);
+                if (!surge->preparePatchFromPath(path.c_str(), p.name.c_str(), pp) || !pp.valid)
+                    failed++;
+            }
+            auto end = std::chrono::high_resolution_clock::now();
+            if (pass > 0)
+                us += std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+        }
+
+        std::cout << (mapped ? "mapped  " : "buffered") << " : " << us / 1000.0 / passes
+                  << "ms per pass; " << us / passes / patches.size() << "us per patch";
+        if (failed)
+            std::cout << "; " << failed / (passes + 1) << " patches failed";
+        std::cout << std::endl;
+
+        Surge::Storage::MappedFile::mappingEnabled = true;
+        return us;
+    };
+
+    auto bufferedUS = runOne(false);
+    auto mappedUS = runOne(true);
+    std::cout << "speedup = " << bufferedUS / std::max(mappedUS, 1.0) << "x" << std::endl;
+}
+
+void patchDBBenchmark(int patches, int readers)
+{
+    /*
+     * Index a synthetic library of copies of one patch, spread over a hundred categories, into a
+     * fresh patch database, then index the unchanged library again (which should touch nothing
+     * but the file times) and finally again with one patch in a hundred edited, then time a few
+     * searches. Patches are read by the given number of reader threads, or by as many as the
+     * database picks for itself.
+     * Run with surge-headless --non-test --patchdb-benchmark 50000 [readers]
+     */
+    namespace PS = Surge::PatchStorage;
+    patches = std::max(patches, 1);
+    static constexpr int categories = 100;
+
+    auto dir = fs::temp_directory_path() / "surge-patchdb-benchmark";
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+
+    auto surge = Surge::Headless::createSurge(48000);
+    surge->storage.getPatch().author = "Benchmark";
+    auto tpl = dir / "template.fxp";
+    surge->savePatchToPath(tpl);
+    surge->storage.userDataPath = path_to_string(dir);
+
+    std::cout << "PatchDB Benchmark with " << patches << " patches in " << categories
+              << " categories under " << path_to_string(dir) << std::endl;
+    if (readers > 0)
+        std::cout << "Reading with " << readers << " threads" << std::endl;
+
+    std::vector<fs::path> paths;
+    for (int i = 0; i < patches; ++i)
+    {
+        auto cat = dir / "patches" / ("Category " + std::to_string(i % categories));
+        if (i < categories)
+            fs::create_directories(cat);
+        paths.push_back(cat / ("Patch " + std::to_string(i) + ".fxp"));
+        fs::copy_file(tpl, paths.back());
+    }
+
+    auto index = [&](const std::string &what) {
+        auto start = std::chrono::high_resolution_clock::now();
+        auto db = std::make_unique<PS::PatchDB>(&surge->storage, readers);
+        for (int c = 0; c < categories; ++c)
+            db->addRootCategory("Category " + std::to_string(c), PS::PatchDB::USER);
+        for (int i = 0; i < patches; ++i)
+            db->considerFXPForLoad(paths[i], "Patch " + std::to_string(i),
+                                   "Category " + std::to_string(i % categories),
+                                   PS::PatchDB::USER);
+        while (db->numberOfJobsOutstanding() > 0)
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        auto end = std::chrono::high_resolution_clock::now();
+
+        auto found = db->rawQueryForNameLike("Patch").size();
+        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+        std::cout << what << " : " << ms << "ms; " << ms * 1000.0 / patches << "us per patch; "
+                  << found << " patches in the database" << std::endl;
+    };
+
+    index("cold     ");
+    index("unchanged");
+
+    // Patch times are kept to the second, so move the edited ones well past the first scan
+    for (int i = 0; i < patches; i += 100)
+        fs::last_write_time(paths[i], fs::last_write_time(paths[i]) + std::chrono::seconds(10));
+    index("1% edited");
+
+    /*
+     * And search the result, as the patch browser does while someone types. Each query runs a
+     * few times and we report its slowest run.
+     */
+    {
+        auto db = std::make_unique<PS::PatchDB>(&surge->storage, readers);
+        auto time = [&](const std::string &what, const std::function<size_t()> &f) {
+            size_t found = 0;
+            double worst = 0;
+            for (int i = 0; i < 10; ++i)
+            {
+                auto start = std::chrono::high_resolution_clock::now();
+                found = f();
+                auto end = std::chrono::high_resolution_clock::now();
+                auto ms = std::chrono::duration<double, std::milli>(end - start).count();
+                worst = std::max(worst, ms);
+            }
+            std::cout << what << " : " << worst << "ms; " << found << " found" << std::endl;
+        };
+
+        for (auto t : {"p", "pa", "patch", "patch 4", "patch 42", "patch 4242"})
+        {
+            time(std::string("prefix search '") + t + "'",
+                 [&]() { return db->prefixSearch(t, 100).size(); });
+        }
+        for (auto t : {"cat", "patch 42", "benchmark category 7"})
+        {
+            time(std::string("ranked search '") + t + "', first page",
+                 [&]() { return db->search({t}, 0, 100).size(); });
+        }
+        time("facets for 'patch 42'", [&]() {
+            auto f = db->searchFacets({"patch 42"});
+            return f.categories.size() + f.authors.size();
+        });
+
+        auto first = db->search({}, 0, 1);
+        if (!first.empty())
+            time("20 patches most like '" + first[0].name + "'",
+                 [&]() { return db->similarPatches(first[0].id, 20).size(); });
+    }
+
+    surge.reset();
+    fs::remove_all(dir);
+}
+
+void blockProfile(const std::string &patchName, int voices, int seconds)
+{
+    /*
+     * Play a chord on a patch and report where each block's time went: control rate work, each
+     * scene and its voices and filters, and each FX slot. Needs a build with
+     * -DSURGE_BLOCK_PROFILING=TRUE.
+     * Run with surge-headless --non-test --block-profile patch.fxp 16 10
+     */
+    const int sr = 48000;
+    auto surge = Surge::Headless::createSurge(sr);
+    auto profiler = surge->storage.profiler.get();
+    if (!profiler)
+    {
+        std::cout << "This surge-headless was built without SURGE_BLOCK_PROFILING" << std::endl;
+        return;
+    }
+
+    if (!patchName.empty())
+        surge->loadPatchByPath(patchName.c_str(), -1, "RUNTIME");
+    surge->storage.getPatch().polylimit.val.i = MAX_VOICES;
+
+    for (int i = 0; i < 10; ++i)
+        surge->process();
+    for (int v = 0; v < voices; ++v)
+        surge->playNote(0, 36 + (v * 7) % 60, 100, 0);
+    for (int i = 0; i < 100; ++i)
+        surge->process();
+
+    profiler->reset();
+    int nBlocks = seconds * sr / BLOCK_SIZE;
+    for (int i = 0; i < nBlocks; ++i)
+        surge->process();
+
+    auto st = profiler->stats();
+    std::cout << "Block Profile of " << (patchName.empty() ? "Init" : patchName) << " with "
+              << voices << " voices over " << st.blocks << " blocks; last " << st.historyBlocks
+              << " blocks (us per block)" << std::endl;
+    std::cout << std::left << std::setw(20) << "stage" << std::right << std::setw(10) << "mean"
+              << std::setw(10) << "p50" << std::setw(10) << "p99" << std::setw(10) << "max"
+              << std::setw(10) << "share" << std::endl;
+    for (auto &s : st.stages)
+    {
+        std::cout << std::left << std::setw(20) << s.name << std::right << std::fixed
+                  << std::setprecision(2) << std::setw(10) << s.mean / 1000 << std::setw(10)
+                  << s.p50 / 1000 << std::setw(10) << s.p99 / 1000 << std::setw(10)
+                  << s.max / 1000 << std::setw(9) << s.share * 100 << "%" << std::endl;
+    }
+}
+
+void renderBatch(const std::string &outDir, int threads, const std::string &format, int maxPatches)
+{
+    /*
+     * Render every patch (or the first maxPatches) against a few fixed event streams, one job
+     * per patch and stream, sharded over a set of threads which each build a fresh synth per job.
+     * Each job seeds its synth and its thread's generator from the patch path and stream name,
+     * so a given job renders the same samples whatever thread runs it and whenever. The audio
+     * streams to disk a block at a time.
+     * Run with surge-headless --non-test --render-batch /tmp/renders 8 wav 100
+     */
+    const int sr = 48000;
+    auto fileFormat = format == "raw" ? AudioFileStream::RAW : AudioFileStream::WAV;
+    auto ext = fileFormat == AudioFileStream::RAW ? ".raw" : ".wav";
+    if (threads <= 0)
+        threads = std::max(1, (int)std::thread::hardware_concurrency());
+
+    struct Scenario
+    {
+        std::string name;
+        playerEvents_t events;
+    };
+    std::vector<Scenario> scenarios;
+    scenarios.push_back({"hold_c4", makeHoldMiddleC(sr * 2, sr)});
+    scenarios.push_back({"c_major", make120BPMCMajorQuarterNoteScale(0, sr)});
+    {
+        playerEvents_t chord;
+        for (auto n : {60, 64, 67})
+        {
+            auto o = makeHoldNoteFor(n, sr * 2);
+            chord.insert(chord.end(), o.begin(), o.end());
+        }
+        std::stable_sort(chord.begin(), chord.end(), [](const Event &a, const Event &b) {
+            return a.atSample < b.atSample;
+        });
+        Event tail;
+        tail.type = Event::NO_EVENT;
+        tail.atSample = sr * 3;
+        chord.push_back(tail);
+        scenarios.push_back({"c_chord", chord});
+    }
+
+    std::vector<Patch> patches;
+    {
+        auto surge = Surge::Headless::createSurge(sr);
+        patches = surge->storage.patch_list;
+    }
+    if (maxPatches > 0 && (int)patches.size() > maxPatches)
+        patches.resize(maxPatches);
+
+    fs::create_directories(string_to_path(outDir));
+
+    auto fnv1a = [](const std::string &s) {
+        uint32_t h = 2166136261u;
+        for (auto c : s)
+            h = (h ^ (uint8_t)c) * 16777619u;
+        return h;
+    };
+
+    // Gives a job its own seeded generator on this thread and puts back whatever was there
+    struct ScopedThreadRNG
+    {
+        SurgeStorage::RNGGen gen;
+        SurgeStorage::RNGGen *prior;
+
+        explicit ScopedThreadRNG(uint32_t seed) : prior(SurgeStorage::threadRNGGen)
+        {
+            gen.g.seed(seed);
+            SurgeStorage::threadRNGGen = &gen;
+        }
+        ~ScopedThreadRNG() { SurgeStorage::threadRNGGen = prior; }
+    };
+
+    size_t nJobs = patches.size() * scenarios.size();
+    std::cout << "Render Batch of " << patches.size() << " patches x " << scenarios.size()
+              << " event streams on " << threads << " threads into " << outDir << std::endl;
+
+    std::atomic<size_t> nextJob{0};
+    std::atomic<int> failed{0};
+    std::atomic<int64_t> samplesRendered{0};
+
+    auto worker = [&]() {
+        for (auto j = nextJob++; j < nJobs; j = nextJob++)
+        {
+            auto &p = patches[j / scenarios.size()];
+            auto &sc = scenarios[j % scenarios.size()];
+            auto path = path_to_string(p.path);
+            auto seed = fnv1a(path + "|" + sc.name);
+
+            ScopedThreadRNG rng(seed);
+
+            auto surge = Surge::Headless::createSurge(sr);
+            surge->seedRandomGenerators(seed);
+            if (!surge->loadPatchByPath(path.c_str(), -1, p.name.c_str()))
+            {
+                failed++;
+                continue;
+            }
+
+            std::ostringstream fn;
+            fn << std::setw(5) << std::setfill('0') << j / scenarios.size() << "_" << sc.name
+               << ext;
+            auto out = path_to_string(string_to_path(outDir) / fn.str());
+
+            AudioFileStream afs;
+            if (!afs.open(out, fileFormat, surge->getNumOutputs(), sr))
+            {
+                failed++;
+                continue;
+            }
+
+            int64_t n = 0;
+            bool writeOK = true;
+            playInBlocks(surge, sc.events, [&](const float *d, int ns, int nc) {
+                writeOK = writeOK && afs.write(d, ns);
+                n += ns;
+            });
+            if (!afs.close() || !writeOK)
+            {
+                failed++;
+                continue;
+            }
+
+            samplesRendered += n;
+        }
+    };
+
+    auto start = std::chrono::high_resolution_clock::now();
+    std::vector<std::thread> pool;
+    for (int t = 0; t < threads; ++t)
+        pool.emplace_back(worker);
+    for (auto &t : pool)
+        t.join();
+    auto end = std::chrono::high_resolution_clock::now();
+    auto secs = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1e6;
+    secs = std::max(secs, 1e-6);
+
+    std::cout << nJobs << " renders in " << secs << "s; " << nJobs / secs << " renders/s; "
+              << samplesRendered / (secs * sr) << "x realtime";
+    if (failed)
+        std::cout << "; " << failed << " failed";
+    std::cout << std::endl;
+}
+
 void generateNLFeedbackNorms()
 {
     /*
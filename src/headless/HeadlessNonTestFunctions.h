@@ -12,6 +12,13 @@ void statsFromPlayingEveryPatch();
 void filterAnalyzer(int ft, int fst, std::ostream &os);
 void generateNLFeedbackNorms();
 [[noreturn]] void performancePlay(const std::string &patchName, int mode);
+void sceneThreadingBenchmark(const std::string &patchName, int voicesPerScene);
+void voiceSnapshotBenchmark(int voices);
+void storageStartupBenchmark(int instances, const std::string &mode);
+void patchLoadBenchmark(int passes);
+void patchDBBenchmark(int patches, int readers);
+void blockProfile(const std::string &patchName, int voices, int seconds);
+void renderBatch(const std::string &outDir, int threads, const std::string &format, int maxPatches);
 } // namespace NonTest
 } // namespace Headless
 } // namespace Surge
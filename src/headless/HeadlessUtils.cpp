@@ -1,8 +1,11 @@
 #include "HeadlessUtils.h"
 #include "HeadlessPluginLayerProxy.h"
 
+#include <cstdint>
+#include <cstring>
 #include <iostream>
 #include <iomanip>
+#include <mutex>
 
 #if LIBSNDFILE
 #include <sndfile.h>
@@ -13,10 +16,10 @@ namespace Surge
 namespace Headless
 {
 static std::unique_ptr<HeadlessPluginLayerProxy> parent = nullptr;
+static std::once_flag parentOnce;
 std::shared_ptr<SurgeSynthesizer> createSurge(int sr)
 {
-    if (parent.get() == nullptr)
-        parent.reset(new HeadlessPluginLayerProxy());
+    std::call_once(parentOnce, []() { parent.reset(new HeadlessPluginLayerProxy()); });
     auto surge = std::shared_ptr<SurgeSynthesizer>(new SurgeSynthesizer(parent.get()));
     surge->setSamplerate(sr);
     surge->time_data.tempo = 120;
@@ -62,5 +65,85 @@ void writeToWav(const float *data, int nSamples, int nChannels, float sampleRate
 #endif
 }
 
+AudioFileStream::~AudioFileStream() { close(); }
+
+bool AudioFileStream::open(const std::string &fileName, Format fmt, int nc, float sr)
+{
+    close();
+    format = fmt;
+    nChannels = nc;
+    sampleRate = sr;
+    dataBytes = 0;
+
+    f = fopen(fileName.c_str(), "wb");
+    if (!f)
+        return false;
+
+    // Big buffers; these files are written front to back in block sized pieces
+    setvbuf(f, nullptr, _IOFBF, 1 << 16);
+
+    if (format == WAV && !writeWavHeader())
+    {
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool AudioFileStream::write(const float *data, int nSamples)
+{
+    if (!f)
+        return false;
+
+    size_t n = (size_t)nSamples * nChannels;
+    if (fwrite(data, sizeof(float), n, f) != n)
+        return false;
+    dataBytes += n * sizeof(float);
+    return true;
+}
+
+bool AudioFileStream::close()
+{
+    if (!f)
+        return true;
+
+    bool ok = true;
+    if (format == WAV)
+        ok = fseek(f, 0, SEEK_SET) == 0 && writeWavHeader();
+    ok = (fclose(f) == 0) && ok;
+    f = nullptr;
+    return ok;
+}
+
+bool AudioFileStream::writeWavHeader()
+{
+    // A WAVE_FORMAT_IEEE_FLOAT header; the sizes are whatever has been written so far
+    auto put32 = [](unsigned char *p, uint32_t v) {
+        for (int i = 0; i < 4; ++i)
+            p[i] = (unsigned char)((v >> (8 * i)) & 0xFF);
+    };
+    auto put16 = [](unsigned char *p, uint16_t v) {
+        p[0] = (unsigned char)(v & 0xFF);
+        p[1] = (unsigned char)((v >> 8) & 0xFF);
+    };
+
+    unsigned char h[44];
+    auto dataSize = (uint32_t)dataBytes;
+    memcpy(h, "RIFF", 4);
+    put32(h + 4, 36 + dataSize);
+    memcpy(h + 8, "WAVEfmt ", 8);
+    put32(h + 16, 16);
+    put16(h + 20, 3);
+    put16(h + 22, (uint16_t)nChannels);
+    put32(h + 24, (uint32_t)sampleRate);
+    put32(h + 28, (uint32_t)sampleRate * nChannels * sizeof(float));
+    put16(h + 32, (uint16_t)(nChannels * sizeof(float)));
+    put16(h + 34, 32);
+    memcpy(h + 36, "data", 4);
+    put32(h + 40, dataSize);
+
+    return fwrite(h, 1, sizeof(h), f) == sizeof(h);
+}
+
 } // namespace Headless
 } // namespace Surge
@@ -6,17 +6,59 @@
 
 #include "SurgeSynthesizer.h"
 
+#include <cstdio>
+#include <string>
+
 namespace Surge
 {
 namespace Headless
 {
 
+/*
+** Safe to call from several threads at once: the shared tables and catalogs are built once
+** (see SharedResources.h) and the user defaults every storage reads are behind a lock.
+*/
 std::shared_ptr<SurgeSynthesizer> createSurge(int sr);
 
 void writeToStream(const float *data, int nSamples, int nChannels, std::ostream &str);
 void writeToWav(const float *data, int nSamples, int nChannels, float sampleRate,
                 std::string wavFileName);
 
+/*
+** AudioFileStream writes interleaved float blocks straight to disk as they are rendered, so a
+** render never has to be held in memory. WAV files are 32 bit float with the sizes filled in on
+** close; RAW files are just the samples, native endian.
+*/
+class AudioFileStream
+{
+  public:
+    enum Format
+    {
+        WAV,
+        RAW
+    };
+
+    AudioFileStream() = default;
+    ~AudioFileStream();
+    AudioFileStream(const AudioFileStream &) = delete;
+    AudioFileStream &operator=(const AudioFileStream &) = delete;
+
+    bool open(const std::string &fileName, Format format, int nChannels, float sampleRate);
+    bool write(const float *data, int nSamples);
+    bool close();
+
+    size_t bytesWritten() const { return dataBytes; }
+
+  private:
+    bool writeWavHeader();
+
+    FILE *f{nullptr};
+    Format format{WAV};
+    int nChannels{2};
+    float sampleRate{48000};
+    size_t dataBytes{0};
+};
+
 /*
 ** One imagines expansions along these lines:
 
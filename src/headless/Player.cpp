@@ -74,7 +74,6 @@ void playAsConfigured(std::shared_ptr<SurgeSynthesizer> surge, const playerEvent
 
     int desiredSamples = events.back().atSample;
     int blockCount = desiredSamples / BLOCK_SIZE + 1;
-    int currEvt = 0;
 
     *nChannels = 2;
     *nSamples = blockCount * BLOCK_SIZE;
@@ -84,6 +83,24 @@ void playAsConfigured(std::shared_ptr<SurgeSynthesizer> surge, const playerEvent
     *data = ldata;
 
     size_t flidx = 0;
+    playInBlocks(surge, events, [&](const float *block, int n, int c) {
+        memcpy(ldata + flidx, block, n * c * sizeof(float));
+        flidx += n * c;
+    });
+}
+
+void playInBlocks(std::shared_ptr<SurgeSynthesizer> surge, const playerEvents_t &events,
+                  std::function<void(const float *data, int nSamples, int nChannels)> cb)
+{
+    if (events.size() == 0)
+        return;
+
+    int desiredSamples = events.back().atSample;
+    int blockCount = desiredSamples / BLOCK_SIZE + 1;
+    int currEvt = 0;
+
+    int nChannels = surge->getNumOutputs();
+    std::vector<float> ldata(BLOCK_SIZE * nChannels);
 
     surge->process();
 
@@ -112,13 +129,15 @@ void playAsConfigured(std::shared_ptr<SurgeSynthesizer> surge, const playerEvent
         }
 
         surge->process();
+        size_t flidx = 0;
         for (int sm = 0; sm < BLOCK_SIZE; ++sm)
         {
-            for (int oi = 0; oi < surge->getNumOutputs(); ++oi)
+            for (int oi = 0; oi < nChannels; ++oi)
             {
                 ldata[flidx++] = surge->output[oi][sm];
             }
         }
+        cb(ldata.data(), BLOCK_SIZE, nChannels);
     }
 }
 
@@ -7,6 +7,7 @@
 #pragma once
 
 #include "HeadlessUtils.h"
+#include <functional>
 #include <vector>
 
 namespace Surge
@@ -63,6 +64,15 @@ playerEvents_t make120BPMCMajorQuarterNoteScale(long sample0 = 0, int sr = 44100
 void playAsConfigured(std::shared_ptr<SurgeSynthesizer> synth, const playerEvents_t &events,
                       float **resultData, int *nSamples, int *nChannels);
 
+/**
+ * playInBlocks
+ *
+ * as playAsConfigured, but rather than collecting the result hand each block of interleaved
+ * output to the callback as it is rendered, so long renders can stream to disk
+ */
+void playInBlocks(std::shared_ptr<SurgeSynthesizer> synth, const playerEvents_t &events,
+                  std::function<void(const float *data, int nSamples, int nChannels)> cb);
+
 /**
  * playOnPatch
  *
@@ -1,10 +1,16 @@
 #include <memory>
 #include "SurgeSynthesizer.h"
+#include "PatchDB.h"
 #include "Player.h"
+#include "UnitTestUtilities.h"
 #include "catch2/catch2.hpp"
+#include <atomic>
+#include <chrono>
 #include <iostream>
 #include <cstdio>
+#include <sstream>
 #include <string>
+#include <thread>
 
 namespace Surge
 {
@@ -197,6 +203,52 @@ std::shared_ptr<SurgeSynthesizer> surgeOnPatch(const std::string &otp)
 std::shared_ptr<SurgeSynthesizer> surgeOnSine() { return surgeOnPatch("Init Sine"); }
 std::shared_ptr<SurgeSynthesizer> surgeOnSaw() { return surgeOnPatch("Init Saw"); }
 
+ScratchPatchFolder::ScratchPatchFolder(const std::string &name)
+{
+    static std::atomic<int> made{0};
+    auto base = fs::temp_directory_path();
+    for (int attempt = 0; dir.empty() && attempt < 100; ++attempt)
+    {
+        // create_directory is false for a folder which is already there, which keeps this unique
+        std::ostringstream oss;
+        oss << "surge-" << name << "-"
+            << std::chrono::steady_clock::now().time_since_epoch().count() << "-" << made++;
+        std::error_code ec;
+        if (fs::create_directory(base / string_to_path(oss.str()), ec))
+            dir = base / string_to_path(oss.str());
+    }
+    REQUIRE(!dir.empty());
+
+    surge = Surge::Headless::createSurge(44100);
+    surge->storage.userDataPath = path_to_string(dir);
+}
+
+ScratchPatchFolder::~ScratchPatchFolder()
+{
+    surge.reset();
+    std::error_code ec;
+    fs::remove_all(dir, ec);
+}
+
+fs::path ScratchPatchFolder::savePatch(const std::string &fileStem)
+{
+    auto p = dir / string_to_path(fileStem + ".fxp");
+    surge->savePatchToPath(p);
+    return p;
+}
+
+bool waitForPatchDB(Surge::PatchStorage::PatchDB &db, int timeoutMs)
+{
+    auto until = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    while (db.numberOfJobsOutstanding() > 0)
+    {
+        if (std::chrono::steady_clock::now() > until)
+            return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    return true;
+}
+
 void makePlotPNGFromData(std::string pngFileName, std::string plotTitle, float *buffer, int nS,
                          int nC, int startSample, int endSample)
 {
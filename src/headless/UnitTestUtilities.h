@@ -7,6 +7,11 @@
 
 namespace Surge
 {
+namespace PatchStorage
+{
+class PatchDB;
+}
+
 namespace Test
 {
 
@@ -39,5 +44,26 @@ void makePlotPNGFromData(std::string pngFileName, std::string plotTitle, float *
 std::shared_ptr<SurgeSynthesizer> surgeOnPatch(const std::string &patchName);
 std::shared_ptr<SurgeSynthesizer> surgeOnSine();
 std::shared_ptr<SurgeSynthesizer> surgeOnSaw();
+
+/*
+** A synth with a folder of its own for patches and user data, made fresh under the system temp
+** directory and removed with everything in it when this goes away, so tests which run at the
+** same time never see each other's files. Anything using the synth, like a PatchDB, has to go
+** before this does.
+*/
+struct ScratchPatchFolder
+{
+    explicit ScratchPatchFolder(const std::string &name);
+    ~ScratchPatchFolder();
+
+    // Saves the synth's current patch into the folder as fileStem.fxp
+    fs::path savePatch(const std::string &fileStem);
+
+    fs::path dir;
+    std::shared_ptr<SurgeSynthesizer> surge;
+};
+
+// Waits for the database to finish what it was given; false if that takes longer than timeoutMs
+bool waitForPatchDB(Surge::PatchStorage::PatchDB &db, int timeoutMs = 30000);
 } // namespace Test
 } // namespace Surge
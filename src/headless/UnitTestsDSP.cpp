@@ -15,8 +15,10 @@
 
 #include "SSEComplex.h"
 #include <complex>
+#include <thread>
 
 #include "LanczosResampler.h"
+#include "BlockFifo.h"
 
 using namespace Surge::Test;
 
@@ -1054,4 +1056,331 @@ TEST_CASE("Wavehaper LUT", "[dsp]")
             }
         }
     }
-}
\ No newline at end of file
+}
+TEST_CASE("Multithreaded Scenes are Bit Identical", "[dsp]")
+{
+    auto setup = [](bool threaded) {
+        auto surge = Surge::Headless::createSurge(44100);
+        surge->setMultithreadedSceneRendering(threaded);
+        surge->storage.getPatch().scenemode.val.i = sm_dual;
+        for (int s = 0; s < n_scenes; ++s)
+        {
+            surge->storage.getPatch().scene[s].osc[0].type.val.i = ot_classic;
+            surge->storage.getPatch().scene[s].filterunit[0].type.val.i = fut_lp24;
+        }
+        surge->storage.getPatch().scene[1].osc[0].type.val.i = ot_wavetable;
+
+        surge->storage.rngGen.g.seed(1234);
+        for (int s = 0; s < n_scenes; ++s)
+        {
+            surge->sceneRNGGen[s].g.seed(5678 + s);
+            for (int q = 0; q < MAX_VOICES >> 2; ++q)
+                surge->voiceQuadRNGGen[s][q].g.seed(9012 + q);
+        }
+
+        for (int i = 0; i < 10; ++i)
+            surge->process();
+        return surge;
+    };
+
+    auto serial = setup(false);
+    auto threaded = setup(true);
+    REQUIRE(threaded->getMultithreadedSceneRendering());
+
+    int notes[] = {48, 55, 60, 64, 67, 71, 72};
+    for (auto n : notes)
+    {
+        serial->playNote(0, n, 100, 0);
+        threaded->playNote(0, n, 100, 0);
+    }
+    REQUIRE(threaded->canProcessScenesInParallel());
+
+    for (int b = 0; b < 2000; ++b)
+    {
+        if (b == 1000)
+        {
+            for (auto n : notes)
+            {
+                serial->releaseNote(0, n, 0);
+                threaded->releaseNote(0, n, 0);
+            }
+        }
+        serial->process();
+        threaded->process();
+
+        INFO("Block " << b);
+        for (int c = 0; c < N_OUTPUTS; ++c)
+        {
+            for (int i = 0; i < BLOCK_SIZE; ++i)
+            {
+                REQUIRE(serial->output[c][i] == threaded->output[c][i]);
+                for (int s = 0; s < n_scenes; ++s)
+                    REQUIRE(serial->sceneout[s][c][i] == threaded->sceneout[s][c][i]);
+            }
+        }
+        REQUIRE(serial->polydisplay == threaded->polydisplay);
+    }
+}
+
+TEST_CASE("Multithreaded Voices are Bit Identical", "[dsp]")
+{
+    auto setup = [](bool threaded) {
+        auto surge = Surge::Headless::createSurge(44100);
+        surge->setMultithreadedVoiceRendering(threaded);
+        surge->setHostBlockSize(256);
+        surge->storage.getPatch().scene[0].osc[0].type.val.i = ot_classic;
+        surge->storage.getPatch().scene[0].osc[1].type.val.i = ot_wavetable;
+        surge->storage.getPatch().scene[0].filterunit[0].type.val.i = fut_lp24;
+        surge->storage.getPatch().scene[0].filterunit[1].type.val.i = fut_comb_pos;
+
+        surge->storage.rngGen.g.seed(1234);
+        for (int s = 0; s < n_scenes; ++s)
+        {
+            surge->sceneRNGGen[s].g.seed(5678 + s);
+            for (int q = 0; q < MAX_VOICES >> 2; ++q)
+                surge->voiceQuadRNGGen[s][q].g.seed(9012 + q);
+        }
+
+        for (int i = 0; i < 10; ++i)
+            surge->process();
+        return surge;
+    };
+
+    auto serial = setup(false);
+    auto threaded = setup(true);
+    REQUIRE(threaded->getMultithreadedVoiceRendering());
+
+    // Three quads, the last one partially filled, and releases staggered so voices drop
+    // out of the middle of the list
+    int notes[] = {36, 43, 48, 52, 55, 60, 62, 64, 67, 71};
+    for (auto n : notes)
+    {
+        serial->playNote(0, n, 100, 0);
+        threaded->playNote(0, n, 100, 0);
+    }
+    REQUIRE(threaded->canProcessVoicesInParallel(0));
+
+    threaded->setHostBlockSize(32);
+    REQUIRE(!threaded->canProcessVoicesInParallel(0));
+    threaded->setHostBlockSize(256);
+
+    for (int b = 0; b < 3000; ++b)
+    {
+        if (b >= 1000 && b < 1000 + 10 * 100 && b % 100 == 0)
+        {
+            auto n = notes[(b - 1000) / 100];
+            serial->releaseNote(0, n, 0);
+            threaded->releaseNote(0, n, 0);
+        }
+        serial->process();
+        threaded->process();
+
+        INFO("Block " << b);
+        for (int c = 0; c < N_OUTPUTS; ++c)
+        {
+            for (int i = 0; i < BLOCK_SIZE; ++i)
+            {
+                REQUIRE(serial->output[c][i] == threaded->output[c][i]);
+            }
+        }
+        REQUIRE(serial->polydisplay == threaded->polydisplay);
+    }
+}
+
+TEST_CASE("Sparse Voice Snapshot Tracks Its Scene", "[dsp]")
+{
+    auto surge = Surge::Headless::createSurge(44100);
+    REQUIRE(surge);
+
+    auto &patch = surge->storage.getPatch();
+    auto &sc = patch.scene[0];
+    auto &sd = patch.scenedata[0];
+    sc.mute_o2.val.b = true;
+    sc.mute_o3.val.b = true;
+
+    // Velocity into the muted second oscillator, so the destination sits outside the snapshot
+    auto dst = sc.osc[1].p[0].param_id_in_scene;
+    REQUIRE(surge->setModulation(sc.osc[1].p[0].id, ms_velocity, 0, 0.5f));
+    REQUIRE(sc.modulation_voice.size() == 1);
+    auto depth = sc.modulation_voice[0].depth;
+
+    for (int i = 0; i < 10; ++i)
+        surge->process();
+    surge->playNote(0, 60, 100, 0);
+    surge->process();
+    REQUIRE(surge->voices[0].size() == 1);
+    auto v = surge->voices[0].front();
+    REQUIRE(v->snapshotParamCount() < n_scene_params);
+
+    SECTION("Skipped Destinations Do Not Accumulate")
+    {
+        for (int i = 0; i < 200; ++i)
+            surge->process();
+        REQUIRE(v->localcopy[dst].f == Approx(sd[dst].f + depth * 100.f / 127.f));
+    }
+
+    SECTION("Unmuting An Oscillator Catches Up Its Parameters")
+    {
+        auto pitch = sc.osc[1].pitch.param_id_in_scene;
+        auto before = v->snapshotParamCount();
+        sc.osc[1].pitch.val.f = 7.f;
+        for (int i = 0; i < 10; ++i)
+            surge->process();
+
+        sc.mute_o2.val.b = false;
+        surge->switch_toggled_queued = true;
+        surge->process();
+        REQUIRE(v->snapshotParamCount() > before);
+        REQUIRE(v->localcopy[pitch].f == 7.f);
+        REQUIRE(v->localcopy[pitch].f == sd[pitch].f);
+    }
+
+    SECTION("Scene Level Parameters Stay Out Of The Snapshot")
+    {
+        // Sends are applied to the scene's output, so a voice never reads them
+        auto send = sc.send_level[0].param_id_in_scene;
+        auto volume = sc.volume.param_id_in_scene;
+        auto stale = v->localcopy[send].f;
+        sc.send_level[0].val.f = stale + 0.5f;
+        sc.volume.val.f = -3.f;
+        for (int i = 0; i < 10; ++i)
+            surge->process();
+        REQUIRE(v->localcopy[send].f == stale);
+        REQUIRE(v->localcopy[volume].f == sd[volume].f);
+    }
+
+    SECTION("Routing A Voice LFO Brings It Into The Snapshot")
+    {
+        auto rate = sc.lfo[2].rate.param_id_in_scene;
+        auto before = v->snapshotParamCount();
+        sc.lfo[2].rate.val.f = 2.5f;
+        for (int i = 0; i < 10; ++i)
+            surge->process();
+
+        REQUIRE(surge->setModulation(sc.filterunit[0].cutoff.id, ms_lfo3, 0, 0.1f));
+        surge->process();
+        REQUIRE(v->snapshotParamCount() > before);
+        REQUIRE(v->localcopy[rate].f == 2.5f);
+    }
+}
+
+TEST_CASE("Seeded Renders Are Repeatable Across Threads", "[dsp]")
+{
+    auto render = [](uint32_t seed) {
+        SurgeStorage::RNGGen threadGen;
+        threadGen.g.seed(seed);
+        SurgeStorage::threadRNGGen = &threadGen;
+
+        auto surge = Surge::Headless::createSurge(44100);
+        surge->seedRandomGenerators(seed);
+        surge->storage.getPatch().scene[0].osc[0].type.val.i = ot_classic;
+        surge->storage.getPatch().scene[0].drift.val.f = 1.f;
+
+        std::vector<float> res;
+        auto events = Surge::Headless::makeHoldNoteFor(60, 44100 / 2, 4410);
+        Surge::Headless::playInBlocks(surge, events, [&res](const float *d, int ns, int nc) {
+            res.insert(res.end(), d, d + ns * nc);
+        });
+
+        SurgeStorage::threadRNGGen = nullptr;
+        return res;
+    };
+
+    auto reference = render(1234);
+    REQUIRE(reference.size() > 0);
+
+    std::vector<std::vector<float>> results(4);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t)
+        threads.emplace_back([&results, &render, t]() { results[t] = render(1234); });
+    for (auto &t : threads)
+        t.join();
+
+    for (auto &r : results)
+        REQUIRE(r == reference);
+
+    // and the seed is what pins it
+    REQUIRE(render(5678) != reference);
+}
+
+TEST_CASE("Block FIFO Handles Jittered Buffers", "[dsp]")
+{
+    // Hosts split their buffers however they like, so give it ragged tails and odd sizes
+    std::vector<int> sizes = {1, 31, 33, 257, BLOCK_SIZE, 7, 2 * BLOCK_SIZE, 63, 1, 1, 500};
+    std::mt19937 gen(2112);
+    std::uniform_int_distribution<int> jitter(1, 4 * BLOCK_SIZE + 1);
+    for (int i = 0; i < 200; ++i)
+        sizes.push_back(jitter(gen));
+
+    int total = 0;
+    for (auto s : sizes)
+        total += s;
+
+    std::vector<float> inL(total), inR(total), sideIn(total);
+    for (int i = 0; i < total; ++i)
+    {
+        inL[i] = i + 1;
+        inR[i] = -(i + 1);
+        sideIn[i] = 0.5f * (i + 1);
+    }
+
+    REQUIRE(BlockFifo::latency == BLOCK_SIZE);
+
+    BlockFifo fifo;
+    std::vector<float> outL, outR, sideSeen;
+    int blocks = 0;
+    auto doubleIt = [&](float *L, float *R, const float *sideL, const float *sideR) {
+        REQUIRE(((uintptr_t)L & 15) == 0);
+        REQUIRE(((uintptr_t)R & 15) == 0);
+        for (int i = 0; i < BLOCK_SIZE; ++i)
+        {
+            L[i] *= 2;
+            R[i] *= 2;
+            sideSeen.push_back(sideL[i]);
+            REQUIRE(sideR[i] == 0.f);
+        }
+        blocks++;
+    };
+
+    const int guard = 8;
+    const float guardValue = 1234.5f;
+    int at = 0;
+    for (auto s : sizes)
+    {
+        // Each buffer sits between guard samples, which must come out untouched
+        std::vector<float> L(s + 2 * guard, guardValue), R(s + 2 * guard, guardValue);
+        std::copy(inL.begin() + at, inL.begin() + at + s, L.begin() + guard);
+        std::copy(inR.begin() + at, inR.begin() + at + s, R.begin() + guard);
+
+        fifo.process(&L[guard], &R[guard], &sideIn[at], nullptr, s, doubleIt,
+                     []() { return true; });
+
+        for (int i = 0; i < guard; ++i)
+        {
+            REQUIRE(L[i] == guardValue);
+            REQUIRE(R[i] == guardValue);
+            REQUIRE(L[guard + s + i] == guardValue);
+            REQUIRE(R[guard + s + i] == guardValue);
+        }
+
+        outL.insert(outL.end(), L.begin() + guard, L.begin() + guard + s);
+        outR.insert(outR.end(), R.begin() + guard, R.begin() + guard + s);
+        at += s;
+    }
+
+    REQUIRE(blocks == total / BLOCK_SIZE);
+
+    // Exactly one block late, whatever the buffers looked like
+    for (int i = 0; i < total; ++i)
+    {
+        auto expectL = i < BLOCK_SIZE ? 0.f : 2 * inL[i - BLOCK_SIZE];
+        auto expectR = i < BLOCK_SIZE ? 0.f : 2 * inR[i - BLOCK_SIZE];
+        REQUIRE(outL[i] == expectL);
+        REQUIRE(outR[i] == expectR);
+    }
+
+    // and the sidechain reaches each block with the audio it arrived with
+    REQUIRE(sideSeen.size() == blocks * BLOCK_SIZE);
+    for (int i = 0; i < sideSeen.size(); ++i)
+        REQUIRE(sideSeen[i] == sideIn[i]);
+}
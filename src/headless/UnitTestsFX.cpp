@@ -10,6 +10,8 @@
 
 #include "UnitTestUtilities.h"
 #include "FastMath.h"
+#include <chrono>
+#include <thread>
 
 using namespace Surge::Test;
 
@@ -61,3 +63,67 @@ TEST_CASE("Airwindows Loud", "[fx]")
         }
     }
 }
+
+TEST_CASE("FX Type Changes Are Prepared Off The Audio Thread", "[fx]")
+{
+    auto sync = Surge::Headless::createSurge(44100);
+    auto async = Surge::Headless::createSurge(44100);
+    REQUIRE(sync);
+    REQUIRE(async);
+    REQUIRE(async->fxPreparer);
+
+    for (int i = 0; i < 10; ++i)
+    {
+        sync->process();
+        async->process();
+    }
+
+    // Once audio is running, type changes go through the preparer
+    async->audio_processing_active = true;
+
+    for (auto type : {fxt_reverb2, fxt_delay, fxt_combulator, fxt_off})
+    {
+        INFO("Switching to FX type " << type);
+        for (auto s : {sync, async})
+        {
+            auto *pt = &(s->storage.getPatch().fx[0].type);
+            s->setParameter01(s->idForParameter(pt),
+                              Parameter::intScaledToFloat(type, pt->val_max.i, pt->val_min.i),
+                              false);
+            s->process();
+        }
+
+        REQUIRE(sync->storage.getPatch().fx[0].type.val.i == type);
+
+        for (int i = 0; i < 5000 && async->storage.getPatch().fx[0].type.val.i != type; ++i)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            async->process();
+        }
+        REQUIRE(async->storage.getPatch().fx[0].type.val.i == type);
+        REQUIRE((bool)async->fx[0] == (bool)sync->fx[0]);
+        REQUIRE((bool)async->fx[0] == (type != fxt_off));
+
+        for (int p = 0; p < n_fx_params; ++p)
+        {
+            REQUIRE(async->storage.getPatch().fx[0].p[p].ctrltype ==
+                    sync->storage.getPatch().fx[0].p[p].ctrltype);
+            REQUIRE(async->storage.getPatch().fx[0].p[p].val.i ==
+                    sync->storage.getPatch().fx[0].p[p].val.i);
+        }
+
+        async->playNote(0, 60, 127, 0);
+        for (int i = 0; i < 100; ++i)
+        {
+            async->process();
+            for (int s = 0; s < BLOCK_SIZE; ++s)
+                REQUIRE(std::isfinite(async->output[0][s]));
+        }
+        async->releaseNote(0, 60, 0);
+    }
+
+    // And everything we replaced along the way has been destroyed over there too
+    for (int i = 0; i < 5000 && async->fxPreparer->hasPendingWork(); ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    REQUIRE(!async->fxPreparer->hasPendingWork());
+}
@@ -1,9 +1,12 @@
 #include <iostream>
 #include <algorithm>
+#include <set>
 
 #include "HeadlessUtils.h"
 #include "BiquadFilter.h"
 #include "QuadFilterUnit.h"
+#include "SharedResources.h"
+#include "BlockProfiler.h"
 
 #include "catch2/catch2.hpp"
 
@@ -78,4 +81,141 @@ TEST_CASE("QFU is Aligned", "[infra]")
             delete[] f;
         }
     }
-}
\ No newline at end of file
+}
+
+TEST_CASE("Storage Instances Share Resources", "[infra]")
+{
+    SECTION("One Copy While Any Instance Lives")
+    {
+        auto a = Surge::Headless::createSurge(44100);
+        auto b = Surge::Headless::createSurge(44100);
+        REQUIRE(a->storage.sharedResources == b->storage.sharedResources);
+        REQUIRE(&a->storage.WindowWT == &b->storage.WindowWT);
+        REQUIRE(a->storage.WindowWT.size > 0);
+        REQUIRE(!a->storage.helpURL_controlgroup.empty());
+
+        REQUIRE(a->storage.sharedCatalog == b->storage.sharedCatalog);
+        REQUIRE(a->storage.patch_list.size() == b->storage.patch_list.size());
+        REQUIRE(a->storage.wt_list.size() == b->storage.wt_list.size());
+        for (int i = 0; i < a->storage.patch_list.size(); ++i)
+        {
+            REQUIRE(a->storage.patch_list[i].name == b->storage.patch_list[i].name);
+            REQUIRE(a->storage.patch_list[i].order == b->storage.patch_list[i].order);
+        }
+
+        std::weak_ptr<const Surge::Storage::SharedResources> res = a->storage.sharedResources;
+        std::weak_ptr<Surge::Storage::SharedCatalog> cat = a->storage.sharedCatalog;
+        a.reset();
+        REQUIRE(!res.expired());
+        REQUIRE(!cat.expired());
+        b.reset();
+        REQUIRE(res.expired());
+        REQUIRE(cat.expired());
+    }
+
+    SECTION("Shared And Unshared Instances Agree")
+    {
+        auto a = Surge::Headless::createSurge(44100);
+        Surge::Storage::SharedResources::sharingEnabled = false;
+        auto b = Surge::Headless::createSurge(44100);
+        Surge::Storage::SharedResources::sharingEnabled = true;
+
+        REQUIRE(a->storage.sharedResources != b->storage.sharedResources);
+        REQUIRE(a->storage.WindowWT.size == b->storage.WindowWT.size);
+        REQUIRE(a->storage.WindowWT.n_tables == b->storage.WindowWT.n_tables);
+        REQUIRE(a->storage.helpURL_paramidentifier == b->storage.helpURL_paramidentifier);
+        REQUIRE(a->storage.helpURL_specials == b->storage.helpURL_specials);
+        REQUIRE(a->storage.patch_list.size() == b->storage.patch_list.size());
+        REQUIRE(a->storage.patchCategoryOrdering == b->storage.patchCategoryOrdering);
+        REQUIRE(a->storage.wtOrdering == b->storage.wtOrdering);
+    }
+}
+
+TEST_CASE("Block Profiler Attributes Time To Stages", "[infra]")
+{
+    using bp = Surge::Profiling::BlockProfiler;
+    auto p = std::make_unique<bp>();
+
+    SECTION("Stages sum into their block")
+    {
+        for (int b = 0; b < 10; ++b)
+        {
+            p->add(bp::st_voices + 1, 300);
+            p->add(bp::st_voices + 1, 100);
+            p->add(bp::st_fx + fxslot_send1, 100);
+            p->add(bp::st_block, 1000);
+            p->endBlock();
+        }
+
+        auto st = p->stats();
+        REQUIRE(st.blocks == 10);
+        REQUIRE(st.historyBlocks == 10);
+        REQUIRE(st.stages.size() == 3);
+
+        for (auto &s : st.stages)
+        {
+            INFO("Stage " << s.name);
+            if (s.stage == bp::st_block)
+            {
+                REQUIRE(s.mean == 1000);
+                REQUIRE(s.share == 1.0);
+            }
+            else if (s.stage == bp::st_voices + 1)
+            {
+                REQUIRE(s.name == "scene B voices");
+                REQUIRE(s.p50 == 400);
+                REQUIRE(s.max == 400);
+                REQUIRE(s.share == Approx(0.4));
+                REQUIRE(s.totalNS == 4000);
+            }
+            else
+            {
+                REQUIRE(s.stage == bp::st_fx + fxslot_send1);
+                REQUIRE(s.name == fxslot_names[fxslot_send1]);
+            }
+        }
+    }
+
+    SECTION("History wraps and reset clears")
+    {
+        for (int b = 0; b < bp::historySize + 20; ++b)
+        {
+            p->add(bp::st_block, b);
+            p->endBlock();
+        }
+        auto st = p->stats();
+        REQUIRE(st.blocks == bp::historySize + 20);
+        // The oldest slot is the one the next block writes, so a full ring can't trust it
+        REQUIRE(st.historyBlocks == bp::historySize - 1);
+        REQUIRE(st.stages[0].max == bp::historySize + 19);
+
+        p->reset();
+        p->add(bp::st_block, 7);
+        p->endBlock();
+        st = p->stats();
+        REQUIRE(st.blocks == 1);
+        REQUIRE(st.historyBlocks == 1);
+        REQUIRE(st.stages[0].mean == 7);
+    }
+
+#if SURGE_BLOCK_PROFILING
+    SECTION("A synth fills in its stages")
+    {
+        auto surge = Surge::Headless::createSurge(44100);
+        REQUIRE(surge->storage.profiler);
+        surge->playNote(0, 60, 100, 0);
+        for (int i = 0; i < 100; ++i)
+            surge->process();
+
+        auto st = surge->storage.profiler->stats();
+        REQUIRE(st.blocks >= 100);
+        std::set<int> seen;
+        for (auto &s : st.stages)
+            seen.insert(s.stage);
+        REQUIRE(seen.count(bp::st_block));
+        REQUIRE(seen.count(bp::st_control));
+        REQUIRE(seen.count(bp::st_voices));
+        REQUIRE(seen.count(bp::st_filters));
+    }
+#endif
+}
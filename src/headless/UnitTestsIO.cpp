@@ -9,7 +9,14 @@
 #include "catch2/catch2.hpp"
 
 #include "UnitTestUtilities.h"
+#include "WavetableLoader.h"
+#include "ServiceThread.h"
+#include "MappedFile.h"
+#include "PatchCache.h"
+#include "PatchDB.h"
+#include "MSEGModulationHelper.h"
 #include <chrono>
+#include <set>
 #include <thread>
 
 #include <unordered_map>
@@ -73,6 +80,210 @@ TEST_CASE("All .wt and .wav factory assets load", "[io]")
     }
 }
 
+TEST_CASE("Queued Wavetables Load Off The Audio Thread", "[io]")
+{
+    auto sync = Surge::Headless::createSurge(44100);
+    auto async = Surge::Headless::createSurge(44100);
+    REQUIRE(sync);
+    REQUIRE(async);
+    REQUIRE(async->storage.wavetableLoader);
+    REQUIRE(async->storage.wt_list.size() > 3);
+
+    // Once audio is running the loads go to the service thread
+    async->audio_processing_active = true;
+
+    for (auto wti : {1, 3})
+    {
+        INFO("Loading wavetable " << wti);
+        for (auto s : {sync, async})
+        {
+            s->storage.getPatch().scene[0].osc[0].type.val.i = ot_wavetable;
+            s->storage.getPatch().scene[0].osc[0].wt.queue_id = wti;
+            s->process();
+        }
+
+        auto &swt = sync->storage.getPatch().scene[0].osc[0].wt;
+        auto &awt = async->storage.getPatch().scene[0].osc[0].wt;
+        REQUIRE(swt.current_id == wti);
+
+        // The request stays queued on the oscillator until the loader has a free slot for it
+        auto loading = [&]() {
+            return awt.queue_id != -1 || async->storage.wavetableLoader->hasPendingLoads();
+        };
+        for (int i = 0; i < 5000 && loading(); ++i)
+        {
+            std::this_thread::sleep_for(1ms);
+            async->process();
+        }
+        REQUIRE(!loading());
+
+        REQUIRE(awt.current_id == wti);
+        REQUIRE(awt.size == swt.size);
+        REQUIRE(awt.n_tables == swt.n_tables);
+        REQUIRE(awt.flags == swt.flags);
+        REQUIRE(std::string(async->storage.getPatch().scene[0].osc[0].wavetable_display_name) ==
+                std::string(sync->storage.getPatch().scene[0].osc[0].wavetable_display_name));
+        for (int t = 0; t < (int)swt.n_tables; ++t)
+        {
+            for (int i = 0; i < swt.size; ++i)
+            {
+                REQUIRE(awt.TableF32WeakPointers[0][t][i] == swt.TableF32WeakPointers[0][t][i]);
+            }
+        }
+    }
+}
+
+TEST_CASE("Queued Patches Load On The Patch Loader Thread", "[io]")
+{
+    auto sync = Surge::Headless::createSurge(44100);
+    auto async = Surge::Headless::createSurge(44100);
+    REQUIRE(sync);
+    REQUIRE(async);
+    REQUIRE(async->patchLoader);
+    REQUIRE(async->storage.patch_list.size() > 20);
+
+    async->audio_processing_active = true;
+
+    for (auto pid : {7, 19})
+    {
+        INFO("Loading patch " << pid << " " << async->storage.patch_list[pid].name);
+        sync->loadPatch(pid);
+
+        async->patchid_queue = pid;
+        async->process();
+
+        // The request is handed over at once and the engine keeps running while it is prepared
+        REQUIRE(async->patchid_queue == -1);
+        REQUIRE(!async->patchLoader->isIdle());
+
+        auto loading = [&]() { return !async->patchLoader->isIdle() || async->halt_engine; };
+        for (int i = 0; i < 5000 && loading(); ++i)
+        {
+            std::this_thread::sleep_for(1ms);
+            async->process();
+        }
+        REQUIRE(!loading());
+
+        auto &sp = sync->storage.getPatch();
+        auto &ap = async->storage.getPatch();
+        REQUIRE(async->patchid == sync->patchid);
+        REQUIRE(ap.name == sp.name);
+        REQUIRE(ap.category == sp.category);
+        for (int i = 0; i < (int)sp.param_ptr.size(); ++i)
+        {
+            INFO("Parameter " << sp.param_ptr[i]->get_storage_name());
+            REQUIRE(ap.param_ptr[i]->val.i == sp.param_ptr[i]->val.i);
+        }
+        for (int s = 0; s < n_fx_slots; ++s)
+        {
+            REQUIRE((bool)async->fx[s] == (bool)sync->fx[s]);
+        }
+
+        // and then fades back in
+        for (int i = 0; i < 100 && async->masterfade < 1.f; ++i)
+            async->process();
+        REQUIRE(async->masterfade == 1.f);
+    }
+
+    // Request, prepare and commit all went through the service thread's queue
+    REQUIRE(async->serviceThread->getStats().serviced >= 4);
+}
+
+TEST_CASE("Queued Patches Bring Their Tuning Before The Engine Restarts", "[io]")
+{
+    auto surge = Surge::Headless::createSurge(44100);
+    REQUIRE(surge->patchLoader);
+    REQUIRE(surge->storage.isStandardTuning);
+    surge->audio_processing_active = true;
+
+    strncpy(surge->patchid_file, "resources/test-data/patches/HasSCL.fxp", FILENAME_MAX - 1);
+    surge->has_patchid_file = true;
+    surge->process();
+    REQUIRE(!surge->has_patchid_file);
+
+    // The voices read the tuning tables as soon as the engine runs, so they must be ready then
+    bool sawEngineBack = false;
+    for (int i = 0; i < 5000 && !sawEngineBack; ++i)
+    {
+        std::this_thread::sleep_for(1ms);
+        if (!surge->patchLoader->isIdle() || surge->halt_engine)
+        {
+            surge->process();
+            continue;
+        }
+        sawEngineBack = true;
+        REQUIRE(!surge->storage.isStandardTuning);
+        REQUIRE(surge->storage.isStandardMapping);
+    }
+    REQUIRE(sawEngineBack);
+}
+
+TEST_CASE("Service Thread Runs Posted Commands", "[io]")
+{
+    using Surge::Storage::ServiceThread;
+
+    ServiceThread st;
+    std::atomic<int> fxRuns{0}, wtRuns{0};
+    st.setHandler(ServiceThread::fxLoad, [&]() {
+        fxRuns++;
+        return false;
+    });
+    st.setHandler(ServiceThread::wavetableLoad, [&]() {
+        wtRuns++;
+        return false;
+    });
+    st.start();
+
+    auto waitFor = [&](uint64_t n) {
+        for (int i = 0; i < 5000; ++i)
+        {
+            auto s = st.getStats();
+            if (s.serviced + s.dropped >= n)
+                return;
+            std::this_thread::sleep_for(1ms);
+        }
+    };
+
+    SECTION("From One Thread")
+    {
+        for (int i = 0; i < 10; ++i)
+            REQUIRE(st.post(ServiceThread::fxLoad));
+        waitFor(10);
+
+        auto s = st.getStats();
+        REQUIRE(s.serviced == 10);
+        REQUIRE(s.dropped == 0);
+        REQUIRE(s.queueDepth == 0);
+        REQUIRE(s.maxQueueDepth >= 1);
+        REQUIRE(s.maxLatencyMs >= s.meanLatencyMs);
+        // Handlers also run on the idle sweep, so at least once per command
+        REQUIRE(fxRuns >= 10);
+
+        st.resetStats();
+        REQUIRE(st.getStats().serviced == 0);
+    }
+
+    SECTION("From Several Threads")
+    {
+        std::vector<std::thread> posters;
+        for (int t = 0; t < 4; ++t)
+        {
+            posters.emplace_back([&st, t]() {
+                for (int i = 0; i < 1000; ++i)
+                    st.post((t + i) % 2 ? ServiceThread::fxLoad : ServiceThread::wavetableLoad);
+            });
+        }
+        for (auto &p : posters)
+            p.join();
+        waitFor(4000);
+
+        auto s = st.getStats();
+        REQUIRE(s.serviced + s.dropped == 4000);
+        REQUIRE(s.maxQueueDepth <= (int)ServiceThread::queueSize);
+        REQUIRE(fxRuns + wtRuns >= (int)s.serviced);
+    }
+}
+
 TEST_CASE("All Patches are Loadable", "[io]")
 {
     auto surge = Surge::Headless::createSurge(44100);
@@ -682,3 +893,738 @@ TEST_CASE("MonoVoicePriority Streams", "[io]")
         }
     }
 }
+
+TEST_CASE("Mapped Patch Files Load Like Buffered Ones", "[io]")
+{
+    auto prepare = [](std::shared_ptr<SurgeSynthesizer> surge, const std::string &path,
+                      bool mapped, PreparedPatch &pp) {
+        Surge::Storage::MappedFile::mappingEnabled = mapped;
+        auto res = surge->preparePatchFromPath(path.c_str(), "Test", pp);
+        Surge::Storage::MappedFile::mappingEnabled = true;
+        return res;
+    };
+
+    for (auto fn : {"Church.fxp", "Wavetable-Sin-Uni2-Absolute.fxp", "HasSCL.fxp"})
+    {
+        DYNAMIC_SECTION("Patch " << fn)
+        {
+            auto path = std::string("resources/test-data/patches/") + fn;
+
+            Surge::Storage::MappedFile mf;
+            REQUIRE(mf.open(string_to_path(path)));
+            REQUIRE(mf.size() == fs::file_size(string_to_path(path)));
+#if !WINDOWS
+            REQUIRE(mf.isMapped());
+#endif
+            mf.close();
+            REQUIRE(mf.data() == nullptr);
+
+            auto sbuf = Surge::Headless::createSurge(44100);
+            auto smap = Surge::Headless::createSurge(44100);
+
+            PreparedPatch pbuf, pmap;
+            REQUIRE(prepare(sbuf, path, false, pbuf));
+            REQUIRE(prepare(smap, path, true, pmap));
+
+            for (int sc = 0; sc < n_scenes; ++sc)
+            {
+                for (int o = 0; o < n_oscs; ++o)
+                {
+                    auto &wb = pbuf.wavetables[sc][o];
+                    auto &wm = pmap.wavetables[sc][o];
+                    REQUIRE((bool)wb == (bool)wm);
+                    if (!wb)
+                        continue;
+                    REQUIRE(wb->size == wm->size);
+                    REQUIRE(wb->n_tables == wm->n_tables);
+                    for (int t = 0; t < wb->n_tables; ++t)
+                        for (int i = 0; i < wb->size; ++i)
+                            REQUIRE(wb->TableF32WeakPointers[0][t][i] ==
+                                    wm->TableF32WeakPointers[0][t][i]);
+                }
+            }
+
+            sbuf->loadPreparedPatch(pbuf, -1, "Test");
+            smap->loadPreparedPatch(pmap, -1, "Test");
+
+            auto &patchb = sbuf->storage.getPatch();
+            auto &patchm = smap->storage.getPatch();
+            REQUIRE(patchb.param_ptr.size() == patchm.param_ptr.size());
+            for (int i = 0; i < patchb.param_ptr.size(); ++i)
+            {
+                INFO(patchb.param_ptr[i]->get_storage_name());
+                REQUIRE(patchb.param_ptr[i]->val.i == patchm.param_ptr[i]->val.i);
+            }
+        }
+    }
+
+    SECTION("Truncated Patch")
+    {
+        auto path = string_to_path("resources/test-data/patches/Church.fxp");
+        auto tpath = fs::temp_directory_path() / "surge-truncated-patch.fxp";
+
+        Surge::Storage::MappedFile mf;
+        REQUIRE(mf.open(path));
+        {
+            // Cut off in the middle of the embedded wavetable
+            std::ofstream ofs(tpath, std::ios::binary);
+            ofs.write(mf.data(), mf.size() - 1000);
+        }
+        mf.close();
+
+        auto surge = Surge::Headless::createSurge(44100);
+        PreparedPatch pp;
+        REQUIRE(surge->preparePatchFromPath(path_to_string(tpath).c_str(), "Test", pp));
+        REQUIRE(pp.valid);
+        REQUIRE(!pp.wavetables[0][0]);
+        REQUIRE(pp.doc.FirstChild("patch"));
+
+        fs::remove(tpath);
+    }
+}
+
+static void requireSamePatchState(SurgePatch &a, SurgePatch &b)
+{
+    REQUIRE(a.param_ptr.size() == b.param_ptr.size());
+    for (int i = 0; i < a.param_ptr.size(); ++i)
+    {
+        auto pa = a.param_ptr[i], pb = b.param_ptr[i];
+        INFO(pa->get_storage_name());
+        if (pa->valtype == vt_float)
+            REQUIRE(pa->val.f == Approx(pb->val.f));
+        else
+            REQUIRE(pa->val.i == pb->val.i);
+        REQUIRE(pa->temposync == pb->temposync);
+        REQUIRE(pa->deactivated == pb->deactivated);
+        REQUIRE(pa->extend_range == pb->extend_range);
+        REQUIRE(pa->absolute == pb->absolute);
+        REQUIRE(pa->deform_type == pb->deform_type);
+    }
+
+    auto sameRoutings = [](const std::vector<ModulationRouting> &ra,
+                           const std::vector<ModulationRouting> &rb) {
+        REQUIRE(ra.size() == rb.size());
+        for (int i = 0; i < ra.size(); ++i)
+        {
+            REQUIRE(ra[i].source_id == rb[i].source_id);
+            REQUIRE(ra[i].destination_id == rb[i].destination_id);
+            REQUIRE(ra[i].depth == Approx(rb[i].depth));
+            REQUIRE(ra[i].muted == rb[i].muted);
+            REQUIRE(ra[i].source_index == rb[i].source_index);
+        }
+    };
+    sameRoutings(a.modulation_global, b.modulation_global);
+
+    for (int sc = 0; sc < n_scenes; ++sc)
+    {
+        sameRoutings(a.scene[sc].modulation_scene, b.scene[sc].modulation_scene);
+        sameRoutings(a.scene[sc].modulation_voice, b.scene[sc].modulation_voice);
+
+        for (int l = 0; l < n_lfos; ++l)
+        {
+            INFO("Scene " << sc << " LFO " << l);
+            auto &ssa = a.stepsequences[sc][l], &ssb = b.stepsequences[sc][l];
+            for (int i = 0; i < n_stepseqsteps; ++i)
+                REQUIRE(ssa.steps[i] == Approx(ssb.steps[i]));
+            REQUIRE(ssa.loop_start == ssb.loop_start);
+            REQUIRE(ssa.loop_end == ssb.loop_end);
+            REQUIRE(ssa.trigmask == ssb.trigmask);
+
+            auto &ma = a.msegs[sc][l], &mb = b.msegs[sc][l];
+            REQUIRE(ma.n_activeSegments == mb.n_activeSegments);
+            REQUIRE(ma.editMode == mb.editMode);
+            REQUIRE(ma.loopMode == mb.loopMode);
+            REQUIRE(ma.endpointMode == mb.endpointMode);
+            for (int i = 0; i < ma.n_activeSegments; ++i)
+            {
+                REQUIRE(ma.segments[i].type == mb.segments[i].type);
+                REQUIRE(ma.segments[i].duration == Approx(mb.segments[i].duration));
+                REQUIRE(ma.segments[i].v0 == Approx(mb.segments[i].v0));
+                REQUIRE(ma.segments[i].cpv == Approx(mb.segments[i].cpv));
+            }
+            REQUIRE(ma.totalDuration == Approx(mb.totalDuration));
+
+            REQUIRE(a.formulamods[sc][l].formulaString == b.formulamods[sc][l].formulaString);
+        }
+    }
+}
+
+TEST_CASE("Compiled Patches Round Trip", "[io]")
+{
+    auto src = Surge::Headless::createSurge(44100);
+    REQUIRE(src->loadPatchByPath("resources/test-data/patches/Church.fxp", -1, "Church"));
+
+    // Give the patch one of everything a compiled patch has to carry
+    auto &patch = src->storage.getPatch();
+    REQUIRE(src->setModulation(patch.scene[0].osc[0].pitch.id, ms_lfo1, 0, 0.3f));
+    REQUIRE(src->setModulation(patch.scene[1].filterunit[0].cutoff.id, ms_slfo2, 0, -0.2f));
+    patch.stepsequences[0][2].steps[3] = 0.7f;
+    patch.stepsequences[0][2].trigmask = 0x10001;
+    Surge::MSEG::createSawMSEG(&patch.msegs[1][0], 5, 0.5f);
+    patch.formulamods[0][4].setFormula("function process(state) return state end");
+    patch.scene[0].osc[1].pitch.set_extend_range(true);
+
+    std::vector<char> compiled;
+    REQUIRE(patch.save_compiled(compiled));
+    REQUIRE(SurgePatch::is_compiled(compiled.data(), compiled.size()));
+
+    pdata v;
+    REQUIRE(SurgePatch::compiled_param_value(compiled, patch.fx[0].type.id, v));
+    REQUIRE(v.i == patch.fx[0].type.val.i);
+
+    SECTION("Compiled")
+    {
+        auto dst = Surge::Headless::createSurge(44100);
+        dst->loadRaw(compiled.data(), compiled.size(), false);
+        requireSamePatchState(patch, dst->storage.getPatch());
+        REQUIRE(dst->storage.getPatch().name == patch.name);
+    }
+
+    SECTION("XML")
+    {
+        void *data = nullptr;
+        auto sz = patch.save_patch(&data);
+        auto dst = Surge::Headless::createSurge(44100);
+        dst->loadRaw(data, sz, false);
+        requireSamePatchState(patch, dst->storage.getPatch());
+    }
+
+    SECTION("Refuses A Truncated Blob Without Touching The Patch")
+    {
+        auto dst = Surge::Headless::createSurge(44100);
+        auto &dp = dst->storage.getPatch();
+        dp.name = "Untouched";
+        dp.comment = "As it was";
+        auto cutoff = dp.scene[1].filterunit[0].cutoff.val.f;
+
+        for (auto cut : {compiled.size() / 2, compiled.size() - 1})
+        {
+            auto part = std::vector<char>(compiled.begin(), compiled.begin() + cut);
+            REQUIRE(!dp.can_load_compiled(part.data(), part.size()));
+            REQUIRE(!dp.load_compiled(part.data(), part.size(), false));
+            REQUIRE(dp.name == "Untouched");
+            REQUIRE(dp.comment == "As it was");
+            REQUIRE(dp.scene[1].filterunit[0].cutoff.val.f == cutoff);
+            REQUIRE(dp.modulation_global.empty());
+        }
+    }
+}
+
+TEST_CASE("Patch Cache Skips The XML On Later Loads", "[io]")
+{
+    Surge::Test::ScratchPatchFolder folder("patch-cache");
+    auto &dir = folder.dir;
+    auto fxp = dir / "Church.fxp";
+    fs::copy_file(string_to_path("resources/test-data/patches/Church.fxp"), fxp);
+    auto path = path_to_string(fxp);
+
+    auto plain = Surge::Headless::createSurge(44100);
+    REQUIRE(plain->loadPatchByPath(path.c_str(), -1, "Church"));
+
+    auto &surge = folder.surge;
+    surge->storage.patchCache = std::make_unique<Surge::Storage::PatchCache>(dir / "cache");
+    auto &cache = *surge->storage.patchCache;
+
+    REQUIRE(surge->loadPatchByPath(path.c_str(), -1, "Church"));
+    REQUIRE(cache.misses == 1);
+    REQUIRE(cache.stores == 1);
+    requireSamePatchState(plain->storage.getPatch(), surge->storage.getPatch());
+
+    REQUIRE(surge->loadPatchByPath("resources/test-data/patches/Wavetable-Sin-Uni2-Absolute.fxp",
+                                   -1, "Other"));
+
+    PreparedPatch pp;
+    REQUIRE(surge->preparePatchFromPath(path.c_str(), "Church", pp));
+    REQUIRE(cache.hits == 1);
+    REQUIRE(!pp.compiled.empty());
+    REQUIRE(!pp.doc.FirstChild("patch"));
+    REQUIRE(pp.wavetables[0][0]);
+    surge->loadPreparedPatch(pp, -1, "Church");
+    requireSamePatchState(plain->storage.getPatch(), surge->storage.getPatch());
+
+    // An edited patch has a new modification time, which makes its entry stale
+    fs::last_write_time(fxp, fs::last_write_time(fxp) + std::chrono::seconds(10));
+    auto hits = cache.hits.load();
+    REQUIRE(surge->loadPatchByPath(path.c_str(), -1, "Church"));
+    REQUIRE(cache.hits == hits);
+    REQUIRE(cache.stores == 3);
+}
+
+TEST_CASE("Patch Cache Refuses Entries It Can't Load", "[io]")
+{
+    Surge::Test::ScratchPatchFolder folder("patch-cache-layout");
+    auto fxp = folder.dir / "Church.fxp";
+    fs::copy_file(string_to_path("resources/test-data/patches/Church.fxp"), fxp);
+    auto path = path_to_string(fxp);
+
+    auto plain = Surge::Headless::createSurge(44100);
+    REQUIRE(plain->loadPatchByPath(path.c_str(), -1, "Church"));
+    std::vector<char> good;
+    REQUIRE(plain->storage.getPatch().save_compiled(good));
+
+    auto &surge = folder.surge;
+    surge->storage.patchCache =
+        std::make_unique<Surge::Storage::PatchCache>(folder.dir / "cache");
+    auto &cache = *surge->storage.patchCache;
+
+    SECTION("An Entry From Another Build")
+    {
+        // A well formed entry whose compiled header says another streaming revision made it
+        auto foreign = good;
+        int32_t revision;
+        memcpy(&revision, foreign.data() + 8, sizeof(revision));
+        revision++;
+        memcpy(foreign.data() + 8, &revision, sizeof(revision));
+        REQUIRE(cache.store(fxp, foreign));
+
+        std::vector<char> found;
+        REQUIRE(!cache.lookup(fxp, surge->storage.getPatch(), found));
+
+        // So the patch comes from its XML, and the entry is replaced with one which works
+        REQUIRE(surge->loadPatchByPath(path.c_str(), -1, "Church"));
+        requireSamePatchState(plain->storage.getPatch(), surge->storage.getPatch());
+        REQUIRE(cache.lookup(fxp, surge->storage.getPatch(), found));
+        REQUIRE(found == good);
+    }
+
+    SECTION("A Compiled Patch Which Won't Load Is Reported, Not Cached")
+    {
+        struct Errors : SurgeStorage::ErrorListener
+        {
+            int count{0};
+            void onSurgeError(const std::string &msg, const std::string &title) override
+            {
+                count++;
+            }
+        } errors;
+        surge->storage.addErrorListener(&errors);
+
+        REQUIRE(surge->loadPatchByPath("resources/test-data/patches/"
+                                       "Wavetable-Sin-Uni2-Absolute.fxp",
+                                       -1, "Other"));
+
+        PreparedPatch pp;
+        REQUIRE(surge->preparePatchFromPath(path.c_str(), "Church", pp));
+        pp.compiled = good;
+        pp.compiled.pop_back();
+        auto stores = cache.stores.load();
+        surge->loadPreparedPatch(pp, -1, "Church");
+        surge->cachePreparedPatch(pp);
+        surge->storage.removeErrorListener(&errors);
+
+        // No file is read while the engine is held, and nothing is cached from it
+        REQUIRE(errors.count == 1);
+        REQUIRE(cache.stores == stores);
+
+        // A load which goes through the cache's own checks still works
+        REQUIRE(surge->loadPatchByPath(path.c_str(), -1, "Church"));
+        requireSamePatchState(plain->storage.getPatch(), surge->storage.getPatch());
+    }
+}
+
+TEST_CASE("PatchDB Header Scan Matches The Document", "[io]")
+{
+    using PatchDB = Surge::PatchStorage::PatchDB;
+
+    SECTION("Test Patches")
+    {
+        auto surge = Surge::Headless::createSurge(44100);
+        for (auto fn : {"Church.fxp", "HasSCL.fxp", "VinceyCrash1514.fxp"})
+        {
+            INFO(fn);
+            auto path = std::string("resources/test-data/patches/") + fn;
+            REQUIRE(surge->loadPatchByPath(path.c_str(), -1, "Test"));
+
+            void *data = nullptr;
+            auto sz = surge->storage.getPatch().save_xml(&data);
+            std::string xml((char *)data, sz);
+            free(data);
+
+            TiXmlDocument doc;
+            doc.Parse(xml.c_str(), nullptr, TIXML_ENCODING_LEGACY);
+            auto patch = TINYXML_SAFE_TO_ELEMENT(doc.FirstChild("patch"));
+            auto meta = TINYXML_SAFE_TO_ELEMENT(patch->FirstChild("meta"));
+            REQUIRE(meta);
+
+            PatchDB::PatchHeader h;
+            REQUIRE(PatchDB::readPatchHeader(xml.data(), xml.size(), h));
+            int rev = 0;
+            patch->QueryIntAttribute("revision", &rev);
+            REQUIRE(h.revision == rev);
+            for (auto a : {"name", "category", "author", "comment"})
+            {
+                REQUIRE(meta->Attribute(a));
+                REQUIRE(h.meta[a] == meta->Attribute(a));
+            }
+        }
+    }
+
+    SECTION("Entities And Oddities")
+    {
+        std::string xml = "<?xml version=\"1.0\" ?>\n<!-- <patch revision=\"3\"> -->\n"
+                          "<patch revision=\"16\">\n  <meta name='A &amp; B' "
+                          "author=\"&lt;me&gt; &quot;x&quot; &#65;\" comment=\"\" />\n"
+                          "  <parameters><meta author=\"wrong\" /></parameters></patch>";
+        PatchDB::PatchHeader h;
+        REQUIRE(PatchDB::readPatchHeader(xml.data(), xml.size(), h));
+        REQUIRE(h.revision == 16);
+        REQUIRE(h.meta["name"] == "A & B");
+        REQUIRE(h.meta["author"] == "<me> \"x\" A");
+        REQUIRE(h.meta["comment"].empty());
+
+        std::string nopatch = "<?xml version=\"1.0\" ?>\n<notapatch revision=\"16\" />";
+        REQUIRE(!PatchDB::readPatchHeader(nopatch.data(), nopatch.size(), h));
+        REQUIRE(!PatchDB::readPatchHeader(xml.data(), 30, h));
+    }
+}
+
+TEST_CASE("PatchDB Indexes With Parallel Readers", "[io]")
+{
+    using PatchDB = Surge::PatchStorage::PatchDB;
+
+    Surge::Test::ScratchPatchFolder folder("patchdb");
+    auto &surge = folder.surge;
+    surge->storage.getPatch().author = "Tester";
+    std::vector<fs::path> paths;
+    for (int i = 0; i < 40; ++i)
+    {
+        surge->storage.getPatch().name = "Indexed " + std::to_string(i);
+        paths.push_back(folder.savePatch(surge->storage.getPatch().name));
+    }
+
+    auto index = [&](int readers) {
+        auto db = std::make_unique<PatchDB>(&surge->storage, readers);
+        db->addRootCategory("Tests", PatchDB::USER);
+        for (int i = 0; i < paths.size(); ++i)
+            db->considerFXPForLoad(paths[i], "Indexed " + std::to_string(i), "Tests",
+                                   PatchDB::USER);
+        // Twice over, as a rescan racing the first one would
+        for (int i = 0; i < paths.size(); ++i)
+            db->considerFXPForLoad(paths[i], "Indexed " + std::to_string(i), "Tests",
+                                   PatchDB::USER);
+        REQUIRE(Surge::Test::waitForPatchDB(*db));
+        return db->rawQueryForNameLike("Indexed");
+    };
+
+    auto res = index(4);
+    REQUIRE(res.size() == paths.size());
+    for (auto &r : res)
+        REQUIRE(r.author == "Tester");
+
+    // Nothing changed, so nothing is read again and nothing is duplicated
+    REQUIRE(index(1).size() == paths.size());
+}
+
+TEST_CASE("PatchDB Drops A Changed Patch's Old Rows", "[io]")
+{
+    using PatchDB = Surge::PatchStorage::PatchDB;
+
+    Surge::Test::ScratchPatchFolder folder("patchdb-drop");
+    auto &surge = folder.surge;
+    surge->storage.getPatch().name = "Rewritten";
+    surge->storage.getPatch().author = "Before";
+    auto path = folder.savePatch("Rewritten");
+
+    auto db = std::make_unique<PatchDB>(&surge->storage, 1);
+    db->considerFXPForLoad(path, "Rewritten", "Tests", PatchDB::USER);
+    REQUIRE(Surge::Test::waitForPatchDB(*db));
+    REQUIRE(db->rawQueryForNameLike("Rewritten").size() == 1);
+
+    surge->storage.getPatch().author = "After";
+    surge->savePatchToPath(path);
+    fs::last_write_time(path, fs::last_write_time(path) + std::chrono::seconds(10));
+    db->considerFXPForLoad(path, "Rewritten", "Tests", PatchDB::USER);
+    REQUIRE(Surge::Test::waitForPatchDB(*db));
+
+    /*
+     * The new row takes the old one's id, so features left behind by the old row would show
+     * up as a second author here.
+     */
+    auto res = db->rawQueryForNameLike("Rewritten");
+    REQUIRE(res.size() == 1);
+    REQUIRE(res[0].author == "After");
+    REQUIRE(db->search({"before"}, 0, 10).empty());
+
+    // and reopened it is still the one patch
+    db = std::make_unique<PatchDB>(&surge->storage, 1);
+    db->considerFXPForLoad(path, "Rewritten", "Tests", PatchDB::USER);
+    REQUIRE(Surge::Test::waitForPatchDB(*db));
+    REQUIRE(db->rawQueryForNameLike("Rewritten").size() == 1);
+}
+
+TEST_CASE("PatchDB Matches Paths And Categories Exactly", "[io]")
+{
+    using PatchDB = Surge::PatchStorage::PatchDB;
+
+    Surge::Test::ScratchPatchFolder folder("patchdb-exact");
+    auto &surge = folder.surge;
+
+    // Each pair would match one another as LIKE patterns, where _ and % are wildcards
+    std::vector<std::string> stems = {"WildXcard", "Wild_card", "100 And More", "100%"};
+    std::vector<fs::path> paths;
+    for (auto &st : stems)
+    {
+        surge->storage.getPatch().name = "Exact " + st;
+        surge->storage.getPatch().author = "Original";
+        paths.push_back(folder.savePatch(st));
+    }
+
+    auto index = [&](PatchDB &db) {
+        for (int i = 0; i < paths.size(); ++i)
+            db.considerFXPForLoad(paths[i], "Exact " + stems[i], "Tests", PatchDB::USER);
+        REQUIRE(Surge::Test::waitForPatchDB(db));
+    };
+    auto authors = [](PatchDB &db) {
+        std::map<std::string, std::string> res;
+        for (auto &r : db.rawQueryForNameLike("Exact"))
+        {
+            REQUIRE(res.find(r.name) == res.end());
+            res[r.name] = r.author;
+        }
+        return res;
+    };
+
+    auto db = std::make_unique<PatchDB>(&surge->storage, 2);
+    index(*db);
+    REQUIRE(authors(*db).size() == stems.size());
+
+    SECTION("Paths")
+    {
+        // Change only the patches whose names are patterns
+        for (auto i : {1, 3})
+        {
+            surge->storage.getPatch().name = "Exact " + stems[i];
+            surge->storage.getPatch().author = "Changed";
+            surge->savePatchToPath(paths[i]);
+            fs::last_write_time(paths[i],
+                                fs::last_write_time(paths[i]) + std::chrono::seconds(10));
+        }
+
+        for (int pass = 0; pass < 2; ++pass)
+        {
+            INFO("Pass " << pass);
+            index(*db);
+            auto a = authors(*db);
+            REQUIRE(a.size() == stems.size());
+            REQUIRE(a["Exact WildXcard"] == "Original");
+            REQUIRE(a["Exact Wild_card"] == "Changed");
+            REQUIRE(a["Exact 100 And More"] == "Original");
+            REQUIRE(a["Exact 100%"] == "Changed");
+
+            // The second pass reads what is known about each path back from the database
+            db = std::make_unique<PatchDB>(&surge->storage, 2);
+        }
+    }
+
+    SECTION("Categories")
+    {
+        for (auto &c : stems)
+            db->addRootCategory(c, PatchDB::USER);
+        db->addSubCategory("Wild_card/Soft", "Wild_card", PatchDB::USER);
+        db->addSubCategory("100%/Soft", "100%", PatchDB::USER);
+        REQUIRE(Surge::Test::waitForPatchDB(*db));
+
+        std::map<std::string, int> roots;
+        for (auto &c : db->rootCategoriesForType(PatchDB::USER))
+            roots[c.name] = c.id;
+        for (auto &c : stems)
+            REQUIRE(roots.find(c) != roots.end());
+
+        REQUIRE(db->childCategoriesOf(roots["WildXcard"]).empty());
+        REQUIRE(db->childCategoriesOf(roots["100 And More"]).empty());
+        REQUIRE(db->childCategoriesOf(roots["Wild_card"]).size() == 1);
+        REQUIRE(db->childCategoriesOf(roots["100%"]).size() == 1);
+    }
+}
+
+TEST_CASE("PatchDB Searches By Word Prefix With Facets", "[io]")
+{
+    using PatchDB = Surge::PatchStorage::PatchDB;
+
+    Surge::Test::ScratchPatchFolder folder("patchdb-search");
+    auto &surge = folder.surge;
+
+    struct Spec
+    {
+        std::string name, category, author, comment;
+    };
+    std::vector<Spec> specs = {{"Warm Pad", "Pads", "Alice", "lush"},
+                               {"Cold Pad", "Pads", "Bob", ""},
+                               {"Pluck Warmth", "Plucks", "Alice", "bright"},
+                               {"Bass Thing", "Basses", "Carol", "warm and round"},
+                               {"Crème Brûlée", "Plucks", "Carol", "sweet"}};
+    for (int i = 0; i < 30; ++i)
+        specs.push_back({"Filler " + std::to_string(i), "Fillers", "Bob", ""});
+
+    std::vector<fs::path> paths;
+    for (auto &s : specs)
+    {
+        surge->storage.getPatch().name = s.name;
+        surge->storage.getPatch().author = s.author;
+        surge->storage.getPatch().comment = s.comment;
+        paths.push_back(folder.savePatch("Search " + std::to_string(paths.size())));
+    }
+
+    auto db = std::make_unique<PatchDB>(&surge->storage, 2);
+    for (int i = 0; i < specs.size(); ++i)
+        db->considerFXPForLoad(paths[i], specs[i].name, specs[i].category, PatchDB::USER);
+    REQUIRE(Surge::Test::waitForPatchDB(*db));
+
+    auto names = [](const std::vector<PatchDB::patchRecord> &res) {
+        std::set<std::string> n;
+        for (auto &r : res)
+            n.insert(r.name);
+        return n;
+    };
+
+    SECTION("Words Match As Prefixes In Every Column")
+    {
+        auto res = db->search({"warm"}, 0, 100);
+        REQUIRE(names(res) == std::set<std::string>{"Warm Pad", "Pluck Warmth", "Bass Thing"});
+        // A match in the name counts for more than one in the comment
+        REQUIRE(res.back().name == "Bass Thing");
+
+        REQUIRE(names(db->search({"pa"}, 0, 100)) ==
+                std::set<std::string>{"Warm Pad", "Cold Pad"});
+        REQUIRE(names(db->search({"alice br"}, 0, 100)) ==
+                std::set<std::string>{"Pluck Warmth"});
+        REQUIRE(names(db->search({"creme"}, 0, 100)) == std::set<std::string>{"Crème Brûlée"});
+
+        // Query syntax in what someone types is just more words
+        REQUIRE(names(db->search({"\"cold\" (pad*"}, 0, 100)) ==
+                std::set<std::string>{"Cold Pad"});
+        REQUIRE(db->search({"nothing"}, 0, 100).empty());
+        REQUIRE(db->countSearchResults({"warm"}) == 3);
+    }
+
+    SECTION("Results Come A Page At A Time")
+    {
+        REQUIRE(db->countSearchResults({}) == (int)specs.size());
+        REQUIRE(db->countSearchResults({"filler"}) == 30);
+
+        std::set<int> seen;
+        for (int offset = 0; offset < 30; offset += 7)
+        {
+            auto page = db->search({"filler"}, offset, 7);
+            REQUIRE((int)page.size() == std::min(7, 30 - offset));
+            for (auto &r : page)
+                REQUIRE(seen.insert(r.id).second);
+        }
+        REQUIRE(seen.size() == 30);
+
+        // With no words everything comes back in category order
+        auto all = db->search({}, 0, 100);
+        REQUIRE(all.size() == specs.size());
+        REQUIRE(all.front().cat == "Basses");
+        REQUIRE(all.back().cat == "Plucks");
+    }
+
+    SECTION("Facets Count And Narrow The Results")
+    {
+        auto f = db->searchFacets({"warm"});
+        REQUIRE(f.categories.size() == 3);
+        REQUIRE(f.authors.size() == 2);
+        REQUIRE(f.authors[0].value == "Alice");
+        REQUIRE(f.authors[0].count == 2);
+        REQUIRE(f.authors[1].value == "Carol");
+        REQUIRE(f.authors[1].count == 1);
+
+        auto all = db->searchFacets({});
+        REQUIRE(all.categories[0].value == "Fillers");
+        REQUIRE(all.categories[0].count == 30);
+
+        REQUIRE(names(db->search({"warm", "", "Alice"}, 0, 100)) ==
+                std::set<std::string>{"Warm Pad", "Pluck Warmth"});
+        REQUIRE(names(db->search({"", "Plucks", "Carol"}, 0, 100)) ==
+                std::set<std::string>{"Crème Brûlée"});
+        REQUIRE(db->countSearchResults({"", "Pads"}) == 2);
+    }
+
+    SECTION("Prefix Search Looks At Names")
+    {
+        auto res = db->prefixSearch("p", 100);
+        REQUIRE(names(res) == std::set<std::string>{"Warm Pad", "Cold Pad", "Pluck Warmth"});
+        REQUIRE(res[0].name == "Cold Pad");
+
+        REQUIRE(db->prefixSearch("warm pa", 100).size() == 1);
+        REQUIRE(db->prefixSearch("fil", 5).size() == 5);
+        REQUIRE(db->prefixSearch("bob", 100).empty());
+        REQUIRE(db->prefixSearch("  ", 100).empty());
+    }
+
+    SECTION("A Changed Patch Is Searched As It Is Now")
+    {
+        surge->storage.getPatch().name = "Warm Pad";
+        surge->storage.getPatch().author = "Dave";
+        surge->storage.getPatch().comment = "";
+        surge->savePatchToPath(paths[0]);
+        fs::last_write_time(paths[0], fs::last_write_time(paths[0]) + std::chrono::seconds(10));
+
+        db->considerFXPForLoad(paths[0], specs[0].name, specs[0].category, PatchDB::USER);
+        REQUIRE(Surge::Test::waitForPatchDB(*db));
+
+        REQUIRE(db->search({"alice"}, 0, 100).size() == 1);
+        auto res = db->search({"dave"}, 0, 100);
+        REQUIRE(res.size() == 1);
+        REQUIRE(res[0].author == "Dave");
+        REQUIRE(db->countSearchResults({}) == (int)specs.size());
+    }
+}
+
+TEST_CASE("PatchDB Finds Patches Built Alike", "[io]")
+{
+    using PatchDB = Surge::PatchStorage::PatchDB;
+
+    // Each patch changes a bit more of the one before
+    Surge::Test::ScratchPatchFolder folder("patchdb-similar");
+    auto &surge = folder.surge;
+    auto &patch = surge->storage.getPatch();
+    std::vector<std::string> names = {"Base", "One Change", "Two Changes", "Many Changes"};
+    std::vector<fs::path> paths;
+    for (int i = 0; i < names.size(); ++i)
+    {
+        auto &sc = patch.scene[0];
+        if (i == 1)
+            sc.osc[0].type.val.i = ot_wavetable;
+        if (i == 2)
+            patch.fx[0].type.val.i = fxt_delay;
+        if (i == 3)
+        {
+            for (auto &o : sc.osc)
+                o.type.val.i = ot_FM3;
+            sc.filterunit[0].type.val.i = fut_hp24;
+            sc.adsr[0].a.val.f = sc.adsr[0].a.val_max.f;
+            patch.fx[1].type.val.i = fxt_reverb;
+        }
+
+        patch.name = names[i];
+        paths.push_back(folder.savePatch("Similar " + std::to_string(i)));
+    }
+
+    auto db = std::make_unique<PatchDB>(&surge->storage, 2);
+    for (int i = 0; i < names.size(); ++i)
+        db->considerFXPForLoad(paths[i], names[i], "Tests", PatchDB::USER);
+    REQUIRE(Surge::Test::waitForPatchDB(*db));
+
+    // What the index read from the XML matches what the loaded patch says
+    auto like = db->similarPatchesTo(patch, 1);
+    REQUIRE(like.size() == 1);
+    REQUIRE(like[0].patch.name == "Many Changes");
+    REQUIRE(like[0].distance == 0);
+
+    auto base = db->search({"base"}, 0, 1);
+    REQUIRE(base.size() == 1);
+    auto res = db->similarPatches(base[0].id, 10);
+    REQUIRE(res.size() == 3);
+    for (int i = 0; i < res.size(); ++i)
+    {
+        INFO("Neighbour " << i << " is " << res[i].patch.name << " at " << res[i].distance);
+        REQUIRE(res[i].patch.name == names[i + 1]);
+        REQUIRE(res[i].distance > (i == 0 ? 0 : res[i - 1].distance));
+    }
+    REQUIRE(db->similarPatches(base[0].id, 1).size() == 1);
+
+    // Reopened, the vectors come back from the database
+    db = std::make_unique<PatchDB>(&surge->storage, 2);
+    REQUIRE(db->similarPatches(base[0].id, 10).size() == 3);
+}
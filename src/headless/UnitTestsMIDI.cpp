@@ -9,6 +9,7 @@
 #include "catch2/catch2.hpp"
 
 #include "UnitTestUtilities.h"
+#include "HostBufferRenderer.h"
 
 using namespace Surge::Test;
 
@@ -1366,4 +1367,228 @@ TEST_CASE("Priority Modes with Keysplit", "[midi]")
             }
         }
     }
-}
\ No newline at end of file
+}
+TEST_CASE("Note Onsets Follow Sample Position In Host Buffer", "[midi]")
+{
+    /*
+     * The plugin renders through HostBufferRenderer, so drive that with the note at a given
+     * sample. The onset should never be earlier than the timestamp and at most a block (plus
+     * filter delay) later, whatever the buffer sizes and wherever in a buffer the note sits.
+     */
+    auto onsetLatency = [](const std::vector<int> &bufferSizes, int eventAt) {
+        auto surge = Surge::Headless::createSurge(44100);
+        REQUIRE(surge);
+
+        Surge::HostBufferRenderer renderer;
+        std::vector<float> out;
+        bool eventPending = true;
+        int bufferStart = 0;
+
+        for (auto sz : bufferSizes)
+        {
+            std::vector<float> L(sz), R(sz);
+            Surge::HostBufferRenderer::Buffer hb;
+            hb.numSamples = sz;
+            hb.out[0] = L.data();
+            hb.out[1] = R.data();
+
+            bool inThisBuffer = eventAt >= bufferStart && eventAt < bufferStart + sz;
+            renderer.render(*surge, hb, [&](int upTo) {
+                if (eventPending && inThisBuffer && eventAt - bufferStart <= upTo)
+                {
+                    surge->playNote(0, 60, 127, 0);
+                    eventPending = false;
+                }
+            });
+            if (eventPending && inThisBuffer)
+            {
+                surge->playNote(0, 60, 127, 0);
+                eventPending = false;
+            }
+
+            out.insert(out.end(), L.begin(), L.end());
+            bufferStart += sz;
+        }
+        REQUIRE(!eventPending);
+
+        int onset = 0;
+        while (onset < (int)out.size() && fabs(out[onset]) < 1e-6)
+            onset++;
+        REQUIRE(onset < (int)out.size());
+        return onset - eventAt;
+    };
+
+    SECTION("Fixed Buffer Sizes")
+    {
+        for (auto hbs : {1, 31, 32, 33, 64, 257, 512})
+        {
+            std::vector<int> sizes(2048 / hbs + 1, hbs);
+            for (auto at : {512, 513, 529, 543, 544, 612, 767, 812, 1023, 1100})
+            {
+                INFO("Host buffer size " << hbs << " event at " << at);
+                auto latency = onsetLatency(sizes, at);
+                REQUIRE(latency >= 0);
+                REQUIRE(latency < 2 * BLOCK_SIZE);
+            }
+        }
+    }
+
+    SECTION("Jittered Buffers")
+    {
+        std::mt19937 gen(73);
+        std::uniform_int_distribution<int> size(1, 300);
+        std::vector<int> sizes;
+        for (int total = 0; total < 3000; total += sizes.back())
+            sizes.push_back(size(gen));
+
+        for (auto at : {0, 1, 500, 517, 1000, 1031, 1777})
+        {
+            INFO("Event at " << at);
+            auto latency = onsetLatency(sizes, at);
+            REQUIRE(latency >= 0);
+            REQUIRE(latency < 2 * BLOCK_SIZE);
+        }
+    }
+}
+
+TEST_CASE("Ragged Host Buffers Render Like Whole Blocks", "[midi]")
+{
+    const int nBlocks = 100;
+    auto setup = []() {
+        auto surge = Surge::Headless::createSurge(44100);
+        surge->seedRandomGenerators(4242);
+        surge->playNote(0, 60, 127, 0);
+        surge->playNote(0, 67, 100, 0);
+        return surge;
+    };
+
+    // What the synth makes one block at a time
+    auto ref = setup();
+    std::vector<float> refOut[2], refScene[n_scenes][2];
+    for (int b = 0; b < nBlocks; ++b)
+    {
+        ref->process_input = true;
+        memset(ref->input, 0, sizeof(ref->input));
+        ref->process();
+        for (int c = 0; c < 2; ++c)
+        {
+            refOut[c].insert(refOut[c].end(), ref->output[c], ref->output[c] + BLOCK_SIZE);
+            for (int s = 0; s < n_scenes; ++s)
+                refScene[s][c].insert(refScene[s][c].end(), ref->sceneout[s][c],
+                                      ref->sceneout[s][c] + BLOCK_SIZE);
+        }
+    }
+
+    auto sizesList = std::vector<std::vector<int>>{{1}, {31}, {33}, {257}, {1, 31, 33, 257, 7}};
+    for (auto &sizes : sizesList)
+    {
+        INFO("Buffer sizes starting " << sizes[0]);
+        auto surge = setup();
+        Surge::HostBufferRenderer renderer;
+
+        std::vector<float> out[2], scene[n_scenes][2];
+        const int total = nBlocks * BLOCK_SIZE;
+        for (int done = 0, k = 0; done < total; ++k)
+        {
+            auto sz = std::min(sizes[k % sizes.size()], total - done);
+
+            // Sized exactly, so a read or write past the end shows up under a sanitizer
+            std::vector<float> buf[2], sbuf[n_scenes][2], in(sz, 0.f);
+            Surge::HostBufferRenderer::Buffer hb;
+            hb.numSamples = sz;
+            hb.in[0] = in.data();
+            for (int c = 0; c < 2; ++c)
+            {
+                buf[c].resize(sz);
+                hb.out[c] = buf[c].data();
+                for (int s = 0; s < n_scenes; ++s)
+                {
+                    sbuf[s][c].resize(sz);
+                    hb.sceneOut[s][c] = sbuf[s][c].data();
+                }
+            }
+
+            renderer.render(*surge, hb, [](int) {});
+
+            for (int c = 0; c < 2; ++c)
+            {
+                out[c].insert(out[c].end(), buf[c].begin(), buf[c].end());
+                for (int s = 0; s < n_scenes; ++s)
+                    scene[s][c].insert(scene[s][c].end(), sbuf[s][c].begin(), sbuf[s][c].end());
+            }
+            done += sz;
+        }
+
+        REQUIRE(renderer.blockPos == 0);
+        for (int c = 0; c < 2; ++c)
+        {
+            REQUIRE(out[c] == refOut[c]);
+            for (int s = 0; s < n_scenes; ++s)
+                REQUIRE(scene[s][c] == refScene[s][c]);
+        }
+    }
+}
+
+TEST_CASE("Host Buffers Move The Song Position By Their Length", "[midi]")
+{
+    auto surge = Surge::Headless::createSurge(44100);
+    surge->time_data.tempo = 120;
+    surge->time_data.ppqPos = 0;
+    Surge::HostBufferRenderer renderer;
+
+    // Half a second at 120bpm is one quarter note, however the host splits it up
+    int total = 0;
+    for (auto sz : {1, 31, 33, 257, 7, 22050 - 329})
+    {
+        std::vector<float> buf[2];
+        Surge::HostBufferRenderer::Buffer hb;
+        hb.numSamples = sz;
+        for (int c = 0; c < 2; ++c)
+        {
+            buf[c].resize(sz);
+            hb.out[c] = buf[c].data();
+        }
+        hb.ppqPerSample = surge->time_data.tempo / (60. * 44100);
+
+        renderer.render(*surge, hb, [](int) {});
+        total += sz;
+    }
+
+    REQUIRE(total == 22050);
+    REQUIRE(surge->time_data.ppqPos == Approx(1.0));
+}
+
+TEST_CASE("Voice Slots Are Recycled In Place", "[midi]")
+{
+    auto surge = Surge::Headless::createSurge(44100);
+    REQUIRE(surge);
+
+    auto first = &surge->voices_array[0][0];
+    for (int round = 0; round < 3; ++round)
+    {
+        INFO("Round " << round);
+
+        // More notes than there are voices
+        for (int k = 0; k < MAX_VOICES + 8; ++k)
+            surge->playNote(0, 20 + k, 100, 0);
+
+        auto &vl = surge->voices[0];
+        REQUIRE(vl.size() > 0);
+        REQUIRE(vl.size() <= MAX_VOICES);
+        REQUIRE(surge->n_freeVoiceSlots[0] + vl.size() == MAX_VOICES);
+        for (auto it = vl.begin(); it != vl.end(); ++it)
+        {
+            REQUIRE(*it >= first);
+            REQUIRE(*it < first + MAX_VOICES);
+            REQUIRE(std::find(vl.begin(), it, *it) == it);
+        }
+
+        for (int k = 0; k < MAX_VOICES + 8; ++k)
+            surge->releaseNote(0, 20 + k, 0);
+        for (int i = 0; i < 10000 && !vl.empty(); ++i)
+            surge->process();
+
+        REQUIRE(vl.empty());
+        REQUIRE(surge->n_freeVoiceSlots[0] == MAX_VOICES);
+    }
+}
@@ -1333,4 +1333,145 @@ TEST_CASE("ModLFO is well behaved", "[mod]")
             }
         }
     }
-}
\ No newline at end of file
+}
+TEST_CASE("Modulation Table Matches Scalar Routing", "[mod]")
+{
+    // Enough routings to span several chunks, with shared sources, repeated destinations,
+    // mutes, indexed outputs and a missing source
+    std::vector<ModulationSource> srcs(n_modsources);
+    std::vector<ModulationSource *> srcp(n_modsources);
+    for (int i = 0; i < n_modsources; ++i)
+    {
+        srcp[i] = &srcs[i];
+        for (int j = 0; j < 4; ++j)
+            srcs[i].set_output(j, 0.1f * i - 0.37f * j);
+    }
+    srcp[ms_ctrl3] = nullptr;
+
+    std::vector<ModulationRouting> routings;
+    for (int i = 0; i < 150; ++i)
+    {
+        ModulationRouting r;
+        r.source_id = 1 + (i * 7) % (n_modsources - 1);
+        r.source_index = i % 3;
+        r.destination_id = (i * 13) % 40;
+        r.depth = 0.013f * (i - 75);
+        r.muted = (i % 11) == 0;
+        routings.push_back(r);
+    }
+
+    // The loop processControl and calc_ctrldata used to run
+    auto scalar = [&](pdata *d, bool useIndex) {
+        for (auto &r : routings)
+        {
+            auto idx = useIndex ? r.source_index : 0;
+            if (srcp[r.source_id])
+                d[r.destination_id].f +=
+                    r.depth * srcp[r.source_id]->get_output(idx) * (1.0 - r.muted);
+        }
+    };
+
+    // The table scales and adds in the same order as the scalar loop, so the sums are exact
+    auto check = [&](const ModulationTable &t, bool useIndex) {
+        pdata a[40], b[40];
+        for (int i = 0; i < 40; ++i)
+            a[i].f = b[i].f = 0.5f * i;
+        scalar(a, useIndex);
+        t.apply(srcp.data(), b);
+        for (int i = 0; i < 40; ++i)
+        {
+            INFO("Destination " << i);
+            REQUIRE(b[i].f == a[i].f);
+        }
+    };
+
+    SECTION("Rebuilt")
+    {
+        ModulationTable t, g(false);
+        t.rebuild(routings);
+        g.rebuild(routings);
+        REQUIRE(t.size() == 150);
+        check(t, true);
+        check(g, false);
+    }
+
+    SECTION("Incremental")
+    {
+        ModulationTable t;
+        for (int i = 0; i < (int)routings.size(); ++i)
+            t.set(i, routings[i]);
+        check(t, true);
+
+        routings[70].depth = -0.9f;
+        routings[3].muted = true;
+        routings[100].source_id = ms_lfo2;
+        t.set(70, routings[70]);
+        t.set(3, routings[3]);
+        t.set(100, routings[100]);
+        check(t, true);
+
+        for (int i : {149, 64, 0})
+        {
+            routings.erase(routings.begin() + i);
+            t.erase(i);
+        }
+        check(t, true);
+    }
+}
+
+TEST_CASE("Modulation Tables Follow Routing Edits", "[mod]")
+{
+    auto surge = Surge::Headless::createSurge(44100);
+    REQUIRE(surge);
+    auto &patch = surge->storage.getPatch();
+    auto &sc = patch.scene[0];
+
+    auto inStep = [&]() {
+        auto same = [](const ModulationTable &t, const std::vector<ModulationRouting> &v) {
+            if (t.size() != (int)v.size())
+                return false;
+            for (int i = 0; i < t.size(); ++i)
+                if (t.destination(i) != v[i].destination_id)
+                    return false;
+            return true;
+        };
+        return same(patch.modulation_global_table, patch.modulation_global) &&
+               same(sc.modulation_scene_table, sc.modulation_scene) &&
+               same(sc.modulation_voice_table, sc.modulation_voice);
+    };
+
+    auto cutoff = sc.filterunit[0].cutoff.id;
+    auto reso = sc.filterunit[0].resonance.id;
+    REQUIRE(surge->setModulation(cutoff, ms_lfo1, 0, 0.3f));
+    REQUIRE(surge->setModulation(reso, ms_lfo1, 0, 0.2f));
+    REQUIRE(surge->setModulation(cutoff, ms_ctrl1, 0, 0.4f));
+    REQUIRE(surge->setModulation(patch.volume.id, ms_ctrl2, 0, 0.1f));
+    REQUIRE(sc.modulation_voice.size() == 2);
+    REQUIRE(sc.modulation_scene.size() == 1);
+    REQUIRE(patch.modulation_global.size() == 1);
+    REQUIRE(inStep());
+
+    // With every source silent but the macro, the scene routing is all there is on the cutoff
+    surge->setMacroParameter01(0, 1.f);
+    for (int i = 0; i < 100; ++i)
+        surge->process();
+    auto cid = sc.filterunit[0].cutoff.param_id_in_scene;
+    auto base = sc.filterunit[0].cutoff.val.f;
+    REQUIRE(patch.scenedata[0][cid].f == Approx(base + sc.modulation_scene[0].depth));
+
+    surge->muteModulation(cutoff, ms_ctrl1, 0, true);
+    surge->process();
+    REQUIRE(patch.scenedata[0][cid].f == Approx(base));
+
+    surge->clearModulation(cutoff, ms_lfo1, 0);
+    REQUIRE(sc.modulation_voice.size() == 1);
+    REQUIRE(inStep());
+
+    // A list edited directly needs its tables rebuilt; the audio thread won't do it
+    sc.modulation_voice.clear();
+    REQUIRE(!inStep());
+    patch.rebuildModulationTables();
+    REQUIRE(inStep());
+    surge->process();
+    REQUIRE(inStep());
+}
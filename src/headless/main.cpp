@@ -47,6 +47,53 @@ int main(int argc, char **argv)
         {
             Surge::Headless::NonTest::performancePlay(argv[3], std::atoi(argv[4]));
         }
+        if (strcmp(argv[2], "--scene-threading-benchmark") == 0)
+        {
+            std::string patch = argc > 3 ? argv[3] : "";
+            int voices = argc > 4 ? std::atoi(argv[4]) : 32;
+            Surge::Headless::NonTest::sceneThreadingBenchmark(patch, voices);
+        }
+        if (strcmp(argv[2], "--voice-snapshot-benchmark") == 0)
+        {
+            int voices = argc > 3 ? std::atoi(argv[3]) : 64;
+            Surge::Headless::NonTest::voiceSnapshotBenchmark(voices);
+        }
+        if (strcmp(argv[2], "--storage-startup-benchmark") == 0)
+        {
+            int instances = argc > 3 ? std::atoi(argv[3]) : 32;
+            std::string mode = argc > 4 ? argv[4] : "";
+            Surge::Headless::NonTest::storageStartupBenchmark(instances, mode);
+        }
+        if (strcmp(argv[2], "--patch-load-benchmark") == 0)
+        {
+            int passes = argc > 3 ? std::atoi(argv[3]) : 3;
+            Surge::Headless::NonTest::patchLoadBenchmark(passes);
+        }
+        if (strcmp(argv[2], "--patchdb-benchmark") == 0)
+        {
+            int patches = argc > 3 ? std::atoi(argv[3]) : 50000;
+            int readers = argc > 4 ? std::atoi(argv[4]) : 0;
+            Surge::Headless::NonTest::patchDBBenchmark(patches, readers);
+        }
+        if (strcmp(argv[2], "--block-profile") == 0)
+        {
+            std::string patch = argc > 3 ? argv[3] : "";
+            int voices = argc > 4 ? std::atoi(argv[4]) : 16;
+            int seconds = argc > 5 ? std::atoi(argv[5]) : 10;
+            Surge::Headless::NonTest::blockProfile(patch, voices, seconds);
+        }
+        if (strcmp(argv[2], "--render-batch") == 0)
+        {
+            if (argc < 4)
+            {
+                std::cout << "Usage: --render-batch outdir [threads] [wav|raw] [patches]\n";
+                return 1;
+            }
+            int threads = argc > 4 ? std::atoi(argv[4]) : 0;
+            std::string format = argc > 5 ? argv[5] : "wav";
+            int patches = argc > 6 ? std::atoi(argv[6]) : 0;
+            Surge::Headless::NonTest::renderBatch(argv[3], threads, format, patches);
+        }
         return 0;
     }
     else
@@ -61,6 +108,20 @@ int main(int argc, char **argv)
                 << "   --non-test --stats-from-every-patch    # play every patch and show RMS\n"
                 << "   --non-test --filter-analyzer ft fst    # analyze filter type/subtype for "
                    "response\n"
+                << "   --non-test --scene-threading-benchmark [patch] [voices]  # time serial "
+                   "vs threaded scenes\n"
+                << "   --non-test --voice-snapshot-benchmark [voices]  # time per-voice "
+                   "control rate work\n"
+                << "   --non-test --storage-startup-benchmark [instances] [shared|unshared]  # "
+                   "time and memory per instance\n"
+                << "   --non-test --patch-load-benchmark [passes]  # time reading every patch, "
+                   "buffered vs mapped\n"
+                << "   --non-test --patchdb-benchmark [patches] [readers]  # time indexing a "
+                   "synthetic patch library and searching it\n"
+                << "   --non-test --block-profile [patch] [voices] [seconds]  # time each "
+                   "stage of processing (needs SURGE_BLOCK_PROFILING)\n"
+                << "   --non-test --render-batch outdir [threads] [wav|raw] [patches]  # render "
+                   "patches x event streams in parallel to disk\n"
                 << "\n"
                 << "If you exlude the `--non-test` argument, standard catch2 arguments, below, "
                    "apply\n\n";
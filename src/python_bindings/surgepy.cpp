@@ -2,10 +2,15 @@
 #include <pybind11/numpy.h>
 #include <pybind11/stl.h>
 
+#include <algorithm>
+#include <memory>
 #include <thread>
 #include <utility>
+#include <vector>
 
 #include "SurgeSynthesizer.h"
+#include "BlockProfiler.h"
+#include "WorkerPool.h"
 #include "HeadlessPluginLayerProxy.h"
 #include "version.h"
 #include "filesystem/import.h"
@@ -100,6 +105,63 @@ struct SurgePyModRouting
     float normalizedDepth;
 };
 
+/*
+ * One timed event for renderEvents; from python these are the rows of a numpy structured array
+ * with the dtype surgepy.eventDtype(). What data1 and value mean depends on the type:
+ *
+ *   ev_note_on      data1 = key, value = velocity
+ *   ev_note_off     data1 = key, value = release velocity
+ *   ev_cc           data1 = controller, value = 0 - 127
+ *   ev_pitch_bend   value = -8192 - 8191
+ *   ev_param        data1 = synth side id of the parameter, value = the value as setParamVal
+ */
+enum SurgePyEventType
+{
+    ev_note_on = 1,
+    ev_note_off,
+    ev_cc,
+    ev_pitch_bend,
+    ev_param,
+};
+
+struct SurgePyEvent
+{
+    int64_t sample;
+    int32_t type;
+    int32_t channel;
+    int32_t data1;
+    float value;
+};
+typedef py::array_t<SurgePyEvent, py::array::c_style | py::array::forcecast> SurgePyEventArray;
+
+/*
+ * A parameter's value at each block of a renderEvents call, worked out from the automation
+ * before the render starts. Plain float parameters are written in place; anything else (ints,
+ * bools, and floats other parameters depend on) still goes through setParameter01. Lanes hold
+ * the parameter's id rather than a pointer, so any instance can play them.
+ */
+struct SurgePyAutomationLane
+{
+    long index = -1;
+    bool direct = false;
+    std::vector<float> values;
+};
+
+/*
+ * Records modulation source outputs into a caller's (nBlocks, nSources) float32 array, one row
+ * per processed block, until the array is full. Voice level sources read the newest voice in
+ * the scene and record 0 when none is playing. The trace holds a reference to the array, so
+ * the rows stay valid however the caller drops theirs.
+ */
+struct SurgePyModTrace
+{
+    py::object owner;
+    float *data = nullptr;
+    int64_t rows = 0, next = 0;
+    int scene = 0;
+    std::vector<modsources> sources;
+};
+
 class SurgePyPatchConverter
 {
   public:
@@ -572,6 +634,224 @@ class SurgeSynthesizerWithPythonExtensions : public SurgeSynthesizer
 
     void releaseNoteWithInts(int ch, int note, int vel) { releaseNote(ch, note, vel); }
 
+    void applyEvent(const SurgePyEvent &e)
+    {
+        switch (e.type)
+        {
+        case ev_note_on:
+            playNote(e.channel, e.data1, (int)e.value, 0);
+            break;
+        case ev_note_off:
+            releaseNote(e.channel, e.data1, (int)e.value);
+            break;
+        case ev_cc:
+            channelController(e.channel, e.data1, (int)e.value);
+            break;
+        case ev_pitch_bend:
+            pitchBend(e.channel, (int)e.value);
+            break;
+        case ev_param:
+        {
+            auto p = storage.getPatch().param_ptr[e.data1];
+            SurgeSynthesizer::ID pid;
+            if (fromSynthSideId(e.data1, pid))
+                setParameter01(pid, p->value_to_normalized(e.value));
+            break;
+        }
+        }
+    }
+
+    /*
+     * Automation maps a parameter (a SurgeNamedParamId or its synth side id) to either a one
+     * dimensional array with a value per block, the last value holding if it runs out, or an
+     * n x 2 array of (sample, value) breakpoints which we interpolate linearly at each block.
+     */
+    std::vector<SurgePyAutomationLane> makeAutomationLanes(const py::dict &automation,
+                                                           int64_t nBlocks)
+    {
+        std::vector<SurgePyAutomationLane> lanes;
+        for (auto item : automation)
+        {
+            SurgePyAutomationLane lane;
+            if (py::isinstance<SurgePyNamedParam>(item.first))
+                lane.index = item.first.cast<SurgePyNamedParam>().getID().getSynthSideId();
+            else
+                lane.index = item.first.cast<long>();
+
+            if (lane.index < 0 || lane.index >= (long)storage.getPatch().param_ptr.size() ||
+                !storage.getPatch().param_ptr[lane.index])
+            {
+                std::ostringstream oss;
+                oss << "Unknown parameter id " << lane.index << " in automation";
+                throw std::invalid_argument(oss.str().c_str());
+            }
+            auto p = storage.getPatch().param_ptr[lane.index];
+            lane.direct = p->valtype == vt_float && !p->affect_other_parameters;
+
+            auto arr = item.second.cast<py::array_t<float, py::array::c_style |
+                                                               py::array::forcecast>>();
+            auto d = arr.data();
+            lane.values.resize(nBlocks);
+
+            if (arr.ndim() == 1 && arr.shape(0) > 0)
+            {
+                auto n = (int64_t)arr.shape(0);
+                for (int64_t b = 0; b < nBlocks; ++b)
+                    lane.values[b] = d[std::min(b, n - 1)];
+            }
+            else if (arr.ndim() == 2 && arr.shape(1) == 2 && arr.shape(0) > 0)
+            {
+                auto n = (int64_t)arr.shape(0);
+                for (int64_t i = 1; i < n; ++i)
+                    if (d[2 * i] < d[2 * (i - 1)])
+                        throw std::invalid_argument(
+                            "Automation breakpoints must be in order of sample");
+
+                int64_t seg = 0;
+                for (int64_t b = 0; b < nBlocks; ++b)
+                {
+                    float t = (float)(b * BLOCK_SIZE);
+                    while (seg < n - 1 && d[2 * (seg + 1)] <= t)
+                        seg++;
+
+                    if (seg == n - 1 || t <= d[2 * seg])
+                    {
+                        lane.values[b] = d[2 * seg + 1];
+                    }
+                    else
+                    {
+                        auto t0 = d[2 * seg], t1 = d[2 * (seg + 1)];
+                        auto frac = (t - t0) / (t1 - t0);
+                        lane.values[b] = d[2 * seg + 1] * (1 - frac) + d[2 * seg + 3] * frac;
+                    }
+                }
+            }
+            else
+            {
+                std::ostringstream oss;
+                oss << "Automation for parameter " << lane.index
+                    << " must be a non empty array of values per block or of (sample, value) "
+                       "breakpoints";
+                throw std::invalid_argument(oss.str().c_str());
+            }
+
+            lanes.push_back(std::move(lane));
+        }
+        return lanes;
+    }
+
+    void applyAutomation(const std::vector<SurgePyAutomationLane> &lanes, int64_t block)
+    {
+        for (auto &l : lanes)
+        {
+            auto p = storage.getPatch().param_ptr[l.index];
+            auto v = l.values[block];
+            if (l.direct)
+            {
+                p->val.f = v;
+                p->bound_value();
+            }
+            else
+            {
+                setParameter01(l.index, p->value_to_normalized(v));
+            }
+        }
+    }
+
+    /*
+     * The whole of a renderEvents call once the python objects are unpacked, so it can run with
+     * the GIL released. Events take effect at the start of the block containing their sample,
+     * and then the automation for that block.
+     */
+    void renderEventsInto(const std::vector<SurgePyEvent> &events,
+                          const std::vector<SurgePyAutomationLane> &lanes, float *dL, float *dR,
+                          int64_t nSamples)
+    {
+        size_t nextEvent = 0;
+        for (int64_t pos = 0; pos < nSamples; pos += BLOCK_SIZE)
+        {
+            while (nextEvent < events.size() && events[nextEvent].sample < pos + BLOCK_SIZE)
+                applyEvent(events[nextEvent++]);
+
+            applyAutomation(lanes, pos / BLOCK_SIZE);
+
+            processPy();
+
+            auto n = std::min((int64_t)BLOCK_SIZE, nSamples - pos);
+            memcpy(dL + pos, output[0], n * sizeof(float));
+            memcpy(dR + pos, output[1], n * sizeof(float));
+        }
+    }
+
+    // Copies, checks and sorts an event array ready for renderEventsInto
+    std::vector<SurgePyEvent> unpackEvents(const SurgePyEventArray &evts)
+    {
+        if (evts.ndim() != 1)
+            throw std::invalid_argument("Events must be a one dimensional array of eventDtype");
+
+        std::vector<SurgePyEvent> events(evts.data(), evts.data() + evts.shape(0));
+        for (auto &e : events)
+        {
+            if (e.sample < 0)
+                throw std::invalid_argument("Events must not have a negative sample time");
+            if (e.type < ev_note_on || e.type > ev_param)
+            {
+                std::ostringstream oss;
+                oss << "Unknown event type " << e.type << " at sample " << e.sample;
+                throw std::invalid_argument(oss.str().c_str());
+            }
+            // These go on to index the synth's channel and key state
+            if (e.type != ev_param && (e.channel < 0 || e.channel > 15))
+            {
+                std::ostringstream oss;
+                oss << "MIDI channel " << e.channel << " at sample " << e.sample
+                    << " is outside 0-15";
+                throw std::invalid_argument(oss.str().c_str());
+            }
+            if (e.type != ev_param && e.type != ev_pitch_bend &&
+                (e.data1 < 0 || e.data1 > 127 || !(e.value >= 0 && e.value <= 127)))
+            {
+                std::ostringstream oss;
+                oss << "Key or CC " << e.data1 << " with value " << e.value << " at sample "
+                    << e.sample << " is outside 0-127";
+                throw std::invalid_argument(oss.str().c_str());
+            }
+            if (e.type == ev_param &&
+                (e.data1 < 0 || e.data1 >= (int)storage.getPatch().param_ptr.size() ||
+                 !storage.getPatch().param_ptr[e.data1]))
+            {
+                std::ostringstream oss;
+                oss << "Unknown parameter id " << e.data1 << " at sample " << e.sample;
+                throw std::invalid_argument(oss.str().c_str());
+            }
+        }
+        std::stable_sort(events.begin(), events.end(),
+                         [](const SurgePyEvent &a, const SurgePyEvent &b) {
+                             return a.sample < b.sample;
+                         });
+        return events;
+    }
+
+    py::array_t<float> renderEvents(const SurgePyEventArray &evts, int64_t nSamples,
+                                    const py::dict &automation)
+    {
+        if (nSamples < 0)
+            throw std::invalid_argument("nSamples must not be negative");
+
+        auto events = unpackEvents(evts);
+        auto lanes = makeAutomationLanes(automation, (nSamples + BLOCK_SIZE - 1) / BLOCK_SIZE);
+
+        auto res = py::array_t<float>({(py::ssize_t)2, (py::ssize_t)nSamples});
+        auto dL = res.mutable_data();
+        auto dR = dL + nSamples;
+
+        {
+            py::gil_scoped_release release;
+            renderEventsInto(events, lanes, dL, dR, nSamples);
+        }
+        return res;
+    }
+
     void loadPatchPy(const std::string &s)
     {
         if (!fs::exists(string_to_path(s)))
@@ -588,10 +868,102 @@ class SurgeSynthesizerWithPythonExtensions : public SurgeSynthesizer
 
     py::array_t<float> getOutput()
     {
-        return py::array_t<float>({2, BLOCK_SIZE}, {2 * sizeof(float), sizeof(float)},
+        return py::array_t<float>({2, BLOCK_SIZE}, {BLOCK_SIZE * sizeof(float), sizeof(float)},
                                   (const float *)(&output[0][0]));
     }
 
+    /*
+     * The views share memory with the engine, which the next process overwrites, and keep this
+     * instance alive for as long as they live. Outputs are read only; the input is for writing.
+     */
+    py::array_t<float> view(float *data, std::vector<py::ssize_t> shape,
+                            std::vector<py::ssize_t> strides, bool writeable)
+    {
+        for (auto &s : strides)
+            s *= sizeof(float);
+        auto res = py::array_t<float>(shape, strides, data, py::cast(this));
+        if (!writeable)
+            res.attr("setflags")(py::arg("write") = false);
+        return res;
+    }
+
+    py::array_t<float> getOutputView()
+    {
+        return view(&output[0][0], {2, BLOCK_SIZE}, {BLOCK_SIZE, 1}, false);
+    }
+
+    // sceneout is oversampled while the scene renders and downsampled in place by the end of it
+    py::array_t<float> getSceneOutputView()
+    {
+        return view(&sceneout[0][0][0], {n_scenes, 2, BLOCK_SIZE},
+                    {2 * BLOCK_SIZE_OS, BLOCK_SIZE_OS, 1}, false);
+    }
+
+    py::array_t<float> getInputView()
+    {
+        return view(&input[0][0], {2, BLOCK_SIZE}, {BLOCK_SIZE, 1}, true);
+    }
+
+    void setProcessInput(bool b) { process_input = b; }
+    bool getProcessInput() const { return process_input; }
+
+    void setModulationTrace(const std::vector<SurgePyModSource> &sources, const py::array &out,
+                            int scene)
+    {
+        if (scene < 0 || scene >= n_scenes)
+            throw std::invalid_argument("Scene must be 0 or 1");
+        if (!py::isinstance<py::array_t<float, py::array::c_style>>(out) || out.ndim() != 2 ||
+            out.shape(1) != (py::ssize_t)sources.size())
+        {
+            std::ostringstream oss;
+            oss << "The trace must be a C contiguous float32 array of shape (nBlocks, "
+                << sources.size() << ")";
+            throw std::invalid_argument(oss.str().c_str());
+        }
+
+        // Written in place, so no conversions
+        auto arr = py::reinterpret_borrow<py::array_t<float>>(out);
+        SurgePyModTrace t;
+        t.owner = arr;
+        t.data = arr.mutable_data();
+        t.rows = out.shape(0);
+        t.scene = scene;
+        for (auto &s : sources)
+            t.sources.push_back((modsources)s.getModSource());
+        modTrace = std::move(t);
+    }
+    void clearModulationTrace() { modTrace = SurgePyModTrace(); }
+    int64_t getModulationTraceBlocks() const { return modTrace.next; }
+
+    void recordModulationTrace()
+    {
+        auto &t = modTrace;
+        if (t.next >= t.rows)
+            return;
+
+        auto &vl = voices[t.scene];
+        auto newest = vl.empty() ? nullptr : *(vl.end() - 1);
+        auto &scene = storage.getPatch().scene[t.scene];
+        auto row = t.data + t.next * t.sources.size();
+        for (auto ms : t.sources)
+        {
+            ModulationSource *src = nullptr;
+            if (isScenelevel(ms))
+                src = scene.modsources[ms];
+            else if (newest)
+                src = newest->modsources[ms];
+            *row++ = src ? src->get_output(0) : 0.f;
+        }
+        t.next++;
+    }
+
+    // Every block python asks for goes through here, so the trace sees them all
+    void processPy()
+    {
+        process();
+        recordModulationTrace();
+    }
+
     void setModulationPy(const SurgePyNamedParam &to, SurgePyModSource const &from, float amt)
     {
         // FIXME - 4871
@@ -683,7 +1055,7 @@ class SurgeSynthesizerWithPythonExtensions : public SurgeSynthesizer
 
         for (auto i = 0; i < blockIterations; ++i)
         {
-            process();
+            processPy();
             memcpy((void *)dL, (void *)(output[0]), BLOCK_SIZE * sizeof(float));
             memcpy((void *)dR, (void *)(output[1]), BLOCK_SIZE * sizeof(float));
 
@@ -809,12 +1181,52 @@ class SurgeSynthesizerWithPythonExtensions : public SurgeSynthesizer
     void retuneToStandardTuning() { storage.retuneTo12TETScaleC261Mapping(); }
     void remapToStandardKeyboard() { storage.remapToConcertCKeyboard(); }
     void retuneToStandardScale() { storage.retuneTo12TETScale(); }
+
+    bool hasBlockProfiler() const { return storage.profiler != nullptr; }
+    py::dict getBlockProfile()
+    {
+        if (!storage.profiler)
+            throw std::runtime_error("This surgepy was built without SURGE_BLOCK_PROFILING");
+
+        auto st = storage.profiler->stats();
+        auto res = py::dict();
+        res["blocks"] = st.blocks;
+        res["historyBlocks"] = st.historyBlocks;
+
+        auto stages = py::list();
+        for (auto &s : st.stages)
+        {
+            auto d = py::dict();
+            d["name"] = s.name;
+            d["stage"] = s.stage;
+            d["meanNS"] = s.mean;
+            d["p50NS"] = s.p50;
+            d["p99NS"] = s.p99;
+            d["maxNS"] = s.max;
+            d["share"] = s.share;
+            d["totalNS"] = s.totalNS;
+            stages.append(d);
+        }
+        res["stages"] = stages;
+        return res;
+    }
+    void resetBlockProfile()
+    {
+        if (storage.profiler)
+            storage.profiler->reset();
+    }
+
+  private:
+    SurgePyModTrace modTrace;
 };
 
 SurgeSynthesizer *createSurge(float sr)
 {
-    if (spysetup_parent == nullptr)
-        spysetup_parent = std::make_unique<HeadlessPluginLayerProxy>();
+    {
+        std::lock_guard<std::mutex> lg(spysetup_mutex);
+        if (spysetup_parent == nullptr)
+            spysetup_parent = std::make_unique<HeadlessPluginLayerProxy>();
+    }
     auto surge = new SurgeSynthesizerWithPythonExtensions(spysetup_parent.get());
     surge->setSamplerate(sr);
     surge->time_data.tempo = 120;
@@ -822,9 +1234,193 @@ SurgeSynthesizer *createSurge(float sr)
     return surge;
 }
 
+/*
+ * SurgeFarm owns n engines and renders lists of jobs across them on a pool of native threads,
+ * with the GIL released. The engines share what every storage in a process shares (the tables,
+ * the parsed documentation and the patch and wavetable lists; see SharedResources.h) so a farm
+ * costs far less than n separate createSurge calls.
+ *
+ * Job i always renders on engine i % n, and each engine renders its jobs in list order, back to
+ * back, much as a live synth plays one patch after another. Only notes are stopped between
+ * jobs, so FX tails, modulator state and parameters set by a job's automation carry into the
+ * engine's next job, and a job with no patch plays whatever its engine last had. Each job
+ * also reseeds the engine's random generators, and those of its thread, from seed + i. So the
+ * audio depends only on the job list, the seed and the engines' state before the render, and
+ * the same list on a freshly made farm renders the same every time, however the threads are
+ * scheduled.
+ *
+ * All of a render's output goes in one contiguous float buffer, which the caller may supply,
+ * and each job's result is a 2 x nSamples numpy view into it.
+ */
+class SurgePyFarm
+{
+  public:
+    SurgePyFarm(int n, float sampleRate)
+    {
+        if (n < 1)
+            throw std::invalid_argument("A SurgeFarm needs at least one engine");
+
+        for (int i = 0; i < n; ++i)
+            engines.emplace_back(
+                static_cast<SurgeSynthesizerWithPythonExtensions *>(createSurge(sampleRate)));
+
+        // The calling thread takes jobs too, so that makes n threads
+        if (n > 1)
+            pool = std::make_unique<Surge::Threading::WorkerPool>(n - 1);
+    }
+
+    int size() const { return (int)engines.size(); }
+
+    SurgeSynthesizerWithPythonExtensions &getEngine(int i)
+    {
+        if (i < 0 || i >= size())
+            throw std::out_of_range("getEngine called with an invalid engine index");
+        return *engines[i];
+    }
+
+    py::list render(const py::list &jobList, const py::object &out, uint32_t seed)
+    {
+        std::vector<Job> jobs;
+        int64_t total = 0;
+        auto &e0 = *engines[0];
+
+        for (auto item : jobList)
+        {
+            auto t = item.cast<py::sequence>();
+            if (t.size() < 3 || t.size() > 4)
+                throw std::invalid_argument("Each job is (patch, events, nSamples) or (patch, "
+                                            "events, nSamples, automation)");
+
+            Job j;
+            if (!t[0].is_none())
+            {
+                j.patch = t[0].cast<std::string>();
+                if (!fs::exists(string_to_path(j.patch)))
+                {
+                    auto msg = std::string("File not found: ") + j.patch;
+                    throw std::invalid_argument(msg.c_str());
+                }
+            }
+            j.events = e0.unpackEvents(t[1].cast<SurgePyEventArray>());
+            j.nSamples = t[2].cast<int64_t>();
+            if (j.nSamples < 0)
+                throw std::invalid_argument("nSamples must not be negative");
+            auto automation = t.size() > 3 ? t[3].cast<py::dict>() : py::dict();
+            j.lanes =
+                e0.makeAutomationLanes(automation, (j.nSamples + BLOCK_SIZE - 1) / BLOCK_SIZE);
+
+            j.offset = total;
+            total += 2 * j.nSamples;
+            jobs.push_back(std::move(j));
+        }
+
+        py::array_t<float> buffer;
+        if (out.is_none())
+        {
+            buffer = py::array_t<float>((py::ssize_t)total);
+        }
+        else
+        {
+            // Written in place, so no conversions
+            if (!py::isinstance<py::array_t<float, py::array::c_style>>(out))
+                throw std::invalid_argument("out must be a C contiguous float32 numpy array");
+            buffer = py::reinterpret_borrow<py::array_t<float>>(out);
+            if (buffer.size() < total)
+            {
+                std::ostringstream oss;
+                oss << "out holds " << buffer.size() << " floats but these jobs need " << total;
+                throw std::invalid_argument(oss.str().c_str());
+            }
+        }
+
+        Run run{this, &jobs, total ? buffer.mutable_data() : nullptr, seed};
+        {
+            py::gil_scoped_release release;
+            if (pool)
+                pool->runAndJoin(&SurgePyFarm::engineLoop, &run, size());
+            else
+                engineLoop(&run, 0);
+        }
+
+        for (auto &j : jobs)
+            if (!j.error.empty())
+                throw std::runtime_error(j.error);
+
+        auto res = py::list();
+        for (auto &j : jobs)
+        {
+            res.append(py::array_t<float>(
+                {(py::ssize_t)2, (py::ssize_t)j.nSamples},
+                {(py::ssize_t)(j.nSamples * sizeof(float)), (py::ssize_t)sizeof(float)},
+                run.base + j.offset, buffer));
+        }
+        return res;
+    }
+
+  private:
+    struct Job
+    {
+        std::string patch;
+        std::vector<SurgePyEvent> events;
+        std::vector<SurgePyAutomationLane> lanes;
+        int64_t nSamples{0}, offset{0};
+        std::string error;
+    };
+
+    struct Run
+    {
+        SurgePyFarm *farm;
+        std::vector<Job> *jobs;
+        float *base;
+        uint32_t seed;
+    };
+
+    // Engine e renders jobs e, e + n, e + 2n, ... in order
+    static void engineLoop(void *ctx, int e)
+    {
+        auto run = static_cast<Run *>(ctx);
+        auto &s = *run->farm->engines[e];
+        for (size_t i = e; i < run->jobs->size(); i += run->farm->engines.size())
+        {
+            auto &j = (*run->jobs)[i];
+            auto seed = run->seed + (uint32_t)i;
+
+            // Oscillator drift and friends draw from the thread's generator; see threadRand
+            auto priorRNG = SurgeStorage::threadRNGGen;
+            SurgeStorage::RNGGen threadGen;
+            threadGen.g.seed(seed);
+            SurgeStorage::threadRNGGen = &threadGen;
+
+            s.seedRandomGenerators(seed);
+            if (!j.patch.empty() && !s.loadPatchByPath(j.patch.c_str(), -1, "Python"))
+            {
+                j.error = "Unable to load patch " + j.patch;
+            }
+            else
+            {
+                s.allNotesOff();
+
+                auto dL = run->base + j.offset;
+                s.renderEventsInto(j.events, j.lanes, dL, dL + j.nSamples, j.nSamples);
+            }
+
+            SurgeStorage::threadRNGGen = priorRNG;
+        }
+    }
+
+    std::vector<std::unique_ptr<SurgeSynthesizerWithPythonExtensions>> engines;
+    std::unique_ptr<Surge::Threading::WorkerPool> pool;
+};
+
 PYBIND11_MODULE(surgepy, m)
 {
     m.doc() = "Python bindings for Surge Synthesizer";
+
+    PYBIND11_NUMPY_DTYPE(SurgePyEvent, sample, type, channel, data1, value);
+    m.def(
+        "eventDtype", []() { return py::dtype::of<SurgePyEvent>(); },
+        "The numpy dtype of the event arrays renderEvents takes: sample (int64), type, channel, "
+        "data1 (int32) and value (float32). See the ev_ constants for the types.");
     m.def("createSurge", &createSurge, "Create a surge instance", py::arg("sampleRate"));
     m.def(
         "getVersion", []() { return Surge::Build::FullVersionStr; }, "Get the version of Surge");
@@ -919,10 +1515,37 @@ PYBIND11_MODULE(surgepy, m)
         .def("getAllModRoutings", &SurgeSynthesizerWithPythonExtensions::getAllModRoutings,
              "Get the entire modulation matrix for this instance")
 
-        .def("process", &SurgeSynthesizer::process,
+        .def("process", &SurgeSynthesizerWithPythonExtensions::processPy,
              "Run surge for one block and update the internal output buffer.")
         .def("getOutput", &SurgeSynthesizerWithPythonExtensions::getOutput,
              "Retrieve the internal output buffer as a 2xBLOCK_SIZE numpy array.")
+        .def("getOutputView", &SurgeSynthesizerWithPythonExtensions::getOutputView,
+             "A read only 2 x BLOCK_SIZE numpy view of the output buffer, which each process "
+             "updates in place.")
+        .def("getSceneOutputView", &SurgeSynthesizerWithPythonExtensions::getSceneOutputView,
+             "A read only n_scenes x 2 x BLOCK_SIZE numpy view of each scene's output before the "
+             "send and global effects,\n"
+             "which each process updates in place.")
+        .def("getInputView", &SurgeSynthesizerWithPythonExtensions::getInputView,
+             "A writable 2 x BLOCK_SIZE numpy view of the audio input, which the next process "
+             "feeds to the audio input\n"
+             "oscillator and the vocoder. Input is only read once setProcessInput(True) is set.")
+        .def("setProcessInput", &SurgeSynthesizerWithPythonExtensions::setProcessInput,
+             "Have process read the input buffer, as a host with input busses would.",
+             py::arg("processInput"))
+        .def("getProcessInput", &SurgeSynthesizerWithPythonExtensions::getProcessInput,
+             "Does process read the input buffer?")
+        .def("setModulationTrace", &SurgeSynthesizerWithPythonExtensions::setModulationTrace,
+             "Record the output of each of a list of modulation sources into out, a float32 "
+             "array of shape\n"
+             "(nBlocks, len(sources)), one row per block processed until it is full. Voice "
+             "sources read the newest voice in the scene.",
+             py::arg("sources"), py::arg("out"), py::arg("scene") = 0)
+        .def("clearModulationTrace", &SurgeSynthesizerWithPythonExtensions::clearModulationTrace,
+             "Stop recording modulation sources and release the trace array.")
+        .def("getModulationTraceBlocks",
+             &SurgeSynthesizerWithPythonExtensions::getModulationTraceBlocks,
+             "How many rows of the modulation trace have been written.")
 
         .def("createMultiBlock", &SurgeSynthesizerWithPythonExtensions::createMultiBlock,
              "Create a numpy array suitable to hold up to b blocks of Surge processing in "
@@ -934,6 +1557,19 @@ PYBIND11_MODULE(surgepy, m)
              "entire array, or starting at startBlock position in the output, populate nBlocks.",
              py::arg("val"), py::arg("startBlock") = 0, py::arg("nBlocks") = -1)
 
+        .def("renderEvents", &SurgeSynthesizerWithPythonExtensions::renderEvents,
+             "Render nSamples of audio, applying a numpy array of timed events (with dtype "
+             "eventDtype()) as it goes,\n"
+             "and return it as a 2 x nSamples numpy array. Events apply at the start of the block "
+             "holding their sample.\n"
+             "The render runs without the GIL, so instances can render in parallel from python "
+             "threads; don't use this instance from another thread while it renders.\n"
+             "automation maps parameters (a SurgeNamedParamId or its synth side id) to a numpy "
+             "array of values, in the units of setParamVal,\n"
+             "either one per block or n x 2 (sample, value) breakpoints interpolated linearly; "
+             "these apply after the block's events.",
+             py::arg("events"), py::arg("nSamples"), py::arg("automation") = py::dict())
+
         .def("getPatch", &SurgeSynthesizerWithPythonExtensions::getPatchAsPy,
              "Get a python dictionary with the Surge parameters laid out in the logical patch "
              "format")
@@ -949,7 +1585,37 @@ PYBIND11_MODULE(surgepy, m)
              "Load an KBM mapping file and apply tuning to this instance")
         .def("remapToStandardKeyboard",
              &SurgeSynthesizerWithPythonExtensions::remapToStandardKeyboard,
-             "Return to standard C centered keyboard mapping");
+             "Return to standard C centered keyboard mapping")
+
+        .def("hasBlockProfiler", &SurgeSynthesizerWithPythonExtensions::hasBlockProfiler,
+             "True if this build times each stage of processing; see getBlockProfile")
+        .def("getBlockProfile", &SurgeSynthesizerWithPythonExtensions::getBlockProfile,
+             "Get the time per block spent in each stage of processing (control, each scene, its "
+             "voices and filters, and each FX slot) over the recent blocks, as a dictionary.\n"
+             "Requires a build with SURGE_BLOCK_PROFILING.")
+        .def("resetBlockProfile", &SurgeSynthesizerWithPythonExtensions::resetBlockProfile,
+             "Clear the block profile; takes effect at the end of the next block");
+
+    py::class_<SurgePyFarm>(m, "SurgeFarm")
+        .def(py::init<int, float>(), "Create n Surge engines which share their resources",
+             py::arg("n"), py::arg("sampleRate"))
+        .def("size", &SurgePyFarm::size, "The number of engines")
+        .def("getEngine", &SurgePyFarm::getEngine,
+             "Get engine i, to set it up before a render; it lives as long as the farm",
+             py::return_value_policy::reference_internal, py::arg("i"))
+        .def("render", &SurgePyFarm::render,
+             "Render a list of jobs across the engines in parallel; job i renders on engine i % n, "
+             "after that engine's\n"
+             "earlier jobs, with its random generators seeded from seed + i, so the same jobs on "
+             "a new farm always render\n"
+             "the same. Each job is a tuple "
+             "(patch, events, nSamples) or (patch, events, nSamples, automation), where patch is "
+             "a path or None to keep the engine's\n"
+             "current patch and the rest are as renderEvents. Returns a list of 2 x nSamples "
+             "numpy arrays, one per job, which are\n"
+             "views into a single buffer; pass out, a float32 array of at least 2 x the total "
+             "samples, to render into your own.",
+             py::arg("jobs"), py::arg("out") = py::none(), py::arg("seed") = 0);
 
     py::class_<SurgePyControlGroup>(m, "SurgeControlGroup")
         .def("getId", &SurgePyControlGroup::getControlGroupId)
@@ -1075,6 +1741,12 @@ PYBIND11_MODULE(surgepy, m)
     C(fxslot_global1);
     C(fxslot_global2);
 
+    C(ev_note_on);
+    C(ev_note_off);
+    C(ev_cc);
+    C(ev_pitch_bend);
+    C(ev_param);
+
     C(pm_poly);
     C(pm_mono);
     C(pm_mono_st);
@@ -104,6 +104,14 @@ void SurgefxAudioProcessor::changeProgramName(int index, const juce::String &new
 void SurgefxAudioProcessor::prepareToPlay(double sr, int samplesPerBlock)
 {
     storage->setSamplerate(sr);
+
+    /*
+     * samplesPerBlock is only the most we'll be sent, and hosts split buffers wherever they
+     * like, so everything goes through the FIFO. That makes the latency the same for the whole
+     * of playback, and this is the one place it is reported.
+     */
+    fifo.reset();
+    setLatencySamples(BlockFifo::latency);
 }
 
 void SurgefxAudioProcessor::releaseResources()
@@ -120,8 +128,6 @@ bool SurgefxAudioProcessor::isBusesLayoutSupported(const BusesLayout &layouts) c
            layouts.getMainInputChannelSet() == juce::AudioChannelSet::stereo();
 }
 
-#define is_aligned(POINTER, BYTE_COUNT) (((uintptr_t)(const void *)(POINTER)) % (BYTE_COUNT) == 0)
-
 void SurgefxAudioProcessor::processBlock(juce::AudioBuffer<float> &buffer,
                                          juce::MidiBuffer &midiMessages)
 {
@@ -168,48 +174,39 @@ void SurgefxAudioProcessor::processBlock(juce::AudioBuffer<float> &buffer,
         audio_thread_surge_effect = surge_effect;
     }
 
-    for (int outPos = 0; outPos < buffer.getNumSamples() && !resettingFx; outPos += BLOCK_SIZE)
+    const float *side[2] = {nullptr, nullptr};
+    auto sideChainBus = getBus(true, 1);
+    if (effectNum == fxt_vocoder && sideChainBus && sideChainBus->isEnabled() &&
+        sideChainInput.getNumChannels() > 0)
     {
-        auto outL = mainInputOutput.getWritePointer(0, outPos);
-        auto outR = mainInputOutput.getWritePointer(1, outPos);
-
-        auto sideChainBus = getBus(true, 1);
-        if (effectNum == fxt_vocoder && sideChainBus && sideChainBus->isEnabled())
-        {
-            auto sideL = sideChainInput.getReadPointer(0, outPos);
-            auto sideR = sideChainInput.getReadPointer(1, outPos);
-
-            memcpy(storage->audio_in_nonOS[0], sideL, BLOCK_SIZE * sizeof(float));
-            memcpy(storage->audio_in_nonOS[1], sideR, BLOCK_SIZE * sizeof(float));
-        }
-
-        for (int i = 0; i < n_fx_params; ++i)
-        {
-            fxstorage->p[fx_param_remap[i]].set_value_f01(*fxParams[i]);
-            paramFeatureOntoParam(&(fxstorage->p[fx_param_remap[i]]), *(fxParamFeatures[i]));
-        }
-        copyGlobaldataSubset(storage_id_start, storage_id_end);
-
-        if (is_aligned(outL, 16) && is_aligned(outR, 16))
-        {
-            audio_thread_surge_effect->process(outL, outR);
-        }
-        else
-        {
-            float bufferL alignas(16)[BLOCK_SIZE], bufferR alignas(16)[BLOCK_SIZE];
-
-            auto inL = mainInputOutput.getReadPointer(0, outPos);
-            auto inR = mainInputOutput.getReadPointer(1, outPos);
-
-            memcpy(bufferL, inL, BLOCK_SIZE * sizeof(float));
-            memcpy(bufferR, inR, BLOCK_SIZE * sizeof(float));
+        side[0] = sideChainInput.getReadPointer(0);
+        side[1] = sideChainInput.getReadPointer(sideChainInput.getNumChannels() > 1 ? 1 : 0);
+    }
 
-            audio_thread_surge_effect->process(bufferL, bufferR);
+    fifo.process(
+        mainInputOutput.getWritePointer(0), mainInputOutput.getWritePointer(1), side[0], side[1],
+        buffer.getNumSamples(),
+        [this](float *L, float *R, const float *sideL, const float *sideR) {
+            if (effectNum == fxt_vocoder)
+            {
+                memcpy(storage->audio_in_nonOS[0], sideL, BLOCK_SIZE * sizeof(float));
+                memcpy(storage->audio_in_nonOS[1], sideR, BLOCK_SIZE * sizeof(float));
+            }
+            processEffectBlock(L, R);
+        },
+        [this]() { return !resettingFx; });
+}
 
-            memcpy(outL, bufferL, BLOCK_SIZE * sizeof(float));
-            memcpy(outR, bufferR, BLOCK_SIZE * sizeof(float));
-        }
+void SurgefxAudioProcessor::processEffectBlock(float *dataL, float *dataR)
+{
+    for (int i = 0; i < n_fx_params; ++i)
+    {
+        fxstorage->p[fx_param_remap[i]].set_value_f01(*fxParams[i]);
+        paramFeatureOntoParam(&(fxstorage->p[fx_param_remap[i]]), *(fxParamFeatures[i]));
     }
+    copyGlobaldataSubset(storage_id_start, storage_id_end);
+
+    audio_thread_surge_effect->process(dataL, dataR);
 }
 
 //==============================================================================
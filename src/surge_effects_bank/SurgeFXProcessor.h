@@ -12,6 +12,7 @@
 
 #include "SurgeStorage.h"
 #include "Effect.h"
+#include "BlockFifo.h"
 
 #include "juce_audio_processors/juce_audio_processors.h"
 
@@ -299,5 +300,11 @@ class SurgefxAudioProcessor : public juce::AudioProcessor,
     void copyGlobaldataSubset(int start, int end);
     void setupStorageRanges(Parameter *start, Parameter *endIncluding);
 
+    // Runs the effect on one BLOCK_SIZE block, in place; the pointers must be 16 byte aligned
+    void processEffectBlock(float *dataL, float *dataR);
+
+    // Any host buffer size goes through this, for one block of latency
+    BlockFifo fifo;
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SurgefxAudioProcessor)
 };
@@ -161,6 +161,7 @@ void SurgeSynthProcessor::changeProgramName(int index, const String &newName) {}
 void SurgeSynthProcessor::prepareToPlay(double sr, int samplesPerBlock)
 {
     surge->setSamplerate(sr);
+    surge->setHostBlockSize(samplesPerBlock);
     surge->audio_processing_active = true;
 }
 
@@ -215,47 +216,12 @@ void SurgeSynthProcessor::processBlock(AudioBuffer<float> &buffer, MidiBuffer &m
         surge->resetStateFromTimeData();
     }
 
+    // The keyboard state only drives the on-screen keyboard, so it can see the whole buffer
+    // up front. The synth itself gets each message at its sample position in the loop below.
     for (const MidiMessageMetadata it : midiMessages)
     {
-        MidiMessage m = it.getMessage();
-        const int ch = m.getChannel() - 1;
         juce::ScopedValueSetter<bool> midiAdd(isAddingFromMidi, true);
-        midiKeyboardState.processNextMidiEvent(m);
-
-        if (m.isNoteOn())
-        {
-            surge->playNote(ch, m.getNoteNumber(), m.getVelocity(), 0);
-        }
-        else if (m.isNoteOff())
-        {
-            surge->releaseNote(ch, m.getNoteNumber(), m.getVelocity());
-        }
-        else if (m.isChannelPressure())
-        {
-            surge->channelAftertouch(ch, m.getChannelPressureValue());
-        }
-        else if (m.isAftertouch())
-        {
-            surge->polyAftertouch(ch, m.getNoteNumber(), m.getAfterTouchValue());
-        }
-        else if (m.isPitchWheel())
-        {
-            surge->pitchBend(ch, m.getPitchWheelValue() - 8192);
-        }
-        else if (m.isController())
-        {
-            surge->channelController(ch, m.getControllerNumber(), m.getControllerValue());
-        }
-        else if (m.isProgramChange())
-        {
-            // apparently this is not enough to actually execute SurgeSynthesizer::programChange
-            // for whatever reason!
-            surge->programChange(ch, m.getProgramChangeNumber());
-        }
-        else
-        {
-            // std::cout << "Ignoring message " << std::endl;
-        }
+        midiKeyboardState.processNextMidiEvent(it.getMessage());
     }
 
     midiR rec;
@@ -267,11 +233,15 @@ void SurgeSynthProcessor::processBlock(AudioBuffer<float> &buffer, MidiBuffer &m
             surge->releaseNote(rec.ch, rec.note, rec.vel);
     }
 
+    auto midiIt = midiMessages.findNextSamplePosition(0);
+
     // Make sure we have a main output
     auto mb = getBus(false, 0);
     if (mb->getNumberOfChannels() != 2 || !mb->isEnabled())
     {
-        // We have to have a stereo output
+        // We have to have a stereo output, but don't drop the MIDI on the floor
+        for (; midiIt != midiMessages.cend(); ++midiIt)
+            applyMidiMessage((*midiIt).getMessage());
         return;
     }
     auto mainOutput = getBusBuffer(buffer, false, 0);
@@ -279,58 +249,38 @@ void SurgeSynthProcessor::processBlock(AudioBuffer<float> &buffer, MidiBuffer &m
     auto mainInput = getBusBuffer(buffer, true, 0);
     auto sceneAOutput = getBusBuffer(buffer, false, 1);
     auto sceneBOutput = getBusBuffer(buffer, false, 2);
-    for (int i = 0; i < buffer.getNumSamples(); i++)
-    {
-        auto outL = mainOutput.getWritePointer(0, i);
-        auto outR = mainOutput.getWritePointer(1, i);
-
-        surge->time_data.ppqPos += (double)BLOCK_SIZE * surge->time_data.tempo / (60. * samplerate);
 
-        if (blockPos == 0 && mainInput.getNumChannels() > 0)
-        {
-            auto inL = mainInput.getReadPointer(0, i);
-            auto inR = inL;                     // assume mono
-            if (mainInput.getNumChannels() > 1) // unless its not
-            {
-                inR = mainInput.getReadPointer(1, i);
-            }
-            surge->process_input = true;
-            memcpy(&(surge->input[0][0]), inL, BLOCK_SIZE * sizeof(float));
-            memcpy(&(surge->input[1][0]), inR, BLOCK_SIZE * sizeof(float));
-        }
-        else
-        {
-            surge->process_input = false;
-        }
-        if (blockPos == 0)
+    Surge::HostBufferRenderer::Buffer hb;
+    hb.numSamples = buffer.getNumSamples();
+    hb.out[0] = mainOutput.getWritePointer(0);
+    hb.out[1] = mainOutput.getWritePointer(1);
+    if (mainInput.getNumChannels() > 0)
+    {
+        hb.in[0] = mainInput.getReadPointer(0);
+        hb.in[1] = mainInput.getNumChannels() > 1 ? mainInput.getReadPointer(1) : hb.in[0];
+    }
+    if (surge->activateExtraOutputs && sceneAOutput.getNumChannels() == 2 &&
+        sceneBOutput.getNumChannels() == 2)
+    {
+        for (int c = 0; c < 2; ++c)
         {
-            surge->process();
+            hb.sceneOut[0][c] = sceneAOutput.getWritePointer(c);
+            hb.sceneOut[1][c] = sceneBOutput.getWritePointer(c);
         }
-        *outL = surge->output[0][blockPos];
-        *outR = surge->output[1][blockPos];
+    }
+    hb.ppqPerSample = surge->time_data.tempo / (60. * samplerate);
 
-        if (surge->activateExtraOutputs && sceneAOutput.getNumChannels() == 2 &&
-            sceneBOutput.getNumChannels() == 2)
+    renderer.render(*surge, hb, [&](int upTo) {
+        while (midiIt != midiMessages.cend() && (*midiIt).samplePosition <= upTo)
         {
-            auto sAL = sceneAOutput.getWritePointer(0, i);
-            auto sAR = sceneAOutput.getWritePointer(1, i);
-            auto sBL = sceneBOutput.getWritePointer(0, i);
-            auto sBR = sceneBOutput.getWritePointer(1, i);
-
-            if (sAL && sAR)
-            {
-                *sAL = surge->sceneout[0][0][blockPos];
-                *sAR = surge->sceneout[0][1][blockPos];
-            }
-            if (sBL && sBR)
-            {
-                *sBL = surge->sceneout[1][0][blockPos];
-                *sBR = surge->sceneout[1][1][blockPos];
-            }
+            applyMidiMessage((*midiIt).getMessage());
+            ++midiIt;
         }
+    });
 
-        blockPos = (blockPos + 1) & (BLOCK_SIZE - 1);
-    }
+    // Anything after the last block start in this buffer lands on the first block of the next
+    for (; midiIt != midiMessages.cend(); ++midiIt)
+        applyMidiMessage((*midiIt).getMessage());
 
     if (checkNamesEvery++ > 10)
     {
@@ -342,6 +292,46 @@ void SurgeSynthProcessor::processBlock(AudioBuffer<float> &buffer, MidiBuffer &m
     }
 }
 
+void SurgeSynthProcessor::applyMidiMessage(const juce::MidiMessage &m)
+{
+    const int ch = m.getChannel() - 1;
+
+    if (m.isNoteOn())
+    {
+        surge->playNote(ch, m.getNoteNumber(), m.getVelocity(), 0);
+    }
+    else if (m.isNoteOff())
+    {
+        surge->releaseNote(ch, m.getNoteNumber(), m.getVelocity());
+    }
+    else if (m.isChannelPressure())
+    {
+        surge->channelAftertouch(ch, m.getChannelPressureValue());
+    }
+    else if (m.isAftertouch())
+    {
+        surge->polyAftertouch(ch, m.getNoteNumber(), m.getAfterTouchValue());
+    }
+    else if (m.isPitchWheel())
+    {
+        surge->pitchBend(ch, m.getPitchWheelValue() - 8192);
+    }
+    else if (m.isController())
+    {
+        surge->channelController(ch, m.getControllerNumber(), m.getControllerValue());
+    }
+    else if (m.isProgramChange())
+    {
+        // apparently this is not enough to actually execute SurgeSynthesizer::programChange
+        // for whatever reason!
+        surge->programChange(ch, m.getProgramChangeNumber());
+    }
+    else
+    {
+        // std::cout << "Ignoring message " << std::endl;
+    }
+}
+
 //==============================================================================
 bool SurgeSynthProcessor::hasEditor() const
 {
@@ -12,6 +12,7 @@
 
 #include "SurgeSynthesizer.h"
 #include "SurgeStorage.h"
+#include "HostBufferRenderer.h"
 #include "LockFreeStack.h"
 
 #include "juce_audio_processors/juce_audio_processors.h"
@@ -222,7 +223,9 @@ class SurgeSynthProcessor : public juce::AudioProcessor,
     std::vector<int> presetOrderToPatchList;
     int juceSidePresetId{0};
 
-    int blockPos = 0;
+    Surge::HostBufferRenderer renderer;
+
+    void applyMidiMessage(const juce::MidiMessage &m);
 
     int checkNamesEvery = 0;
 